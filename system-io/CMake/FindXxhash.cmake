@@ -0,0 +1,25 @@
+# - Try to find xxhash
+# Once done, this will define
+#
+# XXHASH_FOUND - system has xxhash
+# XXHASH_INCLUDE_DIRS - the xxhash include directories
+# XXHASH_LIBRARIES - link these to use xxhash
+
+include(FindPackageHandleStandardArgs)
+
+find_library(XXHASH_LIBRARY xxhash
+  PATHS ${XXHASH_LIBRARYDIR})
+
+find_path(XXHASH_INCLUDE_DIR xxhash.h
+  PATHS ${XXHASH_INCLUDEDIR})
+
+find_package_handle_standard_args(xxhash DEFAULT_MSG
+  XXHASH_LIBRARY
+  XXHASH_INCLUDE_DIR)
+
+mark_as_advanced(
+  XXHASH_LIBRARY
+  XXHASH_INCLUDE_DIR)
+
+set(XXHASH_LIBRARIES ${XXHASH_LIBRARY})
+set(XXHASH_INCLUDE_DIRS ${XXHASH_INCLUDE_DIR})
@@ -0,0 +1,25 @@
+# - Try to find zstd
+# Once done, this will define
+#
+# ZSTD_FOUND - system has zstd
+# ZSTD_INCLUDE_DIRS - the zstd include directories
+# ZSTD_LIBRARIES - link these to use zstd
+
+include(FindPackageHandleStandardArgs)
+
+find_library(ZSTD_LIBRARY zstd
+  PATHS ${ZSTD_LIBRARYDIR})
+
+find_path(ZSTD_INCLUDE_DIR zstd.h
+  PATHS ${ZSTD_INCLUDEDIR})
+
+find_package_handle_standard_args(zstd DEFAULT_MSG
+  ZSTD_LIBRARY
+  ZSTD_INCLUDE_DIR)
+
+mark_as_advanced(
+  ZSTD_LIBRARY
+  ZSTD_INCLUDE_DIR)
+
+set(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
+set(ZSTD_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR})
@@ -0,0 +1,75 @@
+#include "system_io/AsyncFile.h"
+
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "system_io/Exception.h"
+
+namespace sysio
+{
+    namespace
+    {
+        const char *opName(IoOpcode opcode)
+        {
+            switch (opcode)
+            {
+                case IoOpcode::kRead:
+                    return "read";
+                case IoOpcode::kWrite:
+                    return "write";
+                case IoOpcode::kFsync:
+                    return "fsync";
+                case IoOpcode::kFdatasync:
+                    return "fdatasync";
+            }
+            return "I/O";
+        }
+    }
+
+    size_t IoAwaitable::await_resume() const
+    {
+        if (request_.result < 0)
+        {
+            throwSystemErrorExplicit(int(-request_.result),
+                                     std::string("asynchronous ") + opName(request_.opcode) + " failed");
+        }
+        return size_t(request_.result);
+    }
+
+    AsyncLineReader::AsyncLineReader(const AsyncFile &file, size_t bufSize, off_t offset)
+            : file_(file),
+              buf_(bufSize),
+              offset_(offset)
+    {
+        CHECK_GT(bufSize, 0u);
+    }
+
+    Task<bool> AsyncLineReader::readLine(std::string &line)
+    {
+        line.clear();
+        for (;;)
+        {
+            const char *begin = buf_.data() + begin_;
+            auto newline = static_cast<const char *>(memchr(begin, '\n', end_ - begin_));
+            if (newline != nullptr)
+            {
+                size_t n = size_t(newline - begin) + 1;
+                line.append(begin, n);
+                begin_ += n;
+                co_return true;
+            }
+            line.append(begin, end_ - begin_);
+            begin_ = end_ = 0;
+            if (eof_)
+            {
+                co_return !line.empty();
+            }
+
+            size_t n = co_await file_.read(buf_.data(), buf_.size(), offset_);
+            offset_ += off_t(n);
+            end_ = n;
+            eof_ = n < buf_.size();
+        }
+    }
+}
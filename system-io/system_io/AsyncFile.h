@@ -0,0 +1,154 @@
+#ifndef SYSTEM_IO_ASYNCFILE_H
+#define SYSTEM_IO_ASYNCFILE_H
+
+#include <sys/types.h>
+
+#include <coroutine>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "system_io/File.h"
+#include "system_io/IoBackend.h"
+#include "system_io/Task.h"
+
+/*
+ * Coroutine interface to a File: reads and writes are co_awaited instead of
+ * blocking, and performed by an IoBackend (a thread pool or io_uring).
+ *
+ * Requires C++20; available when configured with BUILD_CORO, in the
+ * system_io_coro library.
+ *
+ * Example:
+ *   UringBackend backend;
+ *   File file("data");
+ *   AsyncFile async(file, backend);
+ *   std::string buf(4096, '\0');
+ *   size_t n = syncWait(backend, [&]() -> Task<size_t> {
+ *       co_return co_await async.read(&buf[0], buf.size(), 0);
+ *   }());
+ */
+
+namespace sysio
+{
+    /*
+     * Awaitable for one IoRequest.  co_await yields the number of bytes
+     * transferred (less than requested only at EOF when reading), and throws
+     * std::system_error on failure.
+     */
+    class IoAwaitable
+    {
+    public:
+        IoAwaitable(IoBackend &backend, IoOpcode opcode, int fd, char *buf, size_t size, off_t offset)
+                : backend_(backend),
+                  request_{opcode, fd, buf, size, offset}
+        {}
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> waiter)
+        {
+            request_.waiter = waiter;
+            backend_.submit(&request_);
+        }
+
+        size_t await_resume() const;
+
+    private:
+        IoBackend &backend_;
+        IoRequest request_;
+    };
+
+    /*
+     * Asynchronous positional I/O on a file descriptor, which is not owned.
+     */
+    class AsyncFile
+    {
+    public:
+        AsyncFile(const File &file, IoBackend &backend)
+                : fd_(file.fd()),
+                  backend_(backend)
+        {}
+
+        AsyncFile(int fd, IoBackend &backend)
+                : fd_(fd),
+                  backend_(backend)
+        {}
+
+        int fd() const
+        {
+            return fd_;
+        }
+
+        IoBackend &backend() const
+        {
+            return backend_;
+        }
+
+        /*
+         * Reads up to n bytes at offset; fewer only at EOF.
+         */
+        IoAwaitable read(void *buf, size_t n, off_t offset) const
+        {
+            return IoAwaitable(backend_, IoOpcode::kRead, fd_, static_cast<char *>(buf), n, offset);
+        }
+
+        /*
+         * Writes all n bytes at offset.
+         */
+        IoAwaitable write(const void *buf, size_t n, off_t offset) const
+        {
+            return IoAwaitable(backend_, IoOpcode::kWrite, fd_,
+                               static_cast<char *>(const_cast<void *>(buf)), n, offset);
+        }
+
+        IoAwaitable fsync() const
+        {
+            return IoAwaitable(backend_, IoOpcode::kFsync, fd_, nullptr, 0, 0);
+        }
+
+        IoAwaitable fdatasync() const
+        {
+            return IoAwaitable(backend_, IoOpcode::kFdatasync, fd_, nullptr, 0, 0);
+        }
+
+    private:
+        int fd_;
+        IoBackend &backend_;
+    };
+
+    /*
+     * Reads a file line by line through an AsyncFile, bufSize bytes at a
+     * time, starting at offset.
+     */
+    class AsyncLineReader
+    {
+    public:
+        explicit AsyncLineReader(const AsyncFile &file, size_t bufSize = 64 * 1024, off_t offset = 0);
+
+        AsyncLineReader(const AsyncLineReader &) = delete;
+
+        AsyncLineReader &operator=(const AsyncLineReader &) = delete;
+
+        /*
+         * Sets line to the next line, including its trailing newline (unless
+         * it is the last one and the file does not end in one).  Unlike
+         * LineReader, lines are never split.  Returns false at EOF.
+         */
+        Task<bool> readLine(std::string &line);
+
+    private:
+        const AsyncFile &file_;
+        std::vector<char> buf_;
+        off_t offset_;
+        // Unread data is buf_[begin_, end_)
+        size_t begin_ = 0;
+        size_t end_ = 0;
+        bool eof_ = false;
+    };
+}
+
+#endif //SYSTEM_IO_ASYNCFILE_H
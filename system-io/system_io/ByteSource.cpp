@@ -0,0 +1,121 @@
+#include "system_io/ByteSource.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "system_io/FileUtil.h"
+
+namespace sysio
+{
+    ssize_t FdByteSource::read(void *buf, size_t n)
+    {
+        return readFull(fd_, buf, n);
+    }
+
+    PipelinedByteSource::PipelinedByteSource(
+            std::unique_ptr<ByteSource> inner,
+            size_t chunkSize,
+            size_t depth)
+            : inner_(std::move(inner)),
+              chunks_(depth)
+    {
+        CHECK(inner_) << "inner source must not be null";
+        CHECK_GT(chunkSize, 0u);
+        CHECK_GT(depth, 0u);
+        for (auto &chunk : chunks_)
+        {
+            chunk.data.resize(chunkSize);
+        }
+        producer_ = std::thread([this] { produce(); });
+    }
+
+    PipelinedByteSource::~PipelinedByteSource()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        notFull_.notify_one();
+        producer_.join();
+    }
+
+    void PipelinedByteSource::produce()
+    {
+        for (size_t head = 0;; head = (head + 1) % chunks_.size())
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                notFull_.wait(lock, [this] { return stop_ || filled_ < chunks_.size(); });
+                if (stop_)
+                {
+                    return;
+                }
+            }
+
+            // The consumer never touches chunks_[head] until filled_ says so,
+            // so it can be filled without holding the lock.
+            Chunk &chunk = chunks_[head];
+            ssize_t r = inner_->read(chunk.data.data(), chunk.data.size());
+            chunk.error = r == -1 ? errno : 0;
+            chunk.size = r == -1 ? 0 : size_t(r);
+            chunk.last = chunk.size < chunk.data.size();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++filled_;
+            }
+            notEmpty_.notify_one();
+            if (chunk.last)
+            {
+                return;
+            }
+        }
+    }
+
+    ssize_t PipelinedByteSource::read(void *buf, size_t n)
+    {
+        char *out = static_cast<char *>(buf);
+        size_t total = 0;
+        while (total < n && !done_)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                notEmpty_.wait(lock, [this] { return filled_ > 0; });
+            }
+
+            Chunk &chunk = chunks_[tail_];
+            size_t count = std::min(n - total, chunk.size - offset_);
+            memcpy(out + total, chunk.data.data() + offset_, count);
+            total += count;
+            offset_ += count;
+            if (offset_ < chunk.size)
+            {
+                break; // buf is full
+            }
+
+            if (chunk.last)
+            {
+                done_ = true;
+                if (chunk.error != 0)
+                {
+                    errno = chunk.error;
+                    return -1;
+                }
+                break;
+            }
+
+            // Hand the chunk back to the producer.
+            offset_ = 0;
+            tail_ = (tail_ + 1) % chunks_.size();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --filled_;
+            }
+            notFull_.notify_one();
+        }
+        return ssize_t(total);
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef SYSTEM_IO_BYTESOURCE_H
+#define SYSTEM_IO_BYTESOURCE_H
+
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sysio
+{
+    /*
+     * A ByteSource produces a stream of bytes: a file descriptor, a decoder
+     * stacked on top of another source, etc.
+     *
+     * read() has the same contract as readFull(): it returns the number of
+     * bytes stored in buf, which is less than n only at end of stream, or -1
+     * (and sets errno) on error.
+     */
+    class ByteSource
+    {
+    public:
+        virtual ~ByteSource() = default;
+
+        virtual ssize_t read(void *buf, size_t n) = 0;
+    };
+
+    /*
+     * Reads straight from a file descriptor with readFull().
+     * Does not own the file descriptor.
+     */
+    class FdByteSource : public ByteSource
+    {
+    public:
+        explicit FdByteSource(int fd) noexcept : fd_(fd)
+        {}
+
+        ssize_t read(void *buf, size_t n) override;
+
+    private:
+        int const fd_;
+    };
+
+    /*
+     * Runs another ByteSource on a helper thread, so that producing bytes
+     * (e.g. inflating a compressed file) overlaps with consuming them.
+     *
+     * The helper thread reads chunkSize bytes at a time into a ring of depth
+     * chunks and blocks when the ring is full.  Errors from the inner source
+     * are reported by read() once all bytes produced before them have been
+     * consumed.
+     *
+     * Not async-signal-safe.
+     */
+    class PipelinedByteSource : public ByteSource
+    {
+    public:
+        explicit PipelinedByteSource(
+                std::unique_ptr<ByteSource> inner,
+                size_t chunkSize = 1 << 20,
+                size_t depth = 4);
+
+        PipelinedByteSource(const PipelinedByteSource &) = delete;
+
+        PipelinedByteSource &operator=(const PipelinedByteSource &) = delete;
+
+        ~PipelinedByteSource() override;
+
+        ssize_t read(void *buf, size_t n) override;
+
+    private:
+        struct Chunk
+        {
+            std::vector<char> data;
+            size_t size = 0;
+            int error = 0;
+            bool last = false;
+        };
+
+        void produce();
+
+        std::unique_ptr<ByteSource> inner_;
+        std::vector<Chunk> chunks_;
+
+        // Guarded by mutex_: number of chunks filled by the producer and not
+        // yet released by the consumer.
+        std::mutex mutex_;
+        std::condition_variable notFull_;
+        std::condition_variable notEmpty_;
+        size_t filled_ = 0;
+        bool stop_ = false;
+
+        // Consumer side only.
+        size_t tail_ = 0;
+        size_t offset_ = 0;
+        bool done_ = false;
+
+        std::thread producer_;
+    };
+}
+
+#endif //SYSTEM_IO_BYTESOURCE_H
@@ -0,0 +1,250 @@
+#include "system_io/Checksum.h"
+
+#include <cstring>
+
+#ifdef SYSIO_HAVE_XXHASH
+#include <xxhash.h>
+#endif
+
+#include "system_io/Crc32c.h"
+#include "system_io/Exception.h"
+
+namespace sysio
+{
+    namespace
+    {
+        const char kTrailerMagic[7] = {'S', 'Y', 'S', 'I', 'O', 'C', 'K'};
+
+#ifdef SYSIO_HAVE_XXHASH
+        XXH3_state_t *xxh3State(void *state)
+        {
+            return static_cast<XXH3_state_t *>(state);
+        }
+#endif
+    }
+
+    bool hasChecksum(ChecksumType type)
+    {
+        switch (type)
+        {
+            case ChecksumType::kCrc32c:
+                return true;
+            case ChecksumType::kXxh3:
+#ifdef SYSIO_HAVE_XXHASH
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    StreamingChecksum::StreamingChecksum(ChecksumType type) : type_(type)
+    {
+        if (!hasChecksum(type))
+        {
+            throwSystemErrorExplicit(ENOTSUP, "checksum type not supported by this build");
+        }
+#ifdef SYSIO_HAVE_XXHASH
+        if (type_ == ChecksumType::kXxh3)
+        {
+            xxh3_ = XXH3_createState();
+            if (xxh3_ == nullptr)
+            {
+                throwSystemErrorExplicit(ENOMEM, "XXH3_createState() failed");
+            }
+            XXH3_64bits_reset(xxh3State(xxh3_));
+        }
+#endif
+    }
+
+    StreamingChecksum::StreamingChecksum(StreamingChecksum &&other) noexcept
+            : type_(other.type_),
+              crc_(other.crc_),
+              xxh3_(other.xxh3_)
+    {
+        other.xxh3_ = nullptr;
+    }
+
+    StreamingChecksum &StreamingChecksum::operator=(StreamingChecksum &&other) noexcept
+    {
+        std::swap(type_, other.type_);
+        std::swap(crc_, other.crc_);
+        std::swap(xxh3_, other.xxh3_);
+        return *this;
+    }
+
+    StreamingChecksum::~StreamingChecksum()
+    {
+#ifdef SYSIO_HAVE_XXHASH
+        if (xxh3_ != nullptr)
+        {
+            XXH3_freeState(xxh3State(xxh3_));
+        }
+#endif
+    }
+
+    void StreamingChecksum::update(const void *data, size_t n)
+    {
+        switch (type_)
+        {
+            case ChecksumType::kCrc32c:
+                crc_ = crc32c(data, n, crc_);
+                break;
+            case ChecksumType::kXxh3:
+#ifdef SYSIO_HAVE_XXHASH
+                XXH3_64bits_update(xxh3State(xxh3_), data, n);
+#endif
+                break;
+        }
+    }
+
+    uint64_t StreamingChecksum::value() const
+    {
+        switch (type_)
+        {
+            case ChecksumType::kCrc32c:
+                return crc_;
+            case ChecksumType::kXxh3:
+#ifdef SYSIO_HAVE_XXHASH
+                return XXH3_64bits_digest(xxh3State(xxh3_));
+#else
+                break;
+#endif
+        }
+        return 0;
+    }
+
+    void StreamingChecksum::reset()
+    {
+        crc_ = 0;
+#ifdef SYSIO_HAVE_XXHASH
+        if (xxh3_ != nullptr)
+        {
+            XXH3_64bits_reset(xxh3State(xxh3_));
+        }
+#endif
+    }
+
+    uint64_t checksum(ChecksumType type, const void *data, size_t n)
+    {
+        switch (type)
+        {
+            case ChecksumType::kCrc32c:
+                return crc32c(data, n);
+            case ChecksumType::kXxh3:
+#ifdef SYSIO_HAVE_XXHASH
+                return XXH3_64bits(data, n);
+#else
+                break;
+#endif
+        }
+        throwSystemErrorExplicit(ENOTSUP, "checksum type not supported by this build");
+    }
+
+    ssize_t readFull(int fd, void *buf, size_t n, StreamingChecksum &sum)
+    {
+        char *b = static_cast<char *>(buf);
+        ssize_t total = 0;
+        while (n != 0)
+        {
+            size_t want = std::min(n, kChecksumChunkSize);
+            ssize_t r = readFull(fd, b, want);
+            if (r == -1)
+            {
+                return -1;
+            }
+            sum.update(b, size_t(r));
+            total += r;
+            if (size_t(r) < want)
+            {
+                break; // EOF
+            }
+            b += r;
+            n -= size_t(r);
+        }
+        return total;
+    }
+
+    ssize_t writeFull(int fd, const void *buf, size_t n, StreamingChecksum &sum)
+    {
+        const char *b = static_cast<const char *>(buf);
+        ssize_t total = 0;
+        while (n != 0)
+        {
+            size_t chunk = std::min(n, kChecksumChunkSize);
+            sum.update(b, chunk);
+            ssize_t r = writeFull(fd, b, chunk);
+            if (r == -1)
+            {
+                return -1;
+            }
+            total += r;
+            b += chunk;
+            n -= chunk;
+        }
+        return total;
+    }
+
+    ssize_t writevFull(int fd, const iovec *iov, int count, StreamingChecksum &sum)
+    {
+        // writevFull() submits at most 16 buffers per call anyway
+        constexpr int kMaxBatch = 16;
+        iovec batch[kMaxBatch];
+        ssize_t total = 0;
+        int i = 0;
+        size_t offset = 0; // into iov[i]
+        while (i < count)
+        {
+            int batchCount = 0;
+            size_t batchBytes = 0;
+            while (i < count && batchCount < kMaxBatch && batchBytes < kChecksumChunkSize)
+            {
+                char *base = static_cast<char *>(iov[i].iov_base) + offset;
+                size_t len = std::min(iov[i].iov_len - offset, kChecksumChunkSize - batchBytes);
+                sum.update(base, len);
+                batch[batchCount++] = {base, len};
+                batchBytes += len;
+                offset += len;
+                if (offset == iov[i].iov_len)
+                {
+                    ++i;
+                    offset = 0;
+                }
+            }
+            ssize_t r = writevFull(fd, batch, batchCount);
+            if (r == -1)
+            {
+                return -1;
+            }
+            total += r;
+        }
+        return total;
+    }
+
+    void encodeChecksumTrailer(char *out, ChecksumType type, uint64_t value)
+    {
+        memcpy(out, kTrailerMagic, sizeof(kTrailerMagic));
+        out[7] = char(type);
+        for (int i = 0; i < 8; ++i)
+        {
+            out[8 + i] = char(value >> (8 * i));
+        }
+    }
+
+    bool decodeChecksumTrailer(const char *in, ChecksumType *type, uint64_t *value)
+    {
+        if (memcmp(in, kTrailerMagic, sizeof(kTrailerMagic)) != 0)
+        {
+            return false;
+        }
+        *type = ChecksumType(uint8_t(in[7]));
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            v |= uint64_t(uint8_t(in[8 + i])) << (8 * i);
+        }
+        *value = v;
+        return true;
+    }
+}
@@ -0,0 +1,256 @@
+#ifndef SYSTEM_IO_CHECKSUM_H
+#define SYSTEM_IO_CHECKSUM_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "system_io/FileUtil.h"
+#include "system_io/ScopeGuard.h"
+
+/*
+ * Streaming checksums computed inline with I/O.
+ *
+ * The checksumming variants of readFull(), writeFull() and writevFull() below
+ * move data in chunks of kChecksumChunkSize and checksum each chunk right
+ * after it is read (or right before it is written), while it is still in
+ * cache, instead of making a second pass over the whole buffer.
+ */
+
+namespace sysio
+{
+    enum class ChecksumType : uint8_t
+    {
+        // CRC-32C, see Crc32c.h; always available
+        kCrc32c = 1,
+        // 64-bit XXH3 (libxxhash); only if built with SYSIO_HAVE_XXHASH
+        kXxh3 = 2,
+    };
+
+    /*
+     * Returns true if this build supports the given checksum type.
+     */
+    bool hasChecksum(ChecksumType type);
+
+    constexpr size_t kChecksumChunkSize = 256 * 1024;
+
+    /*
+     * Incrementally computed checksum.  value() may be called at any point
+     * and does not end the stream.
+     *
+     * Throws std::system_error(ENOTSUP) if the type is not supported.
+     */
+    class StreamingChecksum
+    {
+    public:
+        explicit StreamingChecksum(ChecksumType type = ChecksumType::kCrc32c);
+
+        StreamingChecksum(const StreamingChecksum &) = delete;
+
+        StreamingChecksum &operator=(const StreamingChecksum &) = delete;
+
+        StreamingChecksum(StreamingChecksum &&other) noexcept;
+
+        StreamingChecksum &operator=(StreamingChecksum &&other) noexcept;
+
+        ~StreamingChecksum();
+
+        void update(const void *data, size_t n);
+
+        /*
+         * Checksum of everything passed to update() since construction or
+         * reset().  CRC-32C values are zero-extended.
+         */
+        uint64_t value() const;
+
+        void reset();
+
+        ChecksumType type() const
+        {
+            return type_;
+        }
+
+    private:
+        ChecksumType type_;
+        uint32_t crc_ = 0;
+        // XXH3_state_t*, kept opaque so that this header does not need
+        // xxhash.h
+        void *xxh3_ = nullptr;
+    };
+
+    /*
+     * One-shot checksum of a buffer.
+     */
+    uint64_t checksum(ChecksumType type, const void *data, size_t n);
+
+    /*
+     * readFull(), writeFull() and writevFull() that also feed every byte
+     * transferred to sum.  On error, sum has seen an unspecified prefix of
+     * the data.  Unlike the plain writevFull(), iov is not modified.
+     */
+    ssize_t readFull(int fd, void *buf, size_t n, StreamingChecksum &sum);
+
+    ssize_t writeFull(int fd, const void *buf, size_t n, StreamingChecksum &sum);
+
+    ssize_t writevFull(int fd, const iovec *iov, int count, StreamingChecksum &sum);
+
+    /*
+     * Files written by writeFileAtomic(..., embedChecksum = true) end with a
+     * 16 byte trailer: "SYSIOCK", the checksum type and the little-endian
+     * 64-bit checksum of everything before the trailer.
+     */
+    constexpr size_t kChecksumTrailerSize = 16;
+
+    void encodeChecksumTrailer(char *out, ChecksumType type, uint64_t value);
+
+    /*
+     * Returns false if in does not hold a trailer.
+     */
+    bool decodeChecksumTrailer(const char *in, ChecksumType *type, uint64_t *value);
+
+    namespace detail
+    {
+        template<class Fn>
+        bool withOpenFile(const char *file_name, Fn fn)
+        {
+            assert(file_name);
+            const auto fd = openNoInt(file_name, O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+            {
+                return false;
+            }
+            SCOPE_EXIT
+            {
+                // Ignore errors when closing the file
+                closeNoInt(fd);
+            };
+            return fn(fd);
+        }
+    }
+
+    /*
+     * readFile() that checksums the data as it is read and compares the result
+     * with expected.
+     *
+     * Returns false on failure, with errno set by the failing system primitive
+     * or to EBADMSG on a checksum mismatch.
+     */
+    template<class Container>
+    bool readFileVerified(
+            int fd,
+            Container &out,
+            ChecksumType type,
+            uint64_t expected,
+            size_t num_bytes = std::numeric_limits<size_t>::max())
+    {
+        StreamingChecksum sum(type);
+        bool ok = detail::readFileWith(fd, out, num_bytes, [&](int f, void *buf, size_t n) {
+            return readFull(f, buf, n, sum);
+        });
+        if (ok && sum.value() != expected)
+        {
+            errno = EBADMSG;
+            return false;
+        }
+        return ok;
+    }
+
+    template<class Container>
+    bool readFileVerified(
+            const char *file_name,
+            Container &out,
+            ChecksumType type,
+            uint64_t expected,
+            size_t num_bytes = std::numeric_limits<size_t>::max())
+    {
+        return detail::withOpenFile(file_name, [&](int fd) {
+            return readFileVerified(fd, out, type, expected, num_bytes);
+        });
+    }
+
+    /*
+     * Reads a file written with an embedded checksum trailer, verifies it and
+     * strips the trailer from out.
+     *
+     * Returns false on failure, with errno set by the failing system primitive
+     * or to EBADMSG if the trailer is missing, of another type, or does not
+     * match the data.
+     */
+    template<class Container>
+    bool readFileWithTrailer(int fd, Container &out, ChecksumType type)
+    {
+        StreamingChecksum sum(type);
+        // The trailer position is only known at EOF, so keep the checksum
+        // kChecksumTrailerSize bytes behind the data read so far, which is
+        // read in chunks of kChecksumChunkSize to sum each while in cache.
+        size_t soFar = 0;
+        size_t summed = 0;
+        bool ok = detail::readFileWith(
+                fd, out, std::numeric_limits<size_t>::max(),
+                [&](int f, void *buf, size_t n) -> ssize_t {
+                    char *b = static_cast<char *>(buf);
+                    size_t total = 0;
+                    while (total < n)
+                    {
+                        const size_t want = std::min(n - total, kChecksumChunkSize);
+                        const ssize_t r = readFull(f, b + total, want);
+                        if (r == -1)
+                        {
+                            return -1;
+                        }
+                        total += size_t(r);
+                        soFar += size_t(r);
+                        if (soFar > summed + kChecksumTrailerSize)
+                        {
+                            size_t until = soFar - kChecksumTrailerSize;
+                            sum.update(&out[summed], until - summed);
+                            summed = until;
+                        }
+                        if (size_t(r) < want)
+                        {
+                            break; // EOF
+                        }
+                    }
+                    return ssize_t(total);
+                });
+        if (!ok)
+        {
+            return false;
+        }
+        if (out.size() < kChecksumTrailerSize)
+        {
+            errno = EBADMSG;
+            return false;
+        }
+        size_t dataSize = out.size() - kChecksumTrailerSize;
+        sum.update(&out[summed], dataSize - summed);
+
+        ChecksumType trailerType;
+        uint64_t value;
+        if (!decodeChecksumTrailer(&out[dataSize], &trailerType, &value) ||
+            trailerType != type || value != sum.value())
+        {
+            errno = EBADMSG;
+            return false;
+        }
+        out.resize(dataSize);
+        return true;
+    }
+
+    template<class Container>
+    bool readFileWithTrailer(const char *file_name, Container &out, ChecksumType type)
+    {
+        return detail::withOpenFile(file_name, [&](int fd) {
+            return readFileWithTrailer(fd, out, type);
+        });
+    }
+}
+
+#endif //SYSTEM_IO_CHECKSUM_H
@@ -0,0 +1,210 @@
+#include "system_io/Crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace sysio
+{
+    namespace
+    {
+        // Reflected Castagnoli polynomial
+        constexpr uint32_t kPoly = 0x82f63b78;
+
+        struct Table
+        {
+            uint32_t t[8][256];
+
+            Table()
+            {
+                for (uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        c = (c >> 1) ^ (kPoly & (0 - (c & 1)));
+                    }
+                    t[0][i] = c;
+                }
+                for (uint32_t i = 0; i < 256; ++i)
+                {
+                    for (int k = 1; k < 8; ++k)
+                    {
+                        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+                    }
+                }
+            }
+        };
+
+        // Slicing-by-8 on the un-inverted register value.
+        uint32_t crc32cSoftware(const uint8_t *p, size_t n, uint32_t c)
+        {
+            static const Table table;
+            const auto &t = table.t;
+            while (n >= 8)
+            {
+                uint64_t v;
+                memcpy(&v, p, 8);
+                v ^= c;
+                c = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff] ^
+                    t[5][(v >> 16) & 0xff] ^ t[4][(v >> 24) & 0xff] ^
+                    t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff] ^
+                    t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+                p += 8;
+                n -= 8;
+            }
+            while (n--)
+            {
+                c = (c >> 8) ^ t[0][(c ^ *p++) & 0xff];
+            }
+            return c;
+        }
+
+        // Multiply two polynomials modulo P (reflected, bit 31 is x^0).
+        uint32_t multModP(uint32_t a, uint32_t b)
+        {
+            uint32_t m = uint32_t(1) << 31;
+            uint32_t p = 0;
+            for (;;)
+            {
+                if (a & m)
+                {
+                    p ^= b;
+                    if ((a & (m - 1)) == 0)
+                    {
+                        break;
+                    }
+                }
+                m >>= 1;
+                b = b & 1 ? (b >> 1) ^ kPoly : b >> 1;
+            }
+            return p;
+        }
+
+        // x^n modulo P
+        uint32_t xPowModP(uint64_t n)
+        {
+            uint32_t result = uint32_t(1) << 31; // x^0
+            uint32_t square = uint32_t(1) << 30; // x^1
+            for (; n != 0; n >>= 1)
+            {
+                if (n & 1)
+                {
+                    result = multModP(result, square);
+                }
+                square = multModP(square, square);
+            }
+            return result;
+        }
+
+#if defined(__x86_64__)
+        // Each stream of the interleaved loop covers this many bytes.
+        constexpr size_t kStreamBytes = 4096;
+
+        __attribute__((target("sse4.2")))
+        uint32_t crc32cHardwareSerial(const uint8_t *p, size_t n, uint32_t c)
+        {
+            uint64_t c64 = c;
+            while (n >= 8)
+            {
+                uint64_t v;
+                memcpy(&v, p, 8);
+                c64 = _mm_crc32_u64(c64, v);
+                p += 8;
+                n -= 8;
+            }
+            c = uint32_t(c64);
+            while (n--)
+            {
+                c = _mm_crc32_u8(c, *p++);
+            }
+            return c;
+        }
+
+        // Advance crc over len zero bytes, given k = x^(8 * len - 33) mod P:
+        // the carry-less product lands 33 bits short, which the crc32
+        // instruction (itself a multiplication by x^32 and reduction) makes up.
+        __attribute__((target("sse4.2,pclmul")))
+        uint32_t shiftHardware(uint32_t crc, uint32_t k)
+        {
+            __m128i product = _mm_clmulepi64_si128(
+                    _mm_cvtsi32_si128(int(crc)), _mm_cvtsi32_si128(int(k)), 0);
+            return uint32_t(_mm_crc32_u64(0, uint64_t(_mm_cvtsi128_si64(product))));
+        }
+
+        /*
+         * The crc32 instruction has a latency of 3 cycles but a throughput of
+         * one per cycle, so a single dependency chain wastes two thirds of
+         * it.  Checksum three adjacent streams at once and stitch the results
+         * together with carry-less multiplications.
+         */
+        __attribute__((target("sse4.2,pclmul")))
+        uint32_t crc32cHardwareInterleaved(const uint8_t *p, size_t n, uint32_t c)
+        {
+            static const uint32_t kShift1 = xPowModP(8 * kStreamBytes - 33);
+            static const uint32_t kShift2 = xPowModP(8 * 2 * kStreamBytes - 33);
+
+            while (n >= 3 * kStreamBytes)
+            {
+                uint64_t c0 = c;
+                uint64_t c1 = 0;
+                uint64_t c2 = 0;
+                for (size_t i = 0; i < kStreamBytes; i += 8)
+                {
+                    uint64_t v0, v1, v2;
+                    memcpy(&v0, p + i, 8);
+                    memcpy(&v1, p + kStreamBytes + i, 8);
+                    memcpy(&v2, p + 2 * kStreamBytes + i, 8);
+                    c0 = _mm_crc32_u64(c0, v0);
+                    c1 = _mm_crc32_u64(c1, v1);
+                    c2 = _mm_crc32_u64(c2, v2);
+                }
+                c = shiftHardware(uint32_t(c0), kShift2) ^
+                    shiftHardware(uint32_t(c1), kShift1) ^ uint32_t(c2);
+                p += 3 * kStreamBytes;
+                n -= 3 * kStreamBytes;
+            }
+            return crc32cHardwareSerial(p, n, c);
+        }
+
+        bool pclmulSupported()
+        {
+            static const bool supported = __builtin_cpu_supports("pclmul");
+            return supported;
+        }
+#endif
+    }
+
+    bool crc32cHardwareSupported()
+    {
+#if defined(__x86_64__)
+        static const bool supported = __builtin_cpu_supports("sse4.2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t lengthB)
+    {
+        // Appending lengthB bytes multiplies the register by x^(8 * lengthB);
+        // the pre- and post-inversions of the two halves cancel out.
+        return multModP(xPowModP(8 * lengthB), crcA) ^ crcB;
+    }
+
+    uint32_t crc32c(const void *data, size_t n, uint32_t crc)
+    {
+        auto p = static_cast<const uint8_t *>(data);
+#if defined(__x86_64__)
+        if (crc32cHardwareSupported())
+        {
+            return pclmulSupported() ? ~crc32cHardwareInterleaved(p, n, ~crc)
+                                     : ~crc32cHardwareSerial(p, n, ~crc);
+        }
+#endif
+        return ~crc32cSoftware(p, n, ~crc);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef SYSTEM_IO_CRC32C_H
+#define SYSTEM_IO_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sysio
+{
+    /*
+     * CRC-32C (Castagnoli), the checksum used by iSCSI, ext4 and most storage
+     * formats.  Uses the SSE4.2 crc32 instruction when the CPU supports it
+     * (interleaving three streams combined with PCLMULQDQ on large inputs)
+     * and a table-driven implementation otherwise.
+     *
+     * Pass the previous result as crc to checksum data in pieces:
+     *   crc32c(b, nb, crc32c(a, na)) == crc32c(a + b, na + nb)
+     */
+    uint32_t crc32c(const void *data, size_t n, uint32_t crc = 0);
+
+    /*
+     * Returns crc32c(A + B) given crcA = crc32c(A), crcB = crc32c(B) and the
+     * length of B, so that pieces can be checksummed independently.
+     */
+    uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t lengthB);
+
+    /*
+     * Returns true if crc32c() runs on the hardware instruction.
+     */
+    bool crc32cHardwareSupported();
+}
+
+#endif //SYSTEM_IO_CRC32C_H
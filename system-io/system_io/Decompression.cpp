@@ -0,0 +1,230 @@
+#include "system_io/Decompression.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "system_io/Exception.h"
+
+namespace sysio
+{
+    bool hasDecoder(Compression type)
+    {
+        switch (type)
+        {
+            case Compression::kNone:
+                return true;
+            case Compression::kGzip:
+#ifdef SYSIO_HAVE_ZLIB
+                return true;
+#else
+                return false;
+#endif
+            case Compression::kZstd:
+#ifdef SYSIO_HAVE_ZSTD
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+#ifdef SYSIO_HAVE_ZLIB
+    ZlibByteSource::ZlibByteSource(
+            std::unique_ptr<ByteSource> upstream,
+            size_t inBufSize)
+            : upstream_(std::move(upstream)),
+              in_(std::min<size_t>(inBufSize, UINT_MAX))
+    {
+        CHECK(upstream_) << "upstream source must not be null";
+        memset(&stream_, 0, sizeof(stream_));
+        // 15 window bits, +32 to detect gzip or zlib framing automatically
+        if (inflateInit2(&stream_, 15 + 32) != Z_OK)
+        {
+            throwSystemErrorExplicit(ENOMEM, "inflateInit2() failed");
+        }
+    }
+
+    ZlibByteSource::~ZlibByteSource()
+    {
+        inflateEnd(&stream_);
+    }
+
+    bool ZlibByteSource::refill()
+    {
+        ssize_t r = upstream_->read(in_.data(), in_.size());
+        if (r == -1)
+        {
+            return false;
+        }
+        upstreamEof_ = size_t(r) < in_.size();
+        stream_.next_in = reinterpret_cast<Bytef *>(in_.data());
+        stream_.avail_in = uInt(r);
+        return true;
+    }
+
+    ssize_t ZlibByteSource::read(void *buf, size_t n)
+    {
+        char *out = static_cast<char *>(buf);
+        size_t total = 0;
+        while (total < n && !done_)
+        {
+            if (stream_.avail_in == 0 && !upstreamEof_ && !refill())
+            {
+                return -1;
+            }
+
+            size_t room = std::min<size_t>(n - total, UINT_MAX);
+            stream_.next_out = reinterpret_cast<Bytef *>(out + total);
+            stream_.avail_out = uInt(room);
+            int rc = inflate(&stream_, Z_NO_FLUSH);
+            total += room - stream_.avail_out;
+
+            if (rc == Z_STREAM_END)
+            {
+                // Another gzip member may follow; find out whether there is
+                // any input left.
+                if (stream_.avail_in == 0 && !upstreamEof_ && !refill())
+                {
+                    return -1;
+                }
+                if (stream_.avail_in == 0)
+                {
+                    done_ = true;
+                } else
+                {
+                    inflateReset(&stream_);
+                }
+            } else if (rc == Z_BUF_ERROR)
+            {
+                // No progress was possible: out of input before the end of the
+                // stream.
+                if (stream_.avail_in == 0 && upstreamEof_)
+                {
+                    errno = EBADMSG;
+                    return -1;
+                }
+            } else if (rc != Z_OK)
+            {
+                errno = rc == Z_MEM_ERROR ? ENOMEM : EBADMSG;
+                return -1;
+            }
+        }
+        return ssize_t(total);
+    }
+#endif
+
+#ifdef SYSIO_HAVE_ZSTD
+    ZstdByteSource::ZstdByteSource(std::unique_ptr<ByteSource> upstream)
+            : upstream_(std::move(upstream)),
+              in_(ZSTD_DStreamInSize()),
+              input_{in_.data(), 0, 0},
+              stream_(ZSTD_createDStream())
+    {
+        CHECK(upstream_) << "upstream source must not be null";
+        if (stream_ == nullptr)
+        {
+            throwSystemErrorExplicit(ENOMEM, "ZSTD_createDStream() failed");
+        }
+        size_t rc = ZSTD_initDStream(stream_);
+        if (ZSTD_isError(rc))
+        {
+            ZSTD_freeDStream(stream_);
+            throwSystemErrorExplicit(
+                    ENOMEM,
+                    std::string("ZSTD_initDStream() failed: ") + ZSTD_getErrorName(rc));
+        }
+    }
+
+    ZstdByteSource::~ZstdByteSource()
+    {
+        ZSTD_freeDStream(stream_);
+    }
+
+    bool ZstdByteSource::refill()
+    {
+        ssize_t r = upstream_->read(in_.data(), in_.size());
+        if (r == -1)
+        {
+            return false;
+        }
+        upstreamEof_ = size_t(r) < in_.size();
+        input_.src = in_.data();
+        input_.size = size_t(r);
+        input_.pos = 0;
+        return true;
+    }
+
+    ssize_t ZstdByteSource::read(void *buf, size_t n)
+    {
+        ZSTD_outBuffer output{buf, n, 0};
+        while (output.pos < n && !done_)
+        {
+            if (input_.pos == input_.size && !upstreamEof_ && !refill())
+            {
+                return -1;
+            }
+
+            size_t inBefore = input_.pos;
+            size_t outBefore = output.pos;
+            hint_ = ZSTD_decompressStream(stream_, &output, &input_);
+            if (ZSTD_isError(hint_))
+            {
+                errno = EBADMSG;
+                return -1;
+            }
+
+            if (input_.pos == input_.size && upstreamEof_)
+            {
+                if (hint_ == 0)
+                {
+                    // Last frame fully decoded and flushed.
+                    done_ = true;
+                } else if (input_.pos == inBefore && output.pos == outBefore)
+                {
+                    // Truncated frame.
+                    errno = EBADMSG;
+                    return -1;
+                }
+            }
+        }
+        return ssize_t(output.pos);
+    }
+#endif
+
+    std::unique_ptr<ByteSource> makeDecompressingSource(
+            int fd,
+            Compression type,
+            bool pipelined)
+    {
+        std::unique_ptr<ByteSource> source(new FdByteSource(fd));
+        switch (type)
+        {
+            case Compression::kNone:
+                return source;
+            case Compression::kGzip:
+#ifdef SYSIO_HAVE_ZLIB
+                source.reset(new ZlibByteSource(std::move(source)));
+                break;
+#else
+                throwSystemErrorExplicit(ENOTSUP, "built without zlib support");
+#endif
+            case Compression::kZstd:
+#ifdef SYSIO_HAVE_ZSTD
+                source.reset(new ZstdByteSource(std::move(source)));
+                break;
+#else
+                throwSystemErrorExplicit(ENOTSUP, "built without zstd support");
+#endif
+        }
+        if (pipelined)
+        {
+            source.reset(new PipelinedByteSource(std::move(source)));
+        }
+        return source;
+    }
+}
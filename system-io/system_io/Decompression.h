@@ -0,0 +1,122 @@
+#ifndef SYSTEM_IO_DECOMPRESSION_H
+#define SYSTEM_IO_DECOMPRESSION_H
+
+#include <memory>
+#include <vector>
+
+#include "system_io/ByteSource.h"
+
+/*
+ * Streaming decoders exposed as ByteSources, so that a LineReader can read
+ * compressed files directly:
+ *
+ *   auto source = makeDecompressingSource(fd, Compression::kGzip);
+ *   LineReader reader(*source, buf, sizeof(buf));
+ *
+ * Each decoder is only available if the library was built with the matching
+ * codec (SYSIO_HAVE_ZLIB, SYSIO_HAVE_ZSTD).
+ */
+
+#ifdef SYSIO_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef SYSIO_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace sysio
+{
+    enum class Compression
+    {
+        kNone,
+        // gzip or zlib framing, detected from the stream header
+        kGzip,
+        kZstd,
+    };
+
+    /*
+     * Returns true if this build can decode the given compression type.
+     */
+    bool hasDecoder(Compression type);
+
+#ifdef SYSIO_HAVE_ZLIB
+    /*
+     * Inflates a gzip or zlib stream read from upstream.  Concatenated gzip
+     * members are decoded back to back, as gunzip does.
+     *
+     * Corrupt or truncated input makes read() fail with EBADMSG.
+     */
+    class ZlibByteSource : public ByteSource
+    {
+    public:
+        explicit ZlibByteSource(
+                std::unique_ptr<ByteSource> upstream,
+                size_t inBufSize = 64 * 1024);
+
+        ZlibByteSource(const ZlibByteSource &) = delete;
+
+        ZlibByteSource &operator=(const ZlibByteSource &) = delete;
+
+        ~ZlibByteSource() override;
+
+        ssize_t read(void *buf, size_t n) override;
+
+    private:
+        bool refill();
+
+        std::unique_ptr<ByteSource> upstream_;
+        std::vector<char> in_;
+        z_stream stream_;
+        bool upstreamEof_ = false;
+        bool done_ = false;
+    };
+#endif
+
+#ifdef SYSIO_HAVE_ZSTD
+    /*
+     * Decompresses a zstd stream (one or more frames) read from upstream.
+     *
+     * Corrupt or truncated input makes read() fail with EBADMSG.
+     */
+    class ZstdByteSource : public ByteSource
+    {
+    public:
+        explicit ZstdByteSource(std::unique_ptr<ByteSource> upstream);
+
+        ZstdByteSource(const ZstdByteSource &) = delete;
+
+        ZstdByteSource &operator=(const ZstdByteSource &) = delete;
+
+        ~ZstdByteSource() override;
+
+        ssize_t read(void *buf, size_t n) override;
+
+    private:
+        bool refill();
+
+        std::unique_ptr<ByteSource> upstream_;
+        std::vector<char> in_;
+        ZSTD_inBuffer input_;
+        ZSTD_DStream *stream_;
+        // Result of the last ZSTD_decompressStream(); 0 at a frame boundary.
+        size_t hint_ = 0;
+        bool upstreamEof_ = false;
+        bool done_ = false;
+    };
+#endif
+
+    /*
+     * Returns a source that yields the decompressed contents of fd (which is
+     * not owned).  If pipelined is true, decompression runs on a helper thread
+     * ahead of the reader.
+     *
+     * Throws std::system_error(ENOTSUP) if the decoder is not available.
+     */
+    std::unique_ptr<ByteSource> makeDecompressingSource(
+            int fd,
+            Compression type,
+            bool pipelined = true);
+}
+
+#endif //SYSTEM_IO_DECOMPRESSION_H
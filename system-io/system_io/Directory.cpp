@@ -0,0 +1,114 @@
+#include "system_io/Directory.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "system_io/Exception.h"
+#include "system_io/FileUtil.h"
+
+namespace sysio
+{
+    namespace
+    {
+        constexpr int kDirectoryFlags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+    }
+
+    Directory::Directory() noexcept = default;
+
+    Directory::Directory(File file) noexcept
+            : file_(std::move(file))
+    {}
+
+    Directory::Directory(const char *path, int dirfd)
+            : file_(dirfd, path, kDirectoryFlags)
+    {}
+
+    Directory::Directory(const std::string &path, int dirfd)
+            : Directory(path.c_str(), dirfd)
+    {}
+
+    Expected<Directory> Directory::tryOpen(const char *path, int dirfd) noexcept
+    {
+        auto file = File::tryOpen(dirfd, path, kDirectoryFlags);
+        if (!file)
+        {
+            return makeUnexpected(file.error());
+        }
+        return Directory(std::move(*file));
+    }
+
+    File Directory::openFile(const char *name, int flags, mode_t mode) const
+    {
+        return File(fd(), name, flags, mode);
+    }
+
+    Expected<File> Directory::tryOpenFile(const char *name, int flags, mode_t mode) const noexcept
+    {
+        return File::tryOpen(fd(), name, flags, mode);
+    }
+
+    Directory Directory::openDirectory(const char *name) const
+    {
+        return Directory(name, fd());
+    }
+
+    void Directory::makeDirectory(const char *name, mode_t mode) const
+    {
+        checkUnixError(mkdirat(fd(), name, mode), std::string("mkdirat(") + name + ") failed");
+    }
+
+    File Directory::makeTemporary(std::string &nameTemplate, int flags) const
+    {
+        int tmp = mkstempat(fd(), &nameTemplate[0], flags);
+        checkUnixError(tmp, "mkstempat(" + nameTemplate + ") failed");
+        return File(tmp, true);
+    }
+
+    void Directory::rename(const char *from, const char *to) const
+    {
+        rename(from, *this, to);
+    }
+
+    void Directory::rename(const char *from, const Directory &toDir, const char *to) const
+    {
+        checkUnixError(renameatNoInt(fd(), from, toDir.fd(), to),
+                       std::string("renameat(") + from + ", " + to + ") failed");
+    }
+
+    void Directory::link(const char *from, const char *to) const
+    {
+        link(from, *this, to);
+    }
+
+    void Directory::link(const char *from, const Directory &toDir, const char *to) const
+    {
+        checkUnixError(linkatNoInt(fd(), from, toDir.fd(), to),
+                       std::string("linkat(") + from + ", " + to + ") failed");
+    }
+
+    void Directory::unlink(const char *name) const
+    {
+        checkUnixError(unlinkatNoInt(fd(), name), std::string("unlinkat(") + name + ") failed");
+    }
+
+    void Directory::removeDirectory(const char *name) const
+    {
+        checkUnixError(unlinkatNoInt(fd(), name, AT_REMOVEDIR),
+                       std::string("unlinkat(") + name + ", AT_REMOVEDIR) failed");
+    }
+
+    struct stat Directory::stat(const char *name, int flags) const
+    {
+        struct stat st;
+        checkUnixError(fstatat(fd(), name, &st, flags), std::string("fstatat(") + name + ") failed");
+        return st;
+    }
+
+    bool Directory::tryStat(const char *name, struct stat &st, int flags) const noexcept
+    {
+        return fstatat(fd(), name, &st, flags) == 0;
+    }
+}
@@ -0,0 +1,131 @@
+#ifndef SYSTEM_IO_DIRECTORY_H
+#define SYSTEM_IO_DIRECTORY_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <string>
+
+#include "system_io/Expected.h"
+#include "system_io/File.h"
+
+/*
+ * A Directory is a handle to a directory, for opening, creating and renaming
+ * the files in it by name relative to the handle (openat(), renameat(),
+ * etc.) instead of by full path.  Each lookup then starts at the directory
+ * rather than walking the path again, and the handle keeps referring to the
+ * same directory if it, or one of its ancestors, is renamed.
+ *
+ * The directory is opened with O_PATH, which needs no read permission on
+ * it, but also means the descriptor itself cannot be read (listed) or
+ * fsync()ed; open "." relative to it for that.
+ *
+ * Example:
+ *   Directory dir("/var/lib/service");
+ *   File file = dir.openFile("state", O_RDONLY);
+ *   writeFileAtomic(dir.fd(), "state", iov, count);
+ */
+
+namespace sysio
+{
+    class Directory
+    {
+    public:
+        /*
+         * Creates an empty Directory, for late initialization.
+         */
+        Directory() noexcept;
+
+        /*
+         * Opens the directory path (relative to dirfd).  Throws on error.
+         */
+        explicit Directory(const char *path, int dirfd = AT_FDCWD);
+
+        explicit Directory(const std::string &path, int dirfd = AT_FDCWD);
+
+        /*
+         * Non-throwing open, as File::tryOpen().
+         */
+        static Expected<Directory> tryOpen(const char *path, int dirfd = AT_FDCWD) noexcept;
+
+        Directory(Directory &&) noexcept = default;
+
+        Directory &operator=(Directory &&) noexcept = default;
+
+        /*
+         * The O_PATH descriptor, for the *at() functions of FileUtil.h; -1 if
+         * empty.
+         */
+        int fd() const
+        {
+            return file_.fd();
+        }
+
+        explicit operator bool() const
+        {
+            return bool(file_);
+        }
+
+        /*
+         * Opens the file name in this directory.  openFile() throws on error,
+         * tryOpenFile() returns the error code.
+         */
+        File openFile(const char *name, int flags = O_RDONLY, mode_t mode = 0666) const;
+
+        Expected<File> tryOpenFile(const char *name, int flags = O_RDONLY, mode_t mode = 0666) const noexcept;
+
+        /*
+         * Opens the subdirectory name.
+         */
+        Directory openDirectory(const char *name) const;
+
+        /*
+         * Creates the subdirectory name; fails if it exists.
+         */
+        void makeDirectory(const char *name, mode_t mode = 0777) const;
+
+        /*
+         * Creates a new file named after nameTemplate, whose trailing
+         * "XXXXXX" is replaced in place (see mkstempat() in FileUtil.h).
+         */
+        File makeTemporary(std::string &nameTemplate, int flags = O_CLOEXEC) const;
+
+        /*
+         * Renames from to to, within this directory or into toDir.  Replaces
+         * to if it exists, as rename().
+         */
+        void rename(const char *from, const char *to) const;
+
+        void rename(const char *from, const Directory &toDir, const char *to) const;
+
+        /*
+         * Creates the hard link to for the file from.
+         */
+        void link(const char *from, const char *to) const;
+
+        void link(const char *from, const Directory &toDir, const char *to) const;
+
+        /*
+         * Removes the file name, or the empty subdirectory name.
+         */
+        void unlink(const char *name) const;
+
+        void removeDirectory(const char *name) const;
+
+        /*
+         * stat() of name, without following a final symlink if flags is
+         * AT_SYMLINK_NOFOLLOW.  tryStat() returns false and sets errno.
+         */
+        struct stat stat(const char *name, int flags = 0) const;
+
+        bool tryStat(const char *name, struct stat &st, int flags = 0) const noexcept;
+
+    private:
+        explicit Directory(File file) noexcept;
+
+        File file_;
+    };
+}
+
+#endif //SYSTEM_IO_DIRECTORY_H
@@ -0,0 +1,380 @@
+#include "system_io/DirectorySwap.h"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "system_io/Exception.h"
+#include "system_io/FileUtil.h"
+#include "system_io/IoThreadPool.h"
+#include "system_io/ScopeGuard.h"
+
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE (1 << 1)
+#endif
+
+namespace sysio
+{
+    namespace
+    {
+        constexpr int kReadDirectoryFlags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+        struct Entry
+        {
+            std::string name;
+            bool directory;
+        };
+
+        // The entries of the open directory dir, other than "." and "..".
+        // Returns false and sets errno on error.
+        bool listEntries(DIR *dir, std::vector<Entry> &entries)
+        {
+            errno = 0;
+            while (dirent *d = readdir(dir))
+            {
+                if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+                {
+                    continue;
+                }
+                bool directory = d->d_type == DT_DIR;
+                if (d->d_type == DT_UNKNOWN)
+                {
+                    struct stat st;
+                    if (fstatat(dirfd(dir), d->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+                    {
+                        return false;
+                    }
+                    directory = S_ISDIR(st.st_mode);
+                }
+                entries.push_back({d->d_name, directory});
+            }
+            return errno == 0;
+        }
+
+        DIR *openDir(int parent, const char *name)
+        {
+            int fd = openatNoInt(parent, name, kReadDirectoryFlags);
+            if (fd == -1)
+            {
+                return nullptr;
+            }
+            DIR *dir = fdopendir(fd);
+            if (!dir)
+            {
+                closeNoInt(fd);
+            }
+            return dir;
+        }
+
+        // Removes name, and everything under it if it is a directory.
+        // Carries on past errors; returns false if anything was left.
+        bool removeTree(int parent, const char *name)
+        {
+            DIR *dir = openDir(parent, name);
+            if (!dir)
+            {
+                return (errno == ENOTDIR || errno == ELOOP) && unlinkatNoInt(parent, name) == 0;
+            }
+            bool ok;
+            {
+                SCOPE_EXIT
+                {
+                    closedir(dir);
+                };
+                std::vector<Entry> entries;
+                ok = listEntries(dir, entries);
+                for (const Entry &entry : entries)
+                {
+                    if (entry.directory)
+                    {
+                        ok = removeTree(dirfd(dir), entry.name.c_str()) && ok;
+                    } else
+                    {
+                        ok = unlinkatNoInt(dirfd(dir), entry.name.c_str()) == 0 && ok;
+                    }
+                }
+            }
+            return ok && unlinkatNoInt(parent, name, AT_REMOVEDIR) == 0;
+        }
+
+        // fsync()s the regular files and directories under name, and name
+        void syncTree(int parent, const std::string &name)
+        {
+            DIR *dir = openDir(parent, name.c_str());
+            checkUnixError(dir ? 0 : -1, "open(" + name + ") failed");
+            SCOPE_EXIT
+            {
+                closedir(dir);
+            };
+            std::vector<Entry> entries;
+            checkUnixError(listEntries(dir, entries) ? 0 : -1, "readdir(" + name + ") failed");
+            for (const Entry &entry : entries)
+            {
+                if (entry.directory)
+                {
+                    syncTree(dirfd(dir), entry.name);
+                    continue;
+                }
+                int fd = openatNoInt(dirfd(dir), entry.name.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+                if (fd == -1 && errno == ELOOP)
+                {
+                    continue; // A symlink; syncing the directory covers it
+                }
+                checkUnixError(fd, "open(" + entry.name + ") failed");
+                int r = fsync(fd);
+                int err = errno;
+                closeNoInt(fd);
+                if (r == -1)
+                {
+                    throwSystemErrorExplicit(err, "fsync(" + entry.name + ") failed");
+                }
+            }
+            checkUnixError(fsync(dirfd(dir)), "fsync(" + name + ") failed");
+        }
+
+        void syncDirectory(int dirfd)
+        {
+            int fd = openatNoInt(dirfd, ".", kReadDirectoryFlags);
+            checkUnixError(fd, "open(.) failed");
+            int r = fsync(fd);
+            int err = errno;
+            closeNoInt(fd);
+            if (r == -1)
+            {
+                throwSystemErrorExplicit(err, "fsync(.) failed");
+            }
+        }
+
+        bool isUnsupported(int err)
+        {
+            return err == EINVAL || err == ENOSYS || err == EOPNOTSUPP;
+        }
+    }
+
+    DirectorySwap::DirectorySwap(Directory parent, std::string name)
+            : DirectorySwap(std::move(parent), std::move(name), Options())
+    {}
+
+    DirectorySwap::DirectorySwap(Directory parent, std::string name, const Options &options)
+            : parent_(std::move(parent)),
+              name_(std::move(name)),
+              options_(options)
+    {
+        CHECK(parent_) << "no parent directory";
+        CHECK(!name_.empty() && name_.find('/') == std::string::npos) << "bad name " << name_;
+    }
+
+    DirectorySwap::~DirectorySwap()
+    {
+        waitForCleanup();
+    }
+
+    DirectorySwap::Staged DirectorySwap::stage()
+    {
+        std::string name = name_ + ".XXXXXX";
+        checkUnixError(mkdtempat(parent_.fd(), &name[0], 0777), "mkdtempat(" + name + ") failed");
+        auto directory = Directory::tryOpen(name.c_str(), parent_.fd());
+        if (!directory)
+        {
+            unlinkatNoInt(parent_.fd(), name.c_str(), AT_REMOVEDIR);
+            throwSystemErrorExplicit(directory.error().value(), "open(" + name + ") failed");
+        }
+        return Staged{std::move(name), std::move(*directory)};
+    }
+
+    void DirectorySwap::publish(Staged &&staged)
+    {
+        CHECK(staged.directory) << "nothing staged";
+        if (options_.sync)
+        {
+            syncTree(parent_.fd(), staged.name);
+        }
+        if (layout() == Layout::kDirectory)
+        {
+            publishDirectory(staged);
+        } else
+        {
+            publishSymlink(staged);
+        }
+        if (options_.sync)
+        {
+            syncDirectory(parent_.fd());
+        }
+        staged.directory = Directory();
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.publishes;
+    }
+
+    void DirectorySwap::publishDirectory(Staged &staged)
+    {
+        int r = renameat2NoInt(parent_.fd(), staged.name.c_str(), parent_.fd(), name_.c_str(), RENAME_EXCHANGE);
+        if (r == 0)
+        {
+            // The old version is now where the staging directory was
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++stats_.exchanges;
+            }
+            removeLater(staged.name);
+            return;
+        }
+        if (errno != ENOENT)
+        {
+            throwSystemError("renameat2(" + staged.name + ", " + name_ + ", RENAME_EXCHANGE) failed");
+        }
+        // First version
+        checkUnixError(renameatNoInt(parent_.fd(), staged.name.c_str(), parent_.fd(), name_.c_str()),
+                       "renameat(" + staged.name + ", " + name_ + ") failed");
+    }
+
+    void DirectorySwap::publishSymlink(Staged &staged)
+    {
+        // The version the symlink points at now, if it is one of ours
+        std::string old;
+        char target[PATH_MAX];
+        ssize_t n = readlinkat(parent_.fd(), name_.c_str(), target, sizeof(target));
+        if (n == -1 && errno != ENOENT)
+        {
+            throwSystemError("readlinkat(" + name_ + ") failed");
+        }
+        if (n > 0 && size_t(n) < sizeof(target))
+        {
+            old.assign(target, size_t(n));
+            if (old.compare(0, name_.size() + 1, name_ + ".") != 0 || old.find('/') != std::string::npos)
+            {
+                old.clear();
+            }
+        }
+
+        // Replace the symlink by renaming a new one over it.  The staging name
+        // is unique, so is the name of its link.
+        std::string link = staged.name + ".link";
+        unlinkatNoInt(parent_.fd(), link.c_str());
+        checkUnixError(symlinkat(staged.name.c_str(), parent_.fd(), link.c_str()),
+                       "symlinkat(" + link + ") failed");
+        if (renameatNoInt(parent_.fd(), link.c_str(), parent_.fd(), name_.c_str()) == -1)
+        {
+            int err = errno;
+            unlinkatNoInt(parent_.fd(), link.c_str());
+            throwSystemErrorExplicit(err, "renameat(" + link + ", " + name_ + ") failed");
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.symlinkFlips;
+        }
+        if (!old.empty() && old != staged.name)
+        {
+            removeLater(std::move(old));
+        }
+    }
+
+    DirectorySwap::Layout DirectorySwap::layout()
+    {
+        struct stat st;
+        if (parent_.tryStat(name_.c_str(), st, AT_SYMLINK_NOFOLLOW))
+        {
+            if (S_ISLNK(st.st_mode))
+            {
+                return Layout::kSymlink;
+            }
+            if (S_ISDIR(st.st_mode))
+            {
+                return Layout::kDirectory;
+            }
+            throwSystemErrorExplicit(ENOTDIR, name_ + " is not a directory or symlink");
+        }
+        checkUnixError(errno == ENOENT ? 0 : -1, "fstatat(" + name_ + ") failed");
+        return options_.useSymlink || !exchangeSupported() ? Layout::kSymlink : Layout::kDirectory;
+    }
+
+    bool DirectorySwap::exchangeSupported()
+    {
+        if (exchangeSupported_ == -1)
+        {
+            // Support depends on the filesystem as well as the kernel, so try
+            // it on two empty directories in the parent
+            std::string a = name_ + ".XXXXXX";
+            std::string b = a;
+            checkUnixError(mkdtempat(parent_.fd(), &a[0]), "mkdtempat(" + a + ") failed");
+            SCOPE_EXIT
+            {
+                unlinkatNoInt(parent_.fd(), a.c_str(), AT_REMOVEDIR);
+            };
+            checkUnixError(mkdtempat(parent_.fd(), &b[0]), "mkdtempat(" + b + ") failed");
+            SCOPE_EXIT
+            {
+                unlinkatNoInt(parent_.fd(), b.c_str(), AT_REMOVEDIR);
+            };
+            int r = renameat2NoInt(parent_.fd(), a.c_str(), parent_.fd(), b.c_str(), RENAME_EXCHANGE);
+            if (r == -1 && !isUnsupported(errno))
+            {
+                throwSystemError("renameat2(" + a + ", " + b + ", RENAME_EXCHANGE) failed");
+            }
+            exchangeSupported_ = r == 0;
+        }
+        return exchangeSupported_ == 1;
+    }
+
+    void DirectorySwap::discard(Staged &&staged)
+    {
+        CHECK(staged.directory) << "nothing staged";
+        staged.directory = Directory();
+        removeLater(std::move(staged.name));
+    }
+
+    void DirectorySwap::removeLater(std::string name)
+    {
+        auto remove = [this, name] {
+            bool ok = removeTree(parent_.fd(), name.c_str());
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++(ok ? stats_.removed : stats_.removeFailures);
+        };
+        std::future<void> cleanup = options_.cleanupPool
+                                    ? options_.cleanupPool->submit(std::move(remove), IoThreadPool::Priority::kLow)
+                                    : std::async(std::launch::async, std::move(remove));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Forget the ones that are done
+        for (size_t i = 0; i < cleanups_.size();)
+        {
+            if (cleanups_[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                cleanups_[i] = std::move(cleanups_.back());
+                cleanups_.pop_back();
+            } else
+            {
+                ++i;
+            }
+        }
+        cleanups_.push_back(std::move(cleanup));
+    }
+
+    void DirectorySwap::waitForCleanup()
+    {
+        std::vector<std::future<void>> cleanups;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cleanups.swap(cleanups_);
+        }
+        for (auto &cleanup : cleanups)
+        {
+            cleanup.wait();
+        }
+    }
+
+    DirectorySwap::Stats DirectorySwap::stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef SYSTEM_IO_DIRECTORYSWAP_H
+#define SYSTEM_IO_DIRECTORYSWAP_H
+
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "system_io/Directory.h"
+
+/*
+ * Publishes a set of files at once, by building them in a staging directory
+ * and swapping that in for the directory readers use.
+ *
+ * writeFileAtomic() replaces one file; replacing several with it takes one
+ * rename each, and a reader can open some files of the new version and some
+ * of the old.  Here the files are written into a directory that nothing
+ * reads yet, and publish() makes all of them visible with one
+ * renameat2(RENAME_EXCHANGE) of that directory with the published one.
+ * Readers that opened files of the old version keep them; readers opening
+ * by path after publish() see the new version only.
+ *
+ * Where RENAME_EXCHANGE is not supported (older kernels, some filesystems),
+ * or with Options::useSymlink, the published name is instead a symlink to a
+ * version directory next to it, and publishing renames a new symlink over
+ * it.  Readers resolve the symlink once per path lookup, so a file opened
+ * by path is still all from one version, but a reader that wants several
+ * files of one version should open the directory once and open the files
+ * relative to it.
+ *
+ * Either way the old version is then removed in the background.  Staging
+ * directories are named after the target with a random suffix, like the
+ * temporary files of writeFileAtomic(); ones left by a crash are not
+ * removed.
+ *
+ * One DirectorySwap per target, used from one thread at a time.
+ *
+ * Example:
+ *   DirectorySwap swap(Directory("/var/lib/service"), "index");
+ *   auto staged = swap.stage();
+ *   writeFile(shards, staged.directory.fd(), "shards");
+ *   writeFile(terms, staged.directory.fd(), "terms");
+ *   swap.publish(std::move(staged));
+ */
+
+namespace sysio
+{
+    class IoThreadPool;
+
+    class DirectorySwap
+    {
+    public:
+        struct Options
+        {
+            // Publish through a symlink even where RENAME_EXCHANGE works.  Only
+            // applies to a target that does not exist yet; an existing one
+            // keeps its layout.
+            bool useSymlink = false;
+            // fsync() the staged files and directories before publishing, and
+            // the parent directory after, so the new version is durable once
+            // publish() returns
+            bool sync = true;
+            // Where old versions are removed; nullptr for a thread each
+            IoThreadPool *cleanupPool = nullptr;
+        };
+
+        struct Stats
+        {
+            uint64_t publishes = 0;
+            // How those were made visible
+            uint64_t exchanges = 0;
+            uint64_t symlinkFlips = 0;
+            // Old versions and discarded stagings removed, and removals that
+            // failed (and were left behind)
+            uint64_t removed = 0;
+            uint64_t removeFailures = 0;
+        };
+
+        /*
+         * A staging directory: fill it through directory, then publish() or
+         * discard() it.
+         */
+        struct Staged
+        {
+            std::string name;
+            Directory directory;
+        };
+
+        /*
+         * Publishes to the entry name of parent, which need not exist yet.
+         */
+        DirectorySwap(Directory parent, std::string name);
+
+        DirectorySwap(Directory parent, std::string name, const Options &options);
+
+        DirectorySwap(const DirectorySwap &) = delete;
+
+        DirectorySwap &operator=(const DirectorySwap &) = delete;
+
+        /*
+         * Waits for the removals still running.
+         */
+        ~DirectorySwap();
+
+        /*
+         * Creates an empty staging directory next to the target.
+         */
+        Staged stage();
+
+        /*
+         * Makes the contents of staged the published version, and removes the
+         * previous one in the background.  Throws std::system_error; staged is
+         * then left as it was.
+         */
+        void publish(Staged &&staged);
+
+        /*
+         * Removes a staging directory that is not going to be published, in
+         * the background.
+         */
+        void discard(Staged &&staged);
+
+        /*
+         * Waits until the removals started so far are done.
+         */
+        void waitForCleanup();
+
+        Stats stats() const;
+
+    private:
+        enum class Layout
+        {
+            kUnknown,
+            kDirectory,
+            kSymlink,
+        };
+
+        // Looks at what the target is now, and settles how to publish
+        Layout layout();
+
+        bool exchangeSupported();
+
+        void publishDirectory(Staged &staged);
+
+        void publishSymlink(Staged &staged);
+
+        // Removes the tree name of parent_ in the background
+        void removeLater(std::string name);
+
+        Directory parent_;
+        std::string name_;
+        Options options_;
+        // -1 until probed
+        int exchangeSupported_ = -1;
+
+        mutable std::mutex mutex_;
+        Stats stats_;
+        std::vector<std::future<void>> cleanups_;
+    };
+}
+
+#endif //SYSTEM_IO_DIRECTORYSWAP_H
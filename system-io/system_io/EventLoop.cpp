@@ -0,0 +1,304 @@
+#include "system_io/EventLoop.h"
+
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "system_io/Exception.h"
+#include "system_io/FileUtil.h"
+
+namespace sysio
+{
+    namespace
+    {
+        // epoll_event.data of the wakeup eventfd; other descriptors use
+        // generation << 32 | fd
+        constexpr uint64_t kWakeupKey = ~uint64_t(0);
+
+        constexpr size_t kInitialEvents = 256;
+        constexpr size_t kMaxEvents = 64 * 1024;
+
+        // writevNoInt() batch size
+        constexpr int kMaxIov = 64;
+
+        constexpr size_t kReadBufferSize = 64 * 1024;
+
+        File checkedFile(int fd, const char *what)
+        {
+            checkUnixError(fd, std::string(what) + " failed");
+            return File(fd, true);
+        }
+    }
+
+    EventLoop::EventLoop()
+            : epoll_(checkedFile(epoll_create1(EPOLL_CLOEXEC), "epoll_create1()")),
+              wakeup_(checkedFile(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), "eventfd()")),
+              stop_(false),
+              events_(kInitialEvents)
+    {
+        epoll_event ev;
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u64 = kWakeupKey;
+        checkUnixError(epoll_ctl(epoll_.fd(), EPOLL_CTL_ADD, wakeup_.fd(), &ev),
+                       "epoll_ctl() failed");
+    }
+
+    EventLoop::~EventLoop()
+    {}
+
+    void EventLoop::add(int fd, Callback callback)
+    {
+        CHECK_GE(fd, 0);
+        CHECK(callback);
+        int flags = fcntl(fd, F_GETFL);
+        checkUnixError(flags, "fcntl(F_GETFL) failed");
+        if (!(flags & O_NONBLOCK))
+        {
+            checkUnixError(fcntl(fd, F_SETFL, flags | O_NONBLOCK), "fcntl(F_SETFL) failed");
+        }
+
+        if (slots_.size() <= size_t(fd))
+        {
+            slots_.resize(size_t(fd) + 1);
+        }
+        Slot &slot = slots_[size_t(fd)];
+        CHECK(!slot.callback) << "fd " << fd << " is already registered";
+
+        epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.u64 = uint64_t(slot.generation) << 32 | uint32_t(fd);
+        checkUnixError(epoll_ctl(epoll_.fd(), EPOLL_CTL_ADD, fd, &ev), "epoll_ctl() failed");
+        slot.callback = std::move(callback);
+        ++registered_;
+    }
+
+    void EventLoop::remove(int fd)
+    {
+        if (fd < 0 || size_t(fd) >= slots_.size() || !slots_[size_t(fd)].callback)
+        {
+            return;
+        }
+        Slot &slot = slots_[size_t(fd)];
+        // Fails harmlessly if fd was closed already, which removes it too
+        epoll_ctl(epoll_.fd(), EPOLL_CTL_DEL, fd, nullptr);
+        removed_.push_back(std::move(slot.callback));
+        slot.callback = nullptr;
+        // Invalidates events for fd that are already queued
+        ++slot.generation;
+        --registered_;
+    }
+
+    size_t EventLoop::runOnce(int timeoutMs)
+    {
+        int n = epoll_wait(epoll_.fd(), events_.data(), int(events_.size()), timeoutMs);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                return 0;
+            }
+            throwSystemError("epoll_wait() failed");
+        }
+
+        size_t dispatched = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            const epoll_event &ev = events_[size_t(i)];
+            if (ev.data.u64 == kWakeupKey)
+            {
+                uint64_t count;
+                ssize_t r = readNoInt(wakeup_.fd(), &count, sizeof(count));
+                (void) r;
+                continue;
+            }
+            size_t fd = uint32_t(ev.data.u64);
+            Slot &slot = slots_[fd];
+            if (slot.generation == uint32_t(ev.data.u64 >> 32) && slot.callback)
+            {
+                slot.callback(ev.events);
+                ++dispatched;
+            }
+        }
+        removed_.clear();
+
+        if (size_t(n) == events_.size() && events_.size() < kMaxEvents)
+        {
+            events_.resize(events_.size() * 2);
+        }
+        return dispatched;
+    }
+
+    void EventLoop::run()
+    {
+        while (!stop_.exchange(false))
+        {
+            runOnce(-1);
+        }
+    }
+
+    void EventLoop::stop()
+    {
+        stop_ = true;
+        uint64_t one = 1;
+        ssize_t r = writeNoInt(wakeup_.fd(), &one, sizeof(one));
+        (void) r;
+    }
+
+    void WriteQueue::push(std::string data)
+    {
+        if (!data.empty())
+        {
+            bytes_ += data.size();
+            buffers_.push_back(std::move(data));
+        }
+    }
+
+    bool WriteQueue::flush(int fd)
+    {
+        while (bytes_ != 0)
+        {
+            iovec iov[kMaxIov];
+            int count = 0;
+            for (auto it = buffers_.begin(); it != buffers_.end() && count < kMaxIov; ++it, ++count)
+            {
+                size_t skip = count == 0 ? offset_ : 0;
+                iov[count].iov_base = &(*it)[skip];
+                iov[count].iov_len = it->size() - skip;
+            }
+
+            ssize_t r = writevNoInt(fd, iov, count);
+            if (r == -1)
+            {
+                return errno == EAGAIN;
+            }
+
+            bytes_ -= size_t(r);
+            size_t written = size_t(r) + offset_;
+            while (!buffers_.empty() && written >= buffers_.front().size())
+            {
+                written -= buffers_.front().size();
+                buffers_.pop_front();
+            }
+            offset_ = written;
+        }
+        return true;
+    }
+
+    Connection::Connection(EventLoop &loop, File file, DataCallback onData, CloseCallback onClose)
+            : loop_(loop),
+              file_(std::move(file)),
+              onData_(std::move(onData)),
+              onClose_(std::move(onClose)),
+              // Assume so until a write would block
+              writable_(true)
+    {
+        loop_.add(file_, [this](uint32_t events) { handleEvents(events); });
+    }
+
+    Connection::~Connection()
+    {
+        close();
+    }
+
+    bool Connection::send(std::string data)
+    {
+        if (!file_)
+        {
+            errno = EBADF;
+            return false;
+        }
+        queue_.push(std::move(data));
+        return !writable_ || flush();
+    }
+
+    void Connection::close()
+    {
+        if (file_)
+        {
+            loop_.remove(file_.fd());
+            file_.closeNoThrow();
+        }
+    }
+
+    bool Connection::flush()
+    {
+        if (!queue_.flush(file_.fd()))
+        {
+            return false;
+        }
+        // The queue is only left non-empty if the descriptor would block
+        writable_ = queue_.empty();
+        return true;
+    }
+
+    void Connection::handleEvents(uint32_t events)
+    {
+        if (events & EPOLLOUT)
+        {
+            writable_ = true;
+            if (!queue_.empty() && !flush())
+            {
+                fail(errno);
+                return;
+            }
+        }
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            handleRead();
+        }
+    }
+
+    bool Connection::handleRead()
+    {
+        char buf[kReadBufferSize];
+        for (;;)
+        {
+            ssize_t r = readSome(file_.fd(), buf, sizeof(buf));
+            if (r > 0)
+            {
+                bool drained = size_t(r) < sizeof(buf) && errno == EAGAIN;
+                if (onData_)
+                {
+                    onData_(*this, buf, size_t(r));
+                }
+                if (!file_)
+                {
+                    return false; // closed by onData
+                }
+                if (drained)
+                {
+                    return true;
+                }
+            } else if (r == 0)
+            {
+                fail(0);
+                return false;
+            } else if (errno == EAGAIN)
+            {
+                return true;
+            } else
+            {
+                fail(errno);
+                return false;
+            }
+        }
+    }
+
+    void Connection::fail(int error)
+    {
+        close();
+        // onClose may destroy us
+        CloseCallback onClose = std::move(onClose_);
+        onClose_ = nullptr;
+        if (onClose)
+        {
+            onClose(*this, error);
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#ifndef SYSTEM_IO_EVENTLOOP_H
+#define SYSTEM_IO_EVENTLOOP_H
+
+#include <sys/epoll.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "system_io/File.h"
+
+/*
+ * Edge-triggered epoll reactor for non-blocking sockets and pipes.
+ *
+ * Descriptors are registered once for reading and writing; a callback runs
+ * whenever either becomes possible, with the epoll event mask.  Because the
+ * registration is edge-triggered, a callback must read (or write) until it
+ * would block, e.g. with readSome() / writeSome(), or it will not be called
+ * again for the data already pending.
+ *
+ * An EventLoop is used from a single thread, except for stop().
+ */
+
+namespace sysio
+{
+    class EventLoop
+    {
+    public:
+        typedef std::function<void(uint32_t events)> Callback;
+
+        EventLoop();
+
+        EventLoop(const EventLoop &) = delete;
+
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        ~EventLoop();
+
+        /*
+         * Puts fd in non-blocking mode and calls callback(events) whenever
+         * it becomes readable (EPOLLIN), writable (EPOLLOUT), or the peer
+         * hangs up (EPOLLRDHUP, EPOLLHUP, EPOLLERR).  fd must stay open until
+         * it is removed.  Throws on error.
+         */
+        void add(int fd, Callback callback);
+
+        void add(const File &file, Callback callback)
+        {
+            add(file.fd(), std::move(callback));
+        }
+
+        /*
+         * Stops watching fd.  Events for fd that are already queued are
+         * dropped; it is safe to call from any callback.
+         */
+        void remove(int fd);
+
+        /*
+         * Waits up to timeoutMs (-1: forever) for events and dispatches
+         * them.  Returns the number of callbacks run.
+         */
+        size_t runOnce(int timeoutMs = -1);
+
+        /*
+         * Dispatches events until stop() is called.
+         */
+        void run();
+
+        /*
+         * Makes run() return after the current round of callbacks.  May be
+         * called from any thread.
+         */
+        void stop();
+
+        size_t size() const
+        {
+            return registered_;
+        }
+
+    private:
+        struct Slot
+        {
+            Callback callback;
+            uint32_t generation = 0;
+        };
+
+        File epoll_;
+        File wakeup_;
+        std::atomic<bool> stop_;
+        // Indexed by fd.  A deque, so that a callback may add descriptors
+        // while another callback is running.
+        std::deque<Slot> slots_;
+        size_t registered_ = 0;
+        std::vector<epoll_event> events_;
+        // Callbacks removed while dispatching, destroyed afterwards so that
+        // a callback may remove itself.
+        std::vector<Callback> removed_;
+    };
+
+    /*
+     * Outgoing data for a non-blocking descriptor, written in batches with
+     * writevNoInt().
+     */
+    class WriteQueue
+    {
+    public:
+        void push(std::string data);
+
+        /*
+         * Writes until the queue is empty or fd would block.  Returns false
+         * on error, with errno set.
+         */
+        bool flush(int fd);
+
+        bool empty() const
+        {
+            return bytes_ == 0;
+        }
+
+        size_t bytes() const
+        {
+            return bytes_;
+        }
+
+    private:
+        std::deque<std::string> buffers_;
+        // Already written part of buffers_.front()
+        size_t offset_ = 0;
+        size_t bytes_ = 0;
+    };
+
+    /*
+     * A non-blocking connection (socket or pipe) driven by an EventLoop.
+     * Incoming data is passed to onData as it arrives; send() queues data
+     * and writes it as the descriptor becomes writable.
+     *
+     * onData may call send() and close().  onClose is called once, with 0
+     * at EOF or an errno value on a read or write error, with the descriptor
+     * already closed; onClose may destroy the Connection.
+     */
+    class Connection
+    {
+    public:
+        typedef std::function<void(Connection &, const char *data, size_t n)> DataCallback;
+        typedef std::function<void(Connection &, int error)> CloseCallback;
+
+        Connection(EventLoop &loop, File file, DataCallback onData, CloseCallback onClose);
+
+        Connection(const Connection &) = delete;
+
+        Connection &operator=(const Connection &) = delete;
+
+        ~Connection();
+
+        /*
+         * Queues data and writes as much of it as possible right away.
+         * Returns false on error, with errno set; the caller should close()
+         * the connection.
+         */
+        bool send(std::string data);
+
+        /*
+         * Closes the connection without waiting for queued data to be
+         * written, and without calling onClose.
+         */
+        void close();
+
+        int fd() const
+        {
+            return file_.fd();
+        }
+
+        size_t pendingBytes() const
+        {
+            return queue_.bytes();
+        }
+
+    private:
+        void handleEvents(uint32_t events);
+
+        // Returns false if the connection was closed.
+        bool handleRead();
+
+        bool flush();
+
+        void fail(int error);
+
+        EventLoop &loop_;
+        File file_;
+        DataCallback onData_;
+        CloseCallback onClose_;
+        WriteQueue queue_;
+        bool writable_ = false;
+    };
+}
+
+#endif //SYSTEM_IO_EVENTLOOP_H
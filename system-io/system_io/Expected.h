@@ -0,0 +1,240 @@
+#ifndef SYSTEM_IO_EXPECTED_H
+#define SYSTEM_IO_EXPECTED_H
+
+#include <cerrno>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "system_io/Exception.h"
+
+/*
+ * Expected<T, E> holds either a value of type T or an error of type E, for
+ * functions whose failure is routine enough that an exception would cost
+ * more than the work itself (e.g. probing for files that usually do not
+ * exist).
+ *
+ * Nothing is allocated or formatted on the error path: with E =
+ * std::error_code, the message is only built if error().message() is called
+ * or value() throws.
+ *
+ * Example:
+ *   auto file = File::tryOpen(path);
+ *   if (!file) {
+ *       if (file.error() == std::errc::no_such_file_or_directory) ...
+ *   }
+ *   use(file->fd());
+ */
+
+namespace sysio
+{
+    template<class E>
+    class Unexpected
+    {
+    public:
+        explicit Unexpected(E error) : error_(std::move(error))
+        {}
+
+        E &error() &
+        {
+            return error_;
+        }
+
+        E &&error() &&
+        {
+            return std::move(error_);
+        }
+
+    private:
+        E error_;
+    };
+
+    template<class E>
+    Unexpected<typename std::decay<E>::type> makeUnexpected(E &&error)
+    {
+        return Unexpected<typename std::decay<E>::type>(std::forward<E>(error));
+    }
+
+    namespace detail
+    {
+        // Thrown by Expected::value() when there is no value
+        [[noreturn]] inline void throwBadExpectedAccess(const std::error_code &error)
+        {
+            throw_exception(std::system_error(error));
+        }
+
+        template<class E>
+        [[noreturn]] void throwBadExpectedAccess(const E &)
+        {
+            throw_exception(std::logic_error("Expected has no value"));
+        }
+    }
+
+    template<class T, class E = std::error_code>
+    class Expected
+    {
+    public:
+        Expected(const T &value) : hasValue_(true)
+        {
+            new(&value_) T(value);
+        }
+
+        Expected(T &&value) : hasValue_(true)
+        {
+            new(&value_) T(std::move(value));
+        }
+
+        template<class U>
+        Expected(Unexpected<U> error) : hasValue_(false)
+        {
+            new(&error_) E(std::move(error).error());
+        }
+
+        Expected(const Expected &other) : hasValue_(other.hasValue_)
+        {
+            if (hasValue_)
+            {
+                new(&value_) T(other.value_);
+            } else
+            {
+                new(&error_) E(other.error_);
+            }
+        }
+
+        Expected(Expected &&other) noexcept(std::is_nothrow_move_constructible<T>::value &&
+                                            std::is_nothrow_move_constructible<E>::value)
+                : hasValue_(other.hasValue_)
+        {
+            if (hasValue_)
+            {
+                new(&value_) T(std::move(other.value_));
+            } else
+            {
+                new(&error_) E(std::move(other.error_));
+            }
+        }
+
+        Expected &operator=(Expected other)
+        {
+            destroy();
+            hasValue_ = other.hasValue_;
+            if (hasValue_)
+            {
+                new(&value_) T(std::move(other.value_));
+            } else
+            {
+                new(&error_) E(std::move(other.error_));
+            }
+            return *this;
+        }
+
+        ~Expected()
+        {
+            destroy();
+        }
+
+        bool hasValue() const noexcept
+        {
+            return hasValue_;
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return hasValue_;
+        }
+
+        /*
+         * Returns the value, or throws if there is none: std::system_error
+         * for a std::error_code, std::logic_error otherwise.
+         */
+        T &value() &
+        {
+            requireValue();
+            return value_;
+        }
+
+        const T &value() const &
+        {
+            requireValue();
+            return value_;
+        }
+
+        T &&value() &&
+        {
+            requireValue();
+            return std::move(value_);
+        }
+
+        /*
+         * The error; only valid if !hasValue().
+         */
+        const E &error() const noexcept
+        {
+            return error_;
+        }
+
+        T &operator*() &
+        {
+            return value();
+        }
+
+        const T &operator*() const &
+        {
+            return value();
+        }
+
+        T &&operator*() &&
+        {
+            return std::move(*this).value();
+        }
+
+        T *operator->()
+        {
+            return &value();
+        }
+
+        const T *operator->() const
+        {
+            return &value();
+        }
+
+    private:
+        void requireValue() const
+        {
+            if (UNLIKELY(!hasValue_))
+            {
+                detail::throwBadExpectedAccess(error_);
+            }
+        }
+
+        void destroy() noexcept
+        {
+            if (hasValue_)
+            {
+                value_.~T();
+            } else
+            {
+                error_.~E();
+            }
+        }
+
+        union
+        {
+            T value_;
+            E error_;
+        };
+        bool hasValue_;
+    };
+
+    /*
+     * The error code of the current errno, for returning as an Unexpected.
+     */
+    inline std::error_code errnoCode() noexcept
+    {
+        return std::error_code(errno, std::generic_category());
+    }
+}
+
+#endif //SYSTEM_IO_EXPECTED_H
@@ -0,0 +1,581 @@
+#include "system_io/ExternalSort.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "system_io/ByteSource.h"
+#include "system_io/Exception.h"
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/LineReader.h"
+#include "system_io/detail/Clock.h"
+#include "system_io/detail/Page.h"
+
+namespace sysio
+{
+    namespace
+    {
+        const int kIovBatch = IOV_MAX;
+
+        off_t pageFloor(off_t offset)
+        {
+            return offset & ~(off_t(detail::pageSize()) - 1);
+        }
+
+        /*
+         * Reads a file sequentially from offset with pread(), optionally
+         * prefetching the block after each read and dropping what was read
+         * from the page cache.
+         */
+        class SequentialSource : public ByteSource
+        {
+        public:
+            SequentialSource(int fd, off_t offset, bool prefetch, bool dropBehind)
+                    : fd_(fd), offset_(offset), dropped_(pageFloor(offset)),
+                      prefetch_(prefetch), dropBehind_(dropBehind)
+            {
+                posix_fadvise(fd_, offset_, 0, POSIX_FADV_SEQUENTIAL);
+            }
+
+            ssize_t read(void *buf, size_t n) override
+            {
+                ssize_t r = preadFull(fd_, buf, n, offset_);
+                if (r <= 0)
+                {
+                    return r;
+                }
+                offset_ += r;
+                if (prefetch_ && size_t(r) == n)
+                {
+                    posix_fadvise(fd_, offset_, off_t(n), POSIX_FADV_WILLNEED);
+                }
+                if (dropBehind_)
+                {
+                    // Whole pages only: the rest of the last one is read next
+                    off_t end = pageFloor(offset_);
+                    if (end > dropped_)
+                    {
+                        posix_fadvise(fd_, dropped_, end - dropped_, POSIX_FADV_DONTNEED);
+                        dropped_ = end;
+                    }
+                }
+                return r;
+            }
+
+            off_t offset() const
+            {
+                return offset_;
+            }
+
+        private:
+            int fd_;
+            off_t offset_;
+            off_t dropped_;
+            bool prefetch_;
+            bool dropBehind_;
+        };
+
+        // Big-endian first 8 bytes of a key, zero-padded, so that comparing
+        // prefixes as integers compares the keys' first bytes
+        uint64_t keyPrefix(const char *key, size_t size)
+        {
+            uint64_t prefix = 0;
+            memcpy(&prefix, key, std::min(size, sizeof(prefix)));
+            return __builtin_bswap64(prefix);
+        }
+
+        // memcmp() order of two keys whose prefixes are equal
+        int compareTails(const char *a, size_t aSize, const char *b, size_t bSize)
+        {
+            size_t n = std::min(aSize, bSize);
+            if (n > sizeof(uint64_t))
+            {
+                int c = memcmp(a + sizeof(uint64_t), b + sizeof(uint64_t), n - sizeof(uint64_t));
+                if (c != 0)
+                {
+                    return c;
+                }
+            }
+            return aSize < bSize ? -1 : aSize > bSize ? 1 : 0;
+        }
+
+        ExternalSort::Key lineKey(const ExternalSort::KeyExtractor &key, const char *line, size_t size)
+        {
+            if (!key)
+            {
+                return {line, size};
+            }
+            ExternalSort::Key k = key(line, size);
+            DCHECK(k.data >= line && k.data + k.size <= line + size);
+            return k;
+        }
+
+        // A line of a batch; size includes the newline
+        struct Entry
+        {
+            uint64_t prefix;
+            size_t offset;
+            uint32_t size;
+            uint32_t keyOffset;
+            uint32_t keySize;
+        };
+
+        struct Batch
+        {
+            std::vector<char> data;
+            std::vector<Entry> entries;
+        };
+
+        struct Run
+        {
+            File file;
+            uint64_t bytes = 0;
+            uint64_t lines = 0;
+            size_t maxLine = 0;
+            uint64_t sortNanos = 0;
+        };
+
+        File temporaryFile(const std::string &directory)
+        {
+            if (directory.empty())
+            {
+                return File::temporary();
+            }
+            return File(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        }
+
+        void writeAll(int fd, iovec *iov, int count)
+        {
+            if (writevFull(fd, iov, count) == -1)
+            {
+                throwSystemError("ExternalSort: write failed");
+            }
+        }
+
+        // Sorts a batch and writes it to fd
+        void sortBatch(Batch &batch, int fd, const ExternalSort::Options &options, Run &run)
+        {
+            uint64_t start = detail::nowNanos();
+            const char *data = batch.data.data();
+            for (Entry &e : batch.entries)
+            {
+                const char *line = data + e.offset;
+                ExternalSort::Key k = lineKey(options.key, line, e.size - 1);
+                e.keyOffset = uint32_t(k.data - line);
+                e.keySize = uint32_t(k.size);
+                e.prefix = keyPrefix(k.data, k.size);
+            }
+            bool stable = options.stable;
+            std::sort(batch.entries.begin(), batch.entries.end(), [data, stable](const Entry &a, const Entry &b) {
+                if (a.prefix != b.prefix)
+                {
+                    return a.prefix < b.prefix;
+                }
+                int c = compareTails(data + a.offset + a.keyOffset, a.keySize,
+                                     data + b.offset + b.keyOffset, b.keySize);
+                if (c != 0)
+                {
+                    return c < 0;
+                }
+                // Lines are stored in input order
+                return stable && a.offset < b.offset;
+            });
+            run.sortNanos = detail::nowNanos() - start;
+
+            iovec iov[kIovBatch];
+            int n = 0;
+            for (const Entry &e : batch.entries)
+            {
+                iov[n].iov_base = const_cast<char *>(data + e.offset);
+                iov[n].iov_len = e.size;
+                run.maxLine = std::max(run.maxLine, size_t(e.size));
+                if (++n == kIovBatch)
+                {
+                    writeAll(fd, iov, n);
+                    n = 0;
+                }
+            }
+            writeAll(fd, iov, n);
+            run.bytes = batch.data.size();
+            run.lines = batch.entries.size();
+        }
+
+        /*
+         * Merges runs with a loser tree.
+         */
+        class Merger
+        {
+        public:
+            Merger(std::vector<Run> &runs, size_t begin, size_t end, const ExternalSort::Options &options)
+                    : key_(options.key), k_(end - begin), tree_(k_, kNone)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    cursors_.emplace_back(new Cursor(runs[i], options.mergeBlockSize));
+                }
+                for (size_t i = 0; i < k_; ++i)
+                {
+                    next(*cursors_[i]);
+                    replay(i);
+                }
+            }
+
+            // Writes the merged runs to fd
+            void mergeTo(int fd, ExternalSort::PhaseStats &stats)
+            {
+                std::vector<iovec> iov;
+                iov.reserve(kIovBatch);
+                while (!cursors_[tree_[0]]->done)
+                {
+                    size_t winner = tree_[0];
+                    Cursor &c = *cursors_[winner];
+                    iov.push_back({const_cast<char *>(c.line), c.size});
+                    stats.bytes += c.size;
+                    ++stats.lines;
+                    // Lines point into the cursors' blocks: write them out
+                    // before this one reads its next block
+                    if (iov.size() == size_t(kIovBatch) || c.pos == c.end)
+                    {
+                        writeAll(fd, iov.data(), int(iov.size()));
+                        iov.clear();
+                    }
+                    next(c);
+                    replay(winner);
+                }
+                writeAll(fd, iov.data(), int(iov.size()));
+            }
+
+        private:
+            static constexpr size_t kNone = std::numeric_limits<size_t>::max();
+
+            struct Cursor
+            {
+                Cursor(Run &run, size_t blockSize)
+                        : source(run.file.fd(), 0, true, true),
+                          reader(source, readerOptions(blockSize, run.maxLine))
+                {}
+
+                static LineReader::Options readerOptions(size_t blockSize, size_t maxLine)
+                {
+                    LineReader::Options options;
+                    options.initialSize = blockSize;
+                    // Whole lines, so that every block ends with a newline
+                    options.maxSize = std::max(blockSize, maxLine);
+                    return options;
+                }
+
+                SequentialSource source;
+                LineReader reader;
+                // Rest of the current block
+                const char *pos = nullptr;
+                const char *end = nullptr;
+                // Current line (with its newline) and its key
+                const char *line = nullptr;
+                size_t size = 0;
+                ExternalSort::Key key = {nullptr, 0};
+                uint64_t prefix = 0;
+                bool done = false;
+            };
+
+            // Moves c to its next line, reading its next block if needed
+            void next(Cursor &c)
+            {
+                if (c.pos == c.end)
+                {
+                    LineReader::State state = c.reader.readLines(&c.pos, &c.end);
+                    if (state == LineReader::kError)
+                    {
+                        throwSystemError("ExternalSort: read of run failed");
+                    }
+                    if (state == LineReader::kEof)
+                    {
+                        c.done = true;
+                        return;
+                    }
+                }
+                auto nl = static_cast<const char *>(memchr(c.pos, '\n', size_t(c.end - c.pos)));
+                CHECK(nl != nullptr);
+                c.line = c.pos;
+                c.size = size_t(nl + 1 - c.pos);
+                c.pos = nl + 1;
+                c.key = lineKey(key_, c.line, c.size - 1);
+                c.prefix = keyPrefix(c.key.data, c.key.size);
+            }
+
+            // Whether the line of cursor a goes before that of cursor b;
+            // ties go to the earlier run, which keeps the merge stable
+            bool less(size_t a, size_t b) const
+            {
+                const Cursor &x = *cursors_[a];
+                const Cursor &y = *cursors_[b];
+                if (x.done || y.done)
+                {
+                    return !x.done;
+                }
+                if (x.prefix != y.prefix)
+                {
+                    return x.prefix < y.prefix;
+                }
+                int c = compareTails(x.key.data, x.key.size, y.key.data, y.key.size);
+                return c != 0 ? c < 0 : a < b;
+            }
+
+            // Plays leaf's new line up the tree.  Losers stay in the nodes
+            // (leaf i sits under node (i + k) / 2) and the winner ends up in
+            // tree_[0].  While the tree is built, a leaf stops at the first
+            // empty node.
+            void replay(size_t leaf)
+            {
+                size_t winner = leaf;
+                for (size_t node = (leaf + k_) / 2; node > 0; node /= 2)
+                {
+                    if (tree_[node] == kNone)
+                    {
+                        tree_[node] = winner;
+                        return;
+                    }
+                    if (less(tree_[node], winner))
+                    {
+                        std::swap(tree_[node], winner);
+                    }
+                }
+                tree_[0] = winner;
+            }
+
+            const ExternalSort::KeyExtractor &key_;
+            size_t k_;
+            std::vector<size_t> tree_;
+            std::vector<std::unique_ptr<Cursor>> cursors_;
+        };
+
+        constexpr size_t Merger::kNone;
+    }
+
+    ExternalSort::KeyExtractor ExternalSort::fieldKey(char delimiter, size_t index)
+    {
+        return [delimiter, index](const char *line, size_t size) {
+            const char *end = line + size;
+            const char *p = line;
+            for (size_t i = 0; i < index; ++i)
+            {
+                p = static_cast<const char *>(memchr(p, delimiter, size_t(end - p)));
+                if (p == nullptr)
+                {
+                    return Key{end, 0};
+                }
+                ++p;
+            }
+            auto q = static_cast<const char *>(memchr(p, delimiter, size_t(end - p)));
+            return Key{p, size_t((q != nullptr ? q : end) - p)};
+        };
+    }
+
+    ExternalSort::ExternalSort()
+            : ExternalSort(Options())
+    {}
+
+    ExternalSort::ExternalSort(const Options &options)
+            : options_(options)
+    {
+        if (options_.threads == 0)
+        {
+            options_.threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        CHECK_GT(options_.readBlockSize, 0u);
+        CHECK_GT(options_.mergeBlockSize, 0u);
+    }
+
+    void ExternalSort::sort(int fdIn, int fdOut)
+    {
+        off_t offset = lseek(fdIn, 0, SEEK_CUR);
+        if (offset == -1)
+        {
+            // A pipe
+            FdByteSource in(fdIn);
+            sortFrom(in, fdOut);
+            return;
+        }
+        SequentialSource in(fdIn, offset, false, options_.dropBehind);
+        sortFrom(in, fdOut);
+        checkUnixError(lseek(fdIn, in.offset(), SEEK_SET), "ExternalSort: lseek() failed");
+    }
+
+    void ExternalSort::sort(ByteSource &in, int fdOut)
+    {
+        sortFrom(in, fdOut);
+    }
+
+    void ExternalSort::sort(const std::string &input, const std::string &output)
+    {
+        File in(input.c_str(), O_RDONLY | O_CLOEXEC);
+        File out(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        sort(in.fd(), out.fd());
+        out.close();
+    }
+
+    void ExternalSort::sortFrom(ByteSource &in, int fdOut)
+    {
+        stats_ = Stats();
+        uint64_t start = detail::nowNanos();
+        const size_t threads = options_.threads;
+        const size_t batchBudget = std::max(options_.memoryBudget / (threads + 1),
+                                            2 * options_.readBlockSize);
+
+        LineReader::Options readerOptions;
+        readerOptions.initialSize = options_.readBlockSize;
+        LineReader reader(in, readerOptions);
+
+        std::vector<Run> runs;
+        std::deque<std::future<Run>> pending;
+        std::unique_ptr<Batch> batch(new Batch);
+        // Start of the line being read, in batch->data
+        size_t lineStart = 0;
+        bool eof = false;
+        while (!eof)
+        {
+            const char *begin;
+            const char *end;
+            LineReader::State state = reader.readLines(&begin, &end);
+            if (state == LineReader::kError)
+            {
+                throwSystemError("ExternalSort: read failed");
+            }
+            std::vector<char> &data = batch->data;
+            if (state == LineReader::kEof)
+            {
+                eof = true;
+                if (lineStart < data.size())
+                {
+                    // Last line without a newline
+                    data.push_back('\n');
+                }
+            } else
+            {
+                data.insert(data.end(), begin, end);
+                stats_.runs.bytes += size_t(end - begin);
+            }
+            for (;;)
+            {
+                auto nl = static_cast<const char *>(
+                        memchr(data.data() + lineStart, '\n', data.size() - lineStart));
+                if (nl == nullptr)
+                {
+                    break;
+                }
+                size_t next = size_t(nl - data.data()) + 1;
+                CHECK_LE(next - lineStart, size_t(std::numeric_limits<uint32_t>::max()));
+                batch->entries.push_back({0, lineStart, uint32_t(next - lineStart), 0, 0});
+                lineStart = next;
+            }
+
+            if (eof ? batch->entries.empty()
+                    : data.size() + batch->entries.size() * sizeof(Entry) < batchBudget)
+            {
+                continue;
+            }
+            stats_.runs.lines += batch->entries.size();
+            if (eof && runs.empty() && pending.empty())
+            {
+                // Fits in memory: no runs
+                Run run;
+                sortBatch(*batch, fdOut, options_, run);
+                stats_.sortNanos += run.sortNanos;
+                stats_.runs.nanos = detail::nowNanos() - start;
+                return;
+            }
+
+            // The line being read moves to the next batch
+            std::unique_ptr<Batch> full(new Batch);
+            std::swap(full, batch);
+            // The input is larger than a batch: allocate the next one at once
+            // instead of growing it
+            batch->data.reserve(batchBudget + options_.readBlockSize);
+            batch->data.assign(full->data.begin() + lineStart, full->data.end());
+            full->data.resize(lineStart);
+            lineStart = 0;
+
+            if (pending.size() == threads)
+            {
+                uint64_t waitStart = detail::nowNanos();
+                runs.push_back(pending.front().get());
+                pending.pop_front();
+                stats_.runWaitNanos += detail::nowNanos() - waitStart;
+            }
+            std::shared_ptr<Batch> shared(std::move(full));
+            const Options &options = options_;
+            pending.push_back(std::async(std::launch::async, [shared, &options] {
+                Run run;
+                run.file = temporaryFile(options.tempDirectory);
+                sortBatch(*shared, run.file.fd(), options, run);
+                return run;
+            }));
+        }
+        while (!pending.empty())
+        {
+            runs.push_back(pending.front().get());
+            pending.pop_front();
+        }
+        stats_.runCount = runs.size();
+        for (const Run &run : runs)
+        {
+            stats_.sortNanos += run.sortNanos;
+        }
+        stats_.runs.nanos = detail::nowNanos() - start;
+        if (runs.empty())
+        {
+            return;
+        }
+
+        // Merge consecutive runs (which keeps equal lines in input order)
+        // until the blocks of all runs fit in the budget
+        const size_t fanIn = std::max<size_t>(2, options_.memoryBudget / options_.mergeBlockSize);
+        while (runs.size() > fanIn)
+        {
+            start = detail::nowNanos();
+            std::vector<Run> merged;
+            for (size_t i = 0; i < runs.size(); i += fanIn)
+            {
+                size_t end = std::min(runs.size(), i + fanIn);
+                if (end - i == 1)
+                {
+                    merged.push_back(std::move(runs[i]));
+                    continue;
+                }
+                Run run;
+                run.file = temporaryFile(options_.tempDirectory);
+                ExternalSort::PhaseStats pass;
+                Merger(runs, i, end, options_).mergeTo(run.file.fd(), pass);
+                run.bytes = pass.bytes;
+                run.lines = pass.lines;
+                for (size_t j = i; j < end; ++j)
+                {
+                    run.maxLine = std::max(run.maxLine, runs[j].maxLine);
+                    // Frees the disk space
+                    runs[j].file = File();
+                }
+                stats_.intermediateMerges.bytes += pass.bytes;
+                stats_.intermediateMerges.lines += pass.lines;
+                merged.push_back(std::move(run));
+            }
+            runs = std::move(merged);
+            ++stats_.mergePasses;
+            stats_.intermediateMerges.nanos += detail::nowNanos() - start;
+        }
+
+        start = detail::nowNanos();
+        Merger(runs, 0, runs.size(), options_).mergeTo(fdOut, stats_.merge);
+        stats_.merge.nanos = detail::nowNanos() - start;
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef SYSTEM_IO_EXTERNALSORT_H
+#define SYSTEM_IO_EXTERNALSORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/*
+ * Sorts line-oriented files larger than memory.
+ *
+ * The input is read with a LineReader into batches of at most
+ * memoryBudget / (threads + 1) bytes.  Each full batch is sorted and written
+ * out as a run (a temporary file) on a thread of its own while the next
+ * batch is read, up to Options::threads batches at once.  Sorting compares
+ * keys extracted once per line, through an 8-byte prefix of the key before
+ * the rest of it, and runs are written with writevFull() straight from the
+ * batch, without copying the lines into order first.  An input that fits in
+ * one batch is sorted in memory and written straight to the output.
+ *
+ * The runs are then merged with a loser tree, which takes one comparison per
+ * level of the tree for each line.  Each run is read in blocks of
+ * Options::mergeBlockSize, and the block after the one being read is
+ * prefetched (POSIX_FADV_WILLNEED): the kernel's own readahead is too small
+ * for dozens of files read in turns.  When there are more runs than the
+ * memory budget holds blocks for, consecutive runs are merged into longer
+ * ones first, as many passes as needed.
+ *
+ * Lines are compared as bytes (memcmp), on the whole line or on the key an
+ * Options::key extractor picks out of it.  The trailing newline is not part
+ * of the line; a last line without one gets one in the output.
+ *
+ * Example:
+ *   ExternalSort::Options options;
+ *   options.memoryBudget = 8ul << 30;
+ *   options.key = ExternalSort::fieldKey('\t', 2);
+ *   options.stable = true;
+ *   ExternalSort sorter(options);
+ *   sorter.sort("access.log", "access.sorted");
+ */
+
+namespace sysio
+{
+    class ByteSource;
+
+    class ExternalSort
+    {
+    public:
+        struct Key
+        {
+            const char *data;
+            size_t size;
+        };
+
+        /*
+         * Returns the key of the line [line, line + size), newline excluded.
+         * The key must point into the line.  Called concurrently from several
+         * threads.
+         */
+        typedef std::function<Key(const char *line, size_t size)> KeyExtractor;
+
+        struct Options
+        {
+            // Memory for lines and their index while forming runs, and for
+            // the blocks of the runs being merged
+            size_t memoryBudget = size_t(1) << 30;
+            // Batches sorted at once; 0 for one per CPU
+            size_t threads = 0;
+            // Whole line if empty
+            KeyExtractor key;
+            // Keep lines with equal keys in input order
+            bool stable = false;
+            // Drop the input from the page cache as it is read, so that a
+            // sort of a file larger than memory does not evict everything
+            // else.  Runs are always dropped as they are merged.
+            bool dropBehind = false;
+            // Unit of reads of the input and of each run being merged
+            size_t readBlockSize = 1 << 20;
+            size_t mergeBlockSize = 1 << 20;
+            // Directory for runs (unlinked O_TMPFILE files); the default
+            // temporary directory if empty
+            std::string tempDirectory;
+        };
+
+        struct PhaseStats
+        {
+            uint64_t bytes = 0;
+            uint64_t lines = 0;
+            uint64_t nanos = 0;
+        };
+
+        struct Stats
+        {
+            // Run formation: input read, sorted and written out as runs
+            PhaseStats runs;
+            // Time spent sorting batches, summed over threads
+            uint64_t sortNanos = 0;
+            // Time the reading thread waited for a batch to be sorted and
+            // written, for lack of memory to read the next one
+            uint64_t runWaitNanos = 0;
+            uint64_t runCount = 0;
+            // Intermediate merge passes (merging runs into longer runs), and
+            // the final merge into the output
+            PhaseStats intermediateMerges;
+            uint64_t mergePasses = 0;
+            PhaseStats merge;
+        };
+
+        /*
+         * Key of the index-th (from 0) field of lines split on delimiter;
+         * empty if the line has fewer fields.
+         */
+        static KeyExtractor fieldKey(char delimiter, size_t index);
+
+        ExternalSort();
+
+        explicit ExternalSort(const Options &options);
+
+        ExternalSort(const ExternalSort &) = delete;
+
+        ExternalSort &operator=(const ExternalSort &) = delete;
+
+        /*
+         * Sorts fdIn from its current offset to EOF, and writes the result
+         * to fdOut at its current offset.  Throws on error.
+         */
+        void sort(int fdIn, int fdOut);
+
+        void sort(ByteSource &in, int fdOut);
+
+        /*
+         * Sorts file input into file output, which is created or truncated.
+         */
+        void sort(const std::string &input, const std::string &output);
+
+        // Of the last sort()
+        const Stats &stats() const
+        {
+            return stats_;
+        }
+
+    private:
+        void sortFrom(ByteSource &in, int fdOut);
+
+        Options options_;
+        Stats stats_;
+    };
+}
+
+#endif //SYSTEM_IO_EXTERNALSORT_H
@@ -0,0 +1,222 @@
+#include "system_io/FdCache.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include <glog/logging.h>
+
+#include "system_io/FileUtil.h"
+
+namespace sysio
+{
+    FdCache::Identity::Identity(const struct stat &st)
+            : dev(st.st_dev),
+              ino(st.st_ino),
+              size(st.st_size),
+              mtime(st.st_mtim)
+    {}
+
+    bool FdCache::Identity::operator==(const Identity &other) const
+    {
+        return dev == other.dev && ino == other.ino && size == other.size &&
+               mtime.tv_sec == other.mtime.tv_sec && mtime.tv_nsec == other.mtime.tv_nsec;
+    }
+
+    FdCache::FdCache()
+            : FdCache(Options())
+    {}
+
+    FdCache::FdCache(const Options &options)
+            : options_(options)
+    {
+        CHECK_GT(options.shards, 0u);
+        CHECK_GT(options.maxFds, 0u);
+        // Fewer shards than descriptors would leave some without any
+        size_t shards = std::min(options.shards, options.maxFds);
+        maxFdsPerShard_ = options.maxFds / shards;
+        shards_.reserve(shards);
+        for (size_t i = 0; i < shards; ++i)
+        {
+            shards_.emplace_back(new Shard);
+        }
+    }
+
+    FdCache::Shard &FdCache::shardFor(const Key &key)
+    {
+        return *shards_[KeyHash()(key) % shards_.size()];
+    }
+
+    void FdCache::erase(Shard &shard, std::list<Entry>::iterator it)
+    {
+        shard.index.erase(it->key);
+        shard.lru.erase(it);
+    }
+
+    Expected<FdCache::Handle> FdCache::get(const std::string &path, int dirfd)
+    {
+        Key key{dirfd, path};
+        Shard &shard = shardFor(key);
+        auto now = std::chrono::steady_clock::now();
+
+        Handle cached;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto found = shard.index.find(key);
+            if (found != shard.index.end())
+            {
+                auto it = found->second;
+                shard.lru.splice(shard.lru.begin(), shard.lru, it);
+                if (now - it->validated < options_.revalidateInterval)
+                {
+                    ++shard.stats.hits;
+                    return it->file;
+                }
+                cached = it->file;
+            }
+        }
+
+        // Revalidate, or open, without holding the lock
+        struct stat st;
+        if (cached)
+        {
+            if (fstatat(dirfd, path.c_str(), &st, 0) == 0)
+            {
+                Identity current(st);
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                auto found = shard.index.find(key);
+                if (found != shard.index.end() && found->second->file == cached)
+                {
+                    if (found->second->identity == current)
+                    {
+                        found->second->validated = now;
+                        ++shard.stats.hits;
+                        return cached;
+                    }
+                    ++shard.stats.invalidations;
+                    erase(shard, found->second);
+                }
+            } else
+            {
+                int err = errno;
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                auto found = shard.index.find(key);
+                if (found != shard.index.end() && found->second->file == cached)
+                {
+                    ++shard.stats.invalidations;
+                    erase(shard, found->second);
+                }
+                ++shard.stats.misses;
+                return makeUnexpected(std::error_code(err, std::generic_category()));
+            }
+        }
+
+        int fd;
+        do
+        {
+            fd = openat(dirfd, path.c_str(), options_.flags);
+        } while (fd == -1 && errno == EINTR);
+        if (fd == -1 || fstat(fd, &st) == -1)
+        {
+            auto error = errnoCode();
+            if (fd != -1)
+            {
+                closeNoInt(fd);
+            }
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ++shard.stats.misses;
+            return makeUnexpected(error);
+        }
+
+        Handle file = std::make_shared<const File>(fd, true);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.stats.misses;
+        // Another thread may have opened it meanwhile; ours is newer
+        auto found = shard.index.find(key);
+        if (found != shard.index.end())
+        {
+            erase(shard, found->second);
+        }
+        shard.lru.push_front(Entry{key, file, Identity(st), now});
+        shard.index.emplace(std::move(key), shard.lru.begin());
+        while (shard.lru.size() > maxFdsPerShard_)
+        {
+            ++shard.stats.evictions;
+            erase(shard, std::prev(shard.lru.end()));
+        }
+        return file;
+    }
+
+    void FdCache::invalidate(const std::string &path, int dirfd)
+    {
+        Key key{dirfd, path};
+        Shard &shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end())
+        {
+            ++shard.stats.invalidations;
+            erase(shard, found->second);
+        }
+    }
+
+    void FdCache::clear()
+    {
+        for (auto &shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->index.clear();
+            shard->lru.clear();
+        }
+    }
+
+    FdCache::Stats FdCache::stats() const
+    {
+        Stats total;
+        for (auto &shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total.hits += shard->stats.hits;
+            total.misses += shard->stats.misses;
+            total.evictions += shard->stats.evictions;
+            total.invalidations += shard->stats.invalidations;
+            total.open += shard->lru.size();
+        }
+        return total;
+    }
+
+    bool readFile(FdCache &cache, const char *fileName, std::string &out, size_t numBytes)
+    {
+        auto file = cache.get(fileName);
+        if (!file)
+        {
+            errno = file.error().value();
+            return false;
+        }
+        int fd = (*file)->fd();
+
+        // As readFile(int, ...), but with pread() from the start
+        off_t offset = 0;
+        return detail::readFileWith(fd, out, numBytes, [&](int f, void *buf, size_t n) {
+            ssize_t r = preadFull(f, buf, n, offset);
+            if (r != -1)
+            {
+                offset += r;
+            }
+            return r;
+        });
+    }
+
+    ssize_t preadFull(FdCache &cache, const char *fileName, void *buf, size_t n, off_t offset)
+    {
+        auto file = cache.get(fileName);
+        if (!file)
+        {
+            errno = file.error().value();
+            return -1;
+        }
+        return preadFull((*file)->fd(), buf, n, offset);
+    }
+}
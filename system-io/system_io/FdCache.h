@@ -0,0 +1,176 @@
+#ifndef SYSTEM_IO_FDCACHE_H
+#define SYSTEM_IO_FDCACHE_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "system_io/Expected.h"
+#include "system_io/File.h"
+
+/*
+ * Cache of open file descriptors, for services that read the same set of
+ * files over and over: a hit replaces open() + close() (and the path lookup
+ * of open()) with a stat() to check that the file was not replaced or
+ * modified, or with nothing at all between revalidations.
+ *
+ * Entries are keyed by path and directory descriptor (AT_FDCWD for paths
+ * relative to the working directory, as with openat()), and handed out as
+ * shared handles: an evicted or invalidated descriptor stays open until the
+ * last handle to it is released.  The cache keeps at most maxFds
+ * descriptors itself, evicting the least recently used ones.
+ *
+ * The cache is split into shards with a lock each; it is thread-safe.
+ * Descriptors are shared, so only use positional I/O (pread) on them.
+ */
+
+namespace sysio
+{
+    class FdCache
+    {
+    public:
+        typedef std::shared_ptr<const File> Handle;
+
+        struct Options
+        {
+            // Descriptors kept open by the cache, over all shards
+            size_t maxFds = 1024;
+            size_t shards = 16;
+            int flags = O_RDONLY | O_CLOEXEC;
+            // How long a hit is trusted without checking the file's inode,
+            // size and mtime again; 0 checks on every hit
+            std::chrono::milliseconds revalidateInterval{0};
+        };
+
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            // Entries dropped for the budget, and because the file changed
+            uint64_t evictions = 0;
+            uint64_t invalidations = 0;
+            // Descriptors held by the cache now
+            size_t open = 0;
+
+            double hitRate() const
+            {
+                uint64_t lookups = hits + misses;
+                return lookups == 0 ? 0.0 : double(hits) / double(lookups);
+            }
+        };
+
+        FdCache();
+
+        explicit FdCache(const Options &options);
+
+        FdCache(const FdCache &) = delete;
+
+        FdCache &operator=(const FdCache &) = delete;
+
+        /*
+         * Returns a handle to path (relative to dirfd), opening it if it is
+         * not cached or has changed since it was.  Returns the error code of
+         * a failed open() or stat() instead of throwing.
+         */
+        Expected<Handle> get(const std::string &path, int dirfd = AT_FDCWD);
+
+        /*
+         * Drops path from the cache, if present.
+         */
+        void invalidate(const std::string &path, int dirfd = AT_FDCWD);
+
+        /*
+         * Drops all entries.
+         */
+        void clear();
+
+        Stats stats() const;
+
+    private:
+        struct Key
+        {
+            int dirfd;
+            std::string path;
+
+            bool operator==(const Key &other) const
+            {
+                return dirfd == other.dirfd && path == other.path;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key &key) const
+            {
+                return std::hash<std::string>()(key.path) * 31 + size_t(key.dirfd);
+            }
+        };
+
+        // What identifies a version of a file
+        struct Identity
+        {
+            dev_t dev;
+            ino_t ino;
+            off_t size;
+            struct timespec mtime;
+
+            explicit Identity(const struct stat &st);
+
+            bool operator==(const Identity &other) const;
+        };
+
+        struct Entry
+        {
+            Key key;
+            Handle file;
+            Identity identity;
+            std::chrono::steady_clock::time_point validated;
+        };
+
+        struct Shard
+        {
+            mutable std::mutex mutex;
+            // Most recently used first
+            std::list<Entry> lru;
+            std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+            Stats stats;
+        };
+
+        Shard &shardFor(const Key &key);
+
+        // Drops entry it from shard, which must be locked
+        void erase(Shard &shard, std::list<Entry>::iterator it);
+
+        Options options_;
+        size_t maxFdsPerShard_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+    };
+
+    /*
+     * readFile() (see FileUtil.h) through cache.  Reads with pread(), so it
+     * is safe while other threads use the same descriptor.
+     */
+    bool readFile(
+            FdCache &cache,
+            const char *fileName,
+            std::string &out,
+            size_t numBytes = std::numeric_limits<size_t>::max());
+
+    /*
+     * preadFull() (see FileUtil.h) of fileName through cache.
+     */
+    ssize_t preadFull(FdCache &cache, const char *fileName, void *buf, size_t n, off_t offset);
+}
+
+#endif //SYSTEM_IO_FDCACHE_H
@@ -0,0 +1,215 @@
+#include "system_io/FieldSplitter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <glog/logging.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sysio
+{
+    namespace
+    {
+        constexpr size_t kBlockSize = 64;
+
+        struct BlockMasks
+        {
+            uint64_t delimiter;
+            uint64_t quote;
+            uint64_t newline;
+        };
+
+#if defined(__SSE2__)
+        inline uint64_t matchMask(const __m128i chunks[4], char c)
+        {
+            const __m128i v = _mm_set1_epi8(c);
+            uint64_t m = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                m |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], v)))) << (16 * i);
+            }
+            return m;
+        }
+
+        inline BlockMasks classify(const char *p, char delimiter, char quote)
+        {
+            __m128i chunks[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+            }
+            return BlockMasks{
+                    matchMask(chunks, delimiter),
+                    quote != '\0' ? matchMask(chunks, quote) : 0,
+                    matchMask(chunks, '\n')};
+        }
+#else
+        inline BlockMasks classify(const char *p, char delimiter, char quote)
+        {
+            BlockMasks m{0, 0, 0};
+            for (size_t i = 0; i < kBlockSize; ++i)
+            {
+                m.delimiter |= uint64_t(p[i] == delimiter) << i;
+                m.quote |= uint64_t(quote != '\0' && p[i] == quote) << i;
+                m.newline |= uint64_t(p[i] == '\n') << i;
+            }
+            return m;
+        }
+#endif
+
+        /*
+         * Bit i of the result is the xor of bits 0..i of x, i.e. set for every
+         * byte after an odd number of quotes.
+         */
+        inline uint64_t prefixXor(uint64_t x)
+        {
+            x ^= x << 1;
+            x ^= x << 2;
+            x ^= x << 4;
+            x ^= x << 8;
+            x ^= x << 16;
+            x ^= x << 32;
+            return x;
+        }
+    }
+
+    std::string DelimitedRecord::field(size_t i) const
+    {
+        const char *b = fieldBegin(i);
+        const char *e = fieldEnd(i);
+        if (!quoted(i))
+        {
+            return std::string(b, e);
+        }
+        std::string out;
+        out.reserve(size_t(e - b));
+        for (const char *p = b; p != e; ++p)
+        {
+            out.push_back(*p);
+            if (*p == quote_ && p + 1 != e && p[1] == quote_)
+            {
+                ++p;
+            }
+        }
+        return out;
+    }
+
+    FieldSplitter::FieldSplitter(char delimiter, char quote)
+            : delimiter_(delimiter), quote_(quote)
+    {
+        CHECK(delimiter != '\n' && delimiter != quote) << "invalid delimiter";
+        CHECK(quote != '\n') << "invalid quote character";
+    }
+
+    size_t FieldSplitter::split(const char *begin, const char *end, bool final, DelimitedBatch &batch) const
+    {
+        const size_t n = size_t(end - begin);
+        CHECK_LE(n, size_t(std::numeric_limits<uint32_t>::max()));
+
+        batch.base_ = begin;
+        batch.quote_ = quote_;
+        // fields_ and recordFields_ only ever grow, so that a reused batch
+        // needs no allocation or zero-filling; nf and nr are their used sizes.
+        auto &fields = batch.fields_;
+        auto &records = batch.recordFields_;
+        size_t nf = 0;
+        size_t nr = 0;
+        auto reserve = [](std::vector<uint32_t> &v, size_t size) {
+            if (v.size() < size)
+            {
+                v.resize(std::max(size, 2 * v.size()));
+            }
+            return v.data();
+        };
+        uint32_t *f = reserve(fields, 2);
+        uint32_t *r = reserve(records, 1);
+        r[nr++] = 0;
+
+        const char quote = quote_;
+        auto addField = [&](size_t b, size_t e) {
+            if (quote != '\0' && b < e && begin[b] == quote)
+            {
+                ++b;
+                if (b < e && begin[e - 1] == quote)
+                {
+                    --e;
+                }
+            }
+            f[nf++] = uint32_t(b);
+            f[nf++] = uint32_t(e);
+        };
+
+        size_t fieldStart = 0;
+        size_t consumed = 0;
+        // All ones while inside a quoted field at the start of the next block
+        uint64_t inQuote = 0;
+        char tail[kBlockSize];
+
+        for (size_t off = 0; off < n; off += kBlockSize)
+        {
+            const char *p = begin + off;
+            uint64_t valid = ~uint64_t(0);
+            if (n - off < kBlockSize)
+            {
+                // Classify the tail from a padded copy rather than reading
+                // past the end.
+                memset(tail, 0, kBlockSize);
+                memcpy(tail, p, n - off);
+                p = tail;
+                valid = (uint64_t(1) << (n - off)) - 1;
+            }
+            BlockMasks m = classify(p, delimiter_, quote);
+
+            uint64_t inside = prefixXor(m.quote) ^ inQuote;
+            inQuote = uint64_t(int64_t(inside) >> 63);
+
+            uint64_t newlines = m.newline & ~inside & valid;
+            uint64_t structural = (m.delimiter & ~inside & valid) | newlines;
+            if (structural == 0)
+            {
+                continue;
+            }
+            // Room for this block, plus the final field added below
+            f = reserve(fields, nf + 2 * size_t(__builtin_popcountll(structural)) + 2);
+            r = reserve(records, nr + size_t(__builtin_popcountll(newlines)) + 1);
+            do
+            {
+                size_t pos = off + size_t(__builtin_ctzll(structural));
+                bool isNewline = (newlines & (structural & -structural)) != 0;
+                structural &= structural - 1;
+
+                size_t fieldEnd = pos;
+                if (isNewline && fieldEnd > fieldStart && begin[fieldEnd - 1] == '\r')
+                {
+                    --fieldEnd;
+                }
+                addField(fieldStart, fieldEnd);
+                fieldStart = pos + 1;
+                if (isNewline)
+                {
+                    r[nr++] = uint32_t(nf / 2);
+                    consumed = pos + 1;
+                }
+            } while (structural != 0);
+        }
+
+        if (final && consumed < n)
+        {
+            size_t fieldEnd = n;
+            if (fieldEnd > fieldStart && begin[fieldEnd - 1] == '\r')
+            {
+                --fieldEnd;
+            }
+            addField(fieldStart, fieldEnd);
+            r[nr++] = uint32_t(nf / 2);
+            consumed = n;
+        }
+        // Fields of an incomplete last record are simply not referenced.
+        batch.records_ = nr - 1;
+        return consumed;
+    }
+}
@@ -0,0 +1,179 @@
+#ifndef SYSTEM_IO_FIELDSPLITTER_H
+#define SYSTEM_IO_FIELDSPLITTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "system_io/LineReader.h"
+
+/*
+ * Vectorized tokenizer for delimited text (CSV, TSV).
+ *
+ * FieldSplitter classifies a whole block of input 64 bytes at a time: SIMD
+ * compares find every delimiter, quote and newline, a prefix-xor over the
+ * quote bits marks which bytes are inside quoted fields, and only the
+ * delimiters and newlines outside quotes are visited one by one to produce
+ * field offsets.  Fields are views into the input; nothing is copied.
+ *
+ * Quoting follows RFC 4180: a field that starts with the quote character runs
+ * to the matching closing quote and may contain delimiters, newlines and
+ * doubled quotes.  Records end with '\n'; a '\r' before it is dropped.
+ */
+
+namespace sysio
+{
+    class DelimitedBatch;
+
+    /*
+     * View of one record in a DelimitedBatch.
+     */
+    class DelimitedRecord
+    {
+    public:
+        size_t size() const
+        {
+            return size_t(end_ - begin_) / 2;
+        }
+
+        /*
+         * Raw field contents, without the surrounding quotes of a quoted
+         * field.  Doubled quotes inside it are left as is; see field().
+         */
+        const char *fieldBegin(size_t i) const
+        {
+            return base_ + begin_[2 * i];
+        }
+
+        const char *fieldEnd(size_t i) const
+        {
+            return base_ + begin_[2 * i + 1];
+        }
+
+        size_t fieldSize(size_t i) const
+        {
+            return begin_[2 * i + 1] - begin_[2 * i];
+        }
+
+        bool quoted(size_t i) const
+        {
+            uint32_t b = begin_[2 * i];
+            return quote_ != '\0' && b > 0 && base_[b - 1] == quote_;
+        }
+
+        /*
+         * Field contents with doubled quotes collapsed (copies).
+         */
+        std::string field(size_t i) const;
+
+    private:
+        friend class DelimitedBatch;
+
+        DelimitedRecord(const char *base, const uint32_t *begin, const uint32_t *end, char quote)
+                : base_(base), begin_(begin), end_(end), quote_(quote)
+        {}
+
+        const char *base_;
+        const uint32_t *begin_;
+        const uint32_t *end_;
+        char quote_;
+    };
+
+    /*
+     * The records found in one block of input: for every field, its begin and
+     * end offsets relative to the block, and for every record, the index of
+     * its first field.  Reusing a batch across split() calls avoids
+     * reallocating these arrays.
+     */
+    class DelimitedBatch
+    {
+    public:
+        size_t size() const
+        {
+            return records_;
+        }
+
+        DelimitedRecord operator[](size_t i) const
+        {
+            return DelimitedRecord(
+                    base_,
+                    fields_.data() + 2 * recordFields_[i],
+                    fields_.data() + 2 * recordFields_[i + 1],
+                    quote_);
+        }
+
+        void clear()
+        {
+            records_ = 0;
+        }
+
+    private:
+        friend class FieldSplitter;
+
+        const char *base_ = nullptr;
+        char quote_ = '\0';
+        size_t records_ = 0;
+        std::vector<uint32_t> fields_;
+        std::vector<uint32_t> recordFields_;
+    };
+
+    class FieldSplitter
+    {
+    public:
+        /*
+         * quote == '\0' disables quoting.
+         */
+        explicit FieldSplitter(char delimiter = ',', char quote = '"');
+
+        /*
+         * Splits the complete records in [begin, end) (at most 4 GB) into
+         * batch, replacing its contents.  Returns the number of bytes
+         * consumed, i.e. up to and including the last record's newline.
+         *
+         * If final is true, trailing bytes without a newline form one last
+         * record and everything is consumed.
+         */
+        size_t split(const char *begin, const char *end, bool final, DelimitedBatch &batch) const;
+
+    private:
+        char delimiter_;
+        char quote_;
+    };
+
+    /*
+     * Feeds every record from reader to onRecord(const DelimitedRecord&),
+     * splitting whole buffer blocks obtained with LineReader::readLines(), so
+     * fields point straight into the reader's buffer.
+     *
+     * A record longer than the reader's buffer is split, like a long line in
+     * readLine().  Returns kEof, or kError if reading failed.
+     */
+    template<class F>
+    LineReader::State forEachRecord(LineReader &reader, const FieldSplitter &splitter, F onRecord)
+    {
+        DelimitedBatch batch;
+        const char *begin;
+        const char *end;
+        LineReader::State state;
+        while ((state = reader.readLines(&begin, &end)) == LineReader::kReading)
+        {
+            size_t size = size_t(end - begin);
+            // If no more data can arrive, split whatever we have.
+            bool final = reader.state() != LineReader::kReading || size == reader.capacity();
+            size_t used = splitter.split(begin, end, final, batch);
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                onRecord(batch[i]);
+            }
+            if (used < size)
+            {
+                // A quoted field continues past the block.
+                reader.unreadFrom(begin + used);
+            }
+        }
+        return state;
+    }
+}
+
+#endif //SYSTEM_IO_FIELDSPLITTER_H
@@ -28,7 +28,15 @@ namespace sysio
     }
 
     File::File(const char *name, int flags, mode_t mode)
-            : fd_(::open(name, flags, mode)), ownsFd_(false)
+            : File(AT_FDCWD, name, flags, mode)
+    {}
+
+    File::File(const std::string &name, int flags, mode_t mode)
+            : File(name.c_str(), flags, mode)
+    {}
+
+    File::File(int dirfd, const char *name, int flags, mode_t mode)
+            : fd_(::openat(dirfd, name, flags, mode)), ownsFd_(false)
     {
         if (fd_ == -1)
         {
@@ -39,15 +47,38 @@ namespace sysio
             // add leading zero to string because it represent octal number
             std::string perms = std::string("0").append(code.str());
             std::stringstream msg;
-            msg << "open(" << name << ", " << flags << ", " << perms << " failed";
+            if (dirfd == AT_FDCWD)
+            {
+                msg << "open(";
+            } else
+            {
+                msg << "openat(" << dirfd << ", ";
+            }
+            msg << name << ", " << flags << ", " << perms << " failed";
             throwSystemError(msg.str());
         }
         ownsFd_ = true;
     }
 
-    File::File(const std::string &name, int flags, mode_t mode)
-            : File(name.c_str(), flags, mode)
-    {}
+    Expected<File> File::tryOpen(const char *name, int flags, mode_t mode) noexcept
+    {
+        return tryOpen(AT_FDCWD, name, flags, mode);
+    }
+
+    Expected<File> File::tryOpen(int dirfd, const char *name, int flags, mode_t mode) noexcept
+    {
+        int fd = openatNoInt(dirfd, name, flags, mode);
+        if (fd == -1)
+        {
+            return makeUnexpected(errnoCode());
+        }
+        return File(fd, true);
+    }
+
+    Expected<File> File::tryOpen(const std::string &name, int flags, mode_t mode) noexcept
+    {
+        return tryOpen(name.c_str(), flags, mode);
+    }
 
     File::File(File&& other) noexcept : fd_(other.fd_), ownsFd_(other.ownsFd_) {
         other.release();
@@ -105,6 +136,20 @@ namespace sysio
         return File();
     }
 
+    Expected<File> File::dupNoThrow() const noexcept
+    {
+        if (fd_ == -1)
+        {
+            return File();
+        }
+        int fd = ::dup(fd_);
+        if (fd == -1)
+        {
+            return makeUnexpected(errnoCode());
+        }
+        return File(fd, true);
+    }
+
     void File::close()
     {
         if (!closeNoThrow())
@@ -158,6 +203,26 @@ namespace sysio
         unlock();
     }
 
+    std::error_code File::lockNoThrow() noexcept {
+        return flockNoInt(fd_, LOCK_EX) == -1 ? errnoCode() : std::error_code();
+    }
+
+    std::error_code File::tryLockNoThrow() noexcept {
+        return doTryLockNoThrow(LOCK_EX);
+    }
+
+    std::error_code File::lockSharedNoThrow() noexcept {
+        return flockNoInt(fd_, LOCK_SH) == -1 ? errnoCode() : std::error_code();
+    }
+
+    std::error_code File::tryLockSharedNoThrow() noexcept {
+        return doTryLockNoThrow(LOCK_SH);
+    }
+
+    std::error_code File::unlockNoThrow() noexcept {
+        return flockNoInt(fd_, LOCK_UN) == -1 ? errnoCode() : std::error_code();
+    }
+
     void File::doLock(int op) {
         checkUnixError(flockNoInt(fd_, op), "flock() failed (lock)");
     }
@@ -172,6 +237,11 @@ namespace sysio
         return true;
     }
 
+    std::error_code File::doTryLockNoThrow(int op) noexcept {
+        // flock returns EWOULDBLOCK if already locked
+        return flockNoInt(fd_, op | LOCK_NB) == -1 ? errnoCode() : std::error_code();
+    }
+
 
     void swap(File& a, File& b) noexcept {
         a.swap(b);
@@ -9,6 +9,8 @@
 #include <string>
 #include <system_error>
 
+#include "system_io/Expected.h"
+
 namespace sysio
 {
     /*
@@ -39,6 +41,22 @@ namespace sysio
                 int flags = O_RDONLY,
                 mode_t mode = 0666);
 
+        /*
+         * Open name relative to the directory dirfd, as with openat().
+         */
+        File(int dirfd, const char *name, int flags = O_RDONLY, mode_t mode = 0666);
+
+        /*
+         * Non-throwing open: returns the File, or the error code of a failed
+         * open().  Neither allocates nor formats anything on failure, so use
+         * it where failure is expected, e.g. to probe for a file.
+         */
+        static Expected<File> tryOpen(const char *name, int flags = O_RDONLY, mode_t mode = 0666) noexcept;
+
+        static Expected<File> tryOpen(const std::string &name, int flags = O_RDONLY, mode_t mode = 0666) noexcept;
+
+        static Expected<File> tryOpen(int dirfd, const char *name, int flags = O_RDONLY, mode_t mode = 0666) noexcept;
+
         // unique
         File(const File &) = delete;
 
@@ -72,6 +90,11 @@ namespace sysio
          */
         File dup() const;
 
+        /*
+         * Non-throwing dup(); an empty File is duplicated as an empty File.
+         */
+        Expected<File> dupNoThrow() const noexcept;
+
         /*
          * If we own the file descriptor, close the file and throw on error.
          * Otherwise, do nothing.
@@ -116,11 +139,30 @@ namespace sysio
 
         void unlock_shared();
 
+        /*
+         * Non-throwing versions of the locking operations above.  They return
+         * an empty error code if the lock was taken (or released), so that
+         * if (file.tryLockNoThrow()) means it was not; tryLockNoThrow() and
+         * tryLockSharedNoThrow() return std::errc::operation_would_block if
+         * the lock is held elsewhere.
+         */
+        std::error_code lockNoThrow() noexcept;
+
+        std::error_code tryLockNoThrow() noexcept;
+
+        std::error_code lockSharedNoThrow() noexcept;
+
+        std::error_code tryLockSharedNoThrow() noexcept;
+
+        std::error_code unlockNoThrow() noexcept;
+
     private:
         void doLock(int op);
 
         bool doTryLock(int op);
 
+        std::error_code doTryLockNoThrow(int op) noexcept;
+
         int fd_;
         bool ownsFd_;
     };
@@ -0,0 +1,124 @@
+#include "system_io/FileSampler.h"
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include <glog/logging.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/detail/Clock.h"
+
+namespace sysio
+{
+    FileSampler::FileSampler()
+            : FileSampler(Options())
+    {}
+
+    FileSampler::FileSampler(const Options &options)
+            : options_(options)
+    {
+        CHECK_GT(options_.bufferSize, 0u);
+        CHECK_GE(options_.maxBufferSize, options_.bufferSize);
+    }
+
+    size_t FileSampler::add(const std::string &path)
+    {
+        Entry entry;
+        entry.path = path;
+        entry.file = File(path, O_RDONLY | O_CLOEXEC);
+        entry.buffer.resize(options_.bufferSize);
+        entries_.push_back(std::move(entry));
+        return entries_.size() - 1;
+    }
+
+    size_t FileSampler::sampleAll()
+    {
+        uint64_t start = detail::nowNanos();
+        size_t failed = 0;
+        for (Entry &entry : entries_)
+        {
+            read(entry);
+            if (entry.error != 0)
+            {
+                ++failed;
+            }
+        }
+        ++stats_.samples;
+        stats_.lastSampleNanos = detail::nowNanos() - start;
+        return failed;
+    }
+
+    void FileSampler::read(Entry &entry)
+    {
+        if (!entry.file)
+        {
+            auto file = File::tryOpen(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (!file)
+            {
+                entry.error = file.error().value();
+                entry.size = 0;
+                ++entry.stats.errors;
+                ++stats_.errors;
+                return;
+            }
+            entry.file = std::move(*file);
+            ++stats_.reopens;
+        }
+
+        uint64_t start = detail::nowNanos();
+        ssize_t n;
+        for (;;)
+        {
+            n = options_.readToEof
+                ? preadFull(entry.file.fd(), entry.buffer.data(), entry.buffer.size(), 0)
+                : preadNoInt(entry.file.fd(), entry.buffer.data(), entry.buffer.size(), 0);
+            if (n == -1 || size_t(n) < entry.buffer.size() ||
+                entry.buffer.size() == options_.maxBufferSize)
+            {
+                break;
+            }
+            // Filled the buffer: there may be more, read it all again
+            entry.buffer.resize(std::min(entry.buffer.size() * 2, options_.maxBufferSize));
+            ++stats_.grows;
+        }
+        entry.nanos = detail::nowNanos() - start;
+
+        ++entry.stats.reads;
+        ++stats_.reads;
+        entry.stats.totalNanos += entry.nanos;
+        entry.stats.maxNanos = std::max(entry.stats.maxNanos, entry.nanos);
+        if (n == -1)
+        {
+            entry.error = errno;
+            entry.size = 0;
+            entry.truncated = false;
+            ++entry.stats.errors;
+            ++stats_.errors;
+            // Reopen by path next time
+            entry.file = File();
+            return;
+        }
+        entry.error = 0;
+        entry.size = size_t(n);
+        entry.truncated = entry.size == options_.maxBufferSize;
+    }
+
+    FileSampler::Sample FileSampler::sample(size_t index) const
+    {
+        const Entry &entry = entries_[index];
+        Sample sample;
+        sample.data = entry.buffer.data();
+        sample.size = entry.size;
+        sample.error = entry.error;
+        sample.truncated = entry.truncated;
+        sample.nanos = entry.nanos;
+        return sample;
+    }
+
+    FileSampler::FileStats FileSampler::fileStats(size_t index) const
+    {
+        return entries_[index].stats;
+    }
+}
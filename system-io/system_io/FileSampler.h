@@ -0,0 +1,158 @@
+#ifndef SYSTEM_IO_FILESAMPLER_H
+#define SYSTEM_IO_FILESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "system_io/File.h"
+
+/*
+ * Reads a fixed set of small, frequently changing files, such as /proc and
+ * /sys statistics, over and over at low cost.
+ *
+ * readFile() of such a file costs an open(), an fstat() that reports size
+ * 0, a read into a buffer grown on the way and a close().  A FileSampler
+ * keeps every file open and re-reads it with one pread() at offset 0 into a
+ * buffer it keeps, which procfs and sysfs answer with fresh contents.  The
+ * buffer starts at Options::bufferSize and doubles whenever a read fills
+ * it, so after the first few samples each file costs one system call.
+ *
+ * A file whose read fails (a /proc/<pid> entry of a process that exited, a
+ * sysfs attribute of a removed device) reports the error, and is reopened
+ * by path on the next sampleAll().
+ *
+ * Not thread-safe.
+ *
+ * Example:
+ *   FileSampler sampler;
+ *   size_t loadavg = sampler.add("/proc/loadavg");
+ *   for (;;) {
+ *     sampler.sampleAll();
+ *     auto sample = sampler.sample(loadavg);
+ *     if (sample.error == 0) parse(sample.data, sample.size);
+ *     sleep(1);
+ *   }
+ */
+
+namespace sysio
+{
+    class FileSampler
+    {
+    public:
+        struct Options
+        {
+            // Initial buffer per file
+            size_t bufferSize = 4096;
+            // Largest buffer per file; longer contents are cut off
+            size_t maxBufferSize = 1 << 20;
+            // Read each file until EOF, for files that may return less than
+            // their contents in one read().  procfs seq_file and sysfs
+            // attributes fill the buffer they are given, so one read()
+            // returning less than the buffer size is the whole file.
+            bool readToEof = false;
+        };
+
+        /*
+         * Contents of a file as of the last sampleAll(), valid until the next
+         * one.
+         */
+        struct Sample
+        {
+            const char *data = nullptr;
+            size_t size = 0;
+            // errno of the failed open() or read(), or 0
+            int error = 0;
+            // Contents were longer than maxBufferSize
+            bool truncated = false;
+            // Time the read took
+            uint64_t nanos = 0;
+
+            std::string str() const
+            {
+                return std::string(data, size);
+            }
+        };
+
+        struct FileStats
+        {
+            uint64_t reads = 0;
+            uint64_t errors = 0;
+            uint64_t totalNanos = 0;
+            uint64_t maxNanos = 0;
+        };
+
+        struct Stats
+        {
+            uint64_t samples = 0;
+            uint64_t reads = 0;
+            uint64_t errors = 0;
+            uint64_t reopens = 0;
+            // Buffers doubled because a read filled them
+            uint64_t grows = 0;
+            // Time the last sampleAll() took in all
+            uint64_t lastSampleNanos = 0;
+        };
+
+        FileSampler();
+
+        explicit FileSampler(const Options &options);
+
+        FileSampler(const FileSampler &) = delete;
+
+        FileSampler &operator=(const FileSampler &) = delete;
+
+        /*
+         * Opens path and adds it to the set; returns its index.  Throws
+         * std::system_error if it cannot be opened.
+         */
+        size_t add(const std::string &path);
+
+        /*
+         * Reads every file once.  Returns the number of files that failed.
+         */
+        size_t sampleAll();
+
+        Sample sample(size_t index) const;
+
+        FileStats fileStats(size_t index) const;
+
+        const std::string &path(size_t index) const
+        {
+            return entries_[index].path;
+        }
+
+        size_t size() const
+        {
+            return entries_.size();
+        }
+
+        Stats stats() const
+        {
+            return stats_;
+        }
+
+    private:
+        struct Entry
+        {
+            std::string path;
+            File file;
+            std::vector<char> buffer;
+            size_t size = 0;
+            int error = 0;
+            bool truncated = false;
+            uint64_t nanos = 0;
+            FileStats stats;
+        };
+
+        // Reads one file into its buffer, growing it as needed
+        void read(Entry &entry);
+
+        Options options_;
+        std::vector<Entry> entries_;
+        Stats stats_;
+    };
+}
+
+#endif //SYSTEM_IO_FILESAMPLER_H
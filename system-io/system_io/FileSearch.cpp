@@ -0,0 +1,584 @@
+#include "system_io/FileSearch.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <thread>
+
+#include <glog/logging.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "system_io/Exception.h"
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/Newlines.h"
+#include "system_io/ScopeGuard.h"
+#include "system_io/detail/Clock.h"
+
+namespace sysio
+{
+    namespace
+    {
+        // Unit of reads when looking for a line boundary
+        constexpr size_t kScanSize = 64 << 10;
+    }
+
+    /*
+     * Finds the first match starting in [from, limit) of p[0, n): a single
+     * pattern with a SIMD first and last byte filter, several with an
+     * Aho-Corasick automaton.
+     */
+    class FileSearch::Matcher
+    {
+    public:
+        explicit Matcher(const std::vector<std::string> &patterns)
+                : patterns_(patterns)
+        {
+            for (const auto &pattern : patterns_)
+            {
+                CHECK(!pattern.empty());
+                maxLength_ = std::max(maxLength_, pattern.size());
+            }
+            if (patterns_.size() > 1)
+            {
+                build();
+            }
+        }
+
+        size_t maxLength() const
+        {
+            return maxLength_;
+        }
+
+        ssize_t find(const char *p, size_t n, size_t from, size_t limit, size_t *pattern,
+                     uint64_t *candidates) const
+        {
+            if (patterns_.size() == 1)
+            {
+                *pattern = 0;
+                return findOne(p, n, from, limit, candidates);
+            }
+            return findMany(p, n, from, limit, pattern);
+        }
+
+    private:
+        ssize_t findOne(const char *p, size_t n, size_t from, size_t limit, uint64_t *candidates) const
+        {
+            const std::string &pattern = patterns_[0];
+            const size_t m = pattern.size();
+            if (n < m)
+            {
+                return -1;
+            }
+            const size_t end = std::min(limit, n - m + 1);
+            if (from >= end)
+            {
+                return -1;
+            }
+            const char first = pattern[0];
+            if (m == 1)
+            {
+                auto q = static_cast<const char *>(memchr(p + from, first, end - from));
+                return q != nullptr ? q - p : -1;
+            }
+            const char last = pattern[m - 1];
+            size_t i = from;
+#if defined(__SSE2__)
+            // Positions whose first and last bytes match, 16 at a time
+            const __m128i vFirst = _mm_set1_epi8(first);
+            const __m128i vLast = _mm_set1_epi8(last);
+            for (; i < end && i + 16 <= n - m + 1; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + m - 1));
+                uint32_t mask = uint32_t(_mm_movemask_epi8(
+                        _mm_and_si128(_mm_cmpeq_epi8(a, vFirst), _mm_cmpeq_epi8(b, vLast))));
+                while (mask != 0)
+                {
+                    size_t pos = i + size_t(__builtin_ctz(mask));
+                    if (pos >= end)
+                    {
+                        return -1;
+                    }
+                    ++*candidates;
+                    if (memcmp(p + pos + 1, pattern.data() + 1, m - 2) == 0)
+                    {
+                        return ssize_t(pos);
+                    }
+                    mask &= mask - 1;
+                }
+            }
+#endif
+            for (; i < end; ++i)
+            {
+                if (p[i] == first && p[i + m - 1] == last)
+                {
+                    ++*candidates;
+                    if (memcmp(p + i + 1, pattern.data() + 1, m - 2) == 0)
+                    {
+                        return ssize_t(i);
+                    }
+                }
+            }
+            return -1;
+        }
+
+        // Builds the automaton: a trie of the patterns, completed into a DFA
+        // with the failure links, over classes of bytes (one per byte that
+        // occurs in a pattern, and one for all others)
+        void build()
+        {
+            std::fill(std::begin(classes_), std::end(classes_), uint16_t(0));
+            numClasses_ = 1;
+            for (const auto &pattern : patterns_)
+            {
+                for (unsigned char c : pattern)
+                {
+                    if (classes_[c] == 0)
+                    {
+                        classes_[c] = uint16_t(numClasses_++);
+                    }
+                }
+            }
+
+            // Trie
+            std::vector<int32_t> next(numClasses_, -1);
+            std::vector<int32_t> out(1, -1);
+            std::vector<int32_t> depth(1, 0);
+            for (size_t i = 0; i < patterns_.size(); ++i)
+            {
+                int32_t state = 0;
+                for (unsigned char c : patterns_[i])
+                {
+                    int32_t &to = next[size_t(state) * numClasses_ + classes_[c]];
+                    if (to == -1)
+                    {
+                        to = int32_t(out.size());
+                        out.push_back(-1);
+                        depth.push_back(depth[size_t(state)] + 1);
+                        next.resize(next.size() + numClasses_, -1);
+                    }
+                    state = next[size_t(state) * numClasses_ + classes_[c]];
+                }
+                if (out[size_t(state)] == -1)
+                {
+                    out[size_t(state)] = int32_t(i);
+                }
+            }
+
+            // Failure links, breadth first; missing transitions go where the
+            // failure link's do, and states without a pattern of their own
+            // report the longest one ending there
+            std::vector<int32_t> fail(out.size(), 0);
+            std::deque<int32_t> queue;
+            for (size_t c = 0; c < numClasses_; ++c)
+            {
+                int32_t &to = next[c];
+                if (to == -1)
+                {
+                    to = 0;
+                } else
+                {
+                    queue.push_back(to);
+                }
+            }
+            while (!queue.empty())
+            {
+                int32_t state = queue.front();
+                queue.pop_front();
+                int32_t f = fail[size_t(state)];
+                if (out[size_t(state)] == -1)
+                {
+                    out[size_t(state)] = out[size_t(f)];
+                }
+                for (size_t c = 0; c < numClasses_; ++c)
+                {
+                    int32_t &to = next[size_t(state) * numClasses_ + c];
+                    int32_t via = next[size_t(f) * numClasses_ + c];
+                    if (to == -1)
+                    {
+                        to = via;
+                    } else
+                    {
+                        fail[size_t(to)] = via;
+                        queue.push_back(to);
+                    }
+                }
+            }
+
+            // Laid out in rows of the pattern reported in the state (-1 for
+            // none), the length of the prefix it stands for, and the
+            // transitions as offsets of rows, so that a step is one add and
+            // one load
+            rowSize_ = numClasses_ + 2;
+            table_.resize(out.size() * rowSize_);
+            for (size_t state = 0; state < out.size(); ++state)
+            {
+                int32_t *row = &table_[state * rowSize_];
+                row[0] = out[state];
+                row[1] = depth[state];
+                for (size_t c = 0; c < numClasses_; ++c)
+                {
+                    row[2 + c] = int32_t(size_t(next[state * numClasses_ + c]) * rowSize_);
+                }
+            }
+
+            // First two bytes a match can start with (one for patterns of one
+            // byte), for skipping from the root
+            for (const auto &pattern : patterns_)
+            {
+                Prefix prefix = {pattern[0], pattern.size() > 1 ? pattern[1] : '\0', pattern.size() == 1};
+                if (std::find(prefixes_.begin(), prefixes_.end(), prefix) == prefixes_.end())
+                {
+                    prefixes_.push_back(prefix);
+                }
+            }
+        }
+
+        // Position of the next byte in [i, end) that may start a match
+        size_t skip(const char *p, size_t i, size_t end, size_t n) const
+        {
+#if defined(__SSE2__)
+            __m128i firsts[kMaxPrefixes];
+            __m128i seconds[kMaxPrefixes];
+            for (size_t k = 0; k < prefixes_.size(); ++k)
+            {
+                firsts[k] = _mm_set1_epi8(prefixes_[k].first);
+                seconds[k] = _mm_set1_epi8(prefixes_[k].second);
+            }
+            const __m128i ones = _mm_set1_epi8(-1);
+            for (; i < end && i + 17 <= n; i += 16)
+            {
+                __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+                __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + 1));
+                __m128i eq = _mm_setzero_si128();
+                for (size_t k = 0; k < prefixes_.size(); ++k)
+                {
+                    __m128i second = prefixes_[k].one ? ones : _mm_cmpeq_epi8(v1, seconds[k]);
+                    eq = _mm_or_si128(eq, _mm_and_si128(_mm_cmpeq_epi8(v0, firsts[k]), second));
+                }
+                uint32_t mask = uint32_t(_mm_movemask_epi8(eq));
+                if (mask != 0)
+                {
+                    return std::min(end, i + size_t(__builtin_ctz(mask)));
+                }
+            }
+#endif
+            for (; i < end; ++i)
+            {
+                for (const Prefix &prefix : prefixes_)
+                {
+                    if (p[i] == prefix.first && (prefix.one || (i + 1 < n && p[i + 1] == prefix.second)))
+                    {
+                        return i;
+                    }
+                }
+            }
+            return end;
+        }
+
+        ssize_t findMany(const char *p, size_t n, size_t from, size_t limit, size_t *pattern) const
+        {
+            const bool skipping = prefixes_.size() <= kMaxPrefixes;
+            const size_t end = std::min(n, limit);
+            const int32_t *table = table_.data();
+            const int32_t *row = table;
+            size_t i = from;
+            while (i < n)
+            {
+                if (row == table)
+                {
+                    if (skipping)
+                    {
+                        i = skip(p, i, end, n);
+                    }
+                    if (i >= limit)
+                    {
+                        return -1;
+                    }
+                }
+                row = table + row[2 + classes_[uint8_t(p[i])]];
+                ++i;
+                int32_t found = row[0];
+                if (found != -1)
+                {
+                    size_t start = i - patterns_[size_t(found)].size();
+                    if (start < limit)
+                    {
+                        *pattern = size_t(found);
+                        return ssize_t(start);
+                    }
+                }
+                // Matches to come start at or after the current partial one
+                if (i > limit && i - size_t(row[1]) >= limit)
+                {
+                    return -1;
+                }
+            }
+            return -1;
+        }
+
+        struct Prefix
+        {
+            char first;
+            char second;
+            // The pattern is one byte long, second is unused
+            bool one;
+
+            bool operator==(const Prefix &other) const
+            {
+                return first == other.first && one == other.one && (one || second == other.second);
+            }
+        };
+
+        // Beyond this, the filter lets too much through to pay for itself
+        static constexpr size_t kMaxPrefixes = 8;
+
+        std::vector<std::string> patterns_;
+        size_t maxLength_ = 0;
+        uint16_t classes_[256];
+        size_t numClasses_ = 0;
+        // The automaton, rowSize_ per state
+        std::vector<int32_t> table_;
+        size_t rowSize_ = 0;
+        std::vector<Prefix> prefixes_;
+    };
+
+    struct FileSearch::Block
+    {
+        std::vector<Match> matches;
+        // Line numbers in matches are from the start of the block until
+        // search() adds the lines before it
+        uint64_t newlines = 0;
+        uint64_t bytes = 0;
+        uint64_t candidates = 0;
+    };
+
+    FileSearch::FileSearch(const std::vector<std::string> &patterns)
+            : FileSearch(patterns, Options())
+    {}
+
+    FileSearch::FileSearch(const std::vector<std::string> &patterns, const Options &options)
+            : patterns_(patterns), options_(options), matcher_(new Matcher(patterns))
+    {
+        CHECK(!patterns_.empty());
+        CHECK_GT(options_.blockSize, 0u);
+        if (options_.threads == 0)
+        {
+            options_.threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+
+    FileSearch::~FileSearch() = default;
+
+    namespace
+    {
+        // Offset of the first line that starts at or after pos
+        uint64_t lineStartAtOrAfter(int fd, const char *map, uint64_t fileSize, uint64_t pos)
+        {
+            if (pos == 0 || pos >= fileSize)
+            {
+                return std::min(pos, fileSize);
+            }
+            // The line starts at pos if a newline is right before it
+            uint64_t offset = pos - 1;
+            if (map != nullptr)
+            {
+                auto nl = static_cast<const char *>(memchr(map + offset, '\n', size_t(fileSize - offset)));
+                return nl != nullptr ? uint64_t(nl - map) + 1 : fileSize;
+            }
+            char buf[kScanSize];
+            while (offset < fileSize)
+            {
+                size_t len = size_t(std::min<uint64_t>(sizeof(buf), fileSize - offset));
+                ssize_t r = preadFull(fd, buf, len, off_t(offset));
+                checkUnixError(r, "FileSearch: pread() failed");
+                if (r == 0)
+                {
+                    break;
+                }
+                auto nl = static_cast<const char *>(memchr(buf, '\n', size_t(r)));
+                if (nl != nullptr)
+                {
+                    return offset + uint64_t(nl - buf) + 1;
+                }
+                offset += uint64_t(r);
+            }
+            return fileSize;
+        }
+    }
+
+    void FileSearch::searchBlock(int fd, const char *map, uint64_t fileSize, uint64_t index,
+                                 Block &block, std::vector<char> &buffer) const
+    {
+        // Blocks start and end at the first line start at or after their
+        // nominal bounds, so that lines are not split between them
+        const uint64_t begin = lineStartAtOrAfter(fd, map, fileSize, index * options_.blockSize);
+        const uint64_t end = lineStartAtOrAfter(fd, map, fileSize, (index + 1) * options_.blockSize);
+        if (begin >= end)
+        {
+            return;
+        }
+        // And a match may run past the end of the block
+        const size_t limit = size_t(end - begin);
+        const size_t n = size_t(std::min<uint64_t>(fileSize, end + matcher_->maxLength() - 1) - begin);
+        const char *data;
+        if (map != nullptr)
+        {
+            data = map + begin;
+        } else
+        {
+            buffer.resize(n);
+            ssize_t r = preadFull(fd, buffer.data(), n, off_t(begin));
+            checkUnixError(r, "FileSearch: pread() failed");
+            if (size_t(r) != n)
+            {
+                throwSystemErrorExplicit(ESTALE, "FileSearch: file truncated while searching");
+            }
+            data = buffer.data();
+        }
+        block.bytes = limit;
+
+        size_t pos = 0;
+        // Newlines in [0, counted)
+        size_t counted = 0;
+        while (pos < limit)
+        {
+            if (options_.maxMatches != 0 && block.matches.size() == options_.maxMatches)
+            {
+                break;
+            }
+            size_t pattern;
+            ssize_t at = matcher_->find(data, n, pos, limit, &pattern, &block.candidates);
+            if (at == -1)
+            {
+                break;
+            }
+            // counted is always a line start, so the line starts after it
+            auto prev = static_cast<const char *>(memrchr(data + counted, '\n', size_t(at) - counted));
+            size_t lineBegin = prev != nullptr ? size_t(prev - data) + 1 : counted;
+            block.newlines += countNewlines(data + counted, lineBegin - counted);
+            counted = lineBegin;
+            auto nl = static_cast<const char *>(memchr(data + at, '\n', limit - size_t(at)));
+            size_t lineEnd = nl != nullptr ? size_t(nl - data) : limit;
+
+            Match match;
+            match.offset = begin + uint64_t(at);
+            match.line = block.newlines;
+            match.lineOffset = begin + lineBegin;
+            match.pattern = pattern;
+            if (options_.lineText)
+            {
+                match.text.assign(data + lineBegin, lineEnd - lineBegin);
+            }
+            block.matches.push_back(std::move(match));
+            pos = options_.firstMatchPerLine ? lineEnd + 1 : size_t(at) + 1;
+        }
+        block.newlines += countNewlines(data + counted, limit - counted);
+    }
+
+    std::vector<FileSearch::Match> FileSearch::search(int fd)
+    {
+        stats_ = Stats();
+        uint64_t start = detail::nowNanos();
+        struct stat st;
+        checkUnixError(fstat(fd, &st), "FileSearch: fstat() failed");
+        const uint64_t fileSize = uint64_t(st.st_size);
+        const uint64_t numBlocks = (fileSize + options_.blockSize - 1) / options_.blockSize;
+
+        const char *map = nullptr;
+        if (options_.mmap && fileSize != 0)
+        {
+            void *p = mmap(nullptr, size_t(fileSize), PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                throwSystemError("FileSearch: mmap() failed");
+            }
+            madvise(p, size_t(fileSize), MADV_SEQUENTIAL);
+            map = static_cast<const char *>(p);
+        }
+        SCOPE_EXIT
+        {
+            if (map != nullptr)
+            {
+                munmap(const_cast<char *>(map), size_t(fileSize));
+            }
+        };
+        if (map == nullptr)
+        {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+
+        // Threads take blocks in order, so the blocks searched are always a
+        // prefix of the file, also when they stop at maxMatches
+        std::vector<Block> blocks(numBlocks);
+        std::atomic<uint64_t> nextBlock(0);
+        std::atomic<size_t> found(0);
+        std::vector<std::future<void>> workers;
+        const size_t threads = size_t(std::min<uint64_t>(options_.threads, numBlocks));
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.push_back(std::async(std::launch::async, [&] {
+                std::vector<char> buffer;
+                for (;;)
+                {
+                    if (options_.maxMatches != 0 && found.load() >= options_.maxMatches)
+                    {
+                        break;
+                    }
+                    uint64_t index = nextBlock++;
+                    if (index >= numBlocks)
+                    {
+                        break;
+                    }
+                    searchBlock(fd, map, fileSize, index, blocks[index], buffer);
+                    found += blocks[index].matches.size();
+                }
+            }));
+        }
+        for (auto &worker : workers)
+        {
+            worker.get();
+        }
+
+        std::vector<Match> matches;
+        uint64_t lines = 0;
+        const uint64_t searched = std::min(nextBlock.load(), numBlocks);
+        for (uint64_t i = 0; i < searched; ++i)
+        {
+            Block &block = blocks[i];
+            for (Match &match : block.matches)
+            {
+                if (options_.maxMatches != 0 && matches.size() == options_.maxMatches)
+                {
+                    break;
+                }
+                match.line += lines;
+                matches.push_back(std::move(match));
+            }
+            lines += block.newlines;
+            stats_.bytes += block.bytes;
+            stats_.candidates += block.candidates;
+            ++stats_.blocks;
+        }
+        stats_.matches = matches.size();
+        stats_.nanos = detail::nowNanos() - start;
+        return matches;
+    }
+
+    std::vector<FileSearch::Match> FileSearch::search(const std::string &path)
+    {
+        File file(path.c_str(), O_RDONLY | O_CLOEXEC);
+        return search(file.fd());
+    }
+}
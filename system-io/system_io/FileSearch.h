@@ -0,0 +1,127 @@
+#ifndef SYSTEM_IO_FILESEARCH_H
+#define SYSTEM_IO_FILESEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Finds fixed strings in large files, like grep -F, without going through
+ * the file line by line.
+ *
+ * The file is cut into blocks of Options::blockSize, moved to line
+ * boundaries, which Options::threads threads search in parallel, each
+ * reading its blocks with preadFull() (or, with Options::mmap, looking at
+ * them through a mapping of the whole file).  A block is searched as one
+ * buffer; lines only come into play where there is a match: its line
+ * number is the count of newlines before it (counted with SIMD compares),
+ * and the line around it is copied out only if Options::lineText is set.
+ *
+ * A single pattern is searched with an SSE2 filter on its first and last
+ * bytes, 16 positions at a time, and memcmp() of the middle of the
+ * candidates only.  Several patterns are searched with an Aho-Corasick
+ * automaton over byte classes (one table lookup per byte).  From its root,
+ * it skips with SSE2 compares to the next position where the first two
+ * bytes of a pattern are, when the patterns have at most eight different
+ * ones.
+ *
+ * Example:
+ *   FileSearch search({"ERROR", "FATAL"});
+ *   for (const auto &match : search.search("server.log")) {
+ *     printf("%lu: %s\n", match.line + 1, match.text.c_str());
+ *   }
+ */
+
+namespace sysio
+{
+    class FileSearch
+    {
+    public:
+        struct Options
+        {
+            // Threads searching blocks; 0 for one per CPU
+            size_t threads = 0;
+            // Unit of work, and of reads
+            size_t blockSize = 8 << 20;
+            // Search a mapping of the file instead of reading it
+            bool mmap = false;
+            // Report only the first match in each line, like grep
+            bool firstMatchPerLine = true;
+            // Copy the matching lines into Match::text
+            bool lineText = true;
+            // Stop after this many matches (the first ones in the file); 0
+            // for no limit
+            size_t maxMatches = 0;
+        };
+
+        struct Match
+        {
+            // Of the first byte of the match
+            uint64_t offset = 0;
+            // Line number (from 0), and offset of the start of the line
+            uint64_t line = 0;
+            uint64_t lineOffset = 0;
+            // Index of the pattern in the list given to the constructor
+            size_t pattern = 0;
+            // The line, without its newline, if Options::lineText
+            std::string text;
+        };
+
+        struct Stats
+        {
+            uint64_t bytes = 0;
+            uint64_t blocks = 0;
+            uint64_t matches = 0;
+            // Positions that passed the SIMD filter of a single pattern
+            uint64_t candidates = 0;
+            uint64_t nanos = 0;
+        };
+
+        /*
+         * Patterns must not be empty.  With several patterns, matches are
+         * found in the order they end: of overlapping matches, the first to
+         * end is reported.
+         */
+        explicit FileSearch(const std::vector<std::string> &patterns);
+
+        FileSearch(const std::vector<std::string> &patterns, const Options &options);
+
+        FileSearch(const FileSearch &) = delete;
+
+        FileSearch &operator=(const FileSearch &) = delete;
+
+        ~FileSearch();
+
+        /*
+         * Searches the whole file, and returns the matches in file order.
+         * Throws on error.
+         */
+        std::vector<Match> search(int fd);
+
+        std::vector<Match> search(const std::string &path);
+
+        // Of the last search()
+        const Stats &stats() const
+        {
+            return stats_;
+        }
+
+    private:
+        class Matcher;
+
+        struct Block;
+
+        // Searches block index of the file (or of the mapping, if map)
+        void searchBlock(int fd, const char *map, uint64_t fileSize, uint64_t index,
+                         Block &block, std::vector<char> &buffer) const;
+
+        std::vector<std::string> patterns_;
+        Options options_;
+        std::unique_ptr<Matcher> matcher_;
+        Stats stats_;
+    };
+}
+
+#endif //SYSTEM_IO_FILESEARCH_H
@@ -1,26 +1,128 @@
 #include "system_io/FileUtil.h"
 #include <sys/file.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <cerrno>
+#include <future>
+#include <mutex>
 #include <system_error>
 #include <vector>
+#include "system_io/Checksum.h"
 #include "system_io/ScopeGuard.h"
+#include "system_io/detail/Page.h"
 
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
 
 namespace sysio
 {
-    inline void incr(ssize_t /* n */) {}
-    inline void incr(ssize_t n, off_t& offset) {
-        offset += off_t(n);
-    }
-
     int openNoInt(const char *name, int flags, mode_t mode)
     {
         return int(wrapNoInt(open, name, flags, mode));
     }
 
+    int openatNoInt(int dirfd, const char *name, int flags, mode_t mode)
+    {
+        return int(wrapNoInt(openat, dirfd, name, flags, mode));
+    }
+
+    int renameatNoInt(int oldDirfd, const char *oldName, int newDirfd, const char *newName)
+    {
+        return int(wrapNoInt(renameat, oldDirfd, oldName, newDirfd, newName));
+    }
+
+    int linkatNoInt(int oldDirfd, const char *oldName, int newDirfd, const char *newName, int flags)
+    {
+        return int(wrapNoInt(linkat, oldDirfd, oldName, newDirfd, newName, flags));
+    }
+
+    int unlinkatNoInt(int dirfd, const char *name, int flags)
+    {
+        return int(wrapNoInt(unlinkat, dirfd, name, flags));
+    }
+
+    int renameat2NoInt(int oldDirfd, const char *oldName, int newDirfd, const char *newName,
+                       unsigned int flags)
+    {
+#ifdef SYS_renameat2
+        return int(wrapNoInt(syscall, SYS_renameat2, oldDirfd, oldName, newDirfd, newName, flags));
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    // Replaces the trailing "XXXXXX" of nameTemplate until create() does not
+    // fail with EEXIST, and returns what it returned
+    template<class F>
+    static int createUnique(char *nameTemplate, F create)
+    {
+        static const char kChars[] =
+                "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+        constexpr size_t kSuffix = 6;
+        size_t len = strlen(nameTemplate);
+        if (len < kSuffix || strcmp(nameTemplate + len - kSuffix, "XXXXXX") != 0)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        char *suffix = nameTemplate + len - kSuffix;
+
+        // Unpredictability is not the point (O_EXCL guards against collisions),
+        // just a low chance of retrying; seed per thread from the clock.
+        static thread_local uint64_t state = 0;
+        if (state == 0)
+        {
+            timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            state = (uint64_t(ts.tv_sec) * 1000000007u) ^ uint64_t(ts.tv_nsec) ^
+                    (uint64_t(getpid()) << 32) ^ uint64_t(uintptr_t(&state)) ^ 1;
+        }
+        for (int attempt = 0; attempt < 1000; ++attempt)
+        {
+            // xorshift64*
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            uint64_t bits = state * 2685821657736338717ull;
+            for (size_t i = 0; i < kSuffix; ++i)
+            {
+                suffix[i] = kChars[bits % (sizeof(kChars) - 1)];
+                bits /= sizeof(kChars) - 1;
+            }
+            int r = create();
+            if (r != -1 || errno != EEXIST)
+            {
+                return r;
+            }
+        }
+        errno = EEXIST;
+        return -1;
+    }
+
+    int mkstempat(int dirfd, char *nameTemplate, int flags)
+    {
+        return createUnique(nameTemplate, [=] {
+            return openatNoInt(dirfd, nameTemplate, O_RDWR | O_CREAT | O_EXCL | flags, 0600);
+        });
+    }
+
+    int mkdtempat(int dirfd, char *nameTemplate, mode_t mode)
+    {
+        return createUnique(nameTemplate, [=] {
+            return int(wrapNoInt(mkdirat, dirfd, nameTemplate, mode));
+        });
+    }
+
     static int filterCloseReturn(int r)
     {
         // Ignore EINTR.  On Linux, close() may only return EINTR after the file
@@ -59,226 +161,216 @@ namespace sysio
         return int(wrapNoInt(flock, fd, operation));
     }
 
-    ssize_t readNoInt(int fd, void *buf, size_t count)
+    template<class F>
+    static ssize_t wrapSome(F f, int fd, char* buf, size_t count)
     {
-        return wrapNoInt(read, fd, buf, count);
+        ssize_t totalBytes = 0;
+        while (count != 0)
+        {
+            ssize_t r = wrapNoInt(f, fd, buf, count);
+            if (r <= 0)
+            {
+                if (totalBytes == 0)
+                {
+                    return r;
+                }
+                // Report the partial transfer now and an error or EOF (which
+                // persists) on the next call.
+                errno = (r == -1 && errno == EAGAIN) ? EAGAIN : 0;
+                return totalBytes;
+            }
+            totalBytes += r;
+            buf += r;
+            count -= size_t(r);
+        }
+        return totalBytes;
     }
 
-    ssize_t writeNoInt(int fd, const void *buf, size_t count)
+    ssize_t readSome(int fd, void* buf, size_t count)
     {
-        return wrapNoInt(write, fd, buf, count);
-    }
-
-    ssize_t readFull(int fd, void* buf, size_t count) {
-        return wrapFull(read, fd, buf, count);
+        return wrapSome(detail::ReadOp(), fd, static_cast<char*>(buf), count);
     }
 
-    ssize_t writeFull(int fd, const void* buf, size_t count) {
-        return wrapFull(write, fd, const_cast<void*>(buf), count);
+    ssize_t writeSome(int fd, const void* buf, size_t count)
+    {
+        return wrapSome(detail::WriteOp(), fd, static_cast<char*>(const_cast<void*>(buf)), count);
     }
 
-    ssize_t preadNoInt(int fd, void *buf, size_t count, off_t offset)
+    ssize_t spliceNoInt(int fdIn, loff_t* offIn, int fdOut, loff_t* offOut, size_t count, unsigned int flags)
     {
-        return wrapNoInt(pread, fd, buf, count, offset);
+        return wrapNoInt(splice, fdIn, offIn, fdOut, offOut, count, flags);
     }
 
-    ssize_t pwriteNoInt(int fd, const void *buf, size_t count, off_t offset)
+    ssize_t spliceFull(int fdIn, loff_t* offIn, int fdOut, loff_t* offOut, size_t count, unsigned int flags)
     {
-        return wrapNoInt(pwrite, fd, buf, count, offset);
+        // The kernel advances offIn / offOut itself, so unlike wrapFull()
+        // there is no offset to keep track of here.
+        ssize_t totalBytes = 0;
+        while (count != 0)
+        {
+            // Linux moves at most 0x7ffff000 bytes per call anyway; larger
+            // lengths fail with EINVAL if offset + length overflows.
+            size_t n = std::min<size_t>(count, 0x7ffff000);
+            ssize_t r = spliceNoInt(fdIn, offIn, fdOut, offOut, n, flags);
+            if (r == -1)
+            {
+                return r;
+            }
+            if (r == 0)
+            {
+                break; // EOF
+            }
+            totalBytes += r;
+            count -= size_t(r);
+        }
+        return totalBytes;
     }
 
-    ssize_t pwriteFull(int fd, const void* buf, size_t count, off_t offset) {
-        return wrapFull(pwrite, fd, const_cast<void*>(buf), count, offset);
+    ssize_t teeNoInt(int fdIn, int fdOut, size_t count, unsigned int flags)
+    {
+        return wrapNoInt(tee, fdIn, fdOut, count, flags);
     }
 
-    ssize_t readvNoInt(int fd, const iovec *iov, int count)
+    ssize_t vmspliceNoInt(int fd, const iovec* iov, int count, unsigned int flags)
     {
-        return wrapNoInt(readv, fd, iov, count);
+        return wrapNoInt(vmsplice, fd, iov, size_t(count), flags);
     }
 
-    ssize_t writevNoInt(int fd, const iovec *iov, int count)
+    ssize_t vmspliceFull(int fd, iovec* iov, int count, unsigned int flags)
     {
-        return wrapNoInt(writev, fd, iov, count);
+        return wrapvFull(
+                [flags](int f, iovec* v, int n) { return vmsplice(f, v, size_t(n), flags); },
+                fd, iov, count);
     }
 
-    ssize_t readvFull(int fd, iovec* iov, int count) {
-        return wrapvFull(readv, fd, iov, count);
-    }
+    // Creates a temporary file next to filename, has fill() write it, and
+    // renames it over filename.  fill(fd) returns -1 and sets errno on error.
+    // Returns 0 or an errno value.
+    template <class F>
+    static int replaceFileAtomic(
+            int dirfd,
+            const std::string& filename,
+            mode_t permissions,
+            F fill) {
+        // We write the data to a temporary file name first, then atomically rename
+        // it into place.  This ensures that the file contents will always be valid,
+        // even if we crash or are killed partway through writing out data.
+        //
+        // Both names are relative to dirfd, so the temporary file is created in
+        // the destination directory and rename() stays within one filesystem.
+        std::string tempName = filename + ".XXXXXX";
+        char* const tempPath = &tempName[0];
 
-    ssize_t writevFull(int fd, iovec* iov, int count) {
-        return wrapvFull(writev, fd, iov, count);
-    }
+        auto tmpFD = mkstempat(dirfd, tempPath, O_CLOEXEC);
+        if (tmpFD == -1) {
+            return errno;
+        }
+        bool success = false;
+        SCOPE_EXIT {
+                       if (tmpFD != -1) {
+                           close(tmpFD);
+                       }
+                       if (!success) {
+                           unlinkatNoInt(dirfd, tempPath);
+                       }
+                   };
 
-    template<class F, class... Args>
-    ssize_t wrapNoInt(F f, Args... args)
-    {
-        ssize_t r;
-        do
-        {
-            r = f(args...);
-        } while (r == -1 && errno == EINTR);
-        return r;
-    }
+        auto rc = fill(tmpFD);
+        if (rc == -1) {
+            return errno;
+        }
 
-    template <class F, class... Offset>
-    ssize_t wrapFull(F f, int fd, void* buf, size_t count, Offset... offset) {
-        char* b = static_cast<char*>(buf);
-        ssize_t totalBytes = 0;
-        ssize_t r;
-        do {
-            r = f(fd, b, count, offset...);
-            if (r == -1) {
-                if (errno == EINTR) {
-                    continue;
-                }
-                return r;
-            }
+        rc = fchmod(tmpFD, permissions);
+        if (rc == -1) {
+            return errno;
+        }
 
-            totalBytes += r;
-            b += r;
-            count -= r;
-            incr(r, offset...);
-        } while (r != 0 && count); // 0 means EOF
+        // Close the file before renaming to make sure all data has
+        // been successfully written.
+        rc = close(tmpFD);
+        tmpFD = -1;
+        if (rc == -1) {
+            return errno;
+        }
 
-        return totalBytes;
+        rc = renameatNoInt(dirfd, tempPath, dirfd, filename.c_str());
+        if (rc == -1) {
+            return errno;
+        }
+        success = true;
+        return 0;
     }
 
-    template <class F, class... Offset>
-    ssize_t wrapvFull(F f, int fd, iovec* iov, int count, Offset... offset) {
-        ssize_t totalBytes = 0;
-        ssize_t r;
-        do {
-            r = f(fd, iov, std::min<int>(count, 16), offset...);
-            if (r == -1) {
-                if (errno == EINTR) {
-                    continue;
-                }
-                return r;
-            }
-
-            if (r == 0) {
-                break; // EOF
-            }
-
-            totalBytes += r;
-            incr(r, offset...);
-            while (r != 0 && count != 0) {
-                if (r >= ssize_t(iov->iov_len)) {
-                    r -= ssize_t(iov->iov_len);
-                    ++iov;
-                    --count;
-                } else {
-                    iov->iov_base = static_cast<char*>(iov->iov_base) + r;
-                    iov->iov_len -= r;
-                    r = 0;
-                }
+    static int writeFileAtomicImpl(
+            int dirfd,
+            const std::string& filename,
+            iovec* iov,
+            int count,
+            mode_t permissions,
+            StreamingChecksum* sum,
+            bool embedChecksum) {
+        return replaceFileAtomic(dirfd, filename, permissions, [&](int tmpFD) {
+            auto rc = sum ? writevFull(tmpFD, iov, count, *sum)
+                          : writevFull(tmpFD, iov, count);
+            if (rc != -1 && sum && embedChecksum) {
+                char trailer[kChecksumTrailerSize];
+                encodeChecksumTrailer(trailer, sum->type(), sum->value());
+                rc = writeFull(tmpFD, trailer, sizeof(trailer));
             }
-        } while (count);
-
-        return totalBytes;
+            return rc == -1 ? -1 : 0;
+        });
     }
 
-    template<class Container>
-    bool readFile(
-            int fd,
-            Container &out,
-            size_t num_bytes)
-    {
-        static_assert(
-                sizeof(out[0]) == 1,
-                "readFile: only containers with byte-sized elements accepted");
-
-        size_t soFar = 0; // amount of bytes successfully read
-        SCOPE_EXIT
-        {
-            assert(out.size() >= soFar); // resize better doesn't throw
-            out.resize(soFar);
-        };
-
-        // Obtain file size:
-        struct stat buf;
-        if (fstat(fd, &buf) == -1)
-        {
-            return false;
-        }
-        // Some files (notably under /proc and /sys on Linux) lie about
-        // their size, so treat the size advertised by fstat under advise
-        // but don't rely on it. In particular, if the size is zero, we
-        // should attempt to read stuff. If not zero, we'll attempt to read
-        // one extra byte.
-        constexpr size_t initialAlloc = 1024 * 4;
-        out.resize(std::min(
-                buf.st_size > 0 ? (size_t(buf.st_size) + 1) : initialAlloc, num_bytes));
-
-        while (soFar < out.size())
-        {
-            const auto actual = readFull(fd, &out[soFar], out.size() - soFar);
-            if (actual == -1)
-            {
-                return false;
-            }
-            soFar += actual;
-            if (soFar < out.size())
-            {
-                // File exhausted
-                break;
-            }
-            // Ew, allocate more memory. Use exponential growth to avoid
-            // quadratic behavior. Cap size to num_bytes.
-            out.resize(std::min(out.size() * 3 / 2, num_bytes));
+    void writeFileAtomic(
+            std::string filename,
+            iovec* iov,
+            int count,
+            mode_t permissions) {
+        auto rc = writeFileAtomicNoThrow(filename, iov, count, permissions);
+        if (rc != 0) {
+            auto msg = std::string(__func__) + "() failed to update " + filename;
+            throw std::system_error(rc, std::generic_category(), msg);
         }
-
-        return true;
     }
 
-    template<class Container>
-    bool readFile(
-            const char *file_name,
-            Container &out,
-            size_t num_bytes)
-    {
-        assert(file_name);
+    int writeFileAtomicNoThrow(
+            std::string filename,
+            iovec* iov,
+            int count,
+            mode_t permissions) {
+        return writeFileAtomicImpl(AT_FDCWD, filename, iov, count, permissions, nullptr, false);
+    }
 
-        const auto fd = openNoInt(file_name, O_RDONLY | O_CLOEXEC);
-        if (fd == -1)
-        {
-            return false;
+    void writeFileAtomic(
+            int dirfd,
+            std::string filename,
+            iovec* iov,
+            int count,
+            mode_t permissions) {
+        auto rc = writeFileAtomicNoThrow(dirfd, filename, iov, count, permissions);
+        if (rc != 0) {
+            auto msg = std::string(__func__) + "() failed to update " + filename;
+            throw std::system_error(rc, std::generic_category(), msg);
         }
-
-        SCOPE_EXIT
-        {
-            // Ignore errors when closing the file
-            closeNoInt(fd);
-        };
-
-        return readFile(fd, out, num_bytes);
     }
 
-    template<class Container>
-    bool writeFile(
-            const Container &data,
-            const char *filename,
-            int flags,
-            mode_t mode)
-    {
-        static_assert(
-                sizeof(data[0]) == 1, "writeFile works with element size equal to 1");
-        int fd = open(filename, flags, mode);
-        if (fd == -1)
-        {
-            return false;
-        }
-        bool ok = data.empty() ||
-                  writeFull(fd, &data[0], data.size()) == static_cast<ssize_t>(data.size());
-        return closeNoInt(fd) == 0 && ok;
+    int writeFileAtomicNoThrow(
+            int dirfd,
+            std::string filename,
+            iovec* iov,
+            int count,
+            mode_t permissions) {
+        return writeFileAtomicImpl(dirfd, filename, iov, count, permissions, nullptr, false);
     }
 
     void writeFileAtomic(
             std::string filename,
             iovec* iov,
             int count,
+            StreamingChecksum& sum,
+            bool embedChecksum,
             mode_t permissions) {
-        auto rc = writeFileAtomicNoThrow(filename, iov, count, permissions);
+        auto rc = writeFileAtomicNoThrow(filename, iov, count, sum, embedChecksum, permissions);
         if (rc != 0) {
             auto msg = std::string(__func__) + "() failed to update " + filename;
             throw std::system_error(rc, std::generic_category(), msg);
@@ -289,65 +381,291 @@ namespace sysio
             std::string filename,
             iovec* iov,
             int count,
+            StreamingChecksum& sum,
+            bool embedChecksum,
             mode_t permissions) {
-        // We write the data to a temporary file name first, then atomically rename
-        // it into place.  This ensures that the file contents will always be valid,
-        // even if we crash or are killed partway through writing out data.
-        //
-        // Create a buffer that will contain two things:
-        // - A nul-terminated version of the filename
-        // - The temporary file name
-        std::vector<char> pathBuffer;
-        // Note that we have to explicitly pass in the size here to make
-        // sure the nul byte gets included in the data.
-        const std::string suffix(".XXXXXX\0");
-        pathBuffer.resize((2 * filename.size()) + 1 + suffix.size());
-        // Copy in the filename and then a nul terminator
-        memcpy(pathBuffer.data(), filename.data(), filename.size());
-        pathBuffer[filename.size()] = '\0';
-        const char* const filenameCStr = pathBuffer.data();
-        // Now prepare the temporary path template
-        char* const tempPath = pathBuffer.data() + filename.size() + 1;
-        memcpy(tempPath, filename.data(), filename.size());
-        memcpy(tempPath + filename.size(), suffix.data(), suffix.size());
-
-        auto tmpFD = mkstemp(tempPath);
-        if (tmpFD == -1) {
+        return writeFileAtomicImpl(AT_FDCWD, filename, iov, count, permissions, &sum, embedChecksum);
+    }
+
+    int writeFileAtomicWithNoThrow(
+            int dirfd,
+            const std::string& filename,
+            const std::function<bool(int)>& write,
+            mode_t permissions) {
+        return replaceFileAtomic(dirfd, filename, permissions, [&](int tmpFD) {
+            return write(tmpFD) ? 0 : -1;
+        });
+    }
+
+    // Makes tmpFD share the contents of oldFd (size bytes): a reflink, or a
+    // copy if allowed.  Returns false and leaves tmpFD empty if neither works.
+    static bool cloneFile(int oldFd, int tmpFD, off_t size, bool allowCopy) {
+        if (ioctl(tmpFD, FICLONE, oldFd) == 0) {
+            return true;
+        }
+        if (!allowCopy) {
+            return false;
+        }
+        loff_t in = 0;
+        loff_t out = 0;
+        while (in < size) {
+            ssize_t r = copy_file_range(oldFd, &in, tmpFD, &out, size_t(size - in), 0);
+            if (r == -1 && errno == EINTR) {
+                continue;
+            }
+            if (r <= 0) {
+                ftruncate(tmpFD, 0);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static int writeFileAtomicDeltaImpl(
+            int dirfd,
+            const std::string& filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result,
+            const DeltaWriteOptions& options) {
+        assert(options.blockSize > 0);
+        DeltaWriteResult unused;
+        DeltaWriteResult& r = result ? *result : unused;
+        r = DeltaWriteResult();
+
+        size_t size = 0;
+        for (int i = 0; i < count; ++i) {
+            size += iov[i].iov_len;
+        }
+        r.blocks = (size + options.blockSize - 1) / options.blockSize;
+
+        int oldFd = openatNoInt(dirfd, filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (oldFd == -1 && errno != ENOENT) {
             return errno;
         }
-        bool success = false;
         SCOPE_EXIT {
-                       if (tmpFD != -1) {
-                           close(tmpFD);
-                       }
-                       if (!success) {
-                           unlink(tempPath);
+                       if (oldFd != -1) {
+                           close(oldFd);
                        }
                    };
-
-        auto rc = writevFull(tmpFD, iov, count);
-        if (rc == -1) {
+        struct stat st;
+        if (oldFd != -1 && fstat(oldFd, &st) == -1) {
             return errno;
         }
+        const bool haveOld = oldFd != -1 && S_ISREG(st.st_mode);
+
+        return replaceFileAtomic(dirfd, filename, options.permissions, [&](int tmpFD) {
+            if (!haveOld || !cloneFile(oldFd, tmpFD, st.st_size, options.copyWithoutReflink)) {
+                r.bytesWritten = size;
+                r.changedBlocks = r.blocks;
+                std::vector<iovec> copy(iov, iov + count);
+                return writevFull(tmpFD, copy.data(), count) == -1 ? -1 : 0;
+            }
+            r.incremental = true;
+            posix_fadvise(oldFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+            // Walk the new contents a block at a time, pointing into iov where
+            // a block lies within one element and gathering it otherwise
+            const uint64_t oldSize = uint64_t(st.st_size);
+            std::vector<char> oldBlock(options.blockSize);
+            std::vector<char> gathered(options.blockSize);
+            int i = 0;
+            size_t iovOffset = 0;
+            for (uint64_t offset = 0; offset < size; offset += options.blockSize) {
+                size_t n = size_t(std::min<uint64_t>(options.blockSize, size - offset));
+                while (iovOffset == iov[i].iov_len) {
+                    ++i;
+                    iovOffset = 0;
+                }
+                const char* block = static_cast<const char*>(iov[i].iov_base) + iovOffset;
+                if (iov[i].iov_len - iovOffset >= n) {
+                    iovOffset += n;
+                } else {
+                    for (size_t copied = 0; copied < n;) {
+                        if (iovOffset == iov[i].iov_len) {
+                            ++i;
+                            iovOffset = 0;
+                            continue;
+                        }
+                        size_t k = std::min(n - copied, iov[i].iov_len - iovOffset);
+                        memcpy(&gathered[copied], static_cast<const char*>(iov[i].iov_base) + iovOffset, k);
+                        copied += k;
+                        iovOffset += k;
+                    }
+                    block = gathered.data();
+                }
 
-        rc = fchmod(tmpFD, permissions);
-        if (rc == -1) {
-            return errno;
+                if (offset + n <= oldSize) {
+                    ssize_t got = preadFull(oldFd, oldBlock.data(), n, off_t(offset));
+                    if (got == -1) {
+                        return -1;
+                    }
+                    if (size_t(got) == n && memcmp(block, oldBlock.data(), n) == 0) {
+                        continue;
+                    }
+                }
+                if (pwriteFull(tmpFD, block, n, off_t(offset)) == -1) {
+                    return -1;
+                }
+                r.bytesWritten += n;
+                ++r.changedBlocks;
+            }
+            return oldSize != size ? ftruncate(tmpFD, off_t(size)) : 0;
+        });
+    }
+
+    void writeFileAtomicDelta(
+            int dirfd,
+            std::string filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result,
+            const DeltaWriteOptions& options) {
+        auto rc = writeFileAtomicDeltaNoThrow(dirfd, filename, iov, count, result, options);
+        if (rc != 0) {
+            auto msg = std::string(__func__) + "() failed to update " + filename;
+            throw std::system_error(rc, std::generic_category(), msg);
         }
+    }
 
-        // Close the file before renaming to make sure all data has
-        // been successfully written.
-        rc = close(tmpFD);
-        tmpFD = -1;
-        if (rc == -1) {
-            return errno;
+    int writeFileAtomicDeltaNoThrow(
+            int dirfd,
+            std::string filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result,
+            const DeltaWriteOptions& options) {
+        return writeFileAtomicDeltaImpl(dirfd, filename, iov, count, result, options);
+    }
+
+    void writeFileAtomicDelta(
+            std::string filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result,
+            const DeltaWriteOptions& options) {
+        writeFileAtomicDelta(AT_FDCWD, std::move(filename), iov, count, result, options);
+    }
+
+    int writeFileAtomicDeltaNoThrow(
+            std::string filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result,
+            const DeltaWriteOptions& options) {
+        return writeFileAtomicDeltaImpl(AT_FDCWD, filename, iov, count, result, options);
+    }
+
+    ssize_t preadParallel(
+            int fd,
+            void* buf,
+            size_t n,
+            off_t offset,
+            const ParallelReadOptions& options)
+    {
+        const size_t page = detail::pageSize();
+        const size_t chunkSize = std::max<size_t>((options.chunkSize + page - 1) / page, 1) * page;
+        const size_t numChunks = (n + chunkSize - 1) / chunkSize;
+        char* out = static_cast<char*>(buf);
+
+        std::atomic<size_t> nextChunk(0);
+        std::atomic<bool> stop(false);
+        std::mutex mutex;
+        // Under mutex
+        uint64_t done = 0;
+        int error = 0;
+        // Where the file turned out to end, if before n
+        size_t end = n;
+
+        auto work = [&] {
+            // The others stop too if the callback throws
+            SCOPE_FAIL
+            {
+                stop = true;
+            };
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                size_t i = nextChunk++;
+                if (i >= numChunks)
+                {
+                    break;
+                }
+                size_t begin = i * chunkSize;
+                size_t len = std::min(chunkSize, n - begin);
+                ssize_t r = preadFull(fd, out + begin, len, offset + off_t(begin));
+                std::lock_guard<std::mutex> lock(mutex);
+                if (r == -1)
+                {
+                    error = error != 0 ? error : errno;
+                    stop = true;
+                    break;
+                }
+                if (size_t(r) < len)
+                {
+                    end = std::min(end, begin + size_t(r));
+                }
+                done += uint64_t(r);
+                if (options.progress && !stop && !options.progress(done, n))
+                {
+                    error = error != 0 ? error : ECANCELED;
+                    stop = true;
+                }
+            }
+        };
+
+        // The calling thread reads too
+        std::vector<std::future<void>> workers;
+        const size_t threads = std::min(std::max<size_t>(options.threads, 1), numChunks);
+        for (size_t t = 1; t < threads; ++t)
+        {
+            try
+            {
+                workers.push_back(std::async(std::launch::async, work));
+            } catch (const std::system_error&)
+            {
+                // Out of threads: go on with the ones there are
+                break;
+            }
+        }
+        work();
+        for (auto& worker : workers)
+        {
+            worker.get();
         }
 
-        rc = rename(tempPath, filenameCStr);
-        if (rc == -1) {
-            return errno;
+        if (error != 0)
+        {
+            errno = error;
+            return -1;
         }
-        success = true;
-        return 0;
+        return ssize_t(end);
     }
-}
+
+    template bool readFile<std::string>(int, std::string &, size_t);
+
+    template bool readFile<std::string>(const char *, std::string &, size_t);
+
+    template bool readFile<std::vector<char>>(int, std::vector<char> &, size_t);
+
+    template bool readFile<std::vector<char>>(const char *, std::vector<char> &, size_t);
+
+    template bool readFile<std::string>(int, const char *, std::string &, size_t);
+
+    template bool readFile<std::vector<char>>(int, const char *, std::vector<char> &, size_t);
+
+    template bool readFileParallel<std::string>(int, std::string &, const ParallelReadOptions &);
+
+    template bool readFileParallel<std::string>(const char *, std::string &, const ParallelReadOptions &);
+
+    template bool readFileParallel<std::vector<char>>(int, std::vector<char> &, const ParallelReadOptions &);
+
+    template bool readFileParallel<std::vector<char>>(const char *, std::vector<char> &, const ParallelReadOptions &);
+
+    template bool writeFile<std::string>(const std::string &, const char *, int, mode_t);
+
+    template bool writeFile<std::vector<char>>(const std::vector<char> &, const char *, int, mode_t);
+
+    template bool writeFile<std::string>(const std::string &, int, const char *, int, mode_t);
+
+    template bool writeFile<std::vector<char>>(const std::vector<char> &, int, const char *, int, mode_t);
+}
\ No newline at end of file
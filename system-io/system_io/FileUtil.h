@@ -4,22 +4,71 @@
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <sys/fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <limits>
+#include <vector>
+
+#include "system_io/ScopeGuard.h"
 
 /*
  * Convenience wrappers around some commonly used system calls.
  * The *NoInt wrappers retry on EINTR.
  * The *Full wrappers retry on EINTR and also loop until all data is written.
+ * The *Some wrappers are for non-blocking descriptors: they retry on EINTR
+ * and loop until all data is transferred or the call would block.
  * Note that *Full wrappers weaken the thread semantics of underlying system calls.
  */
 
 namespace sysio
 {
+    class StreamingChecksum;
 
     int openNoInt(const char *name, int flags, mode_t mode = 0666);
 
+    /*
+     * The *at() variants resolve names relative to the directory open as
+     * dirfd (or to the working directory for AT_FDCWD), see openat(2).
+     * Holding the directory open saves walking the full path on every call,
+     * and keeps working if the directory is renamed meanwhile.
+     */
+    int openatNoInt(int dirfd, const char *name, int flags, mode_t mode = 0666);
+
+    int renameatNoInt(int oldDirfd, const char *oldName, int newDirfd, const char *newName);
+
+    int linkatNoInt(int oldDirfd, const char *oldName, int newDirfd, const char *newName, int flags = 0);
+
+    int unlinkatNoInt(int dirfd, const char *name, int flags = 0);
+
+    /*
+     * renameat2(2), for RENAME_EXCHANGE and RENAME_NOREPLACE.  Fails with
+     * ENOSYS where the kernel lacks it, and with EINVAL where the filesystem
+     * does not support the flags.
+     */
+    int renameat2NoInt(int oldDirfd, const char *oldName, int newDirfd, const char *newName,
+                       unsigned int flags);
+
+    /*
+     * mkstemp() relative to dirfd: replaces the trailing "XXXXXX" of
+     * nameTemplate in place and creates that file with O_EXCL and mode 0600,
+     * opened O_RDWR | flags.  Returns the descriptor, or -1 and sets errno
+     * (EINVAL if nameTemplate does not end in "XXXXXX").
+     */
+    int mkstempat(int dirfd, char *nameTemplate, int flags = O_CLOEXEC);
+
+    /*
+     * mkdtemp() relative to dirfd: creates the directory nameTemplate,
+     * replacing its trailing "XXXXXX" as mkstempat() does.  Returns 0, or -1
+     * and sets errno.
+     */
+    int mkdtempat(int dirfd, char *nameTemplate, mode_t mode = 0700);
+
     int closeNoInt(int fd);
 
     int dupNoInt(int fd);
@@ -34,37 +83,82 @@ namespace sysio
     /*
      * Read from a file or socket
      */
-    ssize_t readNoInt(int fd, void *buf, size_t n);
+    inline ssize_t readNoInt(int fd, void *buf, size_t n);
 
-    ssize_t writeNoInt(int fd, const void *buf, size_t n);
+    inline ssize_t writeNoInt(int fd, const void *buf, size_t n);
 
-    ssize_t readFull(int fd, void* buf, size_t n);
+    inline ssize_t readFull(int fd, void* buf, size_t n);
 
-    ssize_t writeFull(int fd, const void* buf, size_t n);
+    inline ssize_t writeFull(int fd, const void* buf, size_t n);
+
+    /*
+     * Read or write as much as possible without blocking.  Returns the
+     * number of bytes transferred if it is not 0.  Otherwise returns -1 with
+     * errno set to EAGAIN if nothing could be transferred yet, or to the
+     * error, and readSome() returns 0 at EOF.
+     *
+     * After a partial transfer, errno is EAGAIN if the descriptor would
+     * block, or 0 if an EOF or error follows, which the next call reports.
+     * With edge-triggered epoll, keep calling until one fails with EAGAIN
+     * or transfers less than n bytes with errno == EAGAIN.
+     */
+    ssize_t readSome(int fd, void* buf, size_t n);
+
+    ssize_t writeSome(int fd, const void* buf, size_t n);
 
     /*
      * Read from a file or socket without file pointer change
      */
-    ssize_t preadNoInt(int fd, void *buf, size_t n, off_t offset);
+    inline ssize_t preadNoInt(int fd, void *buf, size_t n, off_t offset);
 
-    ssize_t pwriteNoInt(int fd, const void *buf, size_t n, off_t offset);
+    inline ssize_t pwriteNoInt(int fd, const void *buf, size_t n, off_t offset);
 
-    ssize_t preadFull(int fd, void* buf, size_t n, off_t offset);
+    inline ssize_t preadFull(int fd, void* buf, size_t n, off_t offset);
 
-    ssize_t pwriteFull(int fd, const void* buf, size_t n, off_t offset);
+    inline ssize_t pwriteFull(int fd, const void* buf, size_t n, off_t offset);
 
     /*
      * read or write a vector
      * Read data on a file or socket and store in a set of buffers described by IOVEC.
      * data are put in IOVEC instead of a contiguous buffer.
      */
-    ssize_t readvNoInt(int fd, const iovec *iov, int count);
+    inline ssize_t readvNoInt(int fd, const iovec *iov, int count);
+
+    inline ssize_t writevNoInt(int fd, const iovec *iov, int count);
+
+    inline ssize_t readvFull(int fd, iovec* iov, int count);
+
+    inline ssize_t writevFull(int fd, iovec* iov, int count);
+
+    /*
+     * Move data between a pipe and another file descriptor without copying it
+     * through user memory (see splice(2), tee(2) and vmsplice(2)).  At least
+     * one of fdIn and fdOut must be a pipe.
+     *
+     * spliceFull() loops until n bytes are moved or fdIn reaches EOF.  If
+     * offIn / offOut are not null, they are advanced past the data moved and
+     * the file offset is left alone, as with pread() / pwrite().
+     */
+    ssize_t spliceNoInt(int fdIn, loff_t* offIn, int fdOut, loff_t* offOut, size_t n, unsigned int flags = 0);
 
-    ssize_t writevNoInt(int fd, const iovec *iov, int count);
+    ssize_t spliceFull(int fdIn, loff_t* offIn, int fdOut, loff_t* offOut, size_t n, unsigned int flags = 0);
 
-    ssize_t readvFull(int fd, iovec* iov, int count);
+    /*
+     * Duplicate up to n bytes from the front of pipe fdIn to pipe fdOut
+     * without consuming them.  There is no teeFull(): tee() always starts at
+     * the front of fdIn, so a short tee cannot be resumed.
+     */
+    ssize_t teeNoInt(int fdIn, int fdOut, size_t n, unsigned int flags = 0);
+
+    /*
+     * Map user memory into pipe fd.  Unless SPLICE_F_GIFT is used, the pages
+     * are referenced by the pipe, so the memory must not be modified until
+     * the data has been consumed from the pipe.  Like writevFull(),
+     * vmspliceFull() modifies iov.
+     */
+    ssize_t vmspliceNoInt(int fd, const iovec* iov, int count, unsigned int flags = 0);
 
-    ssize_t writevFull(int fd, iovec* iov, int count);
+    ssize_t vmspliceFull(int fd, iovec* iov, int count, unsigned int flags = 0);
 
     /*
      * Wrap call to f(args) in loop to retry on EINTR
@@ -78,6 +172,14 @@ namespace sysio
     template <class F, class... Offset>
     ssize_t wrapFull(F f, int fd, void* buf, size_t count, Offset... offset);
 
+    namespace detail
+    {
+        // readFile() with read(fd, buf, n), which has the contract of
+        // readFull(), in place of readFull()
+        template<class Container, class Read>
+        bool readFileWith(int fd, Container &out, size_t num_bytes, Read read);
+    }
+
     /*
      * Read entire file (if num_bytes is defaulted) or no more than
      * num_bytes (otherwise) into container *out. The container is assumed
@@ -102,6 +204,71 @@ namespace sysio
             Container& out,
             size_t num_bytes = std::numeric_limits<size_t>::max());
 
+    /*
+     * Same as above, with file_name relative to dirfd
+     */
+    template <class Container>
+    bool readFile(
+            int dirfd,
+            const char* file_name,
+            Container& out,
+            size_t num_bytes = std::numeric_limits<size_t>::max());
+
+    struct ParallelReadOptions
+    {
+        // Reads in flight at once, each on its own thread.  The threads wait
+        // on the device rather than use a CPU, so this is the queue depth
+        // to keep a fast disk busy, not a number of CPUs.
+        size_t threads = 8;
+        // Unit of each pread(), rounded up to a multiple of the page size
+        size_t chunkSize = 2 << 20;
+        // Called after each chunk with the bytes read so far and in total,
+        // one call at a time and with done increasing.  Returning false
+        // cancels the read, which then fails with ECANCELED once the reads
+        // in flight complete; another thread can cancel through a flag the
+        // callback checks.
+        std::function<bool(uint64_t done, uint64_t total)> progress;
+    };
+
+    /*
+     * preadFull() of n bytes at offset as chunks read by several threads at
+     * once, for large files on devices that only reach their bandwidth with
+     * many requests in flight (NVMe, network storage, RAID).  Chunks start
+     * at offset plus multiples of the chunk size.
+     *
+     * Returns the bytes read, fewer than n only if the file ends first, or
+     * -1 with errno set (to ECANCELED if cancelled).  On error, any part of
+     * buf may have been written.
+     */
+    ssize_t preadParallel(
+            int fd,
+            void* buf,
+            size_t n,
+            off_t offset,
+            const ParallelReadOptions& options = ParallelReadOptions());
+
+    /*
+     * readFile() of a whole file with preadParallel(), sized by a single
+     * fstat().  Reads from the start of the file regardless of the file
+     * offset, which is left unchanged.  Files that fstat() gives no size
+     * for (pipes, procfs) are read with readFile() instead.
+     *
+     * Note that resizing a std::string or std::vector zero-fills it first,
+     * on the calling thread; for the largest files, read into a PageBuffer
+     * (see PageMemory.h) with preadParallel() instead.
+     */
+    template <class Container>
+    bool readFileParallel(
+            int fd,
+            Container& out,
+            const ParallelReadOptions& options = ParallelReadOptions());
+
+    template <class Container>
+    bool readFileParallel(
+            const char* file_name,
+            Container& out,
+            const ParallelReadOptions& options = ParallelReadOptions());
+
     /*
      * Writes container to file. The container is assumed to be
      * contiguous, with element size equal to 1, and offering STL-like
@@ -125,6 +292,14 @@ namespace sysio
             int flags = O_WRONLY | O_CREAT | O_TRUNC,
             mode_t mode = 0666);
 
+    template <class Container>
+    bool writeFile(
+            const Container& data,
+            int dirfd,
+            const char* filename,
+            int flags = O_WRONLY | O_CREAT | O_TRUNC,
+            mode_t mode = 0666);
+
     /*
      * Write file contents "atomically".
      *
@@ -153,6 +328,527 @@ namespace sysio
             iovec* iov,
             int count,
             mode_t permissions = 0644);
+
+    /*
+     * writeFileAtomic() of filename relative to dirfd; the temporary file is
+     * created, and renamed, in the same directory.
+     */
+    void writeFileAtomic(
+            int dirfd,
+            std::string filename,
+            iovec* iov,
+            int count,
+            mode_t permissions = 0644);
+
+    int writeFileAtomicNoThrow(
+            int dirfd,
+            std::string filename,
+            iovec* iov,
+            int count,
+            mode_t permissions = 0644);
+
+    /*
+     * Versions of writeFileAtomic() that checksum the data inline as it is
+     * written (see Checksum.h).  On success, sum.value() is the checksum of
+     * the contents of iov.
+     *
+     * If embedChecksum is true, a checksum trailer is appended to the file,
+     * which readFileWithTrailer() verifies and strips.
+     */
+    void writeFileAtomic(
+            std::string filename,
+            iovec* iov,
+            int count,
+            StreamingChecksum& sum,
+            bool embedChecksum = false,
+            mode_t permissions = 0644);
+
+    int writeFileAtomicNoThrow(
+            std::string filename,
+            iovec* iov,
+            int count,
+            StreamingChecksum& sum,
+            bool embedChecksum = false,
+            mode_t permissions = 0644);
+
+    /*
+     * writeFileAtomic() with the contents written into the temporary file
+     * by write(fd), for writers other than writevFull() (e.g. paced, see
+     * RateLimiter.h).  write returns false and sets errno on error.
+     *
+     * Returns 0 or an errno value.
+     */
+    int writeFileAtomicWithNoThrow(
+            int dirfd,
+            const std::string& filename,
+            const std::function<bool(int)>& write,
+            mode_t permissions = 0644);
+
+    struct DeltaWriteOptions
+    {
+        // Unit of comparison and of writing
+        size_t blockSize = 64 << 10;
+        // Where the filesystem cannot reflink, start from a copy_file_range()
+        // copy instead of rewriting everything.  Only worth it where the copy
+        // is offloaded (NFS, SMB server-side copy); a local filesystem writes
+        // every byte of the copy.
+        bool copyWithoutReflink = false;
+        mode_t permissions = 0644;
+    };
+
+    struct DeltaWriteResult
+    {
+        // Bytes written by writeFileAtomicDelta() itself, not counting what
+        // the clone shares or copied
+        uint64_t bytesWritten = 0;
+        uint64_t blocks = 0;
+        uint64_t changedBlocks = 0;
+        // False if the file was rewritten in full: it did not exist, or could
+        // not be cloned
+        bool incremental = false;
+    };
+
+    /*
+     * writeFileAtomic() for large files that change a little at a time.
+     *
+     * The temporary file starts as a reflink clone (FICLONE) of the current
+     * file, which shares its blocks instead of copying them.  Each block of
+     * the new contents is compared with the current file, and only the ones
+     * that differ are written into the clone, which is then renamed into
+     * place as usual.  The current file is still read in full, but reads
+     * are much cheaper than writes that have to reach the disk (and be
+     * copied again by snapshots and replication).
+     *
+     * Where reflinks are not supported (e.g. ext4), or the file does not
+     * exist yet, the contents are written in full.  Unlike writeFileAtomic(),
+     * iov is not modified.
+     */
+    void writeFileAtomicDelta(
+            std::string filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result = nullptr,
+            const DeltaWriteOptions& options = DeltaWriteOptions());
+
+    int writeFileAtomicDeltaNoThrow(
+            std::string filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result = nullptr,
+            const DeltaWriteOptions& options = DeltaWriteOptions());
+
+    void writeFileAtomicDelta(
+            int dirfd,
+            std::string filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result = nullptr,
+            const DeltaWriteOptions& options = DeltaWriteOptions());
+
+    int writeFileAtomicDeltaNoThrow(
+            int dirfd,
+            std::string filename,
+            iovec* iov,
+            int count,
+            DeltaWriteResult* result = nullptr,
+            const DeltaWriteOptions& options = DeltaWriteOptions());
+
+    // Definitions.  The wrappers are inline and the system call is a tag
+    // type rather than a function pointer, so each call compiles down to the
+    // system call and its retry loop.
+
+    namespace detail
+    {
+        struct ReadOp
+        {
+            ssize_t operator()(int fd, void *buf, size_t n) const
+            {
+                return ::read(fd, buf, n);
+            }
+        };
+
+        struct WriteOp
+        {
+            ssize_t operator()(int fd, const void *buf, size_t n) const
+            {
+                return ::write(fd, buf, n);
+            }
+        };
+
+        struct PreadOp
+        {
+            ssize_t operator()(int fd, void *buf, size_t n, off_t offset) const
+            {
+                return ::pread(fd, buf, n, offset);
+            }
+        };
+
+        struct PwriteOp
+        {
+            ssize_t operator()(int fd, const void *buf, size_t n, off_t offset) const
+            {
+                return ::pwrite(fd, buf, n, offset);
+            }
+        };
+
+        struct ReadvOp
+        {
+            ssize_t operator()(int fd, const iovec *iov, int count) const
+            {
+                return ::readv(fd, iov, count);
+            }
+        };
+
+        struct WritevOp
+        {
+            ssize_t operator()(int fd, const iovec *iov, int count) const
+            {
+                return ::writev(fd, iov, count);
+            }
+        };
+
+        inline void incr(ssize_t /* n */) {}
+
+        inline void incr(ssize_t n, off_t &offset)
+        {
+            offset += off_t(n);
+        }
+    }
+
+    template<class F, class... Args>
+    ssize_t wrapNoInt(F f, Args... args)
+    {
+        ssize_t r;
+        do
+        {
+            r = f(args...);
+        } while (r == -1 && errno == EINTR);
+        return r;
+    }
+
+    template <class F, class... Offset>
+    ssize_t wrapFull(F f, int fd, void* buf, size_t count, Offset... offset) {
+        char* b = static_cast<char*>(buf);
+        ssize_t totalBytes = 0;
+        ssize_t r;
+        do {
+            r = f(fd, b, count, offset...);
+            if (r == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return r;
+            }
+
+            totalBytes += r;
+            b += r;
+            count -= r;
+            detail::incr(r, offset...);
+        } while (r != 0 && count); // 0 means EOF
+
+        return totalBytes;
+    }
+
+    template <class F, class... Offset>
+    ssize_t wrapvFull(F f, int fd, iovec* iov, int count, Offset... offset) {
+        ssize_t totalBytes = 0;
+        ssize_t r;
+        do {
+            r = f(fd, iov, std::min<int>(count, 16), offset...);
+            if (r == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return r;
+            }
+
+            if (r == 0) {
+                break; // EOF
+            }
+
+            totalBytes += r;
+            detail::incr(r, offset...);
+            while (r != 0 && count != 0) {
+                if (r >= ssize_t(iov->iov_len)) {
+                    r -= ssize_t(iov->iov_len);
+                    ++iov;
+                    --count;
+                } else {
+                    iov->iov_base = static_cast<char*>(iov->iov_base) + r;
+                    iov->iov_len -= r;
+                    r = 0;
+                }
+            }
+        } while (count);
+
+        return totalBytes;
+    }
+
+    template<class Container>
+    bool readFile(
+            int fd,
+            Container &out,
+            size_t num_bytes)
+    {
+        return detail::readFileWith(fd, out, num_bytes, [](int f, void *buf, size_t n) {
+            return readFull(f, buf, n);
+        });
+    }
+
+    template<class Container, class Read>
+    bool detail::readFileWith(
+            int fd,
+            Container &out,
+            size_t num_bytes,
+            Read read)
+    {
+        static_assert(
+                sizeof(out[0]) == 1,
+                "readFile: only containers with byte-sized elements accepted");
+
+        size_t soFar = 0; // amount of bytes successfully read
+        SCOPE_EXIT
+        {
+            assert(out.size() >= soFar); // resize better doesn't throw
+            out.resize(soFar);
+        };
+
+        // Obtain file size:
+        struct stat buf;
+        if (fstat(fd, &buf) == -1)
+        {
+            return false;
+        }
+        // Some files (notably under /proc and /sys on Linux) lie about
+        // their size, so treat the size advertised by fstat under advise
+        // but don't rely on it. In particular, if the size is zero, we
+        // should attempt to read stuff. If not zero, we'll attempt to read
+        // one extra byte.
+        constexpr size_t initialAlloc = 1024 * 4;
+        out.resize(std::min(
+                buf.st_size > 0 ? (size_t(buf.st_size) + 1) : initialAlloc, num_bytes));
+
+        while (soFar < out.size())
+        {
+            const auto actual = read(fd, &out[soFar], out.size() - soFar);
+            if (actual == -1)
+            {
+                return false;
+            }
+            soFar += actual;
+            if (soFar < out.size())
+            {
+                // File exhausted
+                break;
+            }
+            // Ew, allocate more memory. Use exponential growth to avoid
+            // quadratic behavior. Cap size to num_bytes.
+            out.resize(std::min(out.size() * 3 / 2, num_bytes));
+        }
+
+        return true;
+    }
+
+    template<class Container>
+    bool readFile(
+            const char *file_name,
+            Container &out,
+            size_t num_bytes)
+    {
+        return readFile(AT_FDCWD, file_name, out, num_bytes);
+    }
+
+    template<class Container>
+    bool readFile(
+            int dirfd,
+            const char *file_name,
+            Container &out,
+            size_t num_bytes)
+    {
+        assert(file_name);
+
+        const auto fd = openatNoInt(dirfd, file_name, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            return false;
+        }
+
+        SCOPE_EXIT
+        {
+            // Ignore errors when closing the file
+            closeNoInt(fd);
+        };
+
+        return readFile(fd, out, num_bytes);
+    }
+
+    template<class Container>
+    bool readFileParallel(
+            int fd,
+            Container &out,
+            const ParallelReadOptions &options)
+    {
+        static_assert(
+                sizeof(out[0]) == 1,
+                "readFileParallel: only containers with byte-sized elements accepted");
+
+        struct stat buf;
+        if (fstat(fd, &buf) == -1)
+        {
+            return false;
+        }
+        if (!S_ISREG(buf.st_mode) || buf.st_size == 0)
+        {
+            return readFile(fd, out);
+        }
+        out.resize(size_t(buf.st_size));
+        ssize_t r = preadParallel(fd, &out[0], out.size(), 0, options);
+        out.resize(r == -1 ? 0 : size_t(r));
+        return r != -1;
+    }
+
+    template<class Container>
+    bool readFileParallel(
+            const char *file_name,
+            Container &out,
+            const ParallelReadOptions &options)
+    {
+        assert(file_name);
+
+        const auto fd = openNoInt(file_name, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            return false;
+        }
+
+        SCOPE_EXIT
+        {
+            // Ignore errors when closing the file
+            closeNoInt(fd);
+        };
+
+        return readFileParallel(fd, out, options);
+    }
+
+    template<class Container>
+    bool writeFile(
+            const Container &data,
+            const char *filename,
+            int flags,
+            mode_t mode)
+    {
+        return writeFile(data, AT_FDCWD, filename, flags, mode);
+    }
+
+    template<class Container>
+    bool writeFile(
+            const Container &data,
+            int dirfd,
+            const char *filename,
+            int flags,
+            mode_t mode)
+    {
+        static_assert(
+                sizeof(data[0]) == 1, "writeFile works with element size equal to 1");
+        int fd = openatNoInt(dirfd, filename, flags, mode);
+        if (fd == -1)
+        {
+            return false;
+        }
+        bool ok = data.empty() ||
+                  writeFull(fd, &data[0], data.size()) == static_cast<ssize_t>(data.size());
+        return closeNoInt(fd) == 0 && ok;
+    }
+
+    inline ssize_t readNoInt(int fd, void *buf, size_t n)
+    {
+        return wrapNoInt(detail::ReadOp(), fd, buf, n);
+    }
+
+    inline ssize_t writeNoInt(int fd, const void *buf, size_t n)
+    {
+        return wrapNoInt(detail::WriteOp(), fd, buf, n);
+    }
+
+    inline ssize_t readFull(int fd, void *buf, size_t n)
+    {
+        return wrapFull(detail::ReadOp(), fd, buf, n);
+    }
+
+    inline ssize_t writeFull(int fd, const void *buf, size_t n)
+    {
+        return wrapFull(detail::WriteOp(), fd, const_cast<void *>(buf), n);
+    }
+
+    inline ssize_t preadNoInt(int fd, void *buf, size_t n, off_t offset)
+    {
+        return wrapNoInt(detail::PreadOp(), fd, buf, n, offset);
+    }
+
+    inline ssize_t pwriteNoInt(int fd, const void *buf, size_t n, off_t offset)
+    {
+        return wrapNoInt(detail::PwriteOp(), fd, buf, n, offset);
+    }
+
+    inline ssize_t preadFull(int fd, void *buf, size_t n, off_t offset)
+    {
+        return wrapFull(detail::PreadOp(), fd, buf, n, offset);
+    }
+
+    inline ssize_t pwriteFull(int fd, const void *buf, size_t n, off_t offset)
+    {
+        return wrapFull(detail::PwriteOp(), fd, const_cast<void *>(buf), n, offset);
+    }
+
+    inline ssize_t readvNoInt(int fd, const iovec *iov, int count)
+    {
+        return wrapNoInt(detail::ReadvOp(), fd, iov, count);
+    }
+
+    inline ssize_t writevNoInt(int fd, const iovec *iov, int count)
+    {
+        return wrapNoInt(detail::WritevOp(), fd, iov, count);
+    }
+
+    inline ssize_t readvFull(int fd, iovec *iov, int count)
+    {
+        return wrapvFull(detail::ReadvOp(), fd, iov, count);
+    }
+
+    inline ssize_t writevFull(int fd, iovec *iov, int count)
+    {
+        return wrapvFull(detail::WritevOp(), fd, iov, count);
+    }
+
+    // Instantiated in FileUtil.cpp for the usual containers, so that their
+    // users need not compile them
+    extern template bool readFile<std::string>(int, std::string &, size_t);
+
+    extern template bool readFile<std::string>(const char *, std::string &, size_t);
+
+    extern template bool readFile<std::vector<char>>(int, std::vector<char> &, size_t);
+
+    extern template bool readFile<std::vector<char>>(const char *, std::vector<char> &, size_t);
+
+    extern template bool readFile<std::string>(int, const char *, std::string &, size_t);
+
+    extern template bool readFile<std::vector<char>>(int, const char *, std::vector<char> &, size_t);
+
+    extern template bool readFileParallel<std::string>(int, std::string &, const ParallelReadOptions &);
+
+    extern template bool readFileParallel<std::string>(const char *, std::string &, const ParallelReadOptions &);
+
+    extern template bool readFileParallel<std::vector<char>>(int, std::vector<char> &, const ParallelReadOptions &);
+
+    extern template bool readFileParallel<std::vector<char>>(const char *, std::vector<char> &, const ParallelReadOptions &);
+
+    extern template bool writeFile<std::string>(const std::string &, const char *, int, mode_t);
+
+    extern template bool writeFile<std::vector<char>>(const std::vector<char> &, const char *, int, mode_t);
+
+    extern template bool writeFile<std::string>(const std::string &, int, const char *, int, mode_t);
+
+    extern template bool writeFile<std::vector<char>>(const std::vector<char> &, int, const char *, int, mode_t);
 }
 
 #endif //SYSTEM_IO_FILEUTIL_H
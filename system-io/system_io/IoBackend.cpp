@@ -0,0 +1,389 @@
+#include "system_io/IoBackend.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "system_io/Exception.h"
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+
+namespace sysio
+{
+    namespace
+    {
+        // Largest read or write passed to the kernel at once; longer ones
+        // are resubmitted as they complete
+        constexpr size_t kMaxTransfer = size_t(1) << 30;
+
+        ssize_t runRequest(IoRequest *request)
+        {
+            switch (request->opcode)
+            {
+                case IoOpcode::kRead:
+                    return preadFull(request->fd, request->buf, request->size, request->offset);
+                case IoOpcode::kWrite:
+                    return pwriteFull(request->fd, request->buf, request->size, request->offset);
+                case IoOpcode::kFsync:
+                    return ::fsync(request->fd);
+                case IoOpcode::kFdatasync:
+                    return ::fdatasync(request->fd);
+            }
+            LOG(FATAL) << "bad opcode";
+            return -1;
+        }
+
+        int uringSetup(unsigned entries, io_uring_params *params)
+        {
+            return int(syscall(__NR_io_uring_setup, entries, params));
+        }
+
+        int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+        {
+            return int(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+        }
+
+        void *mapRing(int fd, size_t size, off_t offset)
+        {
+            void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+            if (p == MAP_FAILED)
+            {
+                throwSystemError("mmap() of io_uring failed");
+            }
+            return p;
+        }
+    }
+
+    void Latch::set()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.store(true, std::memory_order_release);
+        cv_.notify_all();
+    }
+
+    void Latch::wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return ready(); });
+    }
+
+    ThreadPoolBackend::ThreadPoolBackend(size_t threads)
+    {
+        CHECK_GT(threads, 0u);
+        threads_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            threads_.emplace_back([this] { work(); });
+        }
+    }
+
+    ThreadPoolBackend::~ThreadPoolBackend()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+    void ThreadPoolBackend::submit(IoRequest *request)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(request);
+        }
+        cv_.notify_one();
+    }
+
+    void ThreadPoolBackend::wait(Latch &latch)
+    {
+        latch.wait();
+    }
+
+    void ThreadPoolBackend::work()
+    {
+        for (;;)
+        {
+            IoRequest *request;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                if (queue_.empty())
+                {
+                    return;
+                }
+                request = queue_.front();
+                queue_.pop_front();
+            }
+            ssize_t r = runRequest(request);
+            request->result = r == -1 ? -errno : r;
+            request->waiter.resume();
+        }
+    }
+
+    struct UringBackend::Ring
+    {
+        File file;
+
+        void *sqRing = nullptr;
+        size_t sqRingSize = 0;
+        void *cqRing = nullptr;
+        size_t cqRingSize = 0;
+        io_uring_sqe *sqes = nullptr;
+        size_t sqesSize = 0;
+
+        unsigned *sqTail;
+        unsigned sqMask;
+        unsigned sqEntries;
+        unsigned *sqArray;
+
+        unsigned *cqHead;
+        unsigned *cqTail;
+        unsigned cqMask;
+        unsigned cqEntries;
+        io_uring_cqe *cqes;
+
+        ~Ring()
+        {
+            if (sqes != nullptr)
+            {
+                munmap(sqes, sqesSize);
+            }
+            if (cqRing != nullptr && cqRing != sqRing)
+            {
+                munmap(cqRing, cqRingSize);
+            }
+            if (sqRing != nullptr)
+            {
+                munmap(sqRing, sqRingSize);
+            }
+        }
+    };
+
+    UringBackend::UringBackend(unsigned entries)
+            : ring_(new Ring)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = uringSetup(entries, &params);
+        checkUnixError(fd, "io_uring_setup() failed");
+        Ring &ring = *ring_;
+        ring.file = File(fd, true);
+
+        ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            ring.sqRingSize = ring.cqRingSize = std::max(ring.sqRingSize, ring.cqRingSize);
+        }
+        ring.sqRing = mapRing(fd, ring.sqRingSize, IORING_OFF_SQ_RING);
+        ring.cqRing = params.features & IORING_FEAT_SINGLE_MMAP
+                      ? ring.sqRing
+                      : mapRing(fd, ring.cqRingSize, IORING_OFF_CQ_RING);
+        ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        ring.sqes = static_cast<io_uring_sqe *>(mapRing(fd, ring.sqesSize, IORING_OFF_SQES));
+
+        char *sq = static_cast<char *>(ring.sqRing);
+        ring.sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        ring.sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        ring.sqEntries = params.sq_entries;
+        ring.sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+        char *cq = static_cast<char *>(ring.cqRing);
+        ring.cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        ring.cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        ring.cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        ring.cqEntries = params.cq_entries;
+        ring.cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    UringBackend::~UringBackend()
+    {
+        CHECK_EQ(0u, inFlight_) << "io_uring destroyed with requests in flight";
+    }
+
+    bool UringBackend::available()
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = uringSetup(1, &params);
+        if (fd == -1)
+        {
+            return false;
+        }
+        closeNoInt(fd);
+        return true;
+    }
+
+    void UringBackend::submit(IoRequest *request)
+    {
+        // Never have more requests in flight than the completion queue
+        // holds; the rest wait for earlier ones to complete
+        if (inFlight_ == ring_->cqEntries)
+        {
+            backlog_.push_back(request);
+            return;
+        }
+        if (toSubmit_ == ring_->sqEntries)
+        {
+            flush(0);
+        }
+
+        Ring &ring = *ring_;
+        unsigned tail = *ring.sqTail;
+        unsigned index = tail & ring.sqMask;
+        io_uring_sqe *sqe = &ring.sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = request->fd;
+        sqe->user_data = reinterpret_cast<uintptr_t>(request);
+        switch (request->opcode)
+        {
+            case IoOpcode::kRead:
+            case IoOpcode::kWrite:
+                sqe->opcode = request->opcode == IoOpcode::kRead ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe->addr = reinterpret_cast<uintptr_t>(request->buf + request->done);
+                sqe->len = unsigned(std::min(request->size - request->done, kMaxTransfer));
+                sqe->off = uint64_t(request->offset) + request->done;
+                break;
+            case IoOpcode::kFsync:
+            case IoOpcode::kFdatasync:
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = request->opcode == IoOpcode::kFdatasync ? IORING_FSYNC_DATASYNC : 0;
+                break;
+        }
+        ring.sqArray[index] = index;
+        __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++toSubmit_;
+        ++inFlight_;
+    }
+
+    void UringBackend::wait(Latch &latch)
+    {
+        while (!latch.ready())
+        {
+            // Only our own requests can set the latch
+            CHECK(inFlight_ != 0) << "waiting for a task with no I/O in flight";
+            poll(true);
+        }
+    }
+
+    size_t UringBackend::poll(bool wait)
+    {
+        size_t n = reap();
+        if (toSubmit_ != 0 || (n == 0 && wait && inFlight_ != 0))
+        {
+            flush(n == 0 && wait ? 1 : 0);
+            n += reap();
+        }
+        return n;
+    }
+
+    void UringBackend::flush(unsigned minComplete)
+    {
+        for (;;)
+        {
+            int r = uringEnter(ring_->file.fd(), toSubmit_, minComplete,
+                               minComplete != 0 ? IORING_ENTER_GETEVENTS : 0);
+            if (r >= 0)
+            {
+                toSubmit_ -= unsigned(r);
+                if (toSubmit_ == 0)
+                {
+                    return;
+                }
+                // Submission stopped early: the remaining requests are
+                // submitted on the next call
+                minComplete = 0;
+                continue;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EBUSY)
+            {
+                // Out of kernel resources until something completes
+                if (reap() != 0)
+                {
+                    continue;
+                }
+                if (uringEnter(ring_->file.fd(), 0, 1, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR)
+                {
+                    throwSystemError("io_uring_enter() failed");
+                }
+                continue;
+            }
+            throwSystemError("io_uring_enter() failed");
+        }
+    }
+
+    size_t UringBackend::reap()
+    {
+        Ring &ring = *ring_;
+        size_t n = 0;
+        unsigned head = *ring.cqHead;
+        for (;;)
+        {
+            unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+            if (head == tail)
+            {
+                break;
+            }
+            const io_uring_cqe &cqe = ring.cqes[head & ring.cqMask];
+            auto request = reinterpret_cast<IoRequest *>(uintptr_t(cqe.user_data));
+            int res = cqe.res;
+            __atomic_store_n(ring.cqHead, ++head, __ATOMIC_RELEASE);
+            --inFlight_;
+            ++n;
+
+            while (!backlog_.empty() && inFlight_ < ring.cqEntries)
+            {
+                IoRequest *next = backlog_.front();
+                backlog_.pop_front();
+                submit(next);
+            }
+            complete(request, res);
+            // complete() may have submitted and reaped more
+            head = *ring.cqHead;
+        }
+        return n;
+    }
+
+    void UringBackend::complete(IoRequest *request, int res)
+    {
+        if (res == -EINTR)
+        {
+            submit(request);
+            return;
+        }
+        if (res < 0)
+        {
+            request->result = res;
+        } else if (request->opcode == IoOpcode::kRead || request->opcode == IoOpcode::kWrite)
+        {
+            request->done += size_t(res);
+            // Short transfer: continue unless a read hit EOF
+            if (res != 0 && request->done < request->size)
+            {
+                submit(request);
+                return;
+            }
+            request->result = ssize_t(request->done);
+        } else
+        {
+            request->result = 0;
+        }
+        request->waiter.resume();
+    }
+}
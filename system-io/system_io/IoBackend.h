@@ -0,0 +1,326 @@
+#ifndef SYSTEM_IO_IOBACKEND_H
+#define SYSTEM_IO_IOBACKEND_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "system_io/Task.h"
+
+/*
+ * Executors for the coroutine file API (see AsyncFile.h).
+ *
+ * An IoBackend performs IoRequests asynchronously and resumes the coroutine
+ * waiting for each one when it completes:
+ *
+ * - ThreadPoolBackend runs the blocking system calls on worker threads and
+ *   resumes coroutines there.
+ * - UringBackend submits requests to an io_uring and resumes coroutines on
+ *   the thread driving its completion loop, i.e. the one in syncWait().
+ *   Everything using it must run on that one thread.
+ */
+
+namespace sysio
+{
+    enum class IoOpcode : uint8_t
+    {
+        kRead,
+        kWrite,
+        kFsync,
+        kFdatasync,
+    };
+
+    struct IoRequest
+    {
+        IoOpcode opcode;
+        int fd;
+        char *buf;
+        size_t size;
+        off_t offset;
+        // Bytes transferred so far; reads and writes are resubmitted until
+        // complete, or EOF for reads
+        size_t done = 0;
+        // Bytes transferred in total, or -errno
+        ssize_t result = 0;
+        std::coroutine_handle<> waiter{};
+    };
+
+    /*
+     * One-shot event that a thread can block on.
+     */
+    class Latch
+    {
+    public:
+        void set();
+
+        void wait();
+
+        bool ready() const
+        {
+            return ready_.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<bool> ready_{false};
+        std::mutex mutex_;
+        std::condition_variable cv_;
+    };
+
+    class IoBackend
+    {
+    public:
+        virtual ~IoBackend() = default;
+
+        /*
+         * Starts request; when it is done, request->result is set and
+         * request->waiter resumed.
+         */
+        virtual void submit(IoRequest *request) = 0;
+
+        /*
+         * Blocks until latch is set, driving completions if the backend needs
+         * a thread to do that.
+         */
+        virtual void wait(Latch &latch) = 0;
+    };
+
+    class ThreadPoolBackend : public IoBackend
+    {
+    public:
+        explicit ThreadPoolBackend(size_t threads = 4);
+
+        ~ThreadPoolBackend() override;
+
+        void submit(IoRequest *request) override;
+
+        void wait(Latch &latch) override;
+
+    private:
+        void work();
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<IoRequest *> queue_;
+        bool stop_ = false;
+        std::vector<std::thread> threads_;
+    };
+
+    class UringBackend : public IoBackend
+    {
+    public:
+        /*
+         * Throws std::system_error if io_uring is not available (ENOSYS, or
+         * EPERM if disabled by the administrator).
+         */
+        explicit UringBackend(unsigned entries = 256);
+
+        ~UringBackend() override;
+
+        /*
+         * Returns true if this kernel lets us create an io_uring.
+         */
+        static bool available();
+
+        void submit(IoRequest *request) override;
+
+        void wait(Latch &latch) override;
+
+        /*
+         * Submits queued requests and resumes the coroutines of completed
+         * ones, first waiting for at least one completion if wait is true.
+         * Returns the number of completions processed.
+         */
+        size_t poll(bool wait);
+
+    private:
+        struct Ring;
+
+        // Passes queued requests to the kernel, waiting for minComplete
+        // completions
+        void flush(unsigned minComplete);
+
+        // Processes the completion queue; returns the number of entries
+        size_t reap();
+
+        void complete(IoRequest *request, int res);
+
+        std::unique_ptr<Ring> ring_;
+        // Queued but not yet passed to the kernel
+        unsigned toSubmit_ = 0;
+        // Submitted (or queued) and not yet completed
+        size_t inFlight_ = 0;
+        // Waiting for room in the completion queue
+        std::deque<IoRequest *> backlog_;
+    };
+
+    namespace detail
+    {
+        // Coroutine that sets a latch once it is suspended at its end, so
+        // that the waiter may destroy it.  If pending is set, only the last
+        // of that many coroutines sets the latch.
+        struct LatchTask
+        {
+            struct promise_type
+            {
+                Latch *latch = nullptr;
+                std::atomic<size_t> *pending = nullptr;
+
+                LatchTask get_return_object() noexcept
+                {
+                    return LatchTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+
+                std::suspend_always initial_suspend() noexcept
+                {
+                    return {};
+                }
+
+                auto final_suspend() noexcept
+                {
+                    struct SetLatch
+                    {
+                        bool await_ready() noexcept
+                        {
+                            return false;
+                        }
+
+                        void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                        {
+                            auto &p = h.promise();
+                            if (p.pending == nullptr || p.pending->fetch_sub(1) == 1)
+                            {
+                                p.latch->set();
+                            }
+                        }
+
+                        void await_resume() noexcept
+                        {}
+                    };
+                    return SetLatch{};
+                }
+
+                void return_void() noexcept
+                {}
+
+                void unhandled_exception() noexcept
+                {
+                    std::terminate();
+                }
+            };
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        template<class T>
+        struct TaskResult
+        {
+            std::optional<T> value;
+            std::exception_ptr exception;
+
+            T get()
+            {
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct TaskResult<void>
+        {
+            std::exception_ptr exception;
+
+            void get()
+            {}
+        };
+
+        template<class T>
+        LatchTask runTask(Task<T> &task, TaskResult<T> &result)
+        {
+            try
+            {
+                if constexpr (std::is_void<T>::value)
+                {
+                    co_await task;
+                } else
+                {
+                    result.value.emplace(co_await task);
+                }
+            } catch (...)
+            {
+                result.exception = std::current_exception();
+            }
+        }
+    }
+
+    /*
+     * Runs task to completion on backend, blocking the calling thread, and
+     * returns its result or rethrows its exception.
+     */
+    template<class T>
+    T syncWait(IoBackend &backend, Task<T> task)
+    {
+        Latch latch;
+        detail::TaskResult<T> result;
+        detail::LatchTask runner = detail::runTask(task, result);
+        runner.handle.promise().latch = &latch;
+        runner.handle.resume();
+        backend.wait(latch);
+        runner.handle.destroy();
+        if (result.exception)
+        {
+            std::rethrow_exception(result.exception);
+        }
+        return result.get();
+    }
+
+    /*
+     * Runs all tasks concurrently on backend, blocking until every one has
+     * finished, then rethrows the first exception, if any.
+     */
+    inline void syncWaitAll(IoBackend &backend, std::vector<Task<void>> tasks)
+    {
+        Latch latch;
+        std::atomic<size_t> pending(tasks.size());
+        std::vector<detail::TaskResult<void>> results(tasks.size());
+        std::vector<detail::LatchTask> runners;
+        runners.reserve(tasks.size());
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            runners.push_back(detail::runTask(tasks[i], results[i]));
+            runners.back().handle.promise().latch = &latch;
+            runners.back().handle.promise().pending = &pending;
+        }
+        for (auto &runner : runners)
+        {
+            runner.handle.resume();
+        }
+        if (!tasks.empty())
+        {
+            backend.wait(latch);
+        }
+        for (auto &runner : runners)
+        {
+            runner.handle.destroy();
+        }
+        for (auto &result : results)
+        {
+            if (result.exception)
+            {
+                std::rethrow_exception(result.exception);
+            }
+        }
+    }
+}
+
+#endif //SYSTEM_IO_IOBACKEND_H
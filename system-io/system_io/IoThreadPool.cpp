@@ -0,0 +1,259 @@
+#include "system_io/IoThreadPool.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "system_io/Exception.h"
+#include "system_io/FileUtil.h"
+
+namespace sysio
+{
+    namespace
+    {
+        // The pool and worker index of the current thread, if it is a worker
+        thread_local const IoThreadPool *tlsPool = nullptr;
+        thread_local size_t tlsWorker = 0;
+    }
+
+    constexpr size_t IoThreadPool::kNumPriorities;
+
+    IoThreadPool::IoThreadPool()
+            : IoThreadPool(Options())
+    {}
+
+    IoThreadPool::IoThreadPool(const Options &options)
+            : maxQueued_(options.maxQueued)
+    {
+        CHECK_GT(options.threads, 0u);
+        workers_.reserve(options.threads);
+        for (size_t i = 0; i < options.threads; ++i)
+        {
+            workers_.emplace_back(new Worker);
+        }
+        for (size_t i = 0; i < options.threads; ++i)
+        {
+            workers_[i]->thread = std::thread([this, i] { work(i); });
+        }
+    }
+
+    IoThreadPool::~IoThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        idle_.notify_all();
+        space_.notify_all();
+        for (auto &worker : workers_)
+        {
+            worker->thread.join();
+        }
+    }
+
+    int IoThreadPool::enqueue(Func func, Priority priority, bool block)
+    {
+        bool onWorker = tlsPool == this;
+        {
+            // Reserve a place first, so that a worker that finds the queues
+            // empty in the meantime retries instead of sleeping
+            std::unique_lock<std::mutex> lock(mutex_);
+            // Workers keep running tasks until the queues are empty, so
+            // tasks can still submit while the pool is being destroyed
+            if (stop_ && !onWorker)
+            {
+                return ECANCELED;
+            }
+            if (maxQueued_ != 0 && queued_ >= maxQueued_ && !onWorker)
+            {
+                if (!block)
+                {
+                    ++rejectedSubmits_;
+                    return EAGAIN;
+                }
+                ++blockedSubmits_;
+                space_.wait(lock, [this] { return stop_ || queued_ < maxQueued_; });
+                if (stop_)
+                {
+                    return ECANCELED;
+                }
+            }
+            ++queued_;
+            maxQueuedSeen_ = std::max(maxQueuedSeen_, queued_);
+        }
+
+        size_t target = onWorker ? tlsWorker : nextWorker_.fetch_add(1) % workers_.size();
+        Worker &worker = *workers_[target];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.queues[size_t(priority)].push_back(std::move(func));
+        }
+        idle_.notify_one();
+        return 0;
+    }
+
+    bool IoThreadPool::dequeue(size_t self, Func &func, bool &stolen)
+    {
+        const size_t n = workers_.size();
+        for (size_t p = 0; p < kNumPriorities; ++p)
+        {
+            for (size_t k = 0; k < n; ++k)
+            {
+                Worker &worker = *workers_[(self + k) % n];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                auto &queue = worker.queues[p];
+                if (queue.empty())
+                {
+                    continue;
+                }
+                // The owner runs its tasks in order; thieves take the ones
+                // it would reach last
+                if (k == 0)
+                {
+                    func = std::move(queue.front());
+                    queue.pop_front();
+                } else
+                {
+                    func = std::move(queue.back());
+                    queue.pop_back();
+                }
+                stolen = k != 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void IoThreadPool::work(size_t self)
+    {
+        tlsPool = this;
+        tlsWorker = self;
+        for (;;)
+        {
+            Func func;
+            bool stolen = false;
+            if (dequeue(self, func, stolen))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    --queued_;
+                }
+                if (maxQueued_ != 0)
+                {
+                    space_.notify_one();
+                }
+                // Counted first, so a task's result is never visible before
+                // the task is
+                executed_.fetch_add(1, std::memory_order_relaxed);
+                if (stolen)
+                {
+                    steals_.fetch_add(1, std::memory_order_relaxed);
+                }
+                func();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (queued_ != 0)
+            {
+                // Reserved but not pushed yet
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
+            }
+            if (stop_)
+            {
+                return;
+            }
+            idle_.wait(lock, [this] { return stop_ || queued_ != 0; });
+        }
+    }
+
+    IoThreadPool::Stats IoThreadPool::stats() const
+    {
+        Stats stats;
+        stats.queuedPerWorker.reserve(workers_.size());
+        for (auto &worker : workers_)
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            size_t queued = 0;
+            for (auto &queue : worker->queues)
+            {
+                queued += queue.size();
+            }
+            stats.queuedPerWorker.push_back(queued);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.queued = queued_;
+        stats.maxQueued = maxQueuedSeen_;
+        stats.executed = executed_.load(std::memory_order_relaxed);
+        stats.steals = steals_.load(std::memory_order_relaxed);
+        stats.blockedSubmits = blockedSubmits_;
+        stats.rejectedSubmits = rejectedSubmits_;
+        return stats;
+    }
+
+    std::future<std::string> readFileAsync(
+            IoThreadPool &pool,
+            std::string fileName,
+            size_t numBytes,
+            IoThreadPool::Priority priority)
+    {
+        return pool.submit([fileName = std::move(fileName), numBytes] {
+            std::string out;
+            if (!readFile(fileName.c_str(), out, numBytes))
+            {
+                throwSystemError("readFile() failed for " + fileName);
+            }
+            return out;
+        }, priority);
+    }
+
+    std::future<void> writeFileAsync(
+            IoThreadPool &pool,
+            std::string data,
+            std::string fileName,
+            int flags,
+            mode_t mode,
+            IoThreadPool::Priority priority)
+    {
+        return pool.submit([data = std::move(data), fileName = std::move(fileName), flags, mode] {
+            if (!writeFile(data, fileName.c_str(), flags, mode))
+            {
+                throwSystemError("writeFile() failed for " + fileName);
+            }
+        }, priority);
+    }
+
+    std::future<void> writeFileAtomicAsync(
+            IoThreadPool &pool,
+            std::string fileName,
+            std::string data,
+            mode_t permissions,
+            IoThreadPool::Priority priority)
+    {
+        return pool.submit([fileName = std::move(fileName), data = std::move(data), permissions]() mutable {
+            iovec iov;
+            iov.iov_base = &data[0];
+            iov.iov_len = data.size();
+            writeFileAtomic(fileName, &iov, 1, permissions);
+        }, priority);
+    }
+
+    std::future<size_t> preadFullAsync(
+            IoThreadPool &pool,
+            int fd,
+            void *buf,
+            size_t n,
+            off_t offset,
+            IoThreadPool::Priority priority)
+    {
+        return pool.submit([fd, buf, n, offset] {
+            ssize_t r = preadFull(fd, buf, n, offset);
+            checkUnixError(r, "preadFull() failed");
+            return size_t(r);
+        }, priority);
+    }
+}
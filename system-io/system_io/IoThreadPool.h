@@ -0,0 +1,221 @@
+#ifndef SYSTEM_IO_IOTHREADPOOL_H
+#define SYSTEM_IO_IOTHREADPOOL_H
+
+#include <sys/types.h>
+#include <fcntl.h>
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "system_io/Exception.h"
+
+/*
+ * Thread pool for offloading blocking system calls (file reads and writes,
+ * fsync, rename...) from threads that must not block.
+ *
+ * Each worker has its own queue per priority; tasks submitted from outside
+ * the pool are spread over the workers round-robin, tasks submitted by a
+ * worker go to its own queue, and idle workers steal from the others.  A
+ * worker always runs the most urgent task it can find, its own or stolen.
+ *
+ * The number of queued tasks is bounded: submit() blocks while the pool is
+ * full (backpressure), trySubmit() fails instead.  Workers never block when
+ * submitting to their own pool, which could deadlock.
+ */
+
+namespace sysio
+{
+    class IoThreadPool
+    {
+    public:
+        enum class Priority
+        {
+            kHigh,
+            kNormal,
+            kLow,
+        };
+
+        static constexpr size_t kNumPriorities = 3;
+
+        struct Options
+        {
+            size_t threads = 4;
+            // Maximum number of queued (not yet running) tasks; 0 for no limit
+            size_t maxQueued = 4096;
+        };
+
+        struct Stats
+        {
+            // Tasks queued now, in total and per worker
+            size_t queued = 0;
+            std::vector<size_t> queuedPerWorker;
+            // Highest number of tasks queued at once
+            size_t maxQueued = 0;
+            // Tasks started, and how many of those were stolen
+            uint64_t executed = 0;
+            uint64_t steals = 0;
+            // Calls to submit() that had to wait for room in the queues, and
+            // calls to trySubmit() that failed for lack of it
+            uint64_t blockedSubmits = 0;
+            uint64_t rejectedSubmits = 0;
+        };
+
+        IoThreadPool();
+
+        explicit IoThreadPool(const Options &options);
+
+        IoThreadPool(const IoThreadPool &) = delete;
+
+        IoThreadPool &operator=(const IoThreadPool &) = delete;
+
+        /*
+         * Runs the tasks still queued, and those they submit, then joins the
+         * workers.
+         */
+        ~IoThreadPool();
+
+        /*
+         * Queues f() to run on a worker, blocking while the pool is full.
+         * The future holds the result, or the exception f threw.
+         *
+         * Tasks can submit at any time, also while the destructor runs.
+         * Other threads cannot once the destructor started: f does not run,
+         * and the future holds a std::system_error with ECANCELED.
+         */
+        template<class F>
+        std::future<typename std::result_of<F()>::type> submit(F f, Priority priority = Priority::kNormal)
+        {
+            return add(std::move(f), priority, true);
+        }
+
+        /*
+         * Like submit(), but returns an invalid future (!valid()) instead of
+         * blocking if the pool is full.
+         */
+        template<class F>
+        std::future<typename std::result_of<F()>::type> trySubmit(F f, Priority priority = Priority::kNormal)
+        {
+            return add(std::move(f), priority, false);
+        }
+
+        size_t threads() const
+        {
+            return workers_.size();
+        }
+
+        Stats stats() const;
+
+    private:
+        typedef std::function<void()> Func;
+
+        struct Worker
+        {
+            mutable std::mutex mutex;
+            std::deque<Func> queues[kNumPriorities];
+            std::thread thread;
+        };
+
+        template<class F>
+        std::future<typename std::result_of<F()>::type> add(F f, Priority priority, bool block)
+        {
+            typedef typename std::result_of<F()>::type R;
+            auto task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+            std::future<R> future = task->get_future();
+            int err = enqueue([task] { (*task)(); }, priority, block);
+            if (err == EAGAIN)
+            {
+                return std::future<R>();
+            }
+            if (err != 0)
+            {
+                std::promise<R> failed;
+                failed.set_exception(std::make_exception_ptr(
+                        makeSystemErrorExplicit(err, "submitting to a pool being destroyed")));
+                return failed.get_future();
+            }
+            return future;
+        }
+
+        // Returns 0, EAGAIN if the pool is full and !block, or ECANCELED if
+        // the pool is being destroyed and the caller is not one of its
+        // workers
+        int enqueue(Func func, Priority priority, bool block);
+
+        // Pops the most urgent task, preferring worker self's own queues;
+        // sets stolen if it came from another worker
+        bool dequeue(size_t self, Func &func, bool &stolen);
+
+        void work(size_t self);
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+        size_t maxQueued_;
+        std::atomic<size_t> nextWorker_{0};
+
+        // Guards sleeping and waking: workers wait on idle_ for tasks,
+        // blocked submitters on space_ for room
+        mutable std::mutex mutex_;
+        std::condition_variable idle_;
+        std::condition_variable space_;
+        size_t queued_ = 0;
+        bool stop_ = false;
+
+        size_t maxQueuedSeen_ = 0;
+        std::atomic<uint64_t> executed_{0};
+        std::atomic<uint64_t> steals_{0};
+        uint64_t blockedSubmits_ = 0;
+        uint64_t rejectedSubmits_ = 0;
+    };
+
+    /*
+     * Asynchronous versions of the FileUtil.h functions, run on pool.  Each
+     * takes ownership of its data, and the future throws std::system_error
+     * if the operation fails.
+     */
+    std::future<std::string> readFileAsync(
+            IoThreadPool &pool,
+            std::string fileName,
+            size_t numBytes = std::numeric_limits<size_t>::max(),
+            IoThreadPool::Priority priority = IoThreadPool::Priority::kNormal);
+
+    std::future<void> writeFileAsync(
+            IoThreadPool &pool,
+            std::string data,
+            std::string fileName,
+            int flags = O_WRONLY | O_CREAT | O_TRUNC,
+            mode_t mode = 0666,
+            IoThreadPool::Priority priority = IoThreadPool::Priority::kNormal);
+
+    std::future<void> writeFileAtomicAsync(
+            IoThreadPool &pool,
+            std::string fileName,
+            std::string data,
+            mode_t permissions = 0644,
+            IoThreadPool::Priority priority = IoThreadPool::Priority::kNormal);
+
+    /*
+     * The future holds the number of bytes read, less than n only at EOF.
+     * buf must stay valid until the future is ready.
+     */
+    std::future<size_t> preadFullAsync(
+            IoThreadPool &pool,
+            int fd,
+            void *buf,
+            size_t n,
+            off_t offset,
+            IoThreadPool::Priority priority = IoThreadPool::Priority::kNormal);
+}
+
+#endif //SYSTEM_IO_IOTHREADPOOL_H
@@ -0,0 +1,334 @@
+#include "system_io/LineIndex.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <thread>
+
+#include <glog/logging.h>
+
+#include "system_io/Crc32c.h"
+#include "system_io/Exception.h"
+#include "system_io/FileUtil.h"
+#include "system_io/Newlines.h"
+#include "system_io/detail/Clock.h"
+
+namespace sysio
+{
+    namespace
+    {
+        const char kMagic[8] = {'S', 'Y', 'S', 'I', 'O', 'L', 'I', 'X'};
+        constexpr uint32_t kVersion = 1;
+        constexpr size_t kHeaderSize = 56;
+        // Bytes at the end of the indexed data whose checksum tells whether
+        // the file was only appended to
+        constexpr size_t kTailSize = 4096;
+        // Unit of reads when looking for a line from a recorded offset
+        constexpr size_t kReadSize = 64 << 10;
+
+        template<class T>
+        T loadLE(const char *p)
+        {
+            T v;
+            memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            v = sizeof(T) == 4 ? T(__builtin_bswap32(uint32_t(v)))
+                               : T(__builtin_bswap64(uint64_t(v)));
+#endif
+            return v;
+        }
+
+        template<class T>
+        void storeLE(char *p, T v)
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            v = sizeof(T) == 4 ? T(__builtin_bswap32(uint32_t(v)))
+                               : T(__builtin_bswap64(uint64_t(v)));
+#endif
+            memcpy(p, &v, sizeof(v));
+        }
+
+        uint64_t mtimeNanos(const struct stat &st)
+        {
+            return uint64_t(st.st_mtim.tv_sec) * 1000000000u + uint64_t(st.st_mtim.tv_nsec);
+        }
+    }
+
+    LineIndex::LineIndex(const std::string &path)
+            : LineIndex(path, Options())
+    {}
+
+    LineIndex::LineIndex(const std::string &path, const Options &options)
+            : indexPath_(options.indexPath.empty() ? path + ".lineidx" : options.indexPath),
+              options_(options),
+              file_(path.c_str(), O_RDONLY | O_CLOEXEC)
+    {
+        CHECK_GT(options_.interval, 0u);
+        CHECK_GT(options_.chunkSize, 0u);
+        if (options_.threads == 0)
+        {
+            options_.threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        clear();
+        stats_.loaded = load();
+        refresh();
+    }
+
+    void LineIndex::clear()
+    {
+        offsets_.assign(1, 0);
+        lines_ = 0;
+        size_ = 0;
+        mtime_ = 0;
+        tail_ = 0;
+    }
+
+    bool LineIndex::load()
+    {
+        std::string data;
+        if (!readFile(indexPath_.c_str(), data) || data.size() < kHeaderSize + 4)
+        {
+            return false;
+        }
+        const char *p = data.data();
+        uint64_t count = loadLE<uint64_t>(p + 48);
+        if (memcmp(p, kMagic, sizeof(kMagic)) != 0 ||
+            loadLE<uint32_t>(p + 8) != kVersion ||
+            loadLE<uint32_t>(p + 12) != options_.interval ||
+            count > (data.size() - kHeaderSize - 4) / 8 ||
+            data.size() != kHeaderSize + 8 * count + 4 ||
+            loadLE<uint32_t>(p + data.size() - 4) != crc32c(p, data.size() - 4))
+        {
+            return false;
+        }
+        uint64_t lines = loadLE<uint64_t>(p + 32);
+        if (count != lines / options_.interval + 1)
+        {
+            return false;
+        }
+        size_ = loadLE<uint64_t>(p + 16);
+        mtime_ = loadLE<uint64_t>(p + 24);
+        lines_ = lines;
+        tail_ = loadLE<uint32_t>(p + 40);
+        offsets_.resize(count);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            offsets_[i] = loadLE<uint64_t>(p + kHeaderSize + 8 * i);
+        }
+        return true;
+    }
+
+    void LineIndex::save()
+    {
+        std::string data(kHeaderSize + 8 * offsets_.size() + 4, '\0');
+        char *p = &data[0];
+        memcpy(p, kMagic, sizeof(kMagic));
+        storeLE<uint32_t>(p + 8, kVersion);
+        storeLE<uint32_t>(p + 12, options_.interval);
+        storeLE<uint64_t>(p + 16, size_);
+        storeLE<uint64_t>(p + 24, mtime_);
+        storeLE<uint64_t>(p + 32, lines_);
+        storeLE<uint32_t>(p + 40, tail_);
+        storeLE<uint32_t>(p + 44, 0);
+        storeLE<uint64_t>(p + 48, offsets_.size());
+        for (size_t i = 0; i < offsets_.size(); ++i)
+        {
+            storeLE<uint64_t>(p + kHeaderSize + 8 * i, offsets_[i]);
+        }
+        storeLE<uint32_t>(p + data.size() - 4, crc32c(p, data.size() - 4));
+        iovec iov = {p, data.size()};
+        writeFileAtomic(indexPath_, &iov, 1, options_.permissions);
+    }
+
+    uint32_t LineIndex::tailChecksum(uint64_t size) const
+    {
+        char buf[kTailSize];
+        size_t n = size_t(std::min<uint64_t>(size, kTailSize));
+        ssize_t r = preadFull(file_.fd(), buf, n, off_t(size - n));
+        checkUnixError(r, "LineIndex: pread() failed");
+        return crc32c(buf, size_t(r));
+    }
+
+    bool LineIndex::refresh()
+    {
+        struct stat st;
+        checkUnixError(fstat(file_.fd(), &st), "LineIndex: fstat() failed");
+        const uint64_t fileSize = uint64_t(st.st_size);
+        const uint64_t mtime = mtimeNanos(st);
+        if (fileSize == size_ && mtime == mtime_)
+        {
+            return false;
+        }
+
+        if (size_ != 0 && fileSize > size_ && tailChecksum(size_) == tail_)
+        {
+            ++stats_.extensions;
+        } else
+        {
+            clear();
+            ++stats_.rebuilds;
+        }
+        scan(fileSize);
+        mtime_ = mtime;
+        tail_ = tailChecksum(size_);
+        if (options_.save)
+        {
+            save();
+        }
+        return true;
+    }
+
+    void LineIndex::scan(uint64_t fileSize)
+    {
+        uint64_t start = detail::nowNanos();
+        posix_fadvise(file_.fd(), off_t(size_), 0, POSIX_FADV_SEQUENTIAL);
+        const uint64_t interval = options_.interval;
+        const size_t chunkSize = options_.chunkSize;
+        std::vector<std::vector<char>> chunks(options_.threads);
+        std::vector<size_t> counts(chunks.size());
+        std::vector<std::vector<uint64_t>> found(chunks.size());
+        std::vector<std::future<void>> futures;
+        while (size_ < fileSize)
+        {
+            // Read and count newlines
+            size_t n = 0;
+            for (; n < chunks.size() && size_ + n * chunkSize < fileSize; ++n)
+            {
+                uint64_t offset = size_ + n * chunkSize;
+                chunks[n].resize(size_t(std::min<uint64_t>(chunkSize, fileSize - offset)));
+                futures.push_back(std::async(std::launch::async, [&, n, offset] {
+                    std::vector<char> &chunk = chunks[n];
+                    ssize_t r = preadFull(file_.fd(), chunk.data(), chunk.size(), off_t(offset));
+                    checkUnixError(r, "LineIndex: pread() failed");
+                    if (size_t(r) != chunk.size())
+                    {
+                        throwSystemErrorExplicit(ESTALE, "LineIndex: file truncated while indexing");
+                    }
+                    counts[n] = countNewlines(chunk.data(), chunk.size());
+                }));
+            }
+            for (auto &future : futures)
+            {
+                future.get();
+            }
+            futures.clear();
+
+            // Now that the number of lines before each chunk is known, find
+            // the lines to record
+            uint64_t lines = lines_;
+            for (size_t i = 0; i < n; ++i)
+            {
+                futures.push_back(std::async(std::launch::async, [&, i, lines] {
+                    const std::vector<char> &chunk = chunks[i];
+                    const uint64_t offset = size_ + i * chunkSize;
+                    found[i].clear();
+                    uint64_t k = interval - lines % interval;
+                    size_t pos = 0;
+                    for (;;)
+                    {
+                        ssize_t nl = findNewline(chunk.data() + pos, chunk.size() - pos, &k);
+                        if (nl == -1)
+                        {
+                            break;
+                        }
+                        pos += size_t(nl) + 1;
+                        found[i].push_back(offset + pos);
+                        k = interval;
+                    }
+                }));
+                lines += counts[i];
+            }
+            for (auto &future : futures)
+            {
+                future.get();
+            }
+            futures.clear();
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                offsets_.insert(offsets_.end(), found[i].begin(), found[i].end());
+                lines_ += counts[i];
+                size_ += chunks[i].size();
+                stats_.scannedBytes += chunks[i].size();
+            }
+        }
+        DCHECK_EQ(offsets_.size(), lines_ / interval + 1);
+        stats_.scanNanos += detail::nowNanos() - start;
+    }
+
+    uint64_t LineIndex::offsetOf(uint64_t n) const
+    {
+        CHECK_LE(n, lines_);
+        uint64_t offset = offsets_[n / options_.interval];
+        uint64_t k = n % options_.interval;
+        char buf[kReadSize];
+        while (k != 0)
+        {
+            size_t len = size_t(std::min<uint64_t>(sizeof(buf), size_ - offset));
+            ssize_t r = preadFull(file_.fd(), buf, len, off_t(offset));
+            checkUnixError(r, "LineIndex: pread() failed");
+            if (r == 0)
+            {
+                throwSystemErrorExplicit(ESTALE, "LineIndex: file changed since indexed");
+            }
+            ssize_t nl = findNewline(buf, size_t(r), &k);
+            if (nl != -1)
+            {
+                return offset + uint64_t(nl) + 1;
+            }
+            offset += uint64_t(r);
+        }
+        return offset;
+    }
+
+    uint64_t LineIndex::seekToLine(uint64_t n)
+    {
+        uint64_t offset = offsetOf(n);
+        checkUnixError(lseek(file_.fd(), off_t(offset), SEEK_SET), "LineIndex: lseek() failed");
+        return offset;
+    }
+
+    size_t LineIndex::readLines(uint64_t first, size_t count, std::string &out) const
+    {
+        if (first > lines_ || count == 0)
+        {
+            return 0;
+        }
+        uint64_t offset = offsetOf(first);
+        uint64_t k = count;
+        size_t appended = 0;
+        while (offset < size_)
+        {
+            size_t len = size_t(std::min<uint64_t>(kReadSize, size_ - offset));
+            size_t old = out.size();
+            out.resize(old + len);
+            ssize_t r = preadFull(file_.fd(), &out[old], len, off_t(offset));
+            if (r != ssize_t(len))
+            {
+                out.resize(old);
+                checkUnixError(r, "LineIndex: pread() failed");
+                throwSystemErrorExplicit(ESTALE, "LineIndex: file changed since indexed");
+            }
+            ssize_t nl = findNewline(&out[old], len, &k);
+            if (nl != -1)
+            {
+                out.resize(old + size_t(nl) + 1);
+                return count;
+            }
+            offset += len;
+            appended += len;
+        }
+        // The end of the data: a last line without a newline counts
+        size_t lines = size_t(count - k);
+        if (appended != 0 && out.back() != '\n')
+        {
+            ++lines;
+        }
+        return lines;
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef SYSTEM_IO_LINEINDEX_H
+#define SYSTEM_IO_LINEINDEX_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "system_io/File.h"
+
+/*
+ * Random access by line number into large text files.
+ *
+ * A LineIndex records the byte offset of every Options::interval-th line of
+ * a file, and keeps them in a sidecar file (path + ".lineidx" by default)
+ * so that the next process opening the file does not scan it again.  Line n
+ * is then found by reading from the offset of line n - n % interval: at
+ * most interval lines, whatever the size of the file.
+ *
+ * Building the index reads the file once, Options::threads chunks at a
+ * time: each thread counts the newlines of its chunk with SIMD compares, and
+ * once the line number at the start of every chunk is known, picks out the
+ * offsets to record from the chunk still in memory.
+ *
+ * The sidecar records the size and modification time of the file it was
+ * built from, and a checksum of the end of the indexed data.  If the file
+ * has only grown since (the end still matches), the index is extended over
+ * the new bytes; if it changed in any other way, the index is rebuilt.
+ * refresh() does the same for a file appended to while it is open.  The
+ * sidecar is replaced with writeFileAtomic() whenever the index changes.
+ *
+ * Lines are numbered from 0 and end with '\n'.  lines() counts complete
+ * lines; a last line without a newline is line lines(), and can be read too.
+ *
+ * Not thread-safe.
+ *
+ * Example:
+ *   LineIndex index("events.log");
+ *   std::string lines;
+ *   index.readLines(1000000000, 10, lines);
+ */
+
+namespace sysio
+{
+    class LineIndex
+    {
+    public:
+        struct Options
+        {
+            // Lines between recorded offsets
+            uint32_t interval = 1024;
+            // Threads scanning the file; 0 for one per CPU
+            size_t threads = 0;
+            // Bytes each thread scans at a time
+            size_t chunkSize = 8 << 20;
+            // Sidecar file; path + ".lineidx" if empty
+            std::string indexPath;
+            // Write the sidecar when the index changes
+            bool save = true;
+            mode_t permissions = 0644;
+        };
+
+        struct Stats
+        {
+            // Whether the index was loaded from the sidecar, and how often
+            // it was extended or rebuilt since
+            bool loaded = false;
+            uint64_t extensions = 0;
+            uint64_t rebuilds = 0;
+            // Bytes of the file scanned for newlines, and the time it took
+            uint64_t scannedBytes = 0;
+            uint64_t scanNanos = 0;
+        };
+
+        explicit LineIndex(const std::string &path);
+
+        /*
+         * Opens path, loads its index from the sidecar, and extends or
+         * rebuilds it as needed.  Throws on error; a missing, stale or
+         * corrupt sidecar is not an error.
+         */
+        LineIndex(const std::string &path, const Options &options);
+
+        LineIndex(const LineIndex &) = delete;
+
+        LineIndex &operator=(const LineIndex &) = delete;
+
+        /*
+         * Brings the index up to date with the file.  Returns true if it
+         * changed (was extended or rebuilt).
+         */
+        bool refresh();
+
+        // Complete lines in the indexed part of the file
+        uint64_t lines() const
+        {
+            return lines_;
+        }
+
+        // Bytes indexed (the size of the file when last refreshed)
+        uint64_t size() const
+        {
+            return size_;
+        }
+
+        /*
+         * Byte offset of the start of line n; n <= lines().  offsetOf(lines())
+         * is the end of the last complete line.
+         */
+        uint64_t offsetOf(uint64_t n) const;
+
+        /*
+         * Moves the file offset of fd() to the start of line n, for reading
+         * on with LineReader.  Returns the offset.
+         */
+        uint64_t seekToLine(uint64_t n);
+
+        /*
+         * Appends lines [first, first + count) to out, with their newlines,
+         * stopping at the end of the indexed data.  Returns the number of
+         * lines appended; a last line without a newline counts.
+         */
+        size_t readLines(uint64_t first, size_t count, std::string &out) const;
+
+        int fd() const
+        {
+            return file_.fd();
+        }
+
+        Stats stats() const
+        {
+            return stats_;
+        }
+
+    private:
+        // Loads the sidecar; false if it is missing, corrupt or for another
+        // interval
+        bool load();
+
+        void save();
+
+        // Indexes [size_, fileSize) of the file
+        void scan(uint64_t fileSize);
+
+        // Checksum of the end of the indexed data
+        uint32_t tailChecksum(uint64_t size) const;
+
+        void clear();
+
+        std::string indexPath_;
+        Options options_;
+        File file_;
+        // offsets_[i] is the offset of line i * interval
+        std::vector<uint64_t> offsets_;
+        uint64_t lines_ = 0;
+        uint64_t size_ = 0;
+        // Modification time of the file, and tailChecksum(size_)
+        uint64_t mtime_ = 0;
+        uint32_t tail_ = 0;
+        Stats stats_;
+    };
+}
+
+#endif //SYSTEM_IO_LINEINDEX_H
@@ -1,22 +1,95 @@
 #include "LineReader.h"
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <new>
 #include "FileUtil.h"
+#include "ByteSource.h"
+#include <glog/logging.h>
 
 namespace sysio
 {
     LineReader::LineReader(int fd, char *buf, size_t bufSize)
             : fd_(fd),
+              source_(nullptr),
               buf_(buf),
               bufEnd_(buf_ + bufSize),
+              growable_(false),
+              options_(),
+              quietCalls_(0),
               bol_(buf),
               eol_(buf),
               end_(buf),
+              unread_(nullptr),
               state_(kReading)
+    {
+        stats_.peakCapacity = bufSize;
+    }
+
+    LineReader::LineReader(ByteSource &source, char *buf, size_t bufSize)
+            : fd_(-1),
+              source_(&source),
+              buf_(buf),
+              bufEnd_(buf_ + bufSize),
+              growable_(false),
+              options_(),
+              quietCalls_(0),
+              bol_(buf),
+              eol_(buf),
+              end_(buf),
+              unread_(nullptr),
+              state_(kReading)
+    {
+        stats_.peakCapacity = bufSize;
+    }
+
+    LineReader::LineReader(int fd, const Options &options)
+            : LineReader(fd, nullptr, options)
+    {}
+
+    LineReader::LineReader(ByteSource &source, const Options &options)
+            : LineReader(-1, &source, options)
     {}
 
+    LineReader::LineReader(int fd, ByteSource *source, const Options &options)
+            : fd_(fd),
+              source_(source),
+              buf_(static_cast<char *>(malloc(options.initialSize))),
+              bufEnd_(buf_ + options.initialSize),
+              growable_(true),
+              options_(options),
+              quietCalls_(0),
+              bol_(buf_),
+              eol_(buf_),
+              end_(buf_),
+              unread_(nullptr),
+              state_(kReading)
+    {
+        CHECK_GT(options.initialSize, 0u);
+        CHECK_GE(options.maxSize, options.initialSize);
+        CHECK_GE(options.growthFactor, 2u);
+        if (!buf_)
+        {
+            throw std::bad_alloc();
+        }
+        stats_.peakCapacity = options.initialSize;
+    }
+
+    LineReader::~LineReader()
+    {
+        if (growable_)
+        {
+            free(buf_);
+        }
+    }
+
     LineReader::State LineReader::readLine(std::string &line)
     {
         bol_ = eol_; // Start past what we already returned
+        if (shouldShrink())
+        {
+            compact();
+        }
         for (;;)
         {
             // Search for newline
@@ -25,38 +98,171 @@ namespace sysio
             {
                 eol_ = newline + 1;
                 break;
-            } else if (state_ != kReading || (bol_ == buf_ && end_ == bufEnd_))
+            } else if (state_ != kReading)
             {
-                // If the buffer is full with one line (line too long), or we're
-                // at the end of the file, return what we have.
+                // At the end of the file, return what we have.
                 eol_ = end_;
                 break;
+            } else if (bol_ == buf_ && end_ == bufEnd_)
+            {
+                // The buffer is full with one line (line too long): grow it if
+                // we can, or return what we have.
+                if (!grow())
+                {
+                    ++stats_.splitLines;
+                    eol_ = end_;
+                    break;
+                }
+            } else
+            {
+                // We don't have a full line in the buffer, but we have room to
+                // read.  Move to the beginning of the buffer.
+                compact();
             }
 
-            // We don't have a full line in the buffer, but we have room to read.
-            // Move to the beginning of the buffer.
-            memmove(buf_, eol_, end_ - eol_);
-            end_ -= (eol_ - buf_);
-            bol_ = buf_;
             eol_ = end_;
+            refill();
+        }
 
-            // Refill
-            ssize_t available = bufEnd_ - end_;
-            ssize_t n = sysio::readFull(fd_, end_, available);
-            if (n < 0)
+        line.assign(bol_, eol_);
+        returned(size_t(eol_ - bol_));
+        return eol_ != bol_ ? kReading : state_;
+    }
+
+    LineReader::State LineReader::readLines(const char **begin, const char **end)
+    {
+        // Start past what we already returned, unless some of it was given back
+        bol_ = unread_ ? unread_ : eol_;
+        unread_ = nullptr;
+        if (shouldShrink())
+        {
+            compact();
+        }
+        char *searchFrom = eol_;
+        for (;;)
+        {
+            // Search for the last newline
+            char *newline = static_cast<char *>(memrchr(searchFrom, '\n', end_ - searchFrom));
+            if (newline)
             {
-                state_ = kError;
-                n = 0;
-            } else if (n < available)
+                eol_ = newline + 1;
+                break;
+            } else if (state_ != kReading)
             {
-                state_ = kEof;
+                eol_ = end_;
+                break;
+            } else if (bol_ == buf_ && end_ == bufEnd_)
+            {
+                if (!grow())
+                {
+                    ++stats_.splitLines;
+                    eol_ = end_;
+                    break;
+                }
+            } else
+            {
+                // Move what we have to the beginning of the buffer and read
+                // more; only the new bytes need to be searched.
+                compact();
             }
-            end_ += n;
+
+            searchFrom = end_;
+            refill();
         }
 
-        line.assign(bol_, eol_);
+        *begin = bol_;
+        *end = eol_;
+        returned(size_t(eol_ - bol_));
         return eol_ != bol_ ? kReading : state_;
     }
-}
 
+    void LineReader::unreadFrom(const char *p)
+    {
+        CHECK(p >= bol_ && p <= eol_) << "unreadFrom() outside the last block";
+        unread_ = bol_ + (p - bol_);
+    }
+
+    void LineReader::compact()
+    {
+        size_t size = size_t(end_ - bol_);
+        memmove(buf_, bol_, size);
+        eol_ = buf_ + (eol_ - bol_);
+        end_ = buf_ + size;
+        bol_ = buf_;
+
+        if (shouldShrink())
+        {
+            char *p = static_cast<char *>(realloc(buf_, options_.initialSize));
+            if (p)
+            {
+                rebase(p, options_.initialSize);
+                ++stats_.shrinks;
+            }
+        }
+    }
+
+    bool LineReader::shouldShrink() const
+    {
+        // The data left must fit, with room to read more
+        return growable_ && capacity() > options_.initialSize &&
+               quietCalls_ >= options_.shrinkAfter &&
+               size_t(end_ - bol_) < options_.initialSize;
+    }
+
+    bool LineReader::grow()
+    {
+        if (!growable_ || capacity() >= options_.maxSize)
+        {
+            return false;
+        }
+        // Geometric growth, so the copies realloc() may make cost O(1) per
+        // byte over the reader's life
+        size_t size = std::min(capacity() * options_.growthFactor, options_.maxSize);
+        char *p = static_cast<char *>(realloc(buf_, size));
+        if (!p)
+        {
+            return false;
+        }
+        rebase(p, size);
+        ++stats_.grows;
+        stats_.peakCapacity = std::max(stats_.peakCapacity, size);
+        quietCalls_ = 0;
+        return true;
+    }
 
+    void LineReader::rebase(char *p, size_t size)
+    {
+        bol_ = p + (bol_ - buf_);
+        eol_ = p + (eol_ - buf_);
+        end_ = p + (end_ - buf_);
+        buf_ = p;
+        bufEnd_ = p + size;
+    }
+
+    void LineReader::returned(size_t n)
+    {
+        if (n > options_.initialSize)
+        {
+            quietCalls_ = 0;
+        } else
+        {
+            ++quietCalls_;
+        }
+    }
+
+    void LineReader::refill()
+    {
+        ssize_t available = bufEnd_ - end_;
+        ssize_t n = source_ ? source_->read(end_, available)
+                            : sysio::readFull(fd_, end_, available);
+        if (n < 0)
+        {
+            state_ = kError;
+            n = 0;
+        } else if (n < available)
+        {
+            state_ = kEof;
+        }
+        end_ += n;
+    }
+}
@@ -2,23 +2,67 @@
 #define SYSTEM_IO_LINEREADER_H
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace sysio {
+    class ByteSource;
+
     /*
      * Async-signal-safe line reader.
+     *
+     * With a user-provided buffer, lines longer than the buffer are returned
+     * in pieces.  Alternatively, the reader can own a buffer that grows
+     * geometrically (up to a cap) to hold each line whole, and shrinks back
+     * once long lines stop coming; that mode allocates, so it is not
+     * async-signal-safe.
      */
     class LineReader {
     public:
+        struct Options {
+            // Size of the buffer normally, and the most it grows to; lines
+            // longer than maxSize are still split
+            size_t initialSize = 64 * 1024;
+            size_t maxSize = 64 * 1024 * 1024;
+            size_t growthFactor = 2;
+            // Shrink back to initialSize after this many calls in a row that
+            // returned at most initialSize bytes
+            size_t shrinkAfter = 64;
+        };
+
+        struct Stats {
+            uint64_t grows = 0;
+            uint64_t shrinks = 0;
+            // Lines returned in pieces because they did not fit the buffer
+            uint64_t splitLines = 0;
+            size_t peakCapacity = 0;
+        };
+
         /*
          * Create a line reader that reads into a user-provided buffer (of size
          * bufSize).
          */
         LineReader(int fd, char* buf, size_t bufSize);
 
+        /*
+         * Create a line reader that pulls bytes from source instead of a file
+         * descriptor (e.g. a decompressing source).  The source is not owned.
+         * Async-signal-safe only if source->read() is.
+         */
+        LineReader(ByteSource& source, char* buf, size_t bufSize);
+
+        /*
+         * Create a line reader with a growable buffer of its own, see Options.
+         */
+        LineReader(int fd, const Options& options);
+
+        LineReader(ByteSource& source, const Options& options);
+
         LineReader(const LineReader&) = delete;
         LineReader& operator=(const LineReader&) = delete;
 
+        ~LineReader();
+
         enum State {
             kReading,
             kEof,
@@ -32,7 +76,7 @@ namespace sysio {
          *
          * If the line is longer than bufSize, we return the first bufSize bytes
          * (which won't include a trailing newline) and then continue from that
-         * point onwards.
+         * point onwards.  A growable buffer grows instead, up to maxSize.
          *
          * The lines returned are not null-terminated.
          *
@@ -47,10 +91,70 @@ namespace sysio {
          */
         State readLine(std::string& line);
 
+        /**
+         * Zero-copy variant of readLine() that returns every complete line
+         * currently in the buffer at once, as [*begin, *end).  The block
+         * always ends with a newline, except at end of file or when a single
+         * line fills the whole buffer (as with readLine(); a growable buffer
+         * grows first).  The block points into the buffer and is valid until
+         * the next call.
+         */
+        State readLines(const char** begin, const char** end);
+
+        /**
+         * Give back the tail [p, end) of the block returned by the last
+         * readLines() call: the next readLines() call returns it again,
+         * followed by at least one more line if the buffer has room.  Used by
+         * parsers whose records may span lines.
+         */
+        void unreadFrom(const char* p);
+
+        /**
+         * kReading while more input may follow the buffered data.
+         */
+        State state() const {
+            return state_;
+        }
+
+        size_t capacity() const {
+            return size_t(bufEnd_ - buf_);
+        }
+
+        const Stats& stats() const {
+            return stats_;
+        }
+
     private:
+        LineReader(int fd, ByteSource* source, const Options& options);
+
+        // Moves [bol_, end_) to the start of the buffer, shrinking a grown
+        // buffer if shouldShrink()
+        void compact();
+
+        // Whether a grown buffer has gone unused for long enough
+        bool shouldShrink() const;
+
+        // Grows a full buffer; false if it cannot grow
+        bool grow();
+
+        // Moves the buffer to p, which has the same contents
+        void rebase(char* p, size_t size);
+
+        // Bookkeeping at the end of readLine() and readLines()
+        void returned(size_t n);
+
+        void refill();
+
         int const fd_;
-        char* const buf_;
-        char* const bufEnd_;
+        ByteSource* const source_;
+        char* buf_;
+        char* bufEnd_;
+        // Only for a growable buffer, which buf_ then owns (from malloc())
+        bool const growable_;
+        Options const options_;
+        Stats stats_;
+        // Calls in a row that returned at most initialSize bytes
+        size_t quietCalls_;
 
         // buf_ <= bol_ <= eol_ <= end_ <= bufEnd_
         //
@@ -65,6 +169,8 @@ namespace sysio {
         char* bol_;
         char* eol_;
         char* end_;
+        // set by unreadFrom(): where the next readLines() block starts
+        char* unread_;
         State state_;
     };
 }
@@ -0,0 +1,364 @@
+#include "system_io/MappedFile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "system_io/Crc32c.h"
+#include "system_io/Exception.h"
+#include "system_io/FileUtil.h"
+#include "system_io/detail/Page.h"
+
+namespace sysio
+{
+    namespace
+    {
+        size_t roundUp(size_t n, size_t unit)
+        {
+            return (n + unit - 1) / unit * unit;
+        }
+
+        // A record of the size file: magic, sequence number, size and the
+        // CRC32C of those, in native byte order
+        const char kSizeMagic[8] = {'S', 'Y', 'S', 'I', 'O', 'M', 'F', 'S'};
+        constexpr size_t kSizeRecord = 32;
+    }
+
+    MappedFile::MappedFile(File file)
+            : MappedFile(std::move(file), Options())
+    {}
+
+    MappedFile::MappedFile(File file, const Options &options)
+            : file_(std::move(file)),
+              options_(options)
+    {
+        CHECK(file_) << "no file";
+        options_.growthStep = roundUp(std::max<size_t>(options_.growthStep, 1), detail::pageSize());
+        options_.reserve = roundUp(options_.reserve, detail::pageSize());
+        if (!options_.sizePath.empty())
+        {
+            sizeFile_ = File(options_.sizePath, O_RDWR | O_CREAT | O_CLOEXEC, options_.mode);
+        }
+        map();
+    }
+
+    MappedFile::MappedFile(const std::string &path)
+            : MappedFile(path, Options())
+    {}
+
+    MappedFile::MappedFile(const std::string &path, const Options &options)
+            : MappedFile(File(path, O_RDWR | O_CREAT | O_CLOEXEC, options.mode), options)
+    {}
+
+    MappedFile::~MappedFile()
+    {
+        if (file_)
+        {
+            unmap();
+            if (ftruncate(file_.fd(), off_t(size_)) == 0 && sizeFile_ && size_ != recordedSize_)
+            {
+                recordSize(false);
+            }
+        }
+    }
+
+    void MappedFile::close()
+    {
+        if (!file_)
+        {
+            return;
+        }
+        unmap();
+        checkUnixError(ftruncate(file_.fd(), off_t(size_)), "ftruncate() failed");
+        if (sizeFile_ && size_ != recordedSize_)
+        {
+            checkUnixError(recordSize(false), "writing the size file failed");
+        }
+        sizeFile_.close();
+        file_.close();
+    }
+
+    void MappedFile::map()
+    {
+        struct stat st;
+        checkUnixError(fstat(file_.fd(), &st), "fstat() failed");
+        size_ = capacity_ = written_ = size_t(st.st_size);
+        size_t recorded;
+        if (readSize(&recorded))
+        {
+            // Past it is padding, or data that was never synced; resize()
+            // clears it when growing
+            size_ = recordedSize_ = std::min(recorded, size_);
+        }
+        size_t length = roundUp(capacity_, detail::pageSize());
+
+        if (options_.reserve != 0)
+        {
+            // Reserve the address space, then map the file over its start
+            reserved_ = std::max(options_.reserve, length);
+            void *p = mmap(nullptr, reserved_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (p == MAP_FAILED)
+            {
+                throwSystemError("mmap() of reservation failed");
+            }
+            map_ = static_cast<char *>(p);
+            if (length != 0 &&
+                mmap(map_, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file_.fd(), 0) == MAP_FAILED)
+            {
+                int err = errno;
+                unmap();
+                throwSystemErrorExplicit(err, "mmap() failed");
+            }
+        } else if (length != 0)
+        {
+            void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, file_.fd(), 0);
+            if (p == MAP_FAILED)
+            {
+                throwSystemError("mmap() failed");
+            }
+            map_ = static_cast<char *>(p);
+        }
+    }
+
+    bool MappedFile::readSize(size_t *size)
+    {
+        if (!sizeFile_)
+        {
+            return false;
+        }
+        char buf[2 * kSizeRecord];
+        ssize_t r = preadFull(sizeFile_.fd(), buf, sizeof(buf), 0);
+        checkUnixError(r, "reading the size file failed");
+        bool found = false;
+        for (size_t slot = 0; slot + kSizeRecord <= size_t(r); slot += kSizeRecord)
+        {
+            const char *p = buf + slot;
+            uint64_t sequence;
+            uint64_t value;
+            uint32_t crc;
+            memcpy(&sequence, p + 8, 8);
+            memcpy(&value, p + 16, 8);
+            memcpy(&crc, p + 24, 4);
+            if (memcmp(p, kSizeMagic, sizeof(kSizeMagic)) != 0 || crc != crc32c(p, 24))
+            {
+                continue;
+            }
+            if (!found || sequence > sizeSequence_)
+            {
+                sizeSequence_ = sequence;
+                *size = size_t(value);
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    int MappedFile::recordSize(bool sync)
+    {
+        char record[kSizeRecord] = {};
+        uint64_t sequence = sizeSequence_ + 1;
+        uint64_t value = size_;
+        memcpy(record, kSizeMagic, sizeof(kSizeMagic));
+        memcpy(record + 8, &sequence, 8);
+        memcpy(record + 16, &value, 8);
+        uint32_t crc = crc32c(record, 24);
+        memcpy(record + 24, &crc, 4);
+        off_t offset = off_t(sequence % 2 * kSizeRecord);
+        if (pwriteFull(sizeFile_.fd(), record, sizeof(record), offset) != ssize_t(sizeof(record)) ||
+            (sync && fdatasync(sizeFile_.fd()) == -1))
+        {
+            return -1;
+        }
+        sizeSequence_ = sequence;
+        recordedSize_ = size_;
+        return 0;
+    }
+
+    void MappedFile::unmap()
+    {
+        size_t length = std::max(reserved_, roundUp(capacity_, detail::pageSize()));
+        if (map_ != nullptr && length != 0)
+        {
+            munmap(map_, length);
+        }
+        map_ = nullptr;
+        reserved_ = 0;
+    }
+
+    void MappedFile::reserveCapacity(size_t n)
+    {
+        if (n <= capacity_)
+        {
+            return;
+        }
+        size_t oldLength = roundUp(capacity_, detail::pageSize());
+        size_t newLength = roundUp(n, options_.growthStep);
+        checkUnixError(ftruncate(file_.fd(), off_t(newLength)), "ftruncate() failed");
+
+        if (newLength > reserved_ && reserved_ != 0)
+        {
+            // Outgrew the reservation: release the rest of it, which may well
+            // leave room to grow in place anyway
+            munmap(map_ + oldLength, reserved_ - oldLength);
+            reserved_ = 0;
+            if (oldLength == 0)
+            {
+                map_ = nullptr;
+            }
+        }
+
+        void *p;
+        if (map_ == nullptr)
+        {
+            p = mmap(nullptr, newLength, PROT_READ | PROT_WRITE, MAP_SHARED, file_.fd(), 0);
+            checkUnixError(p == MAP_FAILED ? -1 : 0, "mmap() failed");
+        } else if (newLength <= reserved_)
+        {
+            p = mmap(map_ + oldLength, newLength - oldLength, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED, file_.fd(), off_t(oldLength));
+            checkUnixError(p == MAP_FAILED ? -1 : 0, "mmap() failed");
+            p = map_;
+        } else
+        {
+            p = mremap(map_, oldLength, newLength, 0);
+            if (p == MAP_FAILED)
+            {
+                p = mremap(map_, oldLength, newLength, MREMAP_MAYMOVE);
+                checkUnixError(p == MAP_FAILED ? -1 : 0, "mremap() failed");
+            }
+        }
+        if (p != map_)
+        {
+            ++stats_.moves;
+        }
+        map_ = static_cast<char *>(p);
+        capacity_ = newLength;
+        ++stats_.grows;
+    }
+
+    void MappedFile::resize(size_t n)
+    {
+        reserveCapacity(n);
+        if (n > size_ && size_ < written_)
+        {
+            // Clear what a shrink left behind
+            size_t end = std::min(n, written_);
+            memset(map_ + size_, 0, end - size_);
+            markDirty(size_, end - size_);
+        }
+        size_ = n;
+        written_ = std::max(written_, n);
+    }
+
+    char *MappedFile::append(size_t n)
+    {
+        size_t offset = size_;
+        resize(size_ + n);
+        markDirty(offset, n);
+        return map_ + offset;
+    }
+
+    void MappedFile::write(size_t offset, const void *data, size_t n)
+    {
+        if (offset + n > size_)
+        {
+            resize(offset + n);
+        }
+        memcpy(map_ + offset, data, n);
+        markDirty(offset, n);
+    }
+
+    void MappedFile::markDirty(size_t offset, size_t n)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+        DCHECK_LE(offset + n, capacity_);
+        size_t begin = offset & ~(detail::pageSize() - 1);
+        size_t end = roundUp(offset + n, detail::pageSize());
+
+        // Merge with the ranges it overlaps or touches
+        auto next = dirty_.upper_bound(begin);
+        if (next != dirty_.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->second >= end)
+            {
+                return; // Already dirty
+            }
+            if (prev->second >= begin)
+            {
+                begin = prev->first;
+                dirty_.erase(prev);
+            }
+        }
+        while (next != dirty_.end() && next->first <= end)
+        {
+            end = std::max(end, next->second);
+            next = dirty_.erase(next);
+        }
+        dirty_.emplace_hint(next, begin, end);
+    }
+
+    void MappedFile::flush(Flush mode)
+    {
+        for (const auto &range : dirty_)
+        {
+            size_t length = range.second - range.first;
+            if (mode == Flush::kAsync)
+            {
+                checkUnixError(msync(map_ + range.first, length, MS_ASYNC), "msync() failed");
+            } else if (mode == Flush::kWriteback)
+            {
+                checkUnixError(sync_file_range(file_.fd(), off_t(range.first), off_t(length),
+                                               SYNC_FILE_RANGE_WRITE),
+                               "sync_file_range() failed");
+            }
+            ++stats_.flushedRanges;
+            stats_.flushedBytes += length;
+        }
+        // The recorded size must only cover data on disk, including ranges
+        // flushed earlier without waiting, so record it after syncing the
+        // whole file
+        const bool record = mode == Flush::kSync && sizeFile_ && size_ != recordedSize_;
+        if (mode == Flush::kSync && (!dirty_.empty() || record))
+        {
+            if (dirty_.size() == 1 && !record)
+            {
+                auto range = *dirty_.begin();
+                checkUnixError(msync(map_ + range.first, range.second - range.first, MS_SYNC), "msync() failed");
+            } else
+            {
+                // The pages dirtied through the mapping are the file's dirty
+                // pages: writing them back one range at a time only costs
+                // more system calls and smaller I/Os
+                checkUnixError(fdatasync(file_.fd()), "fdatasync() failed");
+            }
+        }
+        if (record)
+        {
+            checkUnixError(recordSize(true), "writing the size file failed");
+        }
+        dirty_.clear();
+        ++stats_.flushes;
+    }
+
+    size_t MappedFile::dirtyBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &range : dirty_)
+        {
+            bytes += range.second - range.first;
+        }
+        return bytes;
+    }
+}
@@ -0,0 +1,237 @@
+#ifndef SYSTEM_IO_MAPPEDFILE_H
+#define SYSTEM_IO_MAPPEDFILE_H
+
+#include <sys/types.h>
+#include <fcntl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "system_io/File.h"
+
+/*
+ * A file mapped read-write, for files updated in place a few bytes at a
+ * time (indexes, tables of fixed size records) and for appending to them.
+ *
+ * An update is a store into the mapping instead of a pwrite() system call.
+ * The pages written are recorded as dirty ranges (by write(), append(), or
+ * markDirty() after storing through data()), so that flush() only writes
+ * back and waits for those.
+ *
+ * The mapping, and the file under it, grow in steps of Options::growthStep
+ * (the file with ftruncate(), which allocates nothing on disk until pages
+ * are written), so appending rarely has to remap.  Pointers into data()
+ * stay valid until the mapping moves, which generation() counts: growing
+ * tries to extend the mapping in place first, and never moves it within
+ * Options::reserve.
+ *
+ * The file is truncated back to size() by close() or the destructor only.
+ * A file that is not closed cleanly (a crash, or a kill even right after
+ * flush(Flush::kSync)) is left padded with zeros up to the growth step,
+ * and reopening it takes the padding for data: size() includes it, and
+ * append() lands after it.  To reopen such a file at the size it had at
+ * its last flush(Flush::kSync), set Options::sizePath: that flush records
+ * size() there once the data is durable, and the constructor reads it
+ * back.
+ *
+ * Stores into the mapping past the end of the file raise SIGBUS, as does
+ * any access after another process truncated the file; the file must only
+ * be resized through this object.
+ *
+ * Not thread-safe.
+ *
+ * Example:
+ *   MappedFile index(path);
+ *   index.write(slot * sizeof(Entry), &entry, sizeof(entry));
+ *   index.flush(MappedFile::Flush::kSync);
+ */
+
+namespace sysio
+{
+    class MappedFile
+    {
+    public:
+        enum class Flush
+        {
+            // msync(MS_ASYNC) of each dirty range: schedule writeback, without
+            // waiting.  Linux tracks dirty shared pages anyway, so this does
+            // little there.
+            kAsync,
+            // sync_file_range(SYNC_FILE_RANGE_WRITE) of each dirty range: start
+            // writeback now, without waiting.  Not durable (no metadata, no
+            // disk cache flush).
+            kWriteback,
+            // Durable: msync(MS_SYNC) of the dirty range if there is just
+            // one, else one fdatasync() (msync(MS_SYNC) of each range would
+            // be one journal commit per range on most filesystems).
+            kSync,
+        };
+
+        struct Options
+        {
+            // Unit of growth of the file and of the mapping
+            size_t growthStep = 64 << 20;
+            // Address space reserved for the mapping up front, so that it
+            // never moves while it fits; 0 for none.  Costs no memory.
+            size_t reserve = 0;
+            // Mode for a file created by the path constructor, and for the
+            // size file
+            mode_t mode = 0644;
+            // File, created if needed, where flush(Flush::kSync) records
+            // size() durably and close() records it for the next open; empty
+            // for none.  It belongs to this one file: reopening the file
+            // with it trims the file's size to the recorded one.
+            std::string sizePath;
+        };
+
+        struct Stats
+        {
+            // Times the file and mapping were grown, and the mapping moved
+            uint64_t grows = 0;
+            uint64_t moves = 0;
+            uint64_t flushes = 0;
+            // Dirty ranges and bytes (whole pages) flushed
+            uint64_t flushedRanges = 0;
+            uint64_t flushedBytes = 0;
+        };
+
+        /*
+         * Maps file, which must be open read-write, as it is now.
+         */
+        explicit MappedFile(File file);
+
+        MappedFile(File file, const Options &options);
+
+        /*
+         * Opens path read-write, creating it if needed.
+         */
+        explicit MappedFile(const std::string &path);
+
+        MappedFile(const std::string &path, const Options &options);
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /*
+         * close(), ignoring errors.  Dirty ranges are not flushed; the kernel
+         * writes them back eventually.
+         */
+        ~MappedFile();
+
+        /*
+         * Truncates the file to size(), records the size in Options::sizePath
+         * (without syncing it) and unmaps the file.  Throws on error.
+         */
+        void close();
+
+        char *data()
+        {
+            return map_;
+        }
+
+        const char *data() const
+        {
+            return map_;
+        }
+
+        size_t size() const
+        {
+            return size_;
+        }
+
+        // Bytes mapped, and the size of the file while open
+        size_t capacity() const
+        {
+            return capacity_;
+        }
+
+        // Changes whenever data() moves
+        uint64_t generation() const
+        {
+            return stats_.moves;
+        }
+
+        int fd() const
+        {
+            return file_.fd();
+        }
+
+        /*
+         * Sets the size, growing the mapping if needed.  Bytes past the old
+         * size read as zeros.
+         */
+        void resize(size_t n);
+
+        /*
+         * Grows the file by n bytes, marks them dirty and returns them for the
+         * caller to fill.
+         */
+        char *append(size_t n);
+
+        /*
+         * Copies n bytes to offset, growing the file if they end past size(),
+         * and marks them dirty.
+         */
+        void write(size_t offset, const void *data, size_t n);
+
+        /*
+         * Records that bytes [offset, offset + n) were modified through
+         * data().
+         */
+        void markDirty(size_t offset, size_t n);
+
+        /*
+         * Flushes the dirty ranges and forgets them.  Throws on error.
+         */
+        void flush(Flush mode = Flush::kSync);
+
+        // Bytes in dirty ranges (whole pages)
+        size_t dirtyBytes() const;
+
+        Stats stats() const
+        {
+            return stats_;
+        }
+
+    private:
+        void map();
+
+        void unmap();
+
+        // Makes the mapping and the file at least n bytes long
+        void reserveCapacity(size_t n);
+
+        // Reads the size recorded in sizeFile_, if any
+        bool readSize(size_t *size);
+
+        // Records size_ in sizeFile_, then syncs it if sync.  Returns 0, or
+        // -1 with errno set.
+        int recordSize(bool sync);
+
+        File file_;
+        File sizeFile_;
+        // Of the last record written to sizeFile_, which alternates between
+        // two slots so that a torn write leaves the other one
+        uint64_t sizeSequence_ = 0;
+        size_t recordedSize_ = 0;
+        Options options_;
+        char *map_ = nullptr;
+        size_t size_ = 0;
+        size_t capacity_ = 0;
+        // Bytes at and past this offset are known to be zero (never part of
+        // the file since they were allocated)
+        size_t written_ = 0;
+        // Length of the address space reservation, if any, which map_
+        // starts
+        size_t reserved_ = 0;
+        // Dirty ranges of whole pages, begin -> end, neither overlapping nor
+        // adjacent
+        std::map<size_t, size_t> dirty_;
+        Stats stats_;
+    };
+}
+
+#endif //SYSTEM_IO_MAPPEDFILE_H
@@ -0,0 +1,155 @@
+#include "system_io/MappedLineReader.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "system_io/detail/Page.h"
+
+namespace sysio
+{
+    namespace
+    {
+        uint64_t pageFloor(uint64_t offset)
+        {
+            return offset & ~uint64_t(detail::pageSize() - 1);
+        }
+    }
+
+    MappedLineReader::MappedLineReader(int fd)
+            : MappedLineReader(fd, Options())
+    {}
+
+    MappedLineReader::MappedLineReader(int fd, const Options &options)
+            : fd_(fd),
+              options_(options)
+    {}
+
+    MappedLineReader::~MappedLineReader()
+    {
+        unmap();
+    }
+
+    MappedLineReader::State MappedLineReader::readLine(const char **begin, const char **end)
+    {
+        return next(begin, end, false);
+    }
+
+    MappedLineReader::State MappedLineReader::readLines(const char **begin, const char **end)
+    {
+        return next(begin, end, true);
+    }
+
+    MappedLineReader::State MappedLineReader::next(const char **begin, const char **end, bool block)
+    {
+        if (failed_)
+        {
+            return kError;
+        }
+        for (;;)
+        {
+            // Search the mapped bytes not searched yet; memchr() and memrchr()
+            // are vectorized
+            uint64_t mapEnd = mapOffset_ + mapLength_;
+            uint64_t from = std::max(pos_, searched_);
+            if (from < mapEnd)
+            {
+                const char *p = map_ + (from - mapOffset_);
+                size_t n = size_t(mapEnd - from);
+                const void *newline = block ? memrchr(p, '\n', n) : memchr(p, '\n', n);
+                if (newline)
+                {
+                    const char *nl = static_cast<const char *>(newline);
+                    return emit(mapOffset_ + uint64_t(nl - map_) + 1, begin, end);
+                }
+                searched_ = mapEnd;
+            }
+
+            if (mapEnd >= fileSize_)
+            {
+                // Everything we knew of is mapped; see if the file grew
+                struct stat st;
+                ++stats_.sizeChecks;
+                if (fstat(fd_, &st) == -1)
+                {
+                    failed_ = true;
+                    return kError;
+                }
+                fileSize_ = std::max(fileSize_, uint64_t(st.st_size));
+                if (mapEnd >= fileSize_)
+                {
+                    if (pos_ < fileSize_ && options_.partialLastLine)
+                    {
+                        return emit(fileSize_, begin, end);
+                    }
+                    return kEof;
+                }
+            }
+
+            // Map a new window from the start of the current line, at least a
+            // window past what is mapped now so that long lines make progress
+            uint64_t start = pageFloor(pos_);
+            uint64_t windowEnd = std::max(start, mapEnd) + std::max<size_t>(options_.windowSize, 1);
+            if (!map(start, std::min(windowEnd, fileSize_)))
+            {
+                failed_ = true;
+                return kError;
+            }
+        }
+    }
+
+    MappedLineReader::State MappedLineReader::emit(uint64_t lineEnd, const char **begin, const char **end)
+    {
+        *begin = map_ + (pos_ - mapOffset_);
+        *end = map_ + (lineEnd - mapOffset_);
+
+        // Release the pages before this line.  The page cache keeps them,
+        // but they no longer count against this process, and the kernel can
+        // evict them first.
+        uint64_t consumed = pageFloor(pos_);
+        if (options_.dropBehind != 0 && consumed >= dropped_ + options_.dropBehind)
+        {
+            madvise(const_cast<char *>(map_) + (dropped_ - mapOffset_), size_t(consumed - dropped_),
+                    MADV_DONTNEED);
+            stats_.bytesDropped += consumed - dropped_;
+            dropped_ = consumed;
+        }
+
+        pos_ = lineEnd;
+        return kReading;
+    }
+
+    bool MappedLineReader::map(uint64_t start, uint64_t end)
+    {
+        unmap();
+        start = pageFloor(start);
+        size_t length = size_t(end - start);
+        void *p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd_, off_t(start));
+        if (p == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(p, length, MADV_SEQUENTIAL);
+        adviseMapping(p, length, options_.pages);
+        map_ = static_cast<const char *>(p);
+        mapOffset_ = start;
+        mapLength_ = length;
+        dropped_ = start;
+        ++stats_.remaps;
+        return true;
+    }
+
+    void MappedLineReader::unmap()
+    {
+        if (map_)
+        {
+            munmap(const_cast<char *>(map_), mapLength_);
+            map_ = nullptr;
+            mapLength_ = 0;
+        }
+    }
+}
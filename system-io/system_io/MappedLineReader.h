@@ -0,0 +1,138 @@
+#ifndef SYSTEM_IO_MAPPEDLINEREADER_H
+#define SYSTEM_IO_MAPPEDLINEREADER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "system_io/PageMemory.h"
+
+/*
+ * Line reader over a memory mapping of a file, for regular files on local
+ * disk: lines are returned as pointers into the page cache, with no copy
+ * into a buffer and no read() calls.
+ *
+ * The file is mapped one window at a time (larger if a line is longer than
+ * a window), with MADV_SEQUENTIAL.  Consumed pages are released with
+ * MADV_DONTNEED as the reader moves on, so files larger than RAM can be
+ * scanned without the mapping pinning them.
+ *
+ * At end of file, the reader fstat()s the file again, so lines appended
+ * meanwhile are picked up; it can also be called again after returning
+ * kEof, to follow a file that is being written.  The file must not be
+ * truncated while it is read: touching a mapped page past the end of the
+ * file raises SIGBUS.
+ *
+ * Example:
+ *   MappedLineReader reader(file.fd());
+ *   const char* b;
+ *   const char* e;
+ *   while (reader.readLine(&b, &e) == MappedLineReader::kReading) ...
+ */
+
+namespace sysio
+{
+    class MappedLineReader
+    {
+    public:
+        struct Options
+        {
+            // Bytes mapped at a time; rounded up to whole pages
+            size_t windowSize = 64 * 1024 * 1024;
+            // Release consumed pages in steps of this many bytes; 0 keeps
+            // them mapped until the window moves
+            size_t dropBehind = 8 * 1024 * 1024;
+            // Whether an unterminated last line is returned at end of file,
+            // or held back until its newline is appended
+            bool partialLastLine = true;
+            // Huge pages and pre-faulting for each window, see
+            // adviseMapping()
+            PageOptions pages;
+        };
+
+        struct Stats
+        {
+            uint64_t remaps = 0;
+            uint64_t sizeChecks = 0;
+            uint64_t bytesDropped = 0;
+        };
+
+        enum State
+        {
+            kReading,
+            kEof,
+            kError,
+        };
+
+        /*
+         * Reads lines from fd, which must be open for reading and support
+         * mmap(), starting at offset 0.  fd is not owned.
+         */
+        explicit MappedLineReader(int fd);
+
+        MappedLineReader(int fd, const Options &options);
+
+        MappedLineReader(const MappedLineReader &) = delete;
+
+        MappedLineReader &operator=(const MappedLineReader &) = delete;
+
+        ~MappedLineReader();
+
+        /*
+         * Returns the next line as [*begin, *end), including its newline.
+         * Lines are never split.  The line points into the mapping and is
+         * valid until the next call.
+         *
+         * Returns kReading with a line, kEof at end of file, or kError (and
+         * sets errno) if fstat() or mmap() failed.
+         */
+        State readLine(const char **begin, const char **end);
+
+        /*
+         * As readLine(), but returns every complete line up to the end of
+         * the current window at once (as LineReader::readLines()).
+         */
+        State readLines(const char **begin, const char **end);
+
+        /*
+         * File offset of the next line.
+         */
+        uint64_t offset() const
+        {
+            return pos_;
+        }
+
+        const Stats &stats() const
+        {
+            return stats_;
+        }
+
+    private:
+        State next(const char **begin, const char **end, bool block);
+
+        // Returns [pos_, lineEnd) and moves past it
+        State emit(uint64_t lineEnd, const char **begin, const char **end);
+
+        // Maps [start, end) of the file, start rounded down to a page
+        bool map(uint64_t start, uint64_t end);
+
+        void unmap();
+
+        int const fd_;
+        Options const options_;
+        Stats stats_;
+
+        const char *map_ = nullptr;
+        uint64_t mapOffset_ = 0;
+        size_t mapLength_ = 0;
+        // File size when last checked
+        uint64_t fileSize_ = 0;
+        // Start of the next line, and how far past it no newline was found
+        uint64_t pos_ = 0;
+        uint64_t searched_ = 0;
+        // Pages before this offset were released
+        uint64_t dropped_ = 0;
+        bool failed_ = false;
+    };
+}
+
+#endif //SYSTEM_IO_MAPPEDLINEREADER_H
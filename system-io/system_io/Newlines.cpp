@@ -0,0 +1,94 @@
+#include "system_io/Newlines.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sysio
+{
+    namespace
+    {
+#if defined(__SSE2__)
+        inline uint64_t newlineMask(const char *p)
+        {
+            const __m128i newline = _mm_set1_epi8('\n');
+            uint64_t m = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+                m |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)))) << (16 * i);
+            }
+            return m;
+        }
+#else
+        inline uint64_t newlineMask(const char *p)
+        {
+            uint64_t m = 0;
+            for (size_t i = 0; i < 64; ++i)
+            {
+                m |= uint64_t(p[i] == '\n') << i;
+            }
+            return m;
+        }
+#endif
+    }
+
+    size_t countNewlines(const char *p, size_t n)
+    {
+        size_t count = 0;
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i newline = _mm_set1_epi8('\n');
+        while (n - i >= 16)
+        {
+            // Count in bytes (compares are -1 or 0) for up to 255 vectors,
+            // then add the bytes up
+            __m128i counts = _mm_setzero_si128();
+            size_t end = i + 16 * std::min((n - i) / 16, size_t(255));
+            for (; i < end; i += 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+                counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(v, newline));
+            }
+            __m128i sums = _mm_sad_epu8(counts, _mm_setzero_si128());
+            count += size_t(_mm_cvtsi128_si32(sums)) + size_t(_mm_extract_epi16(sums, 4));
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            count += p[i] == '\n';
+        }
+        return count;
+    }
+
+    ssize_t findNewline(const char *p, size_t n, uint64_t *k)
+    {
+        size_t i = 0;
+        for (; n - i >= 64; i += 64)
+        {
+            uint64_t m = newlineMask(p + i);
+            uint64_t c = uint64_t(__builtin_popcountll(m));
+            if (c < *k)
+            {
+                *k -= c;
+                continue;
+            }
+            for (uint64_t j = *k; j > 1; --j)
+            {
+                m &= m - 1;
+            }
+            *k = 0;
+            return ssize_t(i) + __builtin_ctzll(m);
+        }
+        for (; i < n; ++i)
+        {
+            if (p[i] == '\n' && --*k == 0)
+            {
+                return ssize_t(i);
+            }
+        }
+        return -1;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef SYSTEM_IO_NEWLINES_H
+#define SYSTEM_IO_NEWLINES_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sysio
+{
+    /*
+     * Number of '\n' bytes in [p, p + n).  Compares 16 bytes at a time with
+     * SSE2 where available, summing the compare results in byte lanes.
+     */
+    size_t countNewlines(const char *p, size_t n);
+
+    /*
+     * Returns the position of the *k-th (from 1) '\n' in [p, p + n).  If there
+     * are fewer, returns -1 and subtracts their number from *k, so that the
+     * search can go on in the next buffer.  Skips 64 bytes without newlines
+     * at a time.
+     */
+    ssize_t findNewline(const char *p, size_t n, uint64_t *k);
+}
+
+#endif //SYSTEM_IO_NEWLINES_H
@@ -0,0 +1,198 @@
+#include "system_io/PageMemory.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+
+#include "system_io/Exception.h"
+#include "system_io/detail/Page.h"
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+namespace sysio
+{
+    namespace
+    {
+        size_t mappedLength(size_t size, const PageOptions &options)
+        {
+            size_t align = options.hugePages || options.hugeTlb ? kHugePageSize
+                                                                 : detail::pageSize();
+            return (std::max<size_t>(size, 1) + align - 1) & ~(align - 1);
+        }
+
+        // Faults in every page of [p, p + length), which must be page
+        // aligned.  MADV_POPULATE_* is Linux 5.14 and later; before that,
+        // touch the pages.
+        void populate(char *p, size_t length, bool write)
+        {
+            if (madvise(p, length, write ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0)
+            {
+                return;
+            }
+            volatile char *v = p;
+            for (size_t i = 0; i < length; i += detail::pageSize())
+            {
+                if (write)
+                {
+                    v[i] = 0;
+                } else
+                {
+                    (void) v[i];
+                }
+            }
+        }
+    }
+
+    void *allocatePages(size_t size, const PageOptions &options, bool *usedHugeTlb) noexcept
+    {
+        if (usedHugeTlb)
+        {
+            *usedHugeTlb = false;
+        }
+        size_t length = mappedLength(size, options);
+        if (length < size)
+        {
+            errno = ENOMEM;
+            return nullptr;
+        }
+        const int prot = PROT_READ | PROT_WRITE;
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        const int populateFlag = options.populate ? MAP_POPULATE : 0;
+
+        if (options.hugeTlb)
+        {
+            void *p = mmap(nullptr, length, prot, flags | MAP_HUGETLB | populateFlag, -1, 0);
+            if (p != MAP_FAILED)
+            {
+                if (usedHugeTlb)
+                {
+                    *usedHugeTlb = true;
+                }
+                return p;
+            }
+            // No huge pages reserved (ENOMEM), or no hugetlbfs: fall back
+        }
+        if (!options.hugePages && !options.hugeTlb)
+        {
+            void *p = mmap(nullptr, length, prot, flags | populateFlag, -1, 0);
+            return p == MAP_FAILED ? nullptr : p;
+        }
+
+        // Transparent huge pages are only used for 2 MB aligned ranges, so
+        // map an extra huge page and trim the mapping to an aligned one.
+        // Populate after MADV_HUGEPAGE, or the faults would use small pages.
+        size_t over = length + kHugePageSize;
+        void *raw = mmap(nullptr, over, prot, flags, -1, 0);
+        if (raw == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        char *begin = static_cast<char *>(raw);
+        char *aligned = reinterpret_cast<char *>(
+                (reinterpret_cast<uintptr_t>(begin) + kHugePageSize - 1) & ~uintptr_t(kHugePageSize - 1));
+        if (aligned != begin)
+        {
+            munmap(begin, size_t(aligned - begin));
+        }
+        size_t tail = size_t((begin + over) - (aligned + length));
+        if (tail != 0)
+        {
+            munmap(aligned + length, tail);
+        }
+        madvise(aligned, length, MADV_HUGEPAGE);
+        if (options.populate)
+        {
+            populate(aligned, length, true);
+        }
+        return aligned;
+    }
+
+    void freePages(void *p, size_t size, const PageOptions &options) noexcept
+    {
+        if (p)
+        {
+            munmap(p, mappedLength(size, options));
+        }
+    }
+
+    void adviseMapping(void *addr, size_t length, const PageOptions &options) noexcept
+    {
+        if (length == 0)
+        {
+            return;
+        }
+        uintptr_t begin = reinterpret_cast<uintptr_t>(addr) & ~uintptr_t(detail::pageSize() - 1);
+        length += reinterpret_cast<uintptr_t>(addr) - begin;
+        char *p = reinterpret_cast<char *>(begin);
+        if (options.hugePages)
+        {
+            madvise(p, length, MADV_HUGEPAGE);
+        }
+        if (options.populate)
+        {
+            populate(p, length, false);
+        }
+    }
+
+    PageBuffer::PageBuffer() noexcept
+            : data_(nullptr), size_(0), hugeTlb_(false)
+    {}
+
+    PageBuffer::PageBuffer(size_t size, const PageOptions &options)
+            : data_(nullptr),
+              size_(size),
+              options_(options),
+              hugeTlb_(false)
+    {
+        data_ = static_cast<char *>(allocatePages(size, options, &hugeTlb_));
+        if (!data_)
+        {
+            throwSystemError("mmap() of page buffer failed");
+        }
+    }
+
+    PageBuffer::PageBuffer(PageBuffer &&other) noexcept
+            : data_(other.data_),
+              size_(other.size_),
+              options_(other.options_),
+              hugeTlb_(other.hugeTlb_)
+    {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    PageBuffer &PageBuffer::operator=(PageBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            data_ = other.data_;
+            size_ = other.size_;
+            options_ = other.options_;
+            hugeTlb_ = other.hugeTlb_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    PageBuffer::~PageBuffer()
+    {
+        reset();
+    }
+
+    void PageBuffer::reset() noexcept
+    {
+        freePages(data_, size_, options_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
@@ -0,0 +1,179 @@
+#ifndef SYSTEM_IO_PAGEMEMORY_H
+#define SYSTEM_IO_PAGEMEMORY_H
+
+#include <cstddef>
+#include <new>
+
+/*
+ * Page-granular memory for large I/O buffers and mappings, optionally backed
+ * by 2 MB huge pages and pre-faulted.
+ *
+ * A sequential scan of a large buffer takes a TLB miss (and, the first time,
+ * a page fault) every 4 KB; with huge pages that is every 2 MB.  Huge pages
+ * come from one of:
+ *  - transparent huge pages (MADV_HUGEPAGE), which work unless THP is
+ *    disabled outright in /sys/kernel/mm/transparent_hugepage/enabled;
+ *  - hugetlbfs (MAP_HUGETLB), which needs pages reserved beforehand in
+ *    /proc/sys/vm/nr_hugepages.  If none are free, the allocation falls back
+ *    to transparent huge pages.
+ *
+ * Pre-faulting (populate) moves the page faults to allocation time, e.g. out
+ * of a latency-sensitive loop.
+ *
+ * Example, for a LineReader buffer and a readFile() container:
+ *   PageOptions options;
+ *   options.hugePages = true;
+ *   PageBuffer buf(16 << 20, options);
+ *   LineReader reader(fd, buf.data(), buf.size());
+ *
+ *   std::vector<char, PageAllocator<char>> contents{PageAllocator<char>(options)};
+ *   readFile(path, contents);
+ */
+
+namespace sysio
+{
+    constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+    struct PageOptions
+    {
+        // Ask for transparent huge pages
+        bool hugePages = false;
+        // Try hugetlbfs pages first
+        bool hugeTlb = false;
+        // Pre-fault all pages
+        bool populate = false;
+    };
+
+    /*
+     * Anonymous, page-aligned memory of at least size bytes; 2 MB aligned
+     * with huge pages.  Returns nullptr and sets errno on failure.  If
+     * usedHugeTlb is not null, it is set to whether hugetlbfs pages were
+     * used.
+     */
+    void *allocatePages(size_t size, const PageOptions &options, bool *usedHugeTlb = nullptr) noexcept;
+
+    /*
+     * Frees memory from allocatePages(), given the same size and options.
+     */
+    void freePages(void *p, size_t size, const PageOptions &options) noexcept;
+
+    /*
+     * Applies options to [addr, addr + length) of an existing mapping, such
+     * as a file mapping: MADV_HUGEPAGE for hugePages (for file mappings
+     * this only has an effect on filesystems and kernels that support large
+     * folios in the page cache), and reads every page in for populate.
+     * hugeTlb does not apply.  Best effort: failures are ignored.
+     */
+    void adviseMapping(void *addr, size_t length, const PageOptions &options) noexcept;
+
+    /*
+     * A buffer from allocatePages(), freed on destruction.
+     */
+    class PageBuffer
+    {
+    public:
+        PageBuffer() noexcept;
+
+        /*
+         * Throws std::system_error if the memory cannot be mapped.
+         */
+        explicit PageBuffer(size_t size, const PageOptions &options = PageOptions());
+
+        PageBuffer(const PageBuffer &) = delete;
+
+        PageBuffer &operator=(const PageBuffer &) = delete;
+
+        PageBuffer(PageBuffer &&other) noexcept;
+
+        PageBuffer &operator=(PageBuffer &&other) noexcept;
+
+        ~PageBuffer();
+
+        char *data() const
+        {
+            return data_;
+        }
+
+        size_t size() const
+        {
+            return size_;
+        }
+
+        /*
+         * Whether hugetlbfs pages back the buffer.
+         */
+        bool hugeTlb() const
+        {
+            return hugeTlb_;
+        }
+
+    private:
+        void reset() noexcept;
+
+        char *data_;
+        size_t size_;
+        PageOptions options_;
+        bool hugeTlb_;
+    };
+
+    /*
+     * Allocator over allocatePages(), for containers passed to readFile()
+     * and the like.  Each allocation is at least one page (2 MB with huge
+     * pages), so only use it for large containers.
+     */
+    template<class T>
+    class PageAllocator
+    {
+    public:
+        typedef T value_type;
+
+        explicit PageAllocator(const PageOptions &options = PageOptions()) noexcept
+                : options_(options)
+        {}
+
+        template<class U>
+        PageAllocator(const PageAllocator<U> &other) noexcept
+                : options_(other.options())
+        {}
+
+        T *allocate(size_t n)
+        {
+            void *p = allocatePages(n * sizeof(T), options_);
+            if (!p)
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T *>(p);
+        }
+
+        void deallocate(T *p, size_t n) noexcept
+        {
+            freePages(p, n * sizeof(T), options_);
+        }
+
+        const PageOptions &options() const
+        {
+            return options_;
+        }
+
+    private:
+        PageOptions options_;
+    };
+
+    template<class T, class U>
+    bool operator==(const PageAllocator<T> &a, const PageAllocator<U> &b)
+    {
+        // Memory is freed with munmap() whatever the options, as long as the
+        // size is rounded the same way
+        return a.options().hugePages == b.options().hugePages &&
+               a.options().hugeTlb == b.options().hugeTlb;
+    }
+
+    template<class T, class U>
+    bool operator!=(const PageAllocator<T> &a, const PageAllocator<U> &b)
+    {
+        return !(a == b);
+    }
+}
+
+#endif //SYSTEM_IO_PAGEMEMORY_H
@@ -0,0 +1,245 @@
+#include "system_io/Pipe.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+#include "system_io/Exception.h"
+#include "system_io/FileUtil.h"
+
+namespace sysio
+{
+    namespace
+    {
+        constexpr size_t kCopyBufferSize = 64 * 1024;
+
+        // /proc/sys/fs/pipe-max-size, or 0 if it cannot be read
+        size_t pipeMaxSize()
+        {
+            int fd = openNoInt("/proc/sys/fs/pipe-max-size", O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+            {
+                return 0;
+            }
+            char buf[32];
+            ssize_t n = readFull(fd, buf, sizeof(buf) - 1);
+            closeNoInt(fd);
+            if (n <= 0)
+            {
+                return 0;
+            }
+            buf[n] = '\0';
+            return size_t(strtoul(buf, nullptr, 10));
+        }
+    }
+
+    Pipe makePipe(size_t size, int flags)
+    {
+        int fds[2];
+        checkUnixError(pipe2(fds, flags), "pipe2() failed");
+        Pipe p{File(fds[0], true), File(fds[1], true)};
+
+        if (size != 0 && size > pipeSize(fds[0]))
+        {
+            int r = fcntl(fds[0], F_SETPIPE_SZ, int(std::min<size_t>(size, INT_MAX)));
+            if (r == -1 && errno == EPERM)
+            {
+                // Over the limit for unprivileged processes; the largest size
+                // allowed is still better than the default, but give up
+                // quietly if even that is refused (per-user pipe quota).
+                size_t maxSize = pipeMaxSize();
+                if (maxSize != 0 && maxSize < size)
+                {
+                    fcntl(fds[0], F_SETPIPE_SZ, int(std::min<size_t>(maxSize, INT_MAX)));
+                }
+            } else
+            {
+                checkUnixError(r, "fcntl(F_SETPIPE_SZ) failed");
+            }
+        }
+        return p;
+    }
+
+    size_t pipeSize(int fd)
+    {
+        int r = fcntl(fd, F_GETPIPE_SZ);
+        checkUnixError(r, "fcntl(F_GETPIPE_SZ) failed");
+        return size_t(r);
+    }
+
+    constexpr size_t Pump::kDefaultPipeSize;
+
+    Pump::Pump(size_t pipeSize)
+            : pipe_(makePipe(pipeSize)),
+              pipeSize_(sysio::pipeSize(pipe_.readEnd.fd()))
+    {}
+
+    ssize_t Pump::run(int fdIn, int fdOut, size_t n)
+    {
+        struct stat in;
+        struct stat out;
+        if (fstat(fdIn, &in) == -1 || fstat(fdOut, &out) == -1)
+        {
+            return -1;
+        }
+
+        if (S_ISFIFO(in.st_mode) || S_ISFIFO(out.st_mode))
+        {
+            // No need for our pipe
+            size_t total = 0;
+            while (total < n)
+            {
+                // Capped as in spliceFull(): larger lengths can fail with
+                // EINVAL, which would look like a lack of splice() support
+                ssize_t r = spliceNoInt(
+                        fdIn, nullptr, fdOut, nullptr,
+                        std::min<size_t>(n - total, 0x7ffff000), SPLICE_F_MOVE);
+                if (r == -1)
+                {
+                    if (errno != EINVAL)
+                    {
+                        return -1;
+                    }
+                    // The other end does not support splice()
+                    r = copy(fdIn, fdOut, n - total);
+                    return r == -1 ? -1 : ssize_t(total) + r;
+                }
+                if (r == 0)
+                {
+                    break; // EOF
+                }
+                total += size_t(r);
+                stats_.bytesSpliced += uint64_t(r);
+            }
+            return ssize_t(total);
+        }
+
+        size_t total = 0;
+        while (total < n)
+        {
+            ssize_t r = spliceNoInt(
+                    fdIn, nullptr, pipe_.writeEnd.fd(), nullptr,
+                    std::min(n - total, pipeSize_), SPLICE_F_MOVE);
+            if (r == -1)
+            {
+                if (errno != EINVAL)
+                {
+                    return -1;
+                }
+                // fdIn does not support splice(); nothing is in the pipe.
+                r = copy(fdIn, fdOut, n - total);
+                return r == -1 ? -1 : ssize_t(total) + r;
+            }
+            if (r == 0)
+            {
+                break; // EOF
+            }
+
+            // Always empty the pipe before returning, or the next run()
+            // would deliver stale data.
+            size_t pending = size_t(r);
+            while (pending != 0)
+            {
+                r = spliceNoInt(pipe_.readEnd.fd(), nullptr, fdOut, nullptr, pending, SPLICE_F_MOVE);
+                if (r == -1)
+                {
+                    int err = errno;
+                    if (err != EINVAL)
+                    {
+                        drainTo(-1, pending);
+                        errno = err;
+                        return -1;
+                    }
+                    // fdOut does not support splice(): deliver what is in the
+                    // pipe by hand and copy the rest.
+                    if (!drainTo(fdOut, pending))
+                    {
+                        return -1;
+                    }
+                    total += pending;
+                    stats_.bytesCopied += pending;
+                    r = total < n ? copy(fdIn, fdOut, n - total) : 0;
+                    return r == -1 ? -1 : ssize_t(total) + r;
+                }
+                pending -= size_t(r);
+                total += size_t(r);
+                stats_.bytesSpliced += uint64_t(r);
+            }
+        }
+        return ssize_t(total);
+    }
+
+    char *Pump::buffer()
+    {
+        if (!buf_)
+        {
+            buf_.reset(new char[kCopyBufferSize]);
+        }
+        return buf_.get();
+    }
+
+    ssize_t Pump::copy(int fdIn, int fdOut, size_t n)
+    {
+        size_t total = 0;
+        while (total < n)
+        {
+            ssize_t r = readNoInt(fdIn, buffer(), std::min(n - total, kCopyBufferSize));
+            if (r == -1)
+            {
+                return -1;
+            }
+            if (r == 0)
+            {
+                break; // EOF
+            }
+            if (writeFull(fdOut, buffer(), size_t(r)) == -1)
+            {
+                return -1;
+            }
+            total += size_t(r);
+            stats_.bytesCopied += uint64_t(r);
+        }
+        return ssize_t(total);
+    }
+
+    /*
+     * Moves the n bytes left in our pipe to fdOut, or discards them if fdOut
+     * is -1.  The pipe is emptied even if writing fails, in which case false
+     * is returned with errno set.
+     */
+    bool Pump::drainTo(int fdOut, size_t n)
+    {
+        int err = 0;
+        while (n != 0)
+        {
+            ssize_t r = readNoInt(pipe_.readEnd.fd(), buffer(), std::min(n, kCopyBufferSize));
+            if (r <= 0)
+            {
+                // Cannot happen, we hold the write end and know what is in it
+                err = r == -1 ? errno : EIO;
+                break;
+            }
+            if (err == 0 && fdOut != -1 && writeFull(fdOut, buffer(), size_t(r)) == -1)
+            {
+                err = errno;
+            }
+            n -= size_t(r);
+        }
+        if (err != 0)
+        {
+            errno = err;
+        }
+        return err == 0;
+    }
+
+    ssize_t pumpFull(int fdIn, int fdOut, size_t n)
+    {
+        Pump pump;
+        return pump.run(fdIn, fdOut, n);
+    }
+}
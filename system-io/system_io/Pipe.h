@@ -0,0 +1,100 @@
+#ifndef SYSTEM_IO_PIPE_H
+#define SYSTEM_IO_PIPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "system_io/File.h"
+
+/*
+ * Kernel pipes as zero-copy conduits between file descriptors.
+ */
+
+namespace sysio
+{
+    struct Pipe
+    {
+        File readEnd;
+        File writeEnd;
+    };
+
+    /*
+     * Creates a pipe with pipe2(flags).  If size is not 0, the pipe buffer is
+     * resized to at least size bytes with F_SETPIPE_SZ; if that exceeds
+     * /proc/sys/fs/pipe-max-size for an unprivileged process, it is clamped
+     * to the maximum.  Throws on error.
+     */
+    Pipe makePipe(size_t size = 0, int flags = O_CLOEXEC);
+
+    /*
+     * Returns the buffer size of pipe fd (F_GETPIPE_SZ).  Throws on error.
+     */
+    size_t pipeSize(int fd);
+
+    /*
+     * Moves data from any file descriptor to any other through a kernel pipe
+     * with splice(), so the data never enters user memory: file to socket,
+     * socket to file, file to file, and so on.  If one side already is a
+     * pipe, the data is spliced directly.
+     *
+     * Where splice() is not supported (e.g. an O_APPEND output file), the
+     * pump falls back to read() and write() through a private buffer.
+     *
+     * A Pump keeps its pipe between calls, so reuse it for repeated
+     * transfers.  Not thread-safe.
+     */
+    class Pump
+    {
+    public:
+        static constexpr size_t kDefaultPipeSize = 1 << 20;
+
+        struct Stats
+        {
+            uint64_t bytesSpliced = 0;
+            uint64_t bytesCopied = 0;
+        };
+
+        explicit Pump(size_t pipeSize = kDefaultPipeSize);
+
+        /*
+         * Moves up to n bytes from the current position of fdIn to the current
+         * position of fdOut.  Returns the number of bytes moved, which is
+         * less than n only if fdIn reached EOF, or -1 with errno set on error.
+         * After an error, an unspecified amount of data has been moved.
+         */
+        ssize_t run(int fdIn, int fdOut, size_t n = std::numeric_limits<size_t>::max());
+
+        size_t pipeSize() const
+        {
+            return pipeSize_;
+        }
+
+        const Stats &stats() const
+        {
+            return stats_;
+        }
+
+    private:
+        // read() / write() fallback when splice() is not supported
+        char *buffer();
+
+        ssize_t copy(int fdIn, int fdOut, size_t n);
+
+        bool drainTo(int fdOut, size_t n);
+
+        Pipe pipe_;
+        size_t pipeSize_;
+        std::unique_ptr<char[]> buf_;
+        Stats stats_;
+    };
+
+    /*
+     * Pump::run() with a temporary pump.  Throws if the pipe cannot be
+     * created.
+     */
+    ssize_t pumpFull(int fdIn, int fdOut, size_t n = std::numeric_limits<size_t>::max());
+}
+
+#endif //SYSTEM_IO_PIPE_H
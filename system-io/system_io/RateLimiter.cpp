@@ -0,0 +1,293 @@
+#include "system_io/RateLimiter.h"
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <system_error>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace sysio
+{
+    constexpr size_t RateLimiter::kNumPriorities;
+
+    RateLimiter::RateLimiter(const Options &options)
+            : options_(options)
+    {
+        CHECK_GE(options_.bytesPerSecond, 0);
+        CHECK_GE(options_.opsPerSecond, 0);
+        CHECK_GT(options_.maxChunk, 0u);
+        burstBytes_ = options_.burstBytes > 0 ? options_.burstBytes : options_.bytesPerSecond / 10;
+        burstOps_ = options_.burstOps > 0 ? options_.burstOps : std::max(1.0, options_.opsPerSecond / 10);
+        // Start full
+        bytes_ = burstBytes_;
+        ops_ = burstOps_;
+        refilled_ = Clock::now();
+    }
+
+    void RateLimiter::refill(Clock::time_point now)
+    {
+        double seconds = std::chrono::duration<double>(now - refilled_).count();
+        refilled_ = now;
+        bytes_ = std::min(burstBytes_, bytes_ + seconds * options_.bytesPerSecond);
+        ops_ = std::min(burstOps_, ops_ + seconds * options_.opsPerSecond);
+    }
+
+    double RateLimiter::bytesNeeded(size_t bytes) const
+    {
+        // More than the bucket holds goes through once it is full, and
+        // leaves it in debt
+        return std::min(double(bytes), burstBytes_);
+    }
+
+    RateLimiter::Clock::duration RateLimiter::timeToAcquire(size_t bytes) const
+    {
+        double seconds = 0;
+        if (options_.bytesPerSecond > 0)
+        {
+            seconds = std::max(seconds, (bytesNeeded(bytes) - bytes_) / options_.bytesPerSecond);
+        }
+        if (options_.opsPerSecond > 0)
+        {
+            seconds = std::max(seconds, (1 - ops_) / options_.opsPerSecond);
+        }
+        // Round up, so that the tokens are there when the wait ends
+        return std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(seconds)) + Clock::duration(1);
+    }
+
+    void RateLimiter::acquire(size_t bytes, Priority priority)
+    {
+        const size_t p = size_t(priority);
+        CHECK_LT(p, kNumPriorities);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        const uint64_t ticket = nextTicket_[p]++;
+        ++waiting_[p];
+        // A request of a higher priority goes ahead of whoever waits now
+        cv_.notify_all();
+
+        Clock::time_point start;
+        bool throttled = false;
+        for (;;)
+        {
+            bool turn = serving_[p] == ticket;
+            for (size_t q = 0; turn && q < p; ++q)
+            {
+                turn = waiting_[q] == 0;
+            }
+            if (turn)
+            {
+                refill(Clock::now());
+                bool ready = (options_.bytesPerSecond == 0 || bytes_ >= bytesNeeded(bytes)) &&
+                             (options_.opsPerSecond == 0 || ops_ >= 1);
+                if (ready)
+                {
+                    break;
+                }
+            }
+            if (!throttled)
+            {
+                throttled = true;
+                start = Clock::now();
+            }
+            if (turn)
+            {
+                cv_.wait_for(lock, timeToAcquire(bytes));
+            }
+            else
+            {
+                cv_.wait(lock);
+            }
+        }
+
+        if (options_.bytesPerSecond > 0)
+        {
+            bytes_ -= double(bytes);
+        }
+        if (options_.opsPerSecond > 0)
+        {
+            ops_ -= 1;
+        }
+        --waiting_[p];
+        ++serving_[p];
+        stats_.bytes += bytes;
+        ++stats_.ops;
+        if (throttled)
+        {
+            ++stats_.throttled[p];
+            stats_.throttledTime[p] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - start);
+        }
+        // Wake the next in line
+        cv_.notify_all();
+    }
+
+    RateLimiter::Stats RateLimiter::stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    namespace
+    {
+        // Runs op (which has the contract of readFull() on a buffer) on
+        // chunks of buf of at most limiter.maxChunk() bytes, acquiring each
+        // chunk first
+        template<class Op>
+        ssize_t chunked(char *buf, size_t n, RateLimiter &limiter, RateLimiter::Priority priority,
+                        Op op)
+        {
+            size_t done = 0;
+            while (done < n)
+            {
+                size_t chunk = std::min(n - done, limiter.maxChunk());
+                limiter.acquire(chunk, priority);
+                ssize_t r = op(buf + done, chunk, done);
+                if (r == -1)
+                {
+                    return -1;
+                }
+                done += size_t(r);
+                if (size_t(r) < chunk)
+                {
+                    // EOF
+                    break;
+                }
+            }
+            return ssize_t(done);
+        }
+    }
+
+    ssize_t readFull(int fd, void *buf, size_t n, RateLimiter &limiter,
+                     RateLimiter::Priority priority)
+    {
+        return chunked(static_cast<char *>(buf), n, limiter, priority,
+                       [&](char *p, size_t chunk, size_t) {
+                           return readFull(fd, p, chunk);
+                       });
+    }
+
+    ssize_t writeFull(int fd, const void *buf, size_t n, RateLimiter &limiter,
+                      RateLimiter::Priority priority)
+    {
+        return chunked(static_cast<char *>(const_cast<void *>(buf)), n, limiter, priority,
+                       [&](char *p, size_t chunk, size_t) {
+                           return writeFull(fd, p, chunk);
+                       });
+    }
+
+    ssize_t preadFull(int fd, void *buf, size_t n, off_t offset, RateLimiter &limiter,
+                      RateLimiter::Priority priority)
+    {
+        return chunked(static_cast<char *>(buf), n, limiter, priority,
+                       [&](char *p, size_t chunk, size_t done) {
+                           return preadFull(fd, p, chunk, offset + off_t(done));
+                       });
+    }
+
+    ssize_t pwriteFull(int fd, const void *buf, size_t n, off_t offset, RateLimiter &limiter,
+                       RateLimiter::Priority priority)
+    {
+        return chunked(static_cast<char *>(const_cast<void *>(buf)), n, limiter, priority,
+                       [&](char *p, size_t chunk, size_t done) {
+                           return pwriteFull(fd, p, chunk, offset + off_t(done));
+                       });
+    }
+
+    ssize_t writevFull(int fd, iovec *iov, int count, RateLimiter &limiter,
+                       RateLimiter::Priority priority)
+    {
+        // Gather the buffers into writes of up to maxChunk bytes, splitting
+        // buffers across writes as needed
+        std::vector<iovec> chunk;
+        ssize_t total = 0;
+        int i = 0;
+        size_t offset = 0;
+        while (i < count)
+        {
+            chunk.clear();
+            size_t bytes = 0;
+            while (i < count && bytes < limiter.maxChunk())
+            {
+                size_t take = std::min(iov[i].iov_len - offset, limiter.maxChunk() - bytes);
+                chunk.push_back({static_cast<char *>(iov[i].iov_base) + offset, take});
+                bytes += take;
+                offset += take;
+                if (offset == iov[i].iov_len)
+                {
+                    ++i;
+                    offset = 0;
+                }
+            }
+            limiter.acquire(bytes, priority);
+            ssize_t r = writevFull(fd, chunk.data(), int(chunk.size()));
+            if (r == -1)
+            {
+                return -1;
+            }
+            total += r;
+        }
+        return total;
+    }
+
+    ssize_t copyFull(int fdIn, int fdOut, RateLimiter &limiter, RateLimiter::Priority priority)
+    {
+        std::vector<char> buffer(limiter.maxChunk());
+        ssize_t total = 0;
+        for (;;)
+        {
+            ssize_t n = readFull(fdIn, buffer.data(), buffer.size(), limiter, priority);
+            if (n == -1)
+            {
+                return -1;
+            }
+            if (n == 0)
+            {
+                break;
+            }
+            if (writeFull(fdOut, buffer.data(), size_t(n), limiter, priority) == -1)
+            {
+                return -1;
+            }
+            total += n;
+            if (size_t(n) < buffer.size())
+            {
+                break;
+            }
+        }
+        return total;
+    }
+
+    void writeFileAtomic(std::string filename, iovec *iov, int count, RateLimiter &limiter,
+                         RateLimiter::Priority priority, mode_t permissions)
+    {
+        auto rc = writeFileAtomicNoThrow(filename, iov, count, limiter, priority, permissions);
+        if (rc != 0)
+        {
+            auto msg = std::string(__func__) + "() failed to update " + filename;
+            throw std::system_error(rc, std::generic_category(), msg);
+        }
+    }
+
+    int writeFileAtomicNoThrow(std::string filename, iovec *iov, int count, RateLimiter &limiter,
+                               RateLimiter::Priority priority, mode_t permissions)
+    {
+        return writeFileAtomicWithNoThrow(AT_FDCWD, filename, [&](int fd) {
+            return writevFull(fd, iov, count, limiter, priority) != -1;
+        }, permissions);
+    }
+
+    ssize_t RateLimitedByteSource::read(void *buf, size_t n)
+    {
+        if (inner_ == nullptr)
+        {
+            return readFull(fd_, buf, n, limiter_, priority_);
+        }
+        return chunked(static_cast<char *>(buf), n, limiter_, priority_,
+                       [&](char *p, size_t chunk, size_t) {
+                           return inner_->read(p, chunk);
+                       });
+    }
+}
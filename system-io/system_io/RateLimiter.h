@@ -0,0 +1,231 @@
+#ifndef SYSTEM_IO_RATELIMITER_H
+#define SYSTEM_IO_RATELIMITER_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+
+#include "system_io/ByteSource.h"
+#include "system_io/FileUtil.h"
+
+/*
+ * Paces background I/O (compaction, backups, scans) so that it leaves the
+ * disk to latency-sensitive traffic.
+ *
+ * A RateLimiter holds two token buckets, one of bytes and one of operations,
+ * refilled at bytesPerSecond and opsPerSecond up to their burst sizes.
+ * acquire() takes the tokens for one operation, waiting until both buckets
+ * have them.  A request larger than the bucket is let through once the
+ * bucket is full and leaves it in debt, which later requests wait out, so
+ * the rate holds on average whatever the request sizes.
+ *
+ * Waiting requests are served in priority order, and in arrival order
+ * within a priority: a request only gets tokens once no request of a higher
+ * priority is waiting.  Lower priorities can therefore be starved by a
+ * steady stream of higher ones; give those their own limiter, or none, if
+ * that is not wanted.
+ *
+ * One limiter is shared by all the threads whose I/O it paces; it is
+ * thread-safe.  Below are paced versions of the FileUtil.h functions, and a
+ * ByteSource for LineReader and other readers of one.  They take at most
+ * Options::maxChunk bytes per acquire(), so large transfers are spread over
+ * time instead of arriving in one burst.
+ *
+ * Example:
+ *   RateLimiter::Options options;
+ *   options.bytesPerSecond = 50 << 20;
+ *   options.opsPerSecond = 200;
+ *   RateLimiter limiter(options);
+ *   readFile(path, contents, limiter, RateLimiter::Priority::kLow);
+ */
+
+namespace sysio
+{
+    class RateLimiter
+    {
+    public:
+        enum class Priority
+        {
+            kHigh,
+            kNormal,
+            kLow,
+        };
+
+        static constexpr size_t kNumPriorities = 3;
+
+        struct Options
+        {
+            // 0 for no limit
+            double bytesPerSecond = 0;
+            double opsPerSecond = 0;
+            // Bucket sizes: what may go through at once after a pause.  0
+            // for a tenth of a second's worth (at least one operation).
+            double burstBytes = 0;
+            double burstOps = 0;
+            // Largest transfer the paced functions make per acquire()
+            size_t maxChunk = 1 << 20;
+        };
+
+        struct Stats
+        {
+            uint64_t bytes = 0;
+            uint64_t ops = 0;
+            // Per priority: acquire() calls that had to wait, and how long
+            // they waited in all
+            uint64_t throttled[kNumPriorities] = {};
+            std::chrono::nanoseconds throttledTime[kNumPriorities] = {};
+        };
+
+        explicit RateLimiter(const Options &options);
+
+        RateLimiter(const RateLimiter &) = delete;
+
+        RateLimiter &operator=(const RateLimiter &) = delete;
+
+        /*
+         * Blocks until one operation of bytes bytes may go ahead.
+         */
+        void acquire(size_t bytes, Priority priority = Priority::kNormal);
+
+        size_t maxChunk() const
+        {
+            return options_.maxChunk;
+        }
+
+        Stats stats() const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        // Adds the tokens earned since the last refill
+        void refill(Clock::time_point now);
+
+        // Tokens an operation of bytes bytes needs before it may go ahead
+        double bytesNeeded(size_t bytes) const;
+
+        // How long until the buckets hold the tokens an operation of bytes
+        // bytes needs; zero if they do
+        Clock::duration timeToAcquire(size_t bytes) const;
+
+        Options options_;
+        double burstBytes_;
+        double burstOps_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        // Negative while in debt
+        double bytes_;
+        double ops_;
+        Clock::time_point refilled_;
+        // Per priority: waiting requests, and the tickets of the next request
+        // to arrive and of the one to serve
+        size_t waiting_[kNumPriorities] = {};
+        uint64_t nextTicket_[kNumPriorities] = {};
+        uint64_t serving_[kNumPriorities] = {};
+        Stats stats_;
+    };
+
+    /*
+     * Paced readFull(), writeFull(), preadFull(), pwriteFull() and
+     * writevFull(); same contracts.
+     */
+    ssize_t readFull(int fd, void *buf, size_t n, RateLimiter &limiter,
+                     RateLimiter::Priority priority = RateLimiter::Priority::kNormal);
+
+    ssize_t writeFull(int fd, const void *buf, size_t n, RateLimiter &limiter,
+                      RateLimiter::Priority priority = RateLimiter::Priority::kNormal);
+
+    ssize_t preadFull(int fd, void *buf, size_t n, off_t offset, RateLimiter &limiter,
+                      RateLimiter::Priority priority = RateLimiter::Priority::kNormal);
+
+    ssize_t pwriteFull(int fd, const void *buf, size_t n, off_t offset, RateLimiter &limiter,
+                       RateLimiter::Priority priority = RateLimiter::Priority::kNormal);
+
+    ssize_t writevFull(int fd, iovec *iov, int count, RateLimiter &limiter,
+                       RateLimiter::Priority priority = RateLimiter::Priority::kNormal);
+
+    /*
+     * Copies fdIn from its current offset to EOF into fdOut, through a
+     * buffer of limiter.maxChunk() bytes.  Each chunk is paced as a read and
+     * as a write.  Returns the number of bytes copied, or -1 and sets errno.
+     */
+    ssize_t copyFull(int fdIn, int fdOut, RateLimiter &limiter,
+                     RateLimiter::Priority priority = RateLimiter::Priority::kNormal);
+
+    /*
+     * Paced readFile() (see FileUtil.h).
+     */
+    template<class Container>
+    bool readFile(int fd, Container &out, RateLimiter &limiter,
+                  RateLimiter::Priority priority = RateLimiter::Priority::kNormal,
+                  size_t num_bytes = std::numeric_limits<size_t>::max())
+    {
+        return detail::readFileWith(fd, out, num_bytes, [&](int f, void *buf, size_t n) {
+            return readFull(f, buf, n, limiter, priority);
+        });
+    }
+
+    template<class Container>
+    bool readFile(const char *file_name, Container &out, RateLimiter &limiter,
+                  RateLimiter::Priority priority = RateLimiter::Priority::kNormal,
+                  size_t num_bytes = std::numeric_limits<size_t>::max())
+    {
+        const auto fd = openNoInt(file_name, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            return false;
+        }
+        SCOPE_EXIT
+        {
+            // Ignore errors when closing the file
+            closeNoInt(fd);
+        };
+        return readFile(fd, out, limiter, priority, num_bytes);
+    }
+
+    /*
+     * Paced writeFileAtomic() (see FileUtil.h).
+     */
+    void writeFileAtomic(std::string filename, iovec *iov, int count, RateLimiter &limiter,
+                         RateLimiter::Priority priority = RateLimiter::Priority::kNormal,
+                         mode_t permissions = 0644);
+
+    int writeFileAtomicNoThrow(std::string filename, iovec *iov, int count, RateLimiter &limiter,
+                               RateLimiter::Priority priority = RateLimiter::Priority::kNormal,
+                               mode_t permissions = 0644);
+
+    /*
+     * Reads another ByteSource, or a file descriptor with readFull(), paced
+     * by a limiter.  Does not own either.
+     */
+    class RateLimitedByteSource : public ByteSource
+    {
+    public:
+        RateLimitedByteSource(ByteSource &inner, RateLimiter &limiter,
+                              RateLimiter::Priority priority = RateLimiter::Priority::kNormal) noexcept
+                : inner_(&inner), limiter_(limiter), priority_(priority)
+        {}
+
+        RateLimitedByteSource(int fd, RateLimiter &limiter,
+                              RateLimiter::Priority priority = RateLimiter::Priority::kNormal) noexcept
+                : fd_(fd), limiter_(limiter), priority_(priority)
+        {}
+
+        ssize_t read(void *buf, size_t n) override;
+
+    private:
+        ByteSource *inner_ = nullptr;
+        int fd_ = -1;
+        RateLimiter &limiter_;
+        RateLimiter::Priority priority_;
+    };
+}
+
+#endif //SYSTEM_IO_RATELIMITER_H
@@ -0,0 +1,341 @@
+#include "system_io/RecordLog.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "system_io/Crc32c.h"
+#include "system_io/Exception.h"
+#include "system_io/FileUtil.h"
+#include "system_io/ScopeGuard.h"
+#include "system_io/detail/Page.h"
+
+namespace sysio
+{
+    namespace
+    {
+        const char kMagic[8] = {'S', 'Y', 'S', 'I', 'O', 'L', 'O', 'G'};
+        constexpr uint32_t kVersion = 1;
+        // Offset of the committed offset (and its CRC) in the file header
+        constexpr off_t kCommittedOffset = 16;
+
+        template<class T>
+        T loadLE(const char *p)
+        {
+            T v;
+            memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            v = sizeof(T) == 4 ? T(__builtin_bswap32(uint32_t(v)))
+                               : T(__builtin_bswap64(uint64_t(v)));
+#endif
+            return v;
+        }
+
+        template<class T>
+        void storeLE(char *p, T v)
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            v = sizeof(T) == 4 ? T(__builtin_bswap32(uint32_t(v)))
+                               : T(__builtin_bswap64(uint64_t(v)));
+#endif
+            memcpy(p, &v, sizeof(v));
+        }
+
+        void encodeCommitted(char *p, uint64_t committed)
+        {
+            storeLE<uint64_t>(p, committed);
+            storeLE<uint32_t>(p + 8, crc32c(p, 8));
+            storeLE<uint32_t>(p + 12, 0);
+        }
+
+        void encodeHeader(char *p, uint64_t committed)
+        {
+            memcpy(p, kMagic, sizeof(kMagic));
+            storeLE<uint32_t>(p + 8, kVersion);
+            storeLE<uint32_t>(p + 12, 0);
+            encodeCommitted(p + kCommittedOffset, committed);
+        }
+
+        // Returns the committed offset recorded in the header, or the end of
+        // the header if it cannot be trusted.  Throws if this is not a log.
+        uint64_t decodeHeader(const char *p, uint64_t fileSize)
+        {
+            if (memcmp(p, kMagic, sizeof(kMagic)) != 0 ||
+                loadLE<uint32_t>(p + 8) != kVersion)
+            {
+                throwSystemErrorExplicit(EBADMSG, "not a record log");
+            }
+            const char *c = p + kCommittedOffset;
+            uint64_t committed = loadLE<uint64_t>(c);
+            if (loadLE<uint32_t>(c + 8) != crc32c(c, 8) ||
+                committed < kRecordLogHeaderSize || committed > fileSize)
+            {
+                return kRecordLogHeaderSize;
+            }
+            return committed;
+        }
+
+        uint32_t frameCrc(const char *lengthField, const void *payload, size_t n)
+        {
+            return crc32c(payload, n, crc32c(lengthField, 4));
+        }
+
+        // Validates the frame at p (with avail bytes left in the file).
+        // Returns the payload length, or -1 if the frame is torn or corrupt.
+        int64_t checkFrame(const char *p, uint64_t avail)
+        {
+            if (avail < kRecordFrameHeaderSize)
+            {
+                return -1;
+            }
+            uint32_t length = loadLE<uint32_t>(p);
+            if (length > kRecordLogMaxRecordSize ||
+                length > avail - kRecordFrameHeaderSize)
+            {
+                return -1;
+            }
+            if (loadLE<uint32_t>(p + 4) != frameCrc(p, p + kRecordFrameHeaderSize, length))
+            {
+                return -1;
+            }
+            return length;
+        }
+    }
+
+    RecordLogWriter::RecordLogWriter(const std::string &path)
+            : RecordLogWriter(path, Options())
+    {}
+
+    RecordLogWriter::RecordLogWriter(const std::string &path, Options options)
+            : options_(options),
+              file_(path, O_RDWR | O_CREAT | O_CLOEXEC, options.mode)
+    {
+        CHECK_GT(options_.batchBytes, kRecordFrameHeaderSize);
+        options_.copyThreshold = std::min(
+                options_.copyThreshold, options_.batchBytes - kRecordFrameHeaderSize);
+        staging_.resize(options_.batchBytes);
+        recover();
+    }
+
+    RecordLogWriter::~RecordLogWriter()
+    {
+        try
+        {
+            flush();
+        } catch (const std::exception &)
+        {
+            // nothing we can do; the records are lost
+        }
+    }
+
+    void RecordLogWriter::recover()
+    {
+        struct stat st;
+        checkUnixError(fstat(file_.fd(), &st), "fstat() failed");
+        uint64_t fileSize = uint64_t(st.st_size);
+
+        if (fileSize == 0)
+        {
+            char header[kRecordLogHeaderSize];
+            encodeHeader(header, kRecordLogHeaderSize);
+            ssize_t r = writeFull(file_.fd(), header, sizeof(header));
+            checkUnixError(r, "write() of record log header failed");
+            recovery_.scanStart = recovery_.validEnd = kRecordLogHeaderSize;
+            written_ = end_ = kRecordLogHeaderSize;
+            return;
+        }
+        if (fileSize < kRecordLogHeaderSize)
+        {
+            throwSystemErrorExplicit(EBADMSG, "not a record log (short header)");
+        }
+
+        char header[kRecordLogHeaderSize];
+        ssize_t r = preadFull(file_.fd(), header, sizeof(header), 0);
+        checkUnixError(r, "pread() of record log header failed");
+        uint64_t committed = decodeHeader(header, fileSize);
+
+        // Only map the part of the file after the committed offset.
+        uint64_t mapStart = committed & ~uint64_t(detail::pageSize() - 1);
+        size_t mapLen = size_t(fileSize - mapStart);
+        uint64_t validEnd = committed;
+        uint64_t count = 0;
+        if (committed < fileSize)
+        {
+            void *map = mmap(nullptr, mapLen, PROT_READ, MAP_SHARED, file_.fd(), off_t(mapStart));
+            if (map == MAP_FAILED)
+            {
+                throwSystemError("mmap() of record log tail failed");
+            }
+            SCOPE_EXIT
+            {
+                munmap(map, mapLen);
+            };
+            madvise(map, mapLen, MADV_SEQUENTIAL);
+
+            const char *base = static_cast<const char *>(map);
+            int64_t length;
+            while ((length = checkFrame(
+                    base + (validEnd - mapStart), fileSize - validEnd)) >= 0)
+            {
+                validEnd += kRecordFrameHeaderSize + uint64_t(length);
+                ++count;
+            }
+        }
+
+        if (validEnd < fileSize)
+        {
+            checkUnixError(ftruncate(file_.fd(), off_t(validEnd)),
+                           "ftruncate() of torn record log tail failed");
+        }
+        checkUnixError(lseek(file_.fd(), off_t(validEnd), SEEK_SET), "lseek() failed");
+
+        recovery_.scanStart = committed;
+        recovery_.validEnd = validEnd;
+        recovery_.truncatedBytes = fileSize - validEnd;
+        recovery_.recordsRecovered = count;
+        written_ = end_ = validEnd;
+    }
+
+    void RecordLogWriter::stage(const void *data, size_t n)
+    {
+        char *dst = staging_.data() + stagingUsed_;
+        memcpy(dst, data, n);
+        if (!iov_.empty() &&
+            static_cast<char *>(iov_.back().iov_base) + iov_.back().iov_len == dst)
+        {
+            iov_.back().iov_len += n;
+        } else
+        {
+            iov_.push_back({dst, n});
+        }
+        stagingUsed_ += n;
+        end_ += n;
+    }
+
+    void RecordLogWriter::append(const void *data, size_t n)
+    {
+        CHECK_LE(n, kRecordLogMaxRecordSize) << "record too large";
+
+        char frame[kRecordFrameHeaderSize];
+        storeLE<uint32_t>(frame, uint32_t(n));
+        storeLE<uint32_t>(frame + 4, frameCrc(frame, data, n));
+
+        if (n >= options_.copyThreshold)
+        {
+            if (stagingUsed_ + sizeof(frame) > staging_.size())
+            {
+                flush();
+            }
+            stage(frame, sizeof(frame));
+            iov_.push_back({const_cast<void *>(data), n});
+            end_ += n;
+            // data is only borrowed: write it out before returning
+            flush();
+            return;
+        }
+
+        if (stagingUsed_ + sizeof(frame) + n > staging_.size())
+        {
+            flush();
+        }
+        stage(frame, sizeof(frame));
+        stage(data, n);
+    }
+
+    void RecordLogWriter::flush()
+    {
+        if (iov_.empty())
+        {
+            return;
+        }
+        ssize_t r = writevFull(file_.fd(), iov_.data(), int(iov_.size()));
+        iov_.clear();
+        stagingUsed_ = 0;
+        if (r == -1 || uint64_t(r) != end_ - written_)
+        {
+            int err = r == -1 ? errno : EIO;
+            // Drop the staged records and any partial write, so that later
+            // appends do not land behind a torn frame.
+            end_ = written_;
+            if (ftruncate(file_.fd(), off_t(written_)) == 0)
+            {
+                lseek(file_.fd(), off_t(written_), SEEK_SET);
+            }
+            throwSystemErrorExplicit(err, "writev() to record log failed");
+        }
+        written_ = end_;
+    }
+
+    void RecordLogWriter::sync()
+    {
+        flush();
+        checkUnixError(fdatasync(file_.fd()), "fdatasync() failed");
+
+        // Everything up to written_ is now durable.  The header update itself
+        // becomes durable with the next sync; until then recovery just scans
+        // a little more.
+        char committed[kRecordLogHeaderSize - kCommittedOffset];
+        encodeCommitted(committed, written_);
+        ssize_t r = pwriteFull(file_.fd(), committed, sizeof(committed), kCommittedOffset);
+        checkUnixError(r, "pwrite() of record log header failed");
+    }
+
+    RecordLogReader::RecordLogReader(const std::string &path)
+            : file_(path, O_RDONLY | O_CLOEXEC)
+    {
+        struct stat st;
+        checkUnixError(fstat(file_.fd(), &st), "fstat() failed");
+        size_ = uint64_t(st.st_size);
+        if (size_ < kRecordLogHeaderSize)
+        {
+            throwSystemErrorExplicit(EBADMSG, "not a record log (short header)");
+        }
+
+        void *map = mmap(nullptr, size_t(size_), PROT_READ, MAP_SHARED, file_.fd(), 0);
+        if (map == MAP_FAILED)
+        {
+            throwSystemError("mmap() of record log failed");
+        }
+        base_ = static_cast<const char *>(map);
+        madvise(map, size_t(size_), MADV_SEQUENTIAL);
+        SCOPE_FAIL
+        {
+            munmap(map, size_t(size_));
+        };
+        decodeHeader(base_, size_);
+    }
+
+    RecordLogReader::~RecordLogReader()
+    {
+        munmap(const_cast<char *>(base_), size_t(size_));
+    }
+
+    RecordLogReader::State RecordLogReader::next(const char **data, size_t *n)
+    {
+        if (corrupt_)
+        {
+            return kCorrupt;
+        }
+        if (offset_ == size_)
+        {
+            return kEnd;
+        }
+        const char *frame = base_ + offset_;
+        int64_t length = checkFrame(frame, size_ - offset_);
+        if (length < 0)
+        {
+            corrupt_ = true;
+            return kCorrupt;
+        }
+        *data = frame + kRecordFrameHeaderSize;
+        *n = size_t(length);
+        offset_ += kRecordFrameHeaderSize + uint64_t(length);
+        return kRecord;
+    }
+}
@@ -0,0 +1,189 @@
+#ifndef SYSTEM_IO_RECORDLOG_H
+#define SYSTEM_IO_RECORDLOG_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "system_io/File.h"
+
+/*
+ * Append-only log of length-prefixed, checksummed records.
+ *
+ * Layout:
+ *
+ *   file header (32 bytes)
+ *     magic "SYSIOLOG", version, committed offset + CRC32C of that offset
+ *   records, back to back
+ *     uint32 length | uint32 CRC32C(length, payload) | payload
+ *
+ * All integers are little-endian.  The committed offset is the end of the
+ * prefix known to be durable (updated by RecordLogWriter::sync()), so recovery
+ * only has to validate the frames written after it: it costs time
+ * proportional to the unsynced tail, not to the file.
+ */
+
+namespace sysio
+{
+    constexpr size_t kRecordLogHeaderSize = 32;
+    constexpr size_t kRecordFrameHeaderSize = 8;
+    constexpr uint32_t kRecordLogMaxRecordSize = 1u << 30;
+
+    /*
+     * Appends records to a log, batching them into writevFull() calls.
+     *
+     * Opening an existing log recovers it: frames after the committed offset
+     * are validated and a torn or corrupt tail is truncated away.
+     *
+     * Not thread-safe.  Throws std::system_error on I/O errors.
+     */
+    class RecordLogWriter
+    {
+    public:
+        struct Options
+        {
+            // Bytes of small records to stage before writing them out.
+            size_t batchBytes = 1 << 20;
+            // Records at least this large are not copied into the staging
+            // buffer; they are written straight from the caller's memory.
+            size_t copyThreshold = 4096;
+            mode_t mode = 0644;
+        };
+
+        struct Recovery
+        {
+            // Offset the scan started at (the committed offset).
+            uint64_t scanStart = 0;
+            // End of the last valid frame; the log now ends here.
+            uint64_t validEnd = 0;
+            // Bytes dropped from the tail.
+            uint64_t truncatedBytes = 0;
+            // Valid frames found after scanStart.
+            uint64_t recordsRecovered = 0;
+        };
+
+        explicit RecordLogWriter(const std::string &path);
+
+        RecordLogWriter(const std::string &path, Options options);
+
+        RecordLogWriter(const RecordLogWriter &) = delete;
+
+        RecordLogWriter &operator=(const RecordLogWriter &) = delete;
+
+        /*
+         * Flushes pending records; errors are ignored.
+         */
+        ~RecordLogWriter();
+
+        /*
+         * Append a record.  Small records are staged and written by a later
+         * flush(); larger ones are written (with everything staged before
+         * them) before append() returns.
+         */
+        void append(const void *data, size_t n);
+
+        void append(const std::string &record)
+        {
+            append(record.data(), record.size());
+        }
+
+        /*
+         * Write out all staged records.
+         */
+        void flush();
+
+        /*
+         * flush(), fdatasync() and advance the committed offset.
+         */
+        void sync();
+
+        /*
+         * Logical end of the log, including staged records.
+         */
+        uint64_t size() const
+        {
+            return end_;
+        }
+
+        const Recovery &recovery() const
+        {
+            return recovery_;
+        }
+
+    private:
+        void recover();
+
+        void stage(const void *data, size_t n);
+
+        Options options_;
+        File file_;
+        Recovery recovery_;
+
+        // Staging buffer: never reallocated, so iov_ can point into it.
+        std::vector<char> staging_;
+        size_t stagingUsed_ = 0;
+        std::vector<iovec> iov_;
+
+        uint64_t written_ = 0; // file offset after the last flush
+        uint64_t end_ = 0;     // written_ + staged bytes
+    };
+
+    /*
+     * Scans a log sequentially over a read-only mmap.  Records are returned as
+     * pointers into the mapping, valid for the lifetime of the reader.
+     *
+     * Only the bytes present when the reader was opened are visible.
+     */
+    class RecordLogReader
+    {
+    public:
+        enum State
+        {
+            kRecord,
+            kEnd,
+            // A frame failed validation at offset(); the rest of the log is
+            // not trusted.  This is expected at the tail of a log that was
+            // not recovered after a crash.
+            kCorrupt,
+        };
+
+        explicit RecordLogReader(const std::string &path);
+
+        RecordLogReader(const RecordLogReader &) = delete;
+
+        RecordLogReader &operator=(const RecordLogReader &) = delete;
+
+        ~RecordLogReader();
+
+        /*
+         * Read the next record into [*data, *data + *n).
+         */
+        State next(const char **data, size_t *n);
+
+        /*
+         * Offset of the next frame (or of the corrupt frame).
+         */
+        uint64_t offset() const
+        {
+            return offset_;
+        }
+
+        uint64_t fileSize() const
+        {
+            return size_;
+        }
+
+    private:
+        File file_;
+        const char *base_ = nullptr;
+        uint64_t size_ = 0;
+        uint64_t offset_ = kRecordLogHeaderSize;
+        bool corrupt_ = false;
+    };
+}
+
+#endif //SYSTEM_IO_RECORDLOG_H
@@ -0,0 +1,207 @@
+#ifndef SYSTEM_IO_TASK_H
+#define SYSTEM_IO_TASK_H
+
+#if __cplusplus < 202002L
+#error "Task.h requires C++20; build with BUILD_CORO and link system_io_coro"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include <glog/logging.h>
+
+/*
+ * Minimal lazily started coroutine type for the asynchronous I/O API.
+ *
+ * A Task<T> does not run until it is co_awaited (or passed to syncWait(),
+ * see IoBackend.h); it then runs on the awaiting thread until its first
+ * suspension, and resumes its awaiter when it finishes, by symmetric
+ * transfer.  Exceptions propagate to the awaiter.
+ */
+
+namespace sysio
+{
+    template<class T>
+    class Task;
+
+    namespace detail
+    {
+        class TaskPromiseBase
+        {
+        public:
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            // Resumes the awaiter, if any
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept
+                {
+                    return false;
+                }
+
+                template<class Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+                {
+                    auto continuation = h.promise().continuation_;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept
+                {}
+            };
+
+            FinalAwaiter final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void unhandled_exception() noexcept
+            {
+                exception_ = std::current_exception();
+            }
+
+            void setContinuation(std::coroutine_handle<> continuation) noexcept
+            {
+                continuation_ = continuation;
+            }
+
+        protected:
+            void rethrowIfFailed()
+            {
+                if (exception_)
+                {
+                    std::rethrow_exception(exception_);
+                }
+            }
+
+        private:
+            std::coroutine_handle<> continuation_;
+            std::exception_ptr exception_;
+        };
+
+        template<class T>
+        class TaskPromise : public TaskPromiseBase
+        {
+        public:
+            Task<T> get_return_object() noexcept;
+
+            template<class U>
+            void return_value(U &&value)
+            {
+                value_.emplace(std::forward<U>(value));
+            }
+
+            T result()
+            {
+                rethrowIfFailed();
+                return std::move(*value_);
+            }
+
+        private:
+            std::optional<T> value_;
+        };
+
+        template<>
+        class TaskPromise<void> : public TaskPromiseBase
+        {
+        public:
+            Task<void> get_return_object() noexcept;
+
+            void return_void() noexcept
+            {}
+
+            void result()
+            {
+                rethrowIfFailed();
+            }
+        };
+    }
+
+    template<class T = void>
+    class Task
+    {
+    public:
+        typedef detail::TaskPromise<T> promise_type;
+
+        Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr))
+        {}
+
+        Task &operator=(Task &&other) noexcept
+        {
+            std::swap(handle_, other.handle_);
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+        }
+
+        bool done() const
+        {
+            return !handle_ || handle_.done();
+        }
+
+        auto operator co_await() noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() noexcept
+                {
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+                {
+                    handle.promise().setContinuation(awaiter);
+                    return handle;
+                }
+
+                T await_resume()
+                {
+                    return handle.promise().result();
+                }
+            };
+            CHECK(handle_) << "awaiting an empty Task";
+            return Awaiter{handle_};
+        }
+
+    private:
+        friend class detail::TaskPromise<T>;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle)
+        {}
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    namespace detail
+    {
+        template<class T>
+        Task<T> TaskPromise<T>::get_return_object() noexcept
+        {
+            return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept
+        {
+            return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+        }
+    }
+}
+
+#endif //SYSTEM_IO_TASK_H
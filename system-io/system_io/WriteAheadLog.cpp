@@ -0,0 +1,157 @@
+#include "system_io/WriteAheadLog.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace sysio
+{
+    WriteAheadLog::WriteAheadLog(const std::string &path)
+            : WriteAheadLog(path, Options())
+    {}
+
+    WriteAheadLog::WriteAheadLog(const std::string &path, const Options &options)
+            : options_(options),
+              writer_(path, options.log),
+              durableLsn_(writer_.size())
+    {
+        CHECK_GT(options.maxBatchBytes, 0u);
+        thread_ = std::thread([this] { run(); });
+    }
+
+    WriteAheadLog::~WriteAheadLog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_one();
+        thread_.join();
+    }
+
+    std::future<uint64_t> WriteAheadLog::append(std::string record)
+    {
+        CHECK_LE(record.size(), kRecordLogMaxRecordSize) << "record too large";
+        Node *node = new Node{nullptr, std::move(record), 0, std::promise<uint64_t>()};
+        auto future = node->promise.get_future();
+
+        Node *head = head_.load(std::memory_order_relaxed);
+        do
+        {
+            node->next = head;
+        } while (!head_.compare_exchange_weak(head, node, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed));
+
+        // Only take the lock if the log thread may be waiting.  Pairs with
+        // the store to sleeping_ and load of head_ in run(): either it sees
+        // our node, or we see it sleeping.
+        if (sleeping_.load(std::memory_order_seq_cst))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_.notify_one();
+        }
+        return future;
+    }
+
+    void WriteAheadLog::run()
+    {
+        for (;;)
+        {
+            Node *list = head_.exchange(nullptr, std::memory_order_acquire);
+            if (!list)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                sleeping_.store(true, std::memory_order_seq_cst);
+                while (head_.load(std::memory_order_seq_cst) == nullptr && !stopping_)
+                {
+                    wakeup_.wait(lock);
+                }
+                sleeping_.store(false, std::memory_order_relaxed);
+                if (head_.load(std::memory_order_relaxed) == nullptr)
+                {
+                    return; // stopping, and all written
+                }
+                continue;
+            }
+
+            // Newest first: reverse into append order
+            Node *fifo = nullptr;
+            while (list)
+            {
+                Node *next = list->next;
+                list->next = fifo;
+                fifo = list;
+                list = next;
+            }
+            commit(fifo);
+        }
+    }
+
+    void WriteAheadLog::commit(Node *list)
+    {
+        while (list)
+        {
+            Node *batchEnd = list;
+            if (!error_)
+            {
+                try
+                {
+                    size_t bytes = 0;
+                    uint64_t count = 0;
+                    for (; batchEnd && (count == 0 || bytes < options_.maxBatchBytes);
+                           batchEnd = batchEnd->next)
+                    {
+                        writer_.append(batchEnd->record);
+                        batchEnd->lsn = writer_.size();
+                        bytes += batchEnd->record.size();
+                        ++count;
+                    }
+                    writer_.sync();
+
+                    durableLsn_.store(writer_.size(), std::memory_order_release);
+                    records_.fetch_add(count, std::memory_order_relaxed);
+                    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+                    syncs_.fetch_add(1, std::memory_order_relaxed);
+                    if (count > maxBatchRecords_.load(std::memory_order_relaxed))
+                    {
+                        maxBatchRecords_.store(count, std::memory_order_relaxed);
+                    }
+                } catch (const std::exception &)
+                {
+                    error_ = std::current_exception();
+                }
+            }
+            if (error_)
+            {
+                // Fail everything left, including records of this batch that
+                // made it into the file: they are not known to be durable
+                batchEnd = nullptr;
+            }
+
+            while (list != batchEnd)
+            {
+                Node *node = list;
+                list = list->next;
+                if (error_)
+                {
+                    node->promise.set_exception(error_);
+                } else
+                {
+                    node->promise.set_value(node->lsn);
+                }
+                delete node;
+            }
+        }
+    }
+
+    WriteAheadLog::Stats WriteAheadLog::stats() const
+    {
+        Stats stats;
+        stats.records = records_.load(std::memory_order_relaxed);
+        stats.bytes = bytes_.load(std::memory_order_relaxed);
+        stats.syncs = syncs_.load(std::memory_order_relaxed);
+        stats.maxBatchRecords = maxBatchRecords_.load(std::memory_order_relaxed);
+        return stats;
+    }
+}
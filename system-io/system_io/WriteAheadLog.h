@@ -0,0 +1,137 @@
+#ifndef SYSTEM_IO_WRITEAHEADLOG_H
+#define SYSTEM_IO_WRITEAHEADLOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "system_io/RecordLog.h"
+
+/*
+ * Durable appends to one record log (see RecordLog.h) from many threads,
+ * with group commit.
+ *
+ * Producers push records onto a lock-free queue and get a future.  A single
+ * log thread takes everything queued at once, appends it with one
+ * writevFull() and makes it durable with one fdatasync(), then fulfils the
+ * futures.  While it waits for the disk, the next batch queues up, so the
+ * cost of a flush is shared by all the producers that arrived during the
+ * previous one instead of serializing them.
+ *
+ * A record's LSN (log sequence number) is the log offset just past it; a
+ * future resolves to it once the record is durable, and durableLsn() is the
+ * LSN up to which everything is.  If writing or syncing fails, the futures
+ * of that batch and of every later record throw the error: after a failed
+ * fdatasync() the log cannot be trusted.
+ *
+ * Example:
+ *   WriteAheadLog wal(path);
+ *   uint64_t lsn = wal.append(record).get();  // durable now
+ */
+
+namespace sysio
+{
+    class WriteAheadLog
+    {
+    public:
+        struct Options
+        {
+            RecordLogWriter::Options log;
+            // Most bytes of records written by one fdatasync(); more is left
+            // for the next one
+            size_t maxBatchBytes = 8 << 20;
+        };
+
+        struct Stats
+        {
+            uint64_t records = 0;
+            uint64_t bytes = 0;
+            // Batches written, each with one fdatasync()
+            uint64_t syncs = 0;
+            // Most records in one batch
+            uint64_t maxBatchRecords = 0;
+        };
+
+        /*
+         * Opens (and recovers) or creates the log at path, and starts the log
+         * thread.  Throws std::system_error.
+         */
+        explicit WriteAheadLog(const std::string &path);
+
+        WriteAheadLog(const std::string &path, const Options &options);
+
+        WriteAheadLog(const WriteAheadLog &) = delete;
+
+        WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+        /*
+         * Writes and syncs the records still queued, then stops the log
+         * thread.  No append() may run concurrently.
+         */
+        ~WriteAheadLog();
+
+        /*
+         * Queues a record; thread-safe and lock-free.  The future resolves to
+         * the record's LSN once it is durable.
+         */
+        std::future<uint64_t> append(std::string record);
+
+        std::future<uint64_t> append(const void *data, size_t n)
+        {
+            return append(std::string(static_cast<const char *>(data), n));
+        }
+
+        uint64_t durableLsn() const
+        {
+            return durableLsn_.load(std::memory_order_acquire);
+        }
+
+        Stats stats() const;
+
+    private:
+        struct Node
+        {
+            Node *next;
+            std::string record;
+            uint64_t lsn;
+            std::promise<uint64_t> promise;
+        };
+
+        void run();
+
+        // Writes and syncs the records of list (oldest first), at most
+        // maxBatchBytes of them at a time
+        void commit(Node *list);
+
+        Options options_;
+        RecordLogWriter writer_;
+        // Set after a write or sync failed
+        std::exception_ptr error_;
+
+        // Queue: producers push onto this stack, the log thread takes all of
+        // it at once and reverses it
+        std::atomic<Node *> head_{nullptr};
+
+        // For the log thread to sleep while there is nothing to write
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::atomic<bool> sleeping_{false};
+        bool stopping_ = false;
+
+        std::atomic<uint64_t> durableLsn_;
+        std::atomic<uint64_t> records_{0};
+        std::atomic<uint64_t> bytes_{0};
+        std::atomic<uint64_t> syncs_{0};
+        std::atomic<uint64_t> maxBatchRecords_{0};
+
+        std::thread thread_;
+    };
+}
+
+#endif //SYSTEM_IO_WRITEAHEADLOG_H
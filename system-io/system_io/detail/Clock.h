@@ -0,0 +1,26 @@
+#ifndef SYSTEM_IO_DETAIL_CLOCK_H
+#define SYSTEM_IO_DETAIL_CLOCK_H
+
+#include <time.h>
+
+#include <cstdint>
+
+/*
+ * Internal: the clock the Stats of the library are timed with.
+ */
+
+namespace sysio
+{
+    namespace detail
+    {
+        // CLOCK_MONOTONIC, in nanoseconds
+        inline uint64_t nowNanos()
+        {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
+        }
+    }
+}
+
+#endif //SYSTEM_IO_DETAIL_CLOCK_H
@@ -0,0 +1,24 @@
+#ifndef SYSTEM_IO_DETAIL_PAGE_H
+#define SYSTEM_IO_DETAIL_PAGE_H
+
+#include <unistd.h>
+
+#include <cstddef>
+
+/*
+ * Internal: the page size, for code that maps files or aligns to pages.
+ */
+
+namespace sysio
+{
+    namespace detail
+    {
+        inline size_t pageSize()
+        {
+            static const size_t size = size_t(sysconf(_SC_PAGESIZE));
+            return size;
+        }
+    }
+}
+
+#endif //SYSTEM_IO_DETAIL_PAGE_H
@@ -0,0 +1,185 @@
+#include "system_io/AsyncFile.h"
+
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/IoBackend.h"
+#include "system_io/Task.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        enum class BackendKind {
+            kThreadPool,
+            kUring,
+        };
+
+        class AsyncFileTest : public ::testing::TestWithParam<BackendKind> {
+        protected:
+            void SetUp() override {
+                if (GetParam() == BackendKind::kUring) {
+                    if (!UringBackend::available()) {
+                        GTEST_SKIP() << "io_uring is not available";
+                    }
+                    backend_.reset(new UringBackend(8));
+                } else {
+                    backend_.reset(new ThreadPoolBackend(4));
+                }
+            }
+
+            std::unique_ptr<IoBackend> backend_;
+        };
+
+        std::string makeData(size_t n) {
+            std::string data(n, '\0');
+            uint32_t x = 11;
+            for (auto& c : data) {
+                x = x * 1103515245 + 12345;
+                c = char(x >> 16);
+            }
+            return data;
+        }
+
+        std::string contents(const File& f) {
+            std::string out;
+            char buf[65536];
+            off_t offset = 0;
+            ssize_t r;
+            while ((r = preadFull(f.fd(), buf, sizeof(buf), offset)) > 0) {
+                out.append(buf, size_t(r));
+                offset += r;
+            }
+            CHECK_ERR(r);
+            return out;
+        }
+
+        TEST_P(AsyncFileTest, WriteRead) {
+            File f = File::temporary();
+            AsyncFile file(f, *backend_);
+            const std::string data = makeData(1 << 20);
+
+            size_t n = syncWait(*backend_, [&]() -> Task<size_t> {
+                size_t written = co_await file.write(data.data(), data.size(), 0);
+                EXPECT_EQ(data.size(), written);
+                co_await file.fsync();
+                co_await file.fdatasync();
+                std::string in(data.size() + 100, '\0');
+                // Short only at EOF
+                size_t read = co_await file.read(&in[0], in.size(), 0);
+                in.resize(read);
+                EXPECT_EQ(data, in);
+                co_return read;
+            }());
+            EXPECT_EQ(data.size(), n);
+            EXPECT_EQ(data, contents(f));
+        }
+
+        // Coroutine lambdas must not capture when they outlive the full
+        // expression that calls them, so these are functions
+        Task<void> writeBlock(const AsyncFile& file, const char* data, size_t n, off_t offset) {
+            size_t written = co_await file.write(data, n, offset);
+            EXPECT_EQ(n, written);
+        }
+
+        Task<void> readBlock(const AsyncFile& file, std::string& block, size_t n, off_t offset) {
+            block.resize(n);
+            size_t read = co_await file.read(&block[0], n, offset);
+            EXPECT_EQ(n, read);
+        }
+
+        TEST_P(AsyncFileTest, ConcurrentRequests) {
+            File f = File::temporary();
+            AsyncFile file(f, *backend_);
+            // More requests than the ring has entries
+            const size_t kBlocks = 100;
+            const size_t kBlockSize = 4096;
+            const std::string data = makeData(kBlocks * kBlockSize);
+
+            std::vector<Task<void>> writes;
+            for (size_t i = 0; i < kBlocks; ++i) {
+                writes.push_back(writeBlock(file, data.data() + i * kBlockSize, kBlockSize,
+                                            off_t(i * kBlockSize)));
+            }
+            syncWaitAll(*backend_, std::move(writes));
+            EXPECT_EQ(data, contents(f));
+
+            std::vector<std::string> blocks(kBlocks);
+            std::vector<Task<void>> reads;
+            for (size_t i = 0; i < kBlocks; ++i) {
+                reads.push_back(readBlock(file, blocks[i], kBlockSize, off_t(i * kBlockSize)));
+            }
+            syncWaitAll(*backend_, std::move(reads));
+            for (size_t i = 0; i < kBlocks; ++i) {
+                EXPECT_EQ(data.substr(i * kBlockSize, kBlockSize), blocks[i]);
+            }
+        }
+
+        TEST_P(AsyncFileTest, ReadLine) {
+            File f = File::temporary();
+            std::vector<std::string> lines;
+            std::string data;
+            for (int i = 0; i < 1000; ++i) {
+                lines.push_back(std::string(size_t(i % 37), char('a' + i % 26)) + "\n");
+                data += lines.back();
+            }
+            // Longer than the buffer
+            lines.push_back(std::string(100, 'L') + "\n");
+            data += lines.back();
+            // No trailing newline
+            lines.push_back("last");
+            data += lines.back();
+            ASSERT_EQ(ssize_t(data.size()), writeFull(f.fd(), data.data(), data.size()));
+
+            AsyncFile file(f, *backend_);
+            AsyncLineReader reader(file, 16);
+            std::vector<std::string> out = syncWait(*backend_, [&]() -> Task<std::vector<std::string>> {
+                std::vector<std::string> result;
+                std::string line;
+                while (co_await reader.readLine(line)) {
+                    result.push_back(line);
+                }
+                co_return result;
+            }());
+            EXPECT_EQ(lines, out);
+        }
+
+        TEST_P(AsyncFileTest, Errors) {
+            File f = File::temporary();
+            File readOnly(("/proc/self/fd/" + std::to_string(f.fd())).c_str(), O_RDONLY);
+            AsyncFile file(readOnly, *backend_);
+            char buf[10] = {};
+            try {
+                syncWait(*backend_, [&]() -> Task<void> {
+                    co_await file.write(buf, sizeof(buf), 0);
+                }());
+                ADD_FAILURE() << "write to a read-only file succeeded";
+            } catch (const std::system_error& e) {
+                EXPECT_EQ(EBADF, e.code().value());
+            }
+
+            // The backend is still usable, and reads at EOF return 0
+            size_t n = syncWait(*backend_, [&]() -> Task<size_t> {
+                co_return co_await file.read(buf, sizeof(buf), 0);
+            }());
+            EXPECT_EQ(0u, n);
+        }
+
+        INSTANTIATE_TEST_SUITE_P(
+                Backends, AsyncFileTest,
+                ::testing::Values(BackendKind::kThreadPool, BackendKind::kUring));
+    }
+}
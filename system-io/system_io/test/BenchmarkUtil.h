@@ -0,0 +1,41 @@
+#ifndef SYSTEM_IO_TEST_BENCHMARKUTIL_H
+#define SYSTEM_IO_TEST_BENCHMARKUTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+
+namespace sysio
+{
+    namespace test
+    {
+        /*
+         * Runs fn() iterations times and returns the fastest run, in seconds.
+         */
+        template<class F>
+        double bestOf(int iterations, F fn) {
+            double best = std::numeric_limits<double>::max();
+            for (int i = 0; i < iterations; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                fn();
+                std::chrono::duration<double> elapsed =
+                        std::chrono::steady_clock::now() - start;
+                best = std::min(best, elapsed.count());
+            }
+            return best;
+        }
+
+        inline void printThroughput(const char* name, double bytes, double seconds) {
+            printf("%-48s %10.3f ms %10.2f MB/s\n",
+                   name, seconds * 1e3, bytes / seconds / (1 << 20));
+        }
+
+        inline void printRate(const char* name, double ops, double seconds) {
+            printf("%-48s %10.3f ms %10.2f Mop/s\n",
+                   name, seconds * 1e3, ops / seconds / 1e6);
+        }
+    }
+}
+
+#endif //SYSTEM_IO_TEST_BENCHMARKUTIL_H
@@ -0,0 +1,101 @@
+/*
+ * Compares checksumming inline with I/O against a separate pass over the
+ * buffer, for readFile-style loads and writeFileAtomic().  The file stays in
+ * the page cache, so the numbers reflect memory traffic, not the disk.
+ */
+
+#include "system_io/Checksum.h"
+
+#include <unistd.h>
+
+#include <string>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int64(size_mb, 256, "Size of the test file in MB");
+DEFINE_int32(iterations, 5, "Runs per measurement; the fastest one is reported");
+DEFINE_string(dir, "/tmp", "Directory for the test file");
+
+using namespace sysio;
+using namespace sysio::test;
+
+namespace
+{
+    const char* typeName(ChecksumType type) {
+        return type == ChecksumType::kCrc32c ? "crc32c" : "xxh3";
+    }
+
+    void readWhole(const std::string& path, std::string& out) {
+        int fd = openNoInt(path.c_str(), O_RDONLY | O_CLOEXEC);
+        PCHECK(fd != -1);
+        ssize_t n = readFull(fd, &out[0], out.size());
+        PCHECK(n == ssize_t(out.size()));
+        closeNoInt(fd);
+    }
+}
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const size_t size = size_t(FLAGS_size_mb) << 20;
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = char(i * 2654435761u >> 13);
+    }
+    const std::string path = FLAGS_dir + "/ChecksumBenchmark.dat";
+    std::string in(size, '\0');
+
+    double t = bestOf(FLAGS_iterations, [&] {
+        iovec iov{&data[0], data.size()};
+        writeFileAtomic(path, &iov, 1);
+    });
+    printThroughput("write, no checksum", size, t);
+    t = bestOf(FLAGS_iterations, [&] { readWhole(path, in); });
+    printThroughput("read, no checksum", size, t);
+
+    for (auto type : {ChecksumType::kCrc32c, ChecksumType::kXxh3}) {
+        if (!hasChecksum(type)) {
+            printf("%s: not available in this build\n", typeName(type));
+            continue;
+        }
+        std::string name;
+        uint64_t expected = 0;
+
+        t = bestOf(FLAGS_iterations, [&] {
+            expected = checksum(type, data.data(), data.size());
+            iovec iov{&data[0], data.size()};
+            writeFileAtomic(path, &iov, 1);
+        });
+        name = std::string("write, two-pass ") + typeName(type);
+        printThroughput(name.c_str(), size, t);
+
+        t = bestOf(FLAGS_iterations, [&] {
+            StreamingChecksum sum(type);
+            iovec iov{&data[0], data.size()};
+            writeFileAtomic(path, &iov, 1, sum);
+            CHECK_EQ(expected, sum.value());
+        });
+        name = std::string("write, inline ") + typeName(type);
+        printThroughput(name.c_str(), size, t);
+
+        t = bestOf(FLAGS_iterations, [&] {
+            readWhole(path, in);
+            CHECK_EQ(expected, checksum(type, in.data(), in.size()));
+        });
+        name = std::string("read, two-pass ") + typeName(type);
+        printThroughput(name.c_str(), size, t);
+
+        t = bestOf(FLAGS_iterations, [&] {
+            PCHECK(readFileVerified(path.c_str(), in, type, expected));
+        });
+        name = std::string("read, inline ") + typeName(type);
+        printThroughput(name.c_str(), size, t);
+    }
+
+    unlink(path.c_str());
+    return 0;
+}
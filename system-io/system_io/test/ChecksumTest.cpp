@@ -0,0 +1,189 @@
+#include "system_io/Checksum.h"
+
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/Crc32c.h"
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        std::string makeData(size_t n) {
+            std::string data(n, '\0');
+            uint32_t x = 12345;
+            for (auto& c : data) {
+                x = x * 1103515245 + 12345;
+                c = char(x >> 16);
+            }
+            return data;
+        }
+
+        std::vector<ChecksumType> supportedTypes() {
+            std::vector<ChecksumType> types;
+            for (auto type : {ChecksumType::kCrc32c, ChecksumType::kXxh3}) {
+                if (hasChecksum(type)) {
+                    types.push_back(type);
+                }
+            }
+            return types;
+        }
+
+        TEST(Checksum, StreamingMatchesOneShot) {
+            // larger than kChecksumChunkSize, and not a multiple of it
+            std::string data = makeData(3 * kChecksumChunkSize + 12345);
+            for (auto type : supportedTypes()) {
+                StreamingChecksum sum(type);
+                for (size_t off = 0, step = 1; off < data.size(); off += step, step = step * 3 + 1) {
+                    sum.update(data.data() + off, std::min(step, data.size() - off));
+                }
+                EXPECT_EQ(checksum(type, data.data(), data.size()), sum.value());
+
+                sum.reset();
+                EXPECT_EQ(checksum(type, "", 0), sum.value());
+            }
+            EXPECT_EQ(crc32c(data.data(), data.size()),
+                      checksum(ChecksumType::kCrc32c, data.data(), data.size()));
+        }
+
+        TEST(Checksum, Crc32cCombine) {
+            EXPECT_EQ(0xE3069283u, crc32c("123456789", 9));
+
+            // Both sides reach past the three-stream threshold (3 * 4096
+            // bytes) at some split points, and most are not multiples of 8
+            std::string data = makeData(5 * 4096 + 13);
+            const uint32_t whole = crc32c(data.data(), data.size());
+            for (size_t split : {size_t(0), size_t(1), size_t(7), size_t(8), size_t(13),
+                                 size_t(4095), size_t(3 * 4096), size_t(3 * 4096 + 1),
+                                 data.size() - 3 * 4096 - 5, data.size() - 1, data.size()}) {
+                const uint32_t a = crc32c(data.data(), split);
+                const uint32_t b = crc32c(data.data() + split, data.size() - split);
+                EXPECT_EQ(whole, crc32cCombine(a, b, data.size() - split)) << "split " << split;
+                // Seeding with the first part's value agrees too
+                EXPECT_EQ(whole, crc32c(data.data() + split, data.size() - split, a))
+                    << "split " << split;
+            }
+        }
+
+#ifdef SYSIO_HAVE_XXHASH
+        TEST(Checksum, Xxh3KnownValue) {
+            EXPECT_EQ(0x2D06800538D394C2ull, checksum(ChecksumType::kXxh3, "", 0));
+        }
+#endif
+
+        TEST(Checksum, InlineReadWrite) {
+            std::string data = makeData(2 * kChecksumChunkSize + 777);
+            for (auto type : supportedTypes()) {
+                const uint64_t expected = checksum(type, data.data(), data.size());
+                File tmp = File::temporary();
+
+                StreamingChecksum writeSum(type);
+                ASSERT_EQ(ssize_t(data.size()),
+                          writeFull(tmp.fd(), data.data(), data.size(), writeSum));
+                EXPECT_EQ(expected, writeSum.value());
+
+                CHECK_ERR(lseek(tmp.fd(), 0, SEEK_SET));
+                std::string in(data.size() + 100, '\0');
+                StreamingChecksum readSum(type);
+                ASSERT_EQ(ssize_t(data.size()), readFull(tmp.fd(), &in[0], in.size(), readSum));
+                in.resize(data.size());
+                EXPECT_EQ(data, in);
+                EXPECT_EQ(expected, readSum.value());
+            }
+        }
+
+        TEST(Checksum, InlineWritev) {
+            std::string a = makeData(kChecksumChunkSize + 1);
+            std::string b;
+            std::string c = makeData(3 * kChecksumChunkSize);
+            std::string all = a + b + c;
+            std::vector<iovec> iov = {
+                    {&a[0], a.size()}, {&b[0], b.size()}, {&c[0], c.size()}};
+
+            File tmp = File::temporary();
+            StreamingChecksum sum;
+            ASSERT_EQ(ssize_t(all.size()), writevFull(tmp.fd(), iov.data(), int(iov.size()), sum));
+            EXPECT_EQ(crc32c(all.data(), all.size()), sum.value());
+            // iov is left untouched
+            EXPECT_EQ(a.size(), iov[0].iov_len);
+
+            std::string in(all.size(), '\0');
+            ASSERT_EQ(ssize_t(all.size()), preadFull(tmp.fd(), &in[0], in.size(), 0));
+            EXPECT_EQ(all, in);
+        }
+
+        TEST(Checksum, WriteFileAtomicReturnsChecksum) {
+            TemporaryPath tmp("ChecksumTest");
+            std::string data = makeData(kChecksumChunkSize * 2 + 3);
+            for (auto type : supportedTypes()) {
+                iovec iov{&data[0], data.size()};
+                StreamingChecksum sum(type);
+                writeFileAtomic(tmp.path(), &iov, 1, sum);
+                EXPECT_EQ(checksum(type, data.data(), data.size()), sum.value());
+
+                std::string in;
+                EXPECT_TRUE(readFileVerified(tmp.c_str(), in, type, sum.value()));
+                EXPECT_EQ(data, in);
+
+                errno = 0;
+                EXPECT_FALSE(readFileVerified(tmp.c_str(), in, type, sum.value() + 1));
+                EXPECT_EQ(EBADMSG, errno);
+            }
+        }
+
+        TEST(Checksum, EmbeddedTrailer) {
+            TemporaryPath tmp("ChecksumTest");
+            for (size_t size : {size_t(0), size_t(10), kChecksumChunkSize, kChecksumChunkSize + 5}) {
+                std::string data = makeData(size);
+                for (auto type : supportedTypes()) {
+                    iovec iov{&data[0], data.size()};
+                    StreamingChecksum sum(type);
+                    writeFileAtomic(tmp.path(), &iov, 1, sum, true);
+
+                    std::vector<char> in;
+                    ASSERT_TRUE(readFileWithTrailer(tmp.c_str(), in, type));
+                    EXPECT_EQ(data, std::string(in.begin(), in.end()));
+                }
+            }
+        }
+
+        TEST(Checksum, EmbeddedTrailerDetectsCorruption) {
+            TemporaryPath tmp("ChecksumTest");
+            std::string data = makeData(100000);
+            iovec iov{&data[0], data.size()};
+            StreamingChecksum sum;
+            writeFileAtomic(tmp.path(), &iov, 1, sum, true);
+
+            std::string in;
+            if (hasChecksum(ChecksumType::kXxh3)) {
+                // wrong type in the trailer
+                errno = 0;
+                EXPECT_FALSE(readFileWithTrailer(tmp.c_str(), in, ChecksumType::kXxh3));
+                EXPECT_EQ(EBADMSG, errno);
+            }
+
+            File f(tmp.path(), O_RDWR);
+            char byte = 'x';
+            ASSERT_EQ(1, pwriteFull(f.fd(), &byte, 1, 5000));
+            errno = 0;
+            EXPECT_FALSE(readFileWithTrailer(tmp.c_str(), in, ChecksumType::kCrc32c));
+            EXPECT_EQ(EBADMSG, errno);
+
+            // no trailer at all
+            iov = {&data[0], data.size()};
+            writeFileAtomic(tmp.path(), &iov, 1);
+            errno = 0;
+            EXPECT_FALSE(readFileWithTrailer(tmp.c_str(), in, ChecksumType::kCrc32c));
+            EXPECT_EQ(EBADMSG, errno);
+        }
+    }
+}
@@ -0,0 +1,179 @@
+#include "system_io/Decompression.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/LineReader.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        std::vector<std::string> makeLines(size_t count) {
+            std::vector<std::string> lines;
+            for (size_t i = 0; i < count; ++i) {
+                // vary the length so lines straddle buffer and chunk boundaries
+                lines.push_back(
+                        "line " + std::to_string(i) + " " +
+                        std::string(i % 97, char('a' + i % 26)) + "\n");
+            }
+            return lines;
+        }
+
+        std::string join(const std::vector<std::string>& lines) {
+            std::string out;
+            for (const auto& line : lines) {
+                out += line;
+            }
+            return out;
+        }
+
+        File writeTemp(const std::string& data) {
+            File tmp = File::temporary();
+            CHECK_EQ(ssize_t(data.size()), writeFull(tmp.fd(), data.data(), data.size()));
+            CHECK_ERR(lseek(tmp.fd(), 0, SEEK_SET));
+            return tmp;
+        }
+
+        void expectLines(
+                ByteSource& source,
+                const std::vector<std::string>& expected,
+                size_t bufSize = 256) {
+            std::vector<char> buf(bufSize);
+            LineReader lr(source, buf.data(), buf.size());
+            std::string line;
+            for (const auto& e : expected) {
+                ASSERT_EQ(LineReader::kReading, lr.readLine(line));
+                EXPECT_EQ(e, line);
+            }
+            EXPECT_EQ(LineReader::kEof, lr.readLine(line));
+        }
+
+        TEST(Decompression, Uncompressed) {
+            auto lines = makeLines(1000);
+            File tmp = writeTemp(join(lines));
+            auto source = makeDecompressingSource(tmp.fd(), Compression::kNone);
+            expectLines(*source, lines);
+        }
+
+        TEST(Decompression, PipelinedSmallChunks) {
+            auto lines = makeLines(1000);
+            File tmp = writeTemp(join(lines));
+            PipelinedByteSource source(
+                    std::unique_ptr<ByteSource>(new FdByteSource(tmp.fd())), 37, 3);
+            expectLines(source, lines, 128);
+        }
+
+#ifdef SYSIO_HAVE_ZLIB
+        std::string gzip(const std::string& data) {
+            z_stream s;
+            memset(&s, 0, sizeof(s));
+            // 15 window bits, +16 for a gzip header
+            CHECK_EQ(Z_OK, deflateInit2(
+                    &s, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY));
+            std::string out(deflateBound(&s, data.size()), '\0');
+            s.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+            s.avail_in = uInt(data.size());
+            s.next_out = reinterpret_cast<Bytef*>(&out[0]);
+            s.avail_out = uInt(out.size());
+            CHECK_EQ(Z_STREAM_END, deflate(&s, Z_FINISH));
+            out.resize(s.total_out);
+            deflateEnd(&s);
+            return out;
+        }
+
+        TEST(Decompression, Gzip) {
+            auto lines = makeLines(20000);
+            File tmp = writeTemp(gzip(join(lines)));
+            for (bool pipelined : {false, true}) {
+                CHECK_ERR(lseek(tmp.fd(), 0, SEEK_SET));
+                auto source = makeDecompressingSource(
+                        tmp.fd(), Compression::kGzip, pipelined);
+                expectLines(*source, lines);
+            }
+        }
+
+        TEST(Decompression, GzipMultiMember) {
+            auto lines = makeLines(3000);
+            std::vector<std::string> first(lines.begin(), lines.begin() + 1000);
+            std::vector<std::string> second(lines.begin() + 1000, lines.end());
+            File tmp = writeTemp(gzip(join(first)) + gzip(join(second)));
+            auto source = makeDecompressingSource(tmp.fd(), Compression::kGzip);
+            expectLines(*source, lines);
+        }
+
+        TEST(Decompression, GzipTruncated) {
+            std::string compressed = gzip(join(makeLines(5000)));
+            File tmp = writeTemp(compressed.substr(0, compressed.size() / 2));
+            for (bool pipelined : {false, true}) {
+                CHECK_ERR(lseek(tmp.fd(), 0, SEEK_SET));
+                auto source = makeDecompressingSource(
+                        tmp.fd(), Compression::kGzip, pipelined);
+                char buf[128];
+                LineReader lr(*source, buf, sizeof(buf));
+                std::string line;
+                LineReader::State state;
+                while ((state = lr.readLine(line)) == LineReader::kReading) {
+                }
+                EXPECT_EQ(LineReader::kError, state);
+            }
+        }
+
+        TEST(Decompression, GzipCorrupt) {
+            std::string compressed = gzip(join(makeLines(100)));
+            compressed[compressed.size() / 2] ^= 0x55;
+            File tmp = writeTemp(compressed);
+            ZlibByteSource source(
+                    std::unique_ptr<ByteSource>(new FdByteSource(tmp.fd())));
+            std::vector<char> out(1 << 20);
+            errno = 0;
+            EXPECT_EQ(-1, source.read(out.data(), out.size()));
+            EXPECT_EQ(EBADMSG, errno);
+        }
+#endif
+
+#ifdef SYSIO_HAVE_ZSTD
+        std::string zstd(const std::string& data) {
+            std::string out(ZSTD_compressBound(data.size()), '\0');
+            size_t n = ZSTD_compress(&out[0], out.size(), data.data(), data.size(), 3);
+            CHECK(!ZSTD_isError(n)) << ZSTD_getErrorName(n);
+            out.resize(n);
+            return out;
+        }
+
+        TEST(Decompression, Zstd) {
+            auto lines = makeLines(20000);
+            std::vector<std::string> first(lines.begin(), lines.begin() + 5000);
+            std::vector<std::string> second(lines.begin() + 5000, lines.end());
+            // two frames back to back
+            File tmp = writeTemp(zstd(join(first)) + zstd(join(second)));
+            for (bool pipelined : {false, true}) {
+                CHECK_ERR(lseek(tmp.fd(), 0, SEEK_SET));
+                auto source = makeDecompressingSource(
+                        tmp.fd(), Compression::kZstd, pipelined);
+                expectLines(*source, lines);
+            }
+        }
+
+        TEST(Decompression, ZstdTruncated) {
+            std::string compressed = zstd(join(makeLines(5000)));
+            File tmp = writeTemp(compressed.substr(0, compressed.size() - 10));
+            ZstdByteSource source(
+                    std::unique_ptr<ByteSource>(new FdByteSource(tmp.fd())));
+            std::vector<char> out(1 << 20);
+            errno = 0;
+            EXPECT_EQ(-1, source.read(out.data(), out.size()));
+            EXPECT_EQ(EBADMSG, errno);
+        }
+#endif
+    }
+}
@@ -0,0 +1,154 @@
+#include "system_io/DirectorySwap.h"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/IoThreadPool.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        std::vector<std::string> list(const std::string& path) {
+            std::vector<std::string> names;
+            DIR* dir = opendir(path.c_str());
+            PCHECK(dir);
+            while (dirent* d = readdir(dir)) {
+                std::string name = d->d_name;
+                if (name != "." && name != "..") {
+                    names.push_back(name);
+                }
+            }
+            closedir(dir);
+            std::sort(names.begin(), names.end());
+            return names;
+        }
+
+        std::string contents(const std::string& path) {
+            std::string data;
+            EXPECT_TRUE(readFile(path.c_str(), data)) << path;
+            return data;
+        }
+
+        // Stages version v: files a and b, and sub/c
+        DirectorySwap::Staged stageVersion(DirectorySwap& swap, const std::string& v) {
+            auto staged = swap.stage();
+            EXPECT_TRUE(writeFile("a" + v, staged.directory.fd(), "a"));
+            EXPECT_TRUE(writeFile("b" + v, staged.directory.fd(), "b"));
+            staged.directory.makeDirectory("sub");
+            EXPECT_TRUE(writeFile("c" + v, staged.directory.openDirectory("sub").fd(), "c"));
+            return staged;
+        }
+
+        TEST(DirectorySwap, Exchange) {
+            TemporaryDirectory tmp;
+            const std::string index = tmp.path() + "/index";
+            DirectorySwap swap(Directory(tmp.path()), "index");
+
+            swap.publish(stageVersion(swap, "1"));
+            EXPECT_EQ("a1", contents(index + "/a"));
+            EXPECT_EQ("c1", contents(index + "/sub/c"));
+
+            // A reader of the old version keeps it
+            File old(index + "/b");
+            swap.publish(stageVersion(swap, "2"));
+            EXPECT_EQ("a2", contents(index + "/a"));
+            EXPECT_EQ("b2", contents(index + "/b"));
+            EXPECT_EQ("c2", contents(index + "/sub/c"));
+            std::string data;
+            EXPECT_TRUE(readFile(old.fd(), data));
+            EXPECT_EQ("b1", data);
+
+            swap.waitForCleanup();
+            struct stat st;
+            ASSERT_EQ(0, lstat(index.c_str(), &st));
+            EXPECT_TRUE(S_ISDIR(st.st_mode));
+            EXPECT_THAT(list(tmp.path()), testing::ElementsAre("index"));
+
+            auto stats = swap.stats();
+            EXPECT_EQ(2u, stats.publishes);
+            EXPECT_EQ(1u, stats.exchanges);
+            EXPECT_EQ(0u, stats.symlinkFlips);
+            EXPECT_EQ(1u, stats.removed);
+            EXPECT_EQ(0u, stats.removeFailures);
+        }
+
+        TEST(DirectorySwap, Symlink) {
+            TemporaryDirectory tmp;
+            const std::string index = tmp.path() + "/index";
+            IoThreadPool pool;
+            DirectorySwap::Options options;
+            options.useSymlink = true;
+            options.cleanupPool = &pool;
+            DirectorySwap swap(Directory(tmp.path()), "index", options);
+
+            for (int v = 1; v <= 3; ++v) {
+                auto staged = stageVersion(swap, std::to_string(v));
+                const std::string name = staged.name;
+                swap.publish(std::move(staged));
+                EXPECT_EQ("a" + std::to_string(v), contents(index + "/a"));
+
+                char target[256];
+                ssize_t n = readlink(index.c_str(), target, sizeof(target));
+                ASSERT_GT(n, 0);
+                EXPECT_EQ(name, std::string(target, size_t(n)));
+                swap.waitForCleanup();
+                EXPECT_THAT(list(tmp.path()), testing::ElementsAre("index", name));
+            }
+
+            // A discarded staging directory goes away, the published one stays
+            swap.discard(stageVersion(swap, "x"));
+            swap.waitForCleanup();
+            EXPECT_EQ(2u, list(tmp.path()).size());
+            EXPECT_EQ("c3", contents(index + "/sub/c"));
+
+            auto stats = swap.stats();
+            EXPECT_EQ(3u, stats.publishes);
+            EXPECT_EQ(0u, stats.exchanges);
+            EXPECT_EQ(3u, stats.symlinkFlips);
+            EXPECT_EQ(3u, stats.removed);
+        }
+
+        TEST(DirectorySwap, KeepsExistingLayout) {
+            TemporaryDirectory tmp;
+            const std::string index = tmp.path() + "/index";
+            {
+                DirectorySwap swap(Directory(tmp.path()), "index");
+                swap.publish(stageVersion(swap, "1"));
+            }
+
+            // The target is a directory now, so it is exchanged regardless
+            DirectorySwap::Options options;
+            options.useSymlink = true;
+            options.sync = false;
+            DirectorySwap swap(Directory(tmp.path()), "index", options);
+            swap.publish(stageVersion(swap, "2"));
+            EXPECT_EQ(1u, swap.stats().exchanges);
+            EXPECT_EQ("b2", contents(index + "/b"));
+
+            // Not a directory or symlink
+            swap.waitForCleanup();
+            ASSERT_TRUE(writeFile(std::string("x"), (tmp.path() + "/file").c_str()));
+            DirectorySwap bad(Directory(tmp.path()), "file");
+            auto staged = stageVersion(bad, "3");
+            EXPECT_THROW(bad.publish(std::move(staged)), std::system_error);
+            EXPECT_TRUE(staged.directory);
+            bad.discard(std::move(staged));
+        }
+    }
+}
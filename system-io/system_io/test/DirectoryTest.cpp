@@ -0,0 +1,112 @@
+#include "system_io/Directory.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <system_error>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        TEST(Directory, OpenRelative) {
+            TemporaryDirectory tmp;
+            Directory dir(tmp.path());
+            ASSERT_TRUE(dir);
+
+            File f = dir.openFile("a", O_WRONLY | O_CREAT | O_EXCL);
+            ASSERT_EQ(3, writeFull(f.fd(), "abc", 3));
+            std::string out;
+            ASSERT_TRUE(readFile((tmp.path() + "/a").c_str(), out));
+            EXPECT_EQ("abc", out);
+
+            auto missing = dir.tryOpenFile("b");
+            ASSERT_FALSE(missing);
+            EXPECT_EQ(std::errc::no_such_file_or_directory, missing.error());
+            EXPECT_THROW(dir.openFile("b"), std::system_error);
+
+            auto notDir = Directory::tryOpen("a", dir.fd());
+            ASSERT_FALSE(notDir);
+            EXPECT_EQ(std::errc::not_a_directory, notDir.error());
+
+            // The handle follows the directory when it is renamed
+            std::string moved = tmp.path() + ".moved";
+            ASSERT_EQ(0, rename(tmp.path().c_str(), moved.c_str()));
+            EXPECT_TRUE(readFile(dir.fd(), "a", out));
+            EXPECT_EQ("abc", out);
+            ASSERT_EQ(0, rename(moved.c_str(), tmp.path().c_str()));
+        }
+
+        TEST(Directory, FileUtilAt) {
+            TemporaryDirectory tmp;
+            Directory dir(tmp.path());
+            dir.makeDirectory("sub");
+            Directory sub = dir.openDirectory("sub");
+
+            ASSERT_TRUE(writeFile(std::string("hello"), sub.fd(), "f"));
+            std::vector<char> v;
+            ASSERT_TRUE(readFile(dir.fd(), "sub/f", v));
+            EXPECT_EQ("hello", std::string(v.begin(), v.end()));
+            EXPECT_FALSE(readFile(sub.fd(), "missing", v));
+            EXPECT_EQ(ENOENT, errno);
+
+            std::string data = "replaced";
+            iovec iov{&data[0], data.size()};
+            writeFileAtomic(sub.fd(), "f", &iov, 1, 0600);
+            std::string out;
+            ASSERT_TRUE(readFile(sub.fd(), "f", out));
+            EXPECT_EQ("replaced", out);
+            EXPECT_EQ(0600u, sub.stat("f").st_mode & 0777);
+            EXPECT_EQ(ENOENT, writeFileAtomicNoThrow(sub.fd(), "missing/f", &iov, 1));
+
+            // No temporary files left behind
+            dir.unlink("sub/f");
+            dir.removeDirectory("sub");
+            struct stat st;
+            EXPECT_FALSE(dir.tryStat("sub", st));
+            EXPECT_EQ(ENOENT, errno);
+        }
+
+        TEST(Directory, RenameLinkAndTemporary) {
+            TemporaryDirectory tmp;
+            Directory dir(tmp.path());
+            dir.makeDirectory("other");
+            Directory other = dir.openDirectory("other");
+
+            std::string name = "tmp.XXXXXX";
+            File t = dir.makeTemporary(name);
+            EXPECT_NE("tmp.XXXXXX", name);
+            EXPECT_EQ(0600u, dir.stat(name.c_str()).st_mode & 0777);
+            std::string again = "tmp.XXXXXX";
+            dir.makeTemporary(again);
+            EXPECT_NE(name, again);
+            std::string bad = "tmp";
+            EXPECT_THROW(dir.makeTemporary(bad), std::system_error);
+
+            ASSERT_EQ(1, writeFull(t.fd(), "x", 1));
+            dir.rename(name.c_str(), "x");
+            dir.link("x", other, "y");
+            EXPECT_EQ(2u, dir.stat("x").st_nlink);
+            dir.rename("x", other, "z");
+            std::string out;
+            ASSERT_TRUE(readFile(other.fd(), "z", out));
+            EXPECT_EQ("x", out);
+            other.unlink("y");
+            EXPECT_EQ(1u, other.stat("z").st_nlink);
+            EXPECT_THROW(dir.unlink("x"), std::system_error);
+        }
+    }
+}
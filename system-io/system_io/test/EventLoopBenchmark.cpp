@@ -0,0 +1,110 @@
+/*
+ * Echo throughput of a single EventLoop thread serving many concurrent
+ * socketpair connections.  Every client keeps one message in flight: it
+ * sends, waits for the echo, and sends again, until each has completed
+ * --rounds round trips.
+ */
+
+#include "system_io/EventLoop.h"
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/File.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int32(connections, 10000, "Concurrent connections");
+DEFINE_int32(message_size, 512, "Bytes per message");
+DEFINE_int32(rounds, 20, "Round trips per connection");
+DEFINE_int32(iterations, 3, "Runs per measurement; the fastest one is reported");
+
+using namespace sysio;
+using namespace sysio::test;
+
+namespace
+{
+    void raiseFdLimit(size_t needed) {
+        rlimit limit;
+        PCHECK(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+        if (limit.rlim_cur < needed) {
+            limit.rlim_cur = std::min<rlim_t>(needed, limit.rlim_max);
+            PCHECK(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+        }
+        CHECK_GE(limit.rlim_cur, needed) << "raise the hard limit on open files";
+    }
+
+    // Returns the seconds spent echoing, excluding connection setup
+    double echoRun() {
+        const size_t n = size_t(FLAGS_connections);
+        const std::string message(size_t(FLAGS_message_size), 'e');
+        EventLoop loop;
+        std::vector<std::unique_ptr<Connection>> servers;
+        std::vector<std::unique_ptr<Connection>> clients;
+        std::vector<size_t> received(n);
+        size_t closed = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            int fds[2];
+            PCHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+            servers.emplace_back(new Connection(
+                    loop, File(fds[0], true),
+                    [](Connection& c, const char* data, size_t len) {
+                        PCHECK(c.send(std::string(data, len)));
+                    },
+                    [&](Connection&, int error) {
+                        CHECK_EQ(0, error);
+                        ++closed;
+                    }));
+            clients.emplace_back(new Connection(
+                    loop, File(fds[1], true),
+                    [&, i](Connection& c, const char*, size_t len) {
+                        size_t before = received[i] / message.size();
+                        received[i] += len;
+                        size_t after = received[i] / message.size();
+                        if (after == size_t(FLAGS_rounds)) {
+                            c.close();
+                        } else if (after != before) {
+                            PCHECK(c.send(message));
+                        }
+                    },
+                    nullptr));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (auto& c : clients) {
+            PCHECK(c->send(message));
+        }
+        while (closed < n) {
+            loop.runOnce();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+}
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    raiseFdLimit(2 * size_t(FLAGS_connections) + 64);
+
+    double t = std::numeric_limits<double>::max();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+        t = std::min(t, echoRun());
+    }
+    double messages = double(FLAGS_connections) * FLAGS_rounds;
+    printf("%d connections, %d byte messages, %d round trips each\n",
+           FLAGS_connections, FLAGS_message_size, FLAGS_rounds);
+    printRate("echo round trips", messages, t);
+    // Each round trip moves the message twice
+    printThroughput("echo payload", 2 * messages * FLAGS_message_size, t);
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include "system_io/EventLoop.h"
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        std::pair<File, File> socketPair(bool nonBlocking = true) {
+            int fds[2];
+            int type = SOCK_STREAM | SOCK_CLOEXEC | (nonBlocking ? SOCK_NONBLOCK : 0);
+            CHECK_ERR(socketpair(AF_UNIX, type, 0, fds));
+            return std::make_pair(File(fds[0], true), File(fds[1], true));
+        }
+
+        TEST(EventLoop, ReadSomeWriteSome) {
+            auto sp = socketPair();
+            char buf[100];
+            errno = 0;
+            EXPECT_EQ(-1, readSome(sp.first.fd(), buf, sizeof(buf)));
+            EXPECT_EQ(EAGAIN, errno);
+
+            // Fill the socket buffer: a partial write that would block next
+            std::string big(16 << 20, 'x');
+            ssize_t n = writeSome(sp.second.fd(), big.data(), big.size());
+            ASSERT_GT(n, 0);
+            ASSERT_LT(size_t(n), big.size());
+            EXPECT_EQ(EAGAIN, errno);
+            errno = 0;
+            EXPECT_EQ(-1, writeSome(sp.second.fd(), big.data(), big.size()));
+            EXPECT_EQ(EAGAIN, errno);
+
+            // Drain it, then see EOF
+            sp.second.close();
+            std::string in(big.size(), '\0');
+            EXPECT_EQ(n, readSome(sp.first.fd(), &in[0], in.size()));
+            EXPECT_EQ(0, errno); // EOF follows
+            EXPECT_EQ(0, readSome(sp.first.fd(), &in[0], in.size()));
+        }
+
+        TEST(EventLoop, WriteQueueResumesAfterEagain) {
+            auto sp = socketPair();
+            WriteQueue queue;
+            std::string expected;
+            for (int i = 0; i < 200; ++i) {
+                std::string chunk(100000 + i, char('a' + i % 26));
+                expected += chunk;
+                queue.push(std::move(chunk));
+            }
+            EXPECT_EQ(expected.size(), queue.bytes());
+
+            std::string received;
+            char buf[65536];
+            while (!queue.empty()) {
+                ASSERT_TRUE(queue.flush(sp.first.fd()));
+                ssize_t r;
+                while ((r = readNoInt(sp.second.fd(), buf, sizeof(buf))) > 0) {
+                    received.append(buf, size_t(r));
+                }
+            }
+            ssize_t r;
+            while ((r = readNoInt(sp.second.fd(), buf, sizeof(buf))) > 0) {
+                received.append(buf, size_t(r));
+            }
+            EXPECT_EQ(expected, received);
+        }
+
+        TEST(EventLoop, Echo) {
+            const int kConnections = 100;
+            const std::string message(1000, 'm');
+            const int kRounds = 20;
+
+            EventLoop loop;
+            std::vector<std::unique_ptr<Connection>> servers;
+            std::vector<std::unique_ptr<Connection>> clients;
+            std::vector<size_t> received(kConnections);
+            int finished = 0;
+            int closed = 0;
+
+            for (int i = 0; i < kConnections; ++i) {
+                auto sp = socketPair(false);
+                servers.emplace_back(new Connection(
+                        loop, std::move(sp.first),
+                        [](Connection& c, const char* data, size_t n) {
+                            EXPECT_TRUE(c.send(std::string(data, n)));
+                        },
+                        [&](Connection&, int error) {
+                            EXPECT_EQ(0, error);
+                            ++closed;
+                        }));
+                clients.emplace_back(new Connection(
+                        loop, std::move(sp.second),
+                        [&, i](Connection& c, const char*, size_t n) {
+                            size_t before = received[i] / message.size();
+                            received[i] += n;
+                            size_t after = received[i] / message.size();
+                            if (after == size_t(kRounds)) {
+                                ++finished;
+                                c.close();
+                            } else if (after != before) {
+                                EXPECT_TRUE(c.send(message));
+                            }
+                        },
+                        nullptr));
+                EXPECT_TRUE(clients.back()->send(message));
+            }
+            EXPECT_EQ(size_t(2 * kConnections), loop.size());
+
+            while (closed < kConnections) {
+                loop.runOnce(10000);
+            }
+            EXPECT_EQ(kConnections, finished);
+            EXPECT_EQ(0u, loop.size());
+            for (auto n : received) {
+                EXPECT_EQ(kRounds * message.size(), n);
+            }
+        }
+
+        TEST(EventLoop, BackpressureAndClose) {
+            EventLoop loop;
+            auto sp = socketPair(false);
+            File peer = std::move(sp.second);
+            int closeError = -1;
+            std::unique_ptr<Connection> conn(new Connection(
+                    loop, std::move(sp.first), nullptr,
+                    [&](Connection&, int error) {
+                        closeError = error;
+                        conn.reset(); // may destroy itself
+                    }));
+
+            // More than the socket buffers hold: the rest stays queued
+            std::string big(8 << 20, 'b');
+            EXPECT_TRUE(conn->send(big));
+            EXPECT_LT(size_t(0), conn->pendingBytes());
+
+            std::string received;
+            std::vector<char> buf(1 << 20);
+            while (received.size() < big.size()) {
+                loop.runOnce(0);
+                ssize_t r = readNoInt(peer.fd(), buf.data(), buf.size());
+                ASSERT_GT(r, 0);
+                received.append(buf.data(), size_t(r));
+            }
+            loop.runOnce(0);
+            EXPECT_EQ(0u, conn->pendingBytes());
+            EXPECT_EQ(big, received);
+
+            peer.close();
+            while (conn) {
+                loop.runOnce(10000);
+            }
+            EXPECT_EQ(0, closeError);
+        }
+
+        TEST(EventLoop, RemoveAndStop) {
+            EventLoop loop;
+            auto a = socketPair();
+            auto b = socketPair();
+            int aCalls = 0;
+            int bCalls = 0;
+            // Both are writable right away; whichever runs first removes the
+            // other, whose queued event must then be dropped.
+            loop.add(a.first, [&](uint32_t) {
+                ++aCalls;
+                loop.remove(b.first.fd());
+                loop.remove(a.first.fd());
+            });
+            loop.add(b.first, [&](uint32_t) {
+                ++bCalls;
+                loop.remove(a.first.fd());
+                loop.remove(b.first.fd());
+            });
+            EXPECT_EQ(1u, loop.runOnce(1000));
+            EXPECT_EQ(1, aCalls + bCalls);
+            EXPECT_EQ(0u, loop.size());
+
+            std::thread stopper([&] { loop.stop(); });
+            loop.run();
+            stopper.join();
+        }
+    }
+}
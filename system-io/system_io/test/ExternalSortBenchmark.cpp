@@ -0,0 +1,129 @@
+/*
+ * Sorting a file of random log-like lines: all lines read into a vector of
+ * strings and std::sort()ed, against ExternalSort with the whole file in
+ * memory and with a --budget_mb memory budget that forces runs and merges.
+ *
+ * Prints the throughput of each phase of the external sort, which is what
+ * to look at when choosing a budget.  Use --dir on the disk of interest.
+ */
+
+#include "system_io/ExternalSort.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/LineReader.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int32(input_mb, 512, "Size of the input in MB");
+DEFINE_int32(budget_mb, 64, "Memory budget in MB of the spilling run");
+DEFINE_int32(threads, 0, "Sorting threads; 0 for one per CPU");
+DEFINE_string(dir, "/tmp", "Directory for the input, output and runs");
+
+using namespace sysio;
+using namespace sysio::test;
+
+namespace
+{
+    void writeInput(const std::string& path) {
+        const size_t size = size_t(FLAGS_input_mb) << 20;
+        std::string data;
+        data.reserve(size + 256);
+        uint64_t x = 88172645463325252ull;
+        auto next = [&x] {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            return x;
+        };
+        char line[256];
+        while (data.size() < size) {
+            uint64_t r = next();
+            int n = snprintf(line, sizeof(line), "host%03u %016llx GET /item/%llu %u\n",
+                             unsigned(r % 1000), static_cast<unsigned long long>(next()),
+                             static_cast<unsigned long long>(r >> 20), unsigned(r >> 50));
+            data.append(line, size_t(n));
+        }
+        PCHECK(writeFile(data, path.c_str()));
+    }
+
+    double ms(uint64_t nanos) {
+        return double(nanos) / 1e6;
+    }
+
+    void printPhase(const char* name, const ExternalSort::PhaseStats& phase) {
+        if (phase.nanos != 0) {
+            printThroughput(name, double(phase.bytes), double(phase.nanos) / 1e9);
+        }
+    }
+
+    void printStats(const ExternalSort::Stats& stats) {
+        printPhase("  run formation", stats.runs);
+        printPhase("  intermediate merges", stats.intermediateMerges);
+        printPhase("  final merge", stats.merge);
+        printf("  %lu runs, %lu merge passes, sort %.1f ms (all threads), reader waited %.1f ms\n",
+               static_cast<unsigned long>(stats.runCount),
+               static_cast<unsigned long>(stats.mergePasses),
+               ms(stats.sortNanos), ms(stats.runWaitNanos));
+    }
+}
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const std::string input = FLAGS_dir + "/ExternalSortBenchmark.in";
+    const std::string output = FLAGS_dir + "/ExternalSortBenchmark.out";
+    writeInput(input);
+    const double bytes = double(size_t(FLAGS_input_mb) << 20);
+
+    double t = bestOf(1, [&] {
+        std::string data;
+        PCHECK(readFile(input.c_str(), data));
+        std::vector<std::string> lines;
+        size_t start = 0;
+        for (size_t nl; (nl = data.find('\n', start)) != std::string::npos; start = nl + 1) {
+            lines.emplace_back(data, start, nl + 1 - start);
+        }
+        std::sort(lines.begin(), lines.end());
+        std::string sorted;
+        sorted.reserve(data.size());
+        for (const auto& line : lines) {
+            sorted += line;
+        }
+        PCHECK(writeFile(sorted, output.c_str()));
+    });
+    printThroughput("vector<string> + std::sort", bytes, t);
+
+    ExternalSort::Options options;
+    options.threads = size_t(FLAGS_threads);
+    options.memoryBudget = size_t(FLAGS_input_mb) << 22;
+    options.tempDirectory = FLAGS_dir;
+    {
+        ExternalSort sorter(options);
+        t = bestOf(1, [&] { sorter.sort(input, output); });
+        printThroughput("ExternalSort, in memory", bytes, t);
+        printStats(sorter.stats());
+    }
+
+    options.memoryBudget = size_t(FLAGS_budget_mb) << 20;
+    options.dropBehind = true;
+    {
+        ExternalSort sorter(options);
+        t = bestOf(1, [&] { sorter.sort(input, output); });
+        printThroughput("ExternalSort, spilling", bytes, t);
+        printStats(sorter.stats());
+    }
+
+    unlink(input.c_str());
+    unlink(output.c_str());
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "system_io/ExternalSort.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        std::vector<std::string> randomLines(size_t count, size_t maxSize, unsigned seed) {
+            std::mt19937 rng(seed);
+            std::vector<std::string> lines;
+            for (size_t i = 0; i < count; ++i) {
+                std::string line(rng() % maxSize, ' ');
+                for (char& c : line) {
+                    // Few distinct bytes, so that many lines share prefixes
+                    c = char('a' + rng() % 4);
+                }
+                lines.push_back(line);
+            }
+            return lines;
+        }
+
+        std::string join(const std::vector<std::string>& lines) {
+            std::string out;
+            for (const auto& line : lines) {
+                out += line;
+                out += '\n';
+            }
+            return out;
+        }
+
+        std::string sortFile(ExternalSort& sorter, const std::string& input) {
+            TemporaryPath in;
+            TemporaryPath out;
+            CHECK(writeFile(input, in.c_str()));
+            sorter.sort(in.path(), out.path());
+            std::string output;
+            CHECK(readFile(out.c_str(), output));
+            return output;
+        }
+
+        TEST(ExternalSort, InMemory) {
+            ExternalSort sorter;
+            // The last line has no newline
+            EXPECT_EQ("\napple\nbanana\ncherry\n",
+                      sortFile(sorter, "cherry\napple\n\nbanana"));
+            EXPECT_EQ(0u, sorter.stats().runCount);
+            EXPECT_EQ(4u, sorter.stats().runs.lines);
+
+            EXPECT_EQ("", sortFile(sorter, ""));
+        }
+
+        TEST(ExternalSort, Merge) {
+            auto lines = randomLines(20000, 40, 1);
+            ExternalSort::Options options;
+            options.memoryBudget = 64 << 10;
+            options.readBlockSize = 4096;
+            options.mergeBlockSize = 4096;
+            options.threads = 3;
+            options.dropBehind = true;
+            ExternalSort sorter(options);
+            std::string output = sortFile(sorter, join(lines));
+
+            std::sort(lines.begin(), lines.end());
+            EXPECT_EQ(join(lines), output);
+            auto stats = sorter.stats();
+            // More runs than 16 blocks of 4 KB in the budget
+            EXPECT_GT(stats.runCount, 16u);
+            EXPECT_GE(stats.mergePasses, 1u);
+            EXPECT_EQ(20000u, stats.runs.lines);
+            EXPECT_EQ(20000u, stats.merge.lines);
+            EXPECT_EQ(output.size(), stats.merge.bytes);
+        }
+
+        TEST(ExternalSort, StableKey) {
+            // Keys (the second field) repeat; the first field numbers the
+            // lines
+            std::vector<std::string> lines;
+            std::mt19937 rng(2);
+            for (int i = 0; i < 5000; ++i) {
+                lines.push_back(std::to_string(i) + "\t" + std::to_string(rng() % 50) + "\tx");
+            }
+            lines.push_back("last");
+
+            ExternalSort::Options options;
+            options.memoryBudget = 32 << 10;
+            options.readBlockSize = 4096;
+            options.mergeBlockSize = 4096;
+            options.threads = 2;
+            options.key = ExternalSort::fieldKey('\t', 1);
+            options.stable = true;
+            ExternalSort sorter(options);
+
+            // Through a file descriptor, from an offset
+            File in = File::temporary();
+            File out = File::temporary();
+            std::string input = "skipped\n" + join(lines);
+            CHECK_EQ(ssize_t(input.size()), writeFull(in.fd(), input.data(), input.size()));
+            CHECK_ERR(lseek(in.fd(), 8, SEEK_SET));
+            sorter.sort(in.fd(), out.fd());
+            EXPECT_EQ(off_t(input.size()), lseek(in.fd(), 0, SEEK_CUR));
+            EXPECT_GT(sorter.stats().runCount, 1u);
+
+            auto key = [](const std::string& line) {
+                auto tab = line.find('\t');
+                return tab == std::string::npos ? std::string()
+                                                : line.substr(tab + 1, line.find('\t', tab + 1) - tab - 1);
+            };
+            std::stable_sort(lines.begin(), lines.end(), [&](const std::string& a, const std::string& b) {
+                return key(a) < key(b);
+            });
+            std::string output;
+            CHECK_ERR(lseek(out.fd(), 0, SEEK_SET));
+            ASSERT_TRUE(readFile(out.fd(), output));
+            EXPECT_EQ(join(lines), output);
+        }
+    }
+}
@@ -0,0 +1,185 @@
+#include "system_io/FdCache.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        void replaceAtomically(const std::string& path, std::string data) {
+            iovec iov{&data[0], data.size()};
+            writeFileAtomic(path, &iov, 1);
+        }
+
+        TEST(FdCache, HitsAndMisses) {
+            TemporaryPath path;
+            ASSERT_TRUE(writeFile(std::string("hello"), path.c_str()));
+            FdCache cache;
+
+            auto a = cache.get(path.path());
+            ASSERT_TRUE(a);
+            auto b = cache.get(path.path());
+            ASSERT_TRUE(b);
+            EXPECT_EQ(a->get(), b->get());
+
+            auto missing = cache.get(path.path() + ".missing");
+            ASSERT_FALSE(missing);
+            EXPECT_EQ(std::errc::no_such_file_or_directory, missing.error());
+
+            auto stats = cache.stats();
+            EXPECT_EQ(1u, stats.hits);
+            EXPECT_EQ(2u, stats.misses);
+            EXPECT_EQ(1u, stats.open);
+            EXPECT_DOUBLE_EQ(1.0 / 3, stats.hitRate());
+        }
+
+        TEST(FdCache, InvalidatesChangedFiles) {
+            TemporaryPath path;
+            ASSERT_TRUE(writeFile(std::string("one"), path.c_str()));
+            FdCache cache;
+            std::string out;
+            ASSERT_TRUE(readFile(cache, path.c_str(), out));
+            EXPECT_EQ("one", out);
+
+            // New inode
+            replaceAtomically(path.path(), "two");
+            ASSERT_TRUE(readFile(cache, path.c_str(), out));
+            EXPECT_EQ("two", out);
+            EXPECT_EQ(1u, cache.stats().invalidations);
+
+            // Same inode and size, new mtime
+            auto before = cache.get(path.path()).value();
+            ASSERT_TRUE(writeFile(std::string("333"), path.c_str()));
+            timespec times[2] = {{0, UTIME_OMIT}, {12345, 0}};
+            ASSERT_EQ(0, utimensat(AT_FDCWD, path.c_str(), times, 0));
+            auto after = cache.get(path.path()).value();
+            EXPECT_NE(before.get(), after.get());
+            EXPECT_EQ(2u, cache.stats().invalidations);
+
+            // Removed
+            unlink(path.c_str());
+            EXPECT_FALSE(readFile(cache, path.c_str(), out));
+            EXPECT_EQ(ENOENT, errno);
+            EXPECT_EQ(0u, cache.stats().open);
+            // The handles outlive their entries
+            char c;
+            EXPECT_EQ(1, preadFull(after->fd(), &c, 1, 0));
+        }
+
+        TEST(FdCache, EvictsLeastRecentlyUsed) {
+            FdCache::Options options;
+            options.maxFds = 4;
+            options.shards = 1;
+            FdCache cache(options);
+            std::vector<std::unique_ptr<TemporaryPath>> paths;
+            for (int i = 0; i < 6; ++i) {
+                paths.emplace_back(new TemporaryPath);
+                ASSERT_TRUE(writeFile(std::to_string(i), paths.back()->c_str()));
+            }
+
+            for (int i = 0; i < 4; ++i) {
+                ASSERT_TRUE(cache.get(paths[size_t(i)]->path()));
+            }
+            // 0 becomes the most recent, so 1 and 2 are evicted
+            ASSERT_TRUE(cache.get(paths[0]->path()));
+            auto held = cache.get(paths[4]->path()).value();
+            ASSERT_TRUE(cache.get(paths[5]->path()));
+            auto stats = cache.stats();
+            EXPECT_EQ(2u, stats.evictions);
+            EXPECT_EQ(4u, stats.open);
+
+            uint64_t misses = stats.misses;
+            ASSERT_TRUE(cache.get(paths[0]->path()));
+            ASSERT_TRUE(cache.get(paths[3]->path()));
+            EXPECT_EQ(misses, cache.stats().misses);
+            ASSERT_TRUE(cache.get(paths[1]->path()));
+            EXPECT_EQ(misses + 1, cache.stats().misses);
+
+            // Evicted, but still open while held
+            cache.clear();
+            EXPECT_EQ(0u, cache.stats().open);
+            char c;
+            EXPECT_EQ(1, preadFull(held->fd(), &c, 1, 0));
+            EXPECT_EQ('4', c);
+        }
+
+        TEST(FdCache, DirFdAndRevalidationInterval) {
+            TemporaryPath dir;
+            ASSERT_EQ(0, mkdir(dir.c_str(), 0755));
+            File d(dir.path(), O_RDONLY | O_DIRECTORY);
+            ASSERT_TRUE(writeFile(std::string("relative"), (dir.path() + "/f").c_str()));
+
+            FdCache::Options options;
+            options.revalidateInterval = std::chrono::hours(1);
+            FdCache cache(options);
+            auto a = cache.get("f", d.fd());
+            ASSERT_TRUE(a);
+            // Different key
+            EXPECT_FALSE(cache.get("f"));
+
+            // Trusted without a stat(), so the change goes unnoticed
+            replaceAtomically(dir.path() + "/f", "changed");
+            auto b = cache.get("f", d.fd());
+            ASSERT_TRUE(b);
+            EXPECT_EQ(a->get(), b->get());
+            cache.invalidate("f", d.fd());
+            auto c = cache.get("f", d.fd());
+            ASSERT_TRUE(c);
+            EXPECT_NE(a->get(), c->get());
+
+            unlink((dir.path() + "/f").c_str());
+            rmdir(dir.c_str());
+        }
+
+        TEST(FdCache, Concurrent) {
+            std::vector<std::unique_ptr<TemporaryPath>> paths;
+            for (int i = 0; i < 20; ++i) {
+                paths.emplace_back(new TemporaryPath);
+                ASSERT_TRUE(writeFile(std::string(100, char('a' + i)), paths.back()->c_str()));
+            }
+            FdCache::Options options;
+            options.maxFds = 8;
+            FdCache cache(options);
+            std::atomic<int> errors(0);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; ++t) {
+                threads.emplace_back([&, t] {
+                    char buf[10];
+                    for (int i = 0; i < 2000; ++i) {
+                        size_t k = size_t(i * 7 + t) % paths.size();
+                        ssize_t r = preadFull(cache, paths[k]->c_str(), buf, sizeof(buf), 50);
+                        if (r != ssize_t(sizeof(buf)) || buf[0] != char('a' + k)) {
+                            ++errors;
+                        }
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            EXPECT_EQ(0, errors);
+            auto stats = cache.stats();
+            EXPECT_EQ(8000u, stats.hits + stats.misses);
+            EXPECT_LE(stats.open, 8u);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * Compares splitting delimited records with FieldSplitter over whole
+ * LineReader blocks against the usual readLine() + std::string::find() loop.
+ * Both read the same page-cached file through a LineReader and count fields,
+ * so the difference is the tokenizing.  The naive loop does not handle
+ * quoting, so the input has no quotes.
+ */
+
+#include "system_io/FieldSplitter.h"
+
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int64(size_mb, 256, "Size of the test file in MB");
+DEFINE_int32(fields, 12, "Fields per record");
+DEFINE_int32(field_size, 8, "Average field size in bytes");
+DEFINE_int64(buffer_kb, 256, "LineReader buffer size in KB");
+DEFINE_int32(iterations, 5, "Runs per measurement; the fastest one is reported");
+DEFINE_string(dir, "/tmp", "Directory for the test file");
+
+using namespace sysio;
+using namespace sysio::test;
+
+namespace
+{
+    std::string makeData(size_t size) {
+        std::string data;
+        data.reserve(size + 4096);
+        uint32_t x = 1;
+        while (data.size() < size) {
+            for (int j = 0; j < FLAGS_fields; ++j) {
+                x = x * 1103515245 + 12345;
+                data.append(1 + (x >> 16) % (2 * FLAGS_field_size - 1), char('a' + j % 26));
+                data.push_back(j + 1 == FLAGS_fields ? '\n' : ',');
+            }
+        }
+        return data;
+    }
+
+    size_t naiveCount(int fd, std::vector<char>& buf) {
+        CHECK_ERR(lseek(fd, 0, SEEK_SET));
+        LineReader reader(fd, buf.data(), buf.size());
+        std::string line;
+        size_t fields = 0;
+        while (reader.readLine(line) == LineReader::kReading) {
+            size_t end = line.size();
+            if (end != 0 && line[end - 1] == '\n') {
+                --end;
+            }
+            size_t start = 0;
+            for (;;) {
+                size_t d = line.find(',', start);
+                ++fields;
+                if (d == std::string::npos || d >= end) {
+                    break;
+                }
+                start = d + 1;
+            }
+        }
+        return fields;
+    }
+
+    size_t splitterCount(int fd, std::vector<char>& buf) {
+        CHECK_ERR(lseek(fd, 0, SEEK_SET));
+        LineReader reader(fd, buf.data(), buf.size());
+        FieldSplitter splitter;
+        size_t fields = 0;
+        forEachRecord(reader, splitter, [&](const DelimitedRecord& r) { fields += r.size(); });
+        return fields;
+    }
+}
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const std::string data = makeData(size_t(FLAGS_size_mb) << 20);
+    const std::string path = FLAGS_dir + "/FieldSplitterBenchmark.csv";
+    {
+        File out(path, O_WRONLY | O_CREAT | O_TRUNC);
+        PCHECK(writeFull(out.fd(), data.data(), data.size()) == ssize_t(data.size()));
+    }
+    File in(path);
+    std::vector<char> buf(size_t(FLAGS_buffer_kb) << 10);
+
+    size_t expected = naiveCount(in.fd(), buf);
+    double t = bestOf(FLAGS_iterations, [&] { CHECK_EQ(expected, naiveCount(in.fd(), buf)); });
+    printThroughput("readLine + find", data.size(), t);
+    printRate("readLine + find, fields", expected, t);
+
+    t = bestOf(FLAGS_iterations, [&] { CHECK_EQ(expected, splitterCount(in.fd(), buf)); });
+    printThroughput("FieldSplitter", data.size(), t);
+    printRate("FieldSplitter, fields", expected, t);
+
+    unlink(path.c_str());
+    return 0;
+}
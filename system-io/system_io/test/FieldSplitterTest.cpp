@@ -0,0 +1,179 @@
+#include "system_io/FieldSplitter.h"
+
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        typedef std::vector<std::vector<std::string>> Records;
+
+        Records splitAll(const std::string& data, char delimiter = ',', char quote = '"',
+                         size_t* consumed = nullptr, bool final = true) {
+            FieldSplitter splitter(delimiter, quote);
+            DelimitedBatch batch;
+            size_t used = splitter.split(data.data(), data.data() + data.size(), final, batch);
+            if (consumed) {
+                *consumed = used;
+            }
+            Records records;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                std::vector<std::string> fields;
+                for (size_t j = 0; j < batch[i].size(); ++j) {
+                    fields.push_back(batch[i].field(j));
+                }
+                records.push_back(fields);
+            }
+            return records;
+        }
+
+        // Reference: split lines, then fields, no quoting.
+        Records naiveSplit(const std::string& data, char delimiter) {
+            Records records;
+            size_t pos = 0;
+            while (pos < data.size()) {
+                size_t eol = data.find('\n', pos);
+                if (eol == std::string::npos) {
+                    eol = data.size();
+                }
+                std::vector<std::string> fields;
+                size_t start = pos;
+                for (;;) {
+                    size_t d = data.find(delimiter, start);
+                    if (d == std::string::npos || d > eol) {
+                        fields.push_back(data.substr(start, eol - start));
+                        break;
+                    }
+                    fields.push_back(data.substr(start, d - start));
+                    start = d + 1;
+                }
+                records.push_back(fields);
+                pos = eol + 1;
+            }
+            return records;
+        }
+
+        std::string makeUnquoted(size_t records) {
+            std::string data;
+            uint32_t x = 1;
+            for (size_t i = 0; i < records; ++i) {
+                x = x * 1103515245 + 12345;
+                size_t fields = 1 + (x >> 16) % 12;
+                for (size_t j = 0; j < fields; ++j) {
+                    x = x * 1103515245 + 12345;
+                    data.append((x >> 16) % 40, char('a' + j));
+                    data.push_back(j + 1 == fields ? '\n' : ',');
+                }
+            }
+            return data;
+        }
+
+        TEST(FieldSplitter, Simple) {
+            EXPECT_EQ((Records{{"a", "b", "c"}, {"", "d", ""}, {"e"}}),
+                      splitAll("a,b,c\n,d,\ne\n"));
+            EXPECT_EQ((Records{{"a", "b"}, {"c"}}), splitAll("a,b\r\nc\r\n"));
+            EXPECT_EQ(Records{}, splitAll(""));
+            EXPECT_EQ((Records{{""}}), splitAll("\n"));
+        }
+
+        TEST(FieldSplitter, Quoted) {
+            std::string data =
+                    "\"a,b\",c\n"
+                    "\"say \"\"hi\"\"\",\"\"\n"
+                    "\"multi\nline\",x\r\n";
+            FieldSplitter splitter;
+            DelimitedBatch batch;
+            ASSERT_EQ(data.size(), splitter.split(data.data(), data.data() + data.size(), false, batch));
+            ASSERT_EQ(3, batch.size());
+
+            EXPECT_TRUE(batch[0].quoted(0));
+            EXPECT_FALSE(batch[0].quoted(1));
+            EXPECT_EQ("a,b", std::string(batch[0].fieldBegin(0), batch[0].fieldEnd(0)));
+            // Raw contents keep doubled quotes, field() collapses them
+            EXPECT_EQ("say \"\"hi\"\"", std::string(batch[1].fieldBegin(0), batch[1].fieldEnd(0)));
+            EXPECT_EQ("say \"hi\"", batch[1].field(0));
+            EXPECT_EQ("", batch[1].field(1));
+            EXPECT_TRUE(batch[1].quoted(1));
+            EXPECT_EQ("multi\nline", batch[2].field(0));
+            EXPECT_EQ("x", batch[2].field(1));
+        }
+
+        TEST(FieldSplitter, QuotesAcrossBlocks) {
+            // A quoted field spanning several 64 byte blocks
+            std::string inner(150, 'q');
+            inner[70] = ',';
+            inner[100] = '\n';
+            std::string data = "x,\"" + inner + "\",y\nz\n";
+            EXPECT_EQ((Records{{"x", inner, "y"}, {"z"}}), splitAll(data));
+        }
+
+        TEST(FieldSplitter, IncompleteRecord) {
+            size_t consumed;
+            EXPECT_EQ((Records{{"a", "b"}}), splitAll("a,b\nc,d", ',', '"', &consumed, false));
+            EXPECT_EQ(4, consumed);
+            EXPECT_EQ((Records{{"a", "b"}, {"c", "d"}}), splitAll("a,b\nc,d", ',', '"', &consumed, true));
+            EXPECT_EQ(7, consumed);
+            // The newline is inside an open quote, so the record is not complete
+            EXPECT_EQ((Records{{"a"}}), splitAll("a\n\"b\nc", ',', '"', &consumed, false));
+            EXPECT_EQ(2, consumed);
+        }
+
+        TEST(FieldSplitter, TsvWithoutQuoting) {
+            EXPECT_EQ((Records{{"\"a", "b\""}, {"c"}}), splitAll("\"a\tb\"\nc\n", '\t', '\0'));
+        }
+
+        TEST(FieldSplitter, MatchesNaive) {
+            std::string data = makeUnquoted(5000);
+            EXPECT_EQ(naiveSplit(data, ','), splitAll(data));
+            // Without the final newline, and at every tail length
+            for (size_t cut = 1; cut < 130; ++cut) {
+                std::string d = data.substr(0, data.size() - cut);
+                ASSERT_EQ(naiveSplit(d, ','), splitAll(d)) << cut;
+            }
+        }
+
+        TEST(FieldSplitter, ForEachRecord) {
+            // Quoted records land on every possible buffer boundary
+            std::string data = "id,name,comment\n";
+            for (size_t i = 0; i < 300; ++i) {
+                data += "1,\"Smith, John\",\"line one\nline two\"\r\n"
+                        "2,Doe,\"a \"\"quoted\"\" word\"\n";
+                data += makeUnquoted(1 + i % 7);
+            }
+            data += "3,Roe,last";
+            Records expected = splitAll(data);
+            ASSERT_EQ((std::vector<std::string>{"1", "Smith, John", "line one\nline two"}), expected[1]);
+            ASSERT_EQ((std::vector<std::string>{"3", "Roe", "last"}), expected.back());
+
+            File tmp = File::temporary();
+            ASSERT_EQ(ssize_t(data.size()), writeFull(tmp.fd(), data.data(), data.size()));
+
+            for (size_t bufSize : {size_t(1000), size_t(1024), size_t(65536)}) {
+                CHECK_ERR(lseek(tmp.fd(), 0, SEEK_SET));
+                std::vector<char> buf(bufSize);
+                LineReader reader(tmp.fd(), buf.data(), buf.size());
+                FieldSplitter splitter;
+                Records records;
+                auto state = forEachRecord(reader, splitter, [&](const DelimitedRecord& r) {
+                    std::vector<std::string> fields;
+                    for (size_t j = 0; j < r.size(); ++j) {
+                        fields.push_back(r.field(j));
+                    }
+                    records.push_back(fields);
+                });
+                EXPECT_EQ(LineReader::kEof, state);
+                EXPECT_EQ(expected, records) << bufSize;
+            }
+        }
+    }
+}
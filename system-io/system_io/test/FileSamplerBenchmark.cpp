@@ -0,0 +1,115 @@
+/*
+ * Cost of reading a set of /proc and /sys files once per tick: readFile()
+ * of each path against FileSampler::sampleAll() over descriptors kept open.
+ *
+ * The files are the first --files matches of --patterns.  CPU time is user
+ * plus system time of the process per tick (getrusage()), and the slowest
+ * files by mean read latency are listed at the end.
+ */
+
+#include "system_io/FileSampler.h"
+
+#include <glob.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_string(patterns,
+              "/proc/stat,/proc/meminfo,/proc/vmstat,/proc/loadavg,/proc/diskstats,"
+              "/proc/net/dev,/sys/class/net/*/statistics/*,/proc/[0-9]*/stat",
+              "Comma separated glob patterns of files to sample");
+DEFINE_int32(files, 200, "Most files to sample");
+DEFINE_int32(ticks, 2000, "Samples of all files per measurement");
+
+using namespace sysio;
+using namespace sysio::test;
+
+namespace
+{
+    double cpuSeconds() {
+        rusage usage;
+        PCHECK(getrusage(RUSAGE_SELF, &usage) == 0);
+        return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+               double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+    }
+
+    template <class F>
+    void measure(const char* name, F tick) {
+        double cpu = cpuSeconds();
+        double wall = bestOf(1, [&] {
+            for (int i = 0; i < FLAGS_ticks; ++i) {
+                tick();
+            }
+        });
+        cpu = cpuSeconds() - cpu;
+        printf("%-32s %10.1f us/tick wall %10.1f us/tick CPU\n",
+               name, wall * 1e6 / FLAGS_ticks, cpu * 1e6 / FLAGS_ticks);
+    }
+}
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    std::vector<std::string> paths;
+    std::stringstream patterns(FLAGS_patterns);
+    std::string pattern;
+    while (std::getline(patterns, pattern, ',')) {
+        glob_t matches;
+        if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; ++i) {
+                paths.push_back(matches.gl_pathv[i]);
+            }
+        }
+        globfree(&matches);
+    }
+
+    // Skip files that cannot be read (or went away meanwhile)
+    FileSampler sampler;
+    std::vector<std::string> used;
+    for (const auto& path : paths) {
+        std::string contents;
+        if (used.size() < size_t(FLAGS_files) && readFile(path.c_str(), contents)) {
+            used.push_back(path);
+            sampler.add(path);
+        }
+    }
+    printf("%zu files\n", used.size());
+
+    measure("readFile()", [&] {
+        std::string contents;
+        for (const auto& path : used) {
+            readFile(path.c_str(), contents);
+        }
+    });
+    measure("FileSampler", [&] {
+        sampler.sampleAll();
+    });
+
+    auto stats = sampler.stats();
+    printf("%lu reads, %lu errors, %lu buffer grows\n",
+           static_cast<unsigned long>(stats.reads), static_cast<unsigned long>(stats.errors),
+           static_cast<unsigned long>(stats.grows));
+    std::vector<size_t> order(sampler.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    auto mean = [&](size_t i) {
+        auto s = sampler.fileStats(i);
+        return s.reads == 0 ? 0.0 : double(s.totalNanos) / double(s.reads);
+    };
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return mean(a) > mean(b); });
+    for (size_t i = 0; i < std::min<size_t>(5, order.size()); ++i) {
+        printf("  %-40s %8.1f us mean %8.1f us max\n", sampler.path(order[i]).c_str(),
+               mean(order[i]) / 1e3, double(sampler.fileStats(order[i]).maxNanos) / 1e3);
+    }
+    return 0;
+}
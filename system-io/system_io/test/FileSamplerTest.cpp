@@ -0,0 +1,90 @@
+#include "system_io/FileSampler.h"
+
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <string>
+#include <system_error>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        TEST(FileSampler, RereadsAndGrows) {
+            TemporaryPath a;
+            TemporaryPath b;
+            ASSERT_TRUE(writeFile(std::string("one"), a.c_str()));
+            ASSERT_TRUE(writeFile(std::string(100, 'b'), b.c_str()));
+
+            FileSampler::Options options;
+            options.bufferSize = 16;
+            options.maxBufferSize = 64;
+            FileSampler sampler(options);
+            EXPECT_EQ(0u, sampler.add(a.path()));
+            EXPECT_EQ(1u, sampler.add(b.path()));
+            EXPECT_THROW(sampler.add(a.path() + ".missing"), std::system_error);
+            EXPECT_EQ(2u, sampler.size());
+
+            EXPECT_EQ(0u, sampler.sampleAll());
+            EXPECT_EQ("one", sampler.sample(0).str());
+            auto sample = sampler.sample(1);
+            EXPECT_EQ(std::string(64, 'b'), sample.str());
+            EXPECT_TRUE(sample.truncated);
+            EXPECT_EQ(2u, sampler.stats().grows);
+
+            // Rewritten in place: the open descriptor sees the new contents
+            ASSERT_TRUE(writeFile(std::string("two!"), a.c_str()));
+            ASSERT_TRUE(writeFile(std::string(20, 'c'), b.c_str()));
+            EXPECT_EQ(0u, sampler.sampleAll());
+            EXPECT_EQ("two!", sampler.sample(0).str());
+            EXPECT_EQ(std::string(20, 'c'), sampler.sample(1).str());
+            EXPECT_FALSE(sampler.sample(1).truncated);
+
+            auto stats = sampler.stats();
+            EXPECT_EQ(2u, stats.samples);
+            EXPECT_EQ(4u, stats.reads);
+            EXPECT_EQ(2u, stats.grows);
+            EXPECT_EQ(2u, sampler.fileStats(0).reads);
+            EXPECT_GE(sampler.fileStats(0).totalNanos, sampler.fileStats(0).maxNanos);
+        }
+
+        TEST(FileSampler, ProcfsErrorsAndReopen) {
+            pid_t child = fork();
+            ASSERT_NE(-1, child);
+            if (child == 0) {
+                pause();
+                _exit(0);
+            }
+            const std::string stat = "/proc/" + std::to_string(child) + "/stat";
+            FileSampler sampler;
+            size_t self = sampler.add("/proc/self/stat");
+            size_t other = sampler.add(stat);
+
+            EXPECT_EQ(0u, sampler.sampleAll());
+            EXPECT_THAT(sampler.sample(self).str(), testing::StartsWith(std::to_string(getpid()) + " "));
+            EXPECT_THAT(sampler.sample(other).str(), testing::StartsWith(std::to_string(child) + " "));
+
+            ASSERT_EQ(0, kill(child, SIGKILL));
+            ASSERT_EQ(child, waitpid(child, nullptr, 0));
+
+            // The read fails, then reopening does
+            EXPECT_EQ(1u, sampler.sampleAll());
+            EXPECT_EQ(ESRCH, sampler.sample(other).error);
+            EXPECT_EQ(1u, sampler.sampleAll());
+            EXPECT_EQ(ENOENT, sampler.sample(other).error);
+            EXPECT_EQ(0, sampler.sample(self).error);
+            EXPECT_EQ(2u, sampler.fileStats(other).errors);
+            EXPECT_EQ(0u, sampler.stats().reopens);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * Searching a large text file for fixed strings: FileSearch against reading
+ * it line by line with LineReader and std::string::find() on each line, for
+ * one pattern and for several.
+ *
+ * The file is --size_mb of lines of 1 to 200 lowercase letters, with one
+ * line in --every containing one of the patterns.
+ */
+
+#include "system_io/FileSearch.h"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/LineReader.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int32(size_mb, 1024, "Size of the file in MB");
+DEFINE_int32(every, 10000, "One line in this many contains a pattern");
+DEFINE_int32(threads, 0, "Threads searching; 0 for one per CPU");
+DEFINE_string(dir, "/tmp", "Directory for the file");
+
+using namespace sysio;
+using namespace sysio::test;
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const std::vector<std::string> patterns = {"needle", "haystack", "timeout", "connection reset"};
+    const std::string path = FLAGS_dir + "/FileSearchBenchmark.txt";
+    uint64_t planted = 0;
+    {
+        const size_t size = size_t(FLAGS_size_mb) << 20;
+        std::string data;
+        data.reserve(size + 256);
+        uint64_t x = 88172645463325252ull;
+        auto next = [&] {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            return x;
+        };
+        while (data.size() < size) {
+            size_t length = size_t(next() % 200) + 1;
+            for (size_t i = 0; i < length; ++i) {
+                data += char('a' + next() % 26);
+            }
+            if (next() % uint64_t(FLAGS_every) == 0) {
+                data += ' ';
+                data += patterns[planted++ % patterns.size()];
+            }
+            data += '\n';
+        }
+        PCHECK(writeFile(data, path.c_str()));
+    }
+    const double bytes = double(size_t(FLAGS_size_mb) << 20);
+
+    auto lineReaderSearch = [&](const std::vector<std::string>& search) {
+        File file(path);
+        LineReader reader(file.fd(), LineReader::Options());
+        std::string line;
+        uint64_t matches = 0;
+        while (reader.readLine(line) == LineReader::kReading) {
+            for (const auto& pattern : search) {
+                if (line.find(pattern) != std::string::npos) {
+                    ++matches;
+                    break;
+                }
+            }
+        }
+        return matches;
+    };
+
+    const std::vector<std::string> one = {patterns[0]};
+    uint64_t expected = 0;
+    double t = bestOf(3, [&] { expected = lineReaderSearch(one); });
+    printThroughput("1 pattern, LineReader + string::find", bytes, t);
+
+    FileSearch::Options options;
+    options.threads = size_t(FLAGS_threads);
+    for (bool mmap : {false, true}) {
+        options.mmap = mmap;
+        FileSearch search(one, options);
+        t = bestOf(3, [&] { CHECK_EQ(expected, search.search(path).size()); });
+        printThroughput(mmap ? "1 pattern, FileSearch mmap" : "1 pattern, FileSearch pread", bytes, t);
+    }
+
+    t = bestOf(3, [&] { expected = lineReaderSearch(patterns); });
+    printThroughput("4 patterns, LineReader + string::find", bytes, t);
+    options.mmap = false;
+    FileSearch search(patterns, options);
+    t = bestOf(3, [&] { CHECK_EQ(expected, search.search(path).size()); });
+    printThroughput("4 patterns, FileSearch", bytes, t);
+
+    unlink(path.c_str());
+    return 0;
+}
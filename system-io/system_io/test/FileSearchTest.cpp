@@ -0,0 +1,166 @@
+#include "system_io/FileSearch.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        // Lines of 0 to 99 bytes over a small alphabet, so that patterns
+        // match often, and also across blocks
+        std::string makeContents(size_t lines) {
+            std::string out;
+            uint32_t x = 12345;
+            for (size_t i = 0; i < lines; ++i) {
+                x = x * 1103515245 + 12345;
+                size_t length = (x >> 16) % 100;
+                for (size_t j = 0; j < length; ++j) {
+                    x = x * 1103515245 + 12345;
+                    out += char('a' + (x >> 16) % 4);
+                }
+                out += '\n';
+            }
+            return out;
+        }
+
+        // The longest pattern ending first at or after from, like FileSearch
+        bool findReference(const std::string& text, const std::vector<std::string>& patterns,
+                           size_t from, size_t* at, size_t* pattern) {
+            for (size_t end = from + 1; end <= text.size(); ++end) {
+                bool found = false;
+                for (size_t i = 0; i < patterns.size(); ++i) {
+                    const std::string& p = patterns[i];
+                    if (p.size() > end - from || text.compare(end - p.size(), p.size(), p) != 0) {
+                        continue;
+                    }
+                    if (!found || p.size() > patterns[*pattern].size()) {
+                        *at = end - p.size();
+                        *pattern = i;
+                        found = true;
+                    }
+                }
+                if (found) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::vector<FileSearch::Match> searchReference(const std::string& text,
+                                                       const std::vector<std::string>& patterns,
+                                                       bool firstMatchPerLine) {
+            std::vector<FileSearch::Match> matches;
+            size_t from = 0;
+            size_t at;
+            size_t pattern;
+            while (findReference(text, patterns, from, &at, &pattern)) {
+                FileSearch::Match match;
+                match.offset = at;
+                size_t lineBegin = text.rfind('\n', at);
+                lineBegin = lineBegin == std::string::npos ? 0 : lineBegin + 1;
+                size_t lineEnd = text.find('\n', at);
+                lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd;
+                match.line = size_t(std::count(text.begin(), text.begin() + at, '\n'));
+                match.lineOffset = lineBegin;
+                match.pattern = pattern;
+                match.text = text.substr(lineBegin, lineEnd - lineBegin);
+                matches.push_back(match);
+                from = firstMatchPerLine ? lineEnd + 1 : at + 1;
+            }
+            return matches;
+        }
+
+        void expectMatches(const std::vector<FileSearch::Match>& expected,
+                           const std::vector<FileSearch::Match>& actual) {
+            ASSERT_EQ(expected.size(), actual.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQ(expected[i].offset, actual[i].offset) << i;
+                EXPECT_EQ(expected[i].line, actual[i].line) << i;
+                EXPECT_EQ(expected[i].lineOffset, actual[i].lineOffset) << i;
+                EXPECT_EQ(expected[i].pattern, actual[i].pattern) << i;
+                EXPECT_EQ(expected[i].text, actual[i].text) << i;
+            }
+        }
+
+        TEST(FileSearch, MatchesReference) {
+            TemporaryPath path;
+            // The last line has no newline
+            std::string contents = makeContents(2000) + "abcdabcd";
+            ASSERT_TRUE(writeFile(contents, path.c_str()));
+
+            std::vector<std::vector<std::string>> patternSets = {
+                    {"d"},
+                    {"ab"},
+                    {"abcab"},
+                    {"ddddddd"},
+                    {"abcd", "bc", "dddd"},
+                    {"cab", "abca", "ddda", "bbbbbb", "cccc", "aaab"},
+                    // Too many two-byte prefixes to skip with
+                    {"aab", "abb", "acb", "adb", "bab", "bbb", "bcb", "bdb", "cab", "dcba", "c"},
+            };
+            for (const auto& patterns : patternSets) {
+                for (bool firstMatchPerLine : {true, false}) {
+                    auto expected = searchReference(contents, patterns, firstMatchPerLine);
+                    ASSERT_FALSE(expected.empty());
+                    for (bool mmap : {false, true}) {
+                        for (size_t blockSize : {size_t(97), size_t(4096), size_t(1) << 20}) {
+                            SCOPED_TRACE(patterns[0] + " " + std::to_string(patterns.size()) + " " +
+                                         std::to_string(firstMatchPerLine) + " " +
+                                         std::to_string(mmap) + " " + std::to_string(blockSize));
+                            FileSearch::Options options;
+                            options.threads = 3;
+                            options.blockSize = blockSize;
+                            options.mmap = mmap;
+                            options.firstMatchPerLine = firstMatchPerLine;
+                            FileSearch search(patterns, options);
+                            expectMatches(expected, search.search(path.path()));
+                            EXPECT_EQ(contents.size(), search.stats().bytes);
+                            EXPECT_EQ(expected.size(), search.stats().matches);
+                        }
+                    }
+                }
+            }
+        }
+
+        TEST(FileSearch, Options) {
+            TemporaryPath path;
+            std::string contents = makeContents(5000);
+            ASSERT_TRUE(writeFile(contents, path.c_str()));
+            auto expected = searchReference(contents, {"cdcd"}, true);
+            ASSERT_GT(expected.size(), 100u);
+
+            // The first matches in the file, whichever threads find them
+            FileSearch::Options options;
+            options.threads = 4;
+            options.blockSize = 512;
+            options.maxMatches = 50;
+            options.lineText = false;
+            FileSearch search({"cdcd"}, options);
+            auto matches = search.search(path.path());
+            ASSERT_EQ(50u, matches.size());
+            for (size_t i = 0; i < matches.size(); ++i) {
+                EXPECT_EQ(expected[i].offset, matches[i].offset);
+                EXPECT_EQ(expected[i].line, matches[i].line);
+                EXPECT_TRUE(matches[i].text.empty());
+            }
+            EXPECT_LT(search.stats().bytes, contents.size());
+            EXPECT_GE(search.stats().candidates, 50u);
+
+            // No matches, and an empty file
+            EXPECT_TRUE(FileSearch({"e"}).search(path.path()).empty());
+            ASSERT_TRUE(writeFile(std::string(), path.c_str()));
+            EXPECT_TRUE(FileSearch({"a", "b"}).search(path.path()).empty());
+        }
+    }
+}
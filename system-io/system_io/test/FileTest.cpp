@@ -2,6 +2,9 @@
 
 #include <fcntl.h>
 
+#include <atomic>
+#include <cstdlib>
+#include <new>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
@@ -9,6 +12,27 @@
 
 using namespace sysio;
 
+// Counts allocations, to check that the non-throwing API does not allocate
+static std::atomic<size_t> gAllocations(0);
+
+void* operator new(size_t size) {
+    ++gAllocations;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// Not inlined, where GCC would warn about free() of new'ed memory
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
 namespace {
     void expectWouldBlock(ssize_t r) {
         int savedErrno = errno;
@@ -109,4 +133,64 @@ TEST(File, Truthy) {
     if (File notOpened = File()) {
         ADD_FAILURE();
     }
-}
\ No newline at end of file
+}
+
+TEST(File, TryOpen) {
+    size_t before = gAllocations;
+    auto missing = File::tryOpen("does_not_exist.txt");
+    EXPECT_EQ(before, gAllocations.load());
+    ASSERT_FALSE(missing);
+    EXPECT_EQ(std::errc::no_such_file_or_directory, missing.error());
+    // Formatted only on demand
+    EXPECT_FALSE(missing.error().message().empty());
+    EXPECT_THROW(missing.value(), std::system_error);
+
+    auto hosts = File::tryOpen(std::string("/etc/hosts"));
+    ASSERT_TRUE(hosts);
+    EXPECT_NE(-1, hosts->fd());
+    File f = std::move(hosts).value();
+    EXPECT_NE(-1, f.fd());
+
+    auto dup = f.dupNoThrow();
+    ASSERT_TRUE(dup);
+    EXPECT_NE(f.fd(), dup->fd());
+    EXPECT_FALSE(File().dupNoThrow()->operator bool());
+
+    File notOwned(1000000);
+    before = gAllocations;
+    auto badDup = notOwned.dupNoThrow();
+    EXPECT_EQ(before, gAllocations.load());
+    ASSERT_FALSE(badDup);
+    EXPECT_EQ(std::errc::bad_file_descriptor, badDup.error());
+}
+
+TEST(File, LockNoThrow) {
+    File a = File::temporary();
+    File b = File::tryOpen("/proc/self/fd/" + std::to_string(a.fd())).value();
+
+    EXPECT_FALSE(a.lockNoThrow());
+    // Contended: an error, so that if (tryLockNoThrow()) reads as not taken
+    std::error_code locked = b.tryLockNoThrow();
+    EXPECT_TRUE(bool(locked));
+    EXPECT_EQ(std::errc::operation_would_block, locked);
+    std::error_code shared = b.tryLockSharedNoThrow();
+    EXPECT_EQ(std::errc::operation_would_block, shared);
+    EXPECT_FALSE(a.unlockNoThrow());
+
+    EXPECT_FALSE(a.lockSharedNoThrow());
+    shared = b.tryLockSharedNoThrow();
+    EXPECT_FALSE(shared);
+    EXPECT_EQ(std::errc::operation_would_block, a.tryLockNoThrow());
+    EXPECT_FALSE(b.unlockNoThrow());
+    EXPECT_FALSE(a.unlockNoThrow());
+    EXPECT_FALSE(b.tryLockNoThrow());
+    EXPECT_FALSE(b.unlockNoThrow());
+
+    File closed;
+    size_t before = gAllocations;
+    std::error_code ec = closed.lockNoThrow();
+    std::error_code tried = closed.tryLockNoThrow();
+    EXPECT_EQ(before, gAllocations.load());
+    EXPECT_EQ(std::errc::bad_file_descriptor, ec);
+    EXPECT_EQ(std::errc::bad_file_descriptor, tried);
+}
@@ -0,0 +1,91 @@
+/*
+ * Per-call overhead of the FileUtil.h wrappers for small reads, which is
+ * dominated by the system call itself when the file lives on tmpfs.  Run
+ * with --dir on a tmpfs mount (the default, /dev/shm, usually is one).
+ */
+
+#include "system_io/FileUtil.h"
+
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int32(calls, 1000000, "Calls per run");
+DEFINE_int32(read_size, 64, "Bytes per small read");
+DEFINE_int32(iterations, 5, "Runs per measurement; the fastest one is reported");
+DEFINE_string(dir, "/dev/shm", "Directory for the test file; should be tmpfs");
+
+using namespace sysio;
+using namespace sysio::test;
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const std::string path = FLAGS_dir + "/FileUtilBenchmark.dat";
+    const std::string data(4096, 'f');
+    PCHECK(writeFile(data, path.c_str()));
+    int fd = openNoInt(path.c_str(), O_RDONLY | O_CLOEXEC);
+    PCHECK(fd != -1);
+
+    const size_t size = size_t(FLAGS_read_size);
+    std::vector<char> buf(size);
+    const int calls = FLAGS_calls;
+    printf("%d byte reads from %s\n", FLAGS_read_size, path.c_str());
+
+    double t = bestOf(FLAGS_iterations, [&] {
+        for (int i = 0; i < calls; ++i) {
+            PCHECK(::pread(fd, buf.data(), size, 0) == ssize_t(size));
+        }
+    });
+    printRate("pread(), for reference", calls, t);
+
+    t = bestOf(FLAGS_iterations, [&] {
+        for (int i = 0; i < calls; ++i) {
+            PCHECK(preadNoInt(fd, buf.data(), size, 0) == ssize_t(size));
+        }
+    });
+    printRate("preadNoInt()", calls, t);
+
+    t = bestOf(FLAGS_iterations, [&] {
+        for (int i = 0; i < calls; ++i) {
+            PCHECK(preadFull(fd, buf.data(), size, 0) == ssize_t(size));
+        }
+    });
+    printRate("preadFull()", calls, t);
+
+    t = bestOf(FLAGS_iterations, [&] {
+        for (int i = 0; i < calls; ++i) {
+            PCHECK(lseek(fd, 0, SEEK_SET) == 0);
+            PCHECK(readFull(fd, buf.data(), size) == ssize_t(size));
+        }
+    });
+    printRate("lseek() + readFull()", calls, t);
+
+    t = bestOf(FLAGS_iterations, [&] {
+        for (int i = 0; i < calls; ++i) {
+            iovec iov[2] = {{buf.data(), size / 2}, {buf.data() + size / 2, size - size / 2}};
+            PCHECK(lseek(fd, 0, SEEK_SET) == 0);
+            PCHECK(readvFull(fd, iov, 2) == ssize_t(size));
+        }
+    });
+    printRate("lseek() + readvFull(), 2 buffers", calls, t);
+
+    std::string contents;
+    const int fileCalls = calls / 10;
+    t = bestOf(FLAGS_iterations, [&] {
+        for (int i = 0; i < fileCalls; ++i) {
+            PCHECK(readFile(path.c_str(), contents));
+        }
+    });
+    printRate("readFile(), 4KB file", fileCalls, t);
+
+    closeNoInt(fd);
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "system_io/FileUtil.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        TEST(FileUtil, ReadFileContainers) {
+            TemporaryPath path;
+            const std::string data(10000, 'c');
+            ASSERT_TRUE(writeFile(data, path.c_str()));
+
+            std::string s;
+            EXPECT_TRUE(readFile(path.c_str(), s));
+            EXPECT_EQ(data, s);
+
+            std::vector<char> v;
+            EXPECT_TRUE(readFile(path.c_str(), v, 100));
+            EXPECT_EQ(std::vector<char>(100, 'c'), v);
+
+            // Not explicitly instantiated: compiled from the header
+            std::basic_string<unsigned char> u;
+            EXPECT_TRUE(readFile(path.c_str(), u));
+            EXPECT_EQ(data.size(), u.size());
+            EXPECT_TRUE(writeFile(u, path.c_str(), O_WRONLY | O_APPEND));
+            EXPECT_TRUE(readFile(path.c_str(), s));
+            EXPECT_EQ(data + data, s);
+
+            EXPECT_FALSE(readFile((path.path() + ".missing").c_str(), s));
+            EXPECT_EQ(ENOENT, errno);
+        }
+
+        TEST(FileUtil, WriteFileAtomicDelta) {
+            TemporaryPath path;
+            const size_t kBlock = 4096;
+            std::string data(100 * kBlock + 10, 'a');
+            for (size_t i = 0; i < data.size(); ++i) {
+                data[i] = char('a' + i % 23);
+            }
+            iovec iov[3];
+            auto split = [&](const std::string& s) {
+                // Element boundaries that do not line up with blocks
+                iov[0] = {const_cast<char*>(s.data()), 5000};
+                iov[1] = {const_cast<char*>(s.data()) + 5000, 0};
+                iov[2] = {const_cast<char*>(s.data()) + 5000, s.size() - 5000};
+            };
+            DeltaWriteOptions options;
+            options.blockSize = kBlock;
+            options.copyWithoutReflink = true;
+            DeltaWriteResult result;
+
+            // No file yet: written in full
+            split(data);
+            writeFileAtomicDelta(path.path(), iov, 3, &result, options);
+            EXPECT_FALSE(result.incremental);
+            EXPECT_EQ(data.size(), result.bytesWritten);
+            EXPECT_EQ(101u, result.blocks);
+
+            // Change a byte in two blocks, one of them the gathered one, and
+            // grow the file by a partial block
+            std::string next = data;
+            next[4500] = '!';
+            next[50 * kBlock] = '!';
+            next += "tail";
+            split(next);
+            writeFileAtomicDelta(path.path(), iov, 3, &result, options);
+            EXPECT_TRUE(result.incremental);
+            EXPECT_EQ(3u, result.changedBlocks);
+            EXPECT_EQ(2 * kBlock + 14, result.bytesWritten);
+            EXPECT_EQ(5000u, iov[0].iov_len);
+            std::string contents;
+            ASSERT_TRUE(readFile(path.c_str(), contents));
+            EXPECT_EQ(next, contents);
+
+            // Shrinking writes nothing but truncates
+            std::string shorter = next.substr(0, 60 * kBlock);
+            split(shorter);
+            writeFileAtomicDelta(path.path(), iov, 3, &result, options);
+            EXPECT_EQ(0u, result.bytesWritten);
+            ASSERT_TRUE(readFile(path.c_str(), contents));
+            EXPECT_EQ(shorter, contents);
+
+            // Without a copy, it is incremental only where reflinks work
+            options.copyWithoutReflink = false;
+            shorter[0] = '!';
+            split(shorter);
+            writeFileAtomicDelta(path.path(), iov, 3, &result, options);
+            EXPECT_EQ(result.incremental ? kBlock : shorter.size(), result.bytesWritten);
+            ASSERT_TRUE(readFile(path.c_str(), contents));
+            EXPECT_EQ(shorter, contents);
+        }
+
+        TEST(FileUtil, WrapFullResumesShortTransfers) {
+            // An operation that moves at most 3 bytes per call, with offset
+            int calls = 0;
+            std::string source = "0123456789";
+            auto op = [&](int, void* buf, size_t n, off_t offset) -> ssize_t {
+                ++calls;
+                size_t k = std::min<size_t>({n, 3, source.size() - size_t(offset)});
+                memcpy(buf, &source[size_t(offset)], k);
+                return ssize_t(k);
+            };
+            char buf[20];
+            EXPECT_EQ(8, wrapFull(op, -1, buf, 8, off_t(2)));
+            EXPECT_EQ("23456789", std::string(buf, 8));
+            EXPECT_EQ(3, calls);
+
+            // Stops at EOF
+            calls = 0;
+            EXPECT_EQ(4, wrapFull(op, -1, buf, sizeof(buf), off_t(6)));
+            EXPECT_EQ(3, calls);
+        }
+
+        TEST(FileUtil, ReadFileParallel) {
+            TemporaryPath path;
+            std::string data(1000000, '\0');
+            for (size_t i = 0; i < data.size(); ++i) {
+                data[i] = char(i * 7 + i / 4096);
+            }
+            ASSERT_TRUE(writeFile(data, path.c_str()));
+
+            // Chunks are rounded up to pages: 3 pages, and a short last one
+            const size_t chunk = 3 * size_t(sysconf(_SC_PAGESIZE));
+            ParallelReadOptions options;
+            options.threads = 4;
+            options.chunkSize = chunk - 100;
+            std::vector<uint64_t> progress;
+            options.progress = [&](uint64_t done, uint64_t total) {
+                EXPECT_EQ(data.size(), total);
+                progress.push_back(done);
+                return true;
+            };
+            std::string s;
+            ASSERT_TRUE(readFileParallel(path.c_str(), s, options));
+            EXPECT_EQ(data, s);
+            ASSERT_EQ((data.size() + chunk - 1) / chunk, progress.size());
+            EXPECT_TRUE(std::is_sorted(progress.begin(), progress.end()));
+            EXPECT_EQ(data.size(), progress.back());
+
+            // Past the end, and at an offset
+            File file(path.c_str());
+            std::vector<char> buf(data.size());
+            EXPECT_EQ(ssize_t(data.size() - 5000),
+                      preadParallel(file.fd(), buf.data(), buf.size(), 5000, options));
+            EXPECT_EQ(0, memcmp(buf.data(), data.data() + 5000, data.size() - 5000));
+
+            // Cancelled from the callback
+            progress.clear();
+            options.progress = [&](uint64_t done, uint64_t) {
+                progress.push_back(done);
+                return progress.size() < 3;
+            };
+            std::vector<char> v;
+            EXPECT_FALSE(readFileParallel(file.fd(), v, options));
+            EXPECT_EQ(ECANCELED, errno);
+            EXPECT_TRUE(v.empty());
+            // Not called again once cancelled
+            EXPECT_EQ(3u, progress.size());
+
+            // No size to split by: read sequentially
+            ASSERT_TRUE(readFileParallel("/proc/self/status", s));
+            EXPECT_NE(std::string::npos, s.find("Name:"));
+        }
+    }
+}
@@ -0,0 +1,236 @@
+#include "system_io/IoThreadPool.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        // Blocks tasks until opened
+        class Gate {
+        public:
+            void wait() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return open_; });
+            }
+
+            void open() {
+                std::lock_guard<std::mutex> lock(mutex_);
+                open_ = true;
+                cv_.notify_all();
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            bool open_ = false;
+        };
+
+        TEST(IoThreadPool, Futures) {
+            IoThreadPool pool;
+            std::vector<std::future<int>> results;
+            for (int i = 0; i < 1000; ++i) {
+                results.push_back(pool.submit([i] { return i * i; }));
+            }
+            for (int i = 0; i < 1000; ++i) {
+                EXPECT_EQ(i * i, results[size_t(i)].get());
+            }
+
+            auto failed = pool.submit([]() -> int { throw std::runtime_error("boom"); });
+            EXPECT_THROW(failed.get(), std::runtime_error);
+            EXPECT_EQ(1001u, pool.stats().executed);
+        }
+
+        TEST(IoThreadPool, Priorities) {
+            IoThreadPool::Options options;
+            options.threads = 1;
+            IoThreadPool pool(options);
+            Gate gate;
+            pool.submit([&] { gate.wait(); });
+
+            std::mutex mutex;
+            std::string order;
+            auto record = [&](char c) {
+                return [&, c] {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    order += c;
+                };
+            };
+            std::vector<std::future<void>> done;
+            done.push_back(pool.submit(record('l'), IoThreadPool::Priority::kLow));
+            done.push_back(pool.submit(record('n'), IoThreadPool::Priority::kNormal));
+            done.push_back(pool.submit(record('h'), IoThreadPool::Priority::kHigh));
+            done.push_back(pool.submit(record('n'), IoThreadPool::Priority::kNormal));
+            gate.open();
+            for (auto& f : done) {
+                f.get();
+            }
+            EXPECT_EQ("hnnl", order);
+        }
+
+        TEST(IoThreadPool, Backpressure) {
+            IoThreadPool::Options options;
+            options.threads = 1;
+            options.maxQueued = 2;
+            IoThreadPool pool(options);
+            Gate gate;
+            std::atomic<bool> started(false);
+            pool.submit([&] {
+                started = true;
+                gate.wait();
+            });
+            while (!started) {
+                std::this_thread::yield();
+            }
+
+            auto a = pool.trySubmit([] { return 1; });
+            auto b = pool.trySubmit([] { return 2; });
+            auto c = pool.trySubmit([] { return 3; });
+            EXPECT_TRUE(a.valid());
+            EXPECT_TRUE(b.valid());
+            EXPECT_FALSE(c.valid());
+            EXPECT_EQ(2u, pool.stats().queued);
+            EXPECT_EQ(1u, pool.stats().rejectedSubmits);
+
+            // Blocks until the worker makes room
+            std::atomic<bool> submitted(false);
+            std::thread submitter([&] {
+                pool.submit([] {}).get();
+                submitted = true;
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            EXPECT_FALSE(submitted);
+            gate.open();
+            submitter.join();
+            EXPECT_TRUE(submitted);
+            EXPECT_EQ(1, a.get());
+            EXPECT_EQ(2, b.get());
+            EXPECT_EQ(1u, pool.stats().blockedSubmits);
+            EXPECT_EQ(2u, pool.stats().maxQueued);
+        }
+
+        TEST(IoThreadPool, WorkStealing) {
+            IoThreadPool::Options options;
+            options.threads = 4;
+            IoThreadPool pool(options);
+            // One task fans out onto its worker's own queue; the others must
+            // steal to help
+            std::atomic<int> count(0);
+            std::vector<std::future<void>> children;
+            pool.submit([&] {
+                for (int i = 0; i < 200; ++i) {
+                    children.push_back(pool.submit([&] {
+                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                        ++count;
+                    }));
+                }
+            }).get();
+            for (auto& f : children) {
+                f.get();
+            }
+            EXPECT_EQ(200, count);
+            auto stats = pool.stats();
+            EXPECT_EQ(201u, stats.executed);
+            EXPECT_LT(0u, stats.steals);
+            EXPECT_EQ(0u, stats.queued);
+            EXPECT_EQ(4u, stats.queuedPerWorker.size());
+        }
+
+        TEST(IoThreadPool, DestructorDrains) {
+            std::atomic<int> count(0);
+            {
+                IoThreadPool::Options options;
+                options.threads = 2;
+                IoThreadPool pool(options);
+                for (int i = 0; i < 100; ++i) {
+                    pool.submit([&] { ++count; });
+                }
+            }
+            EXPECT_EQ(100, count);
+        }
+
+        TEST(IoThreadPool, SubmitDuringDestruction) {
+            std::atomic<int> count(0);
+            bool cancelled = false;
+            // Outlives the pool, whose destructor runs the chain
+            std::function<void(int)> chain;
+            {
+                IoThreadPool::Options options;
+                options.threads = 2;
+                IoThreadPool pool(options);
+                chain = [&](int n) {
+                    ++count;
+                    if (n > 0) {
+                        pool.submit([&chain, n] { chain(n - 1); });
+                    }
+                };
+                pool.submit([&] {
+                    // Holds the destructor up until another thread is
+                    // refused, then submits from the worker
+                    std::thread outside([&] {
+                        for (;;) {
+                            auto future = pool.submit([] {});
+                            try {
+                                future.get();
+                            } catch (const std::system_error& e) {
+                                EXPECT_EQ(ECANCELED, e.code().value());
+                                cancelled = true;
+                                return;
+                            }
+                        }
+                    });
+                    outside.join();
+                    chain(10);
+                });
+            }
+            EXPECT_TRUE(cancelled);
+            EXPECT_EQ(11, count);
+        }
+
+        TEST(IoThreadPool, FileOperations) {
+            IoThreadPool pool;
+            TemporaryPath path;
+            std::string data(100000, 'd');
+            writeFileAsync(pool, data, path.path()).get();
+            EXPECT_EQ(data, readFileAsync(pool, path.path()).get());
+            EXPECT_EQ(data.substr(0, 10), readFileAsync(pool, path.path(), 10).get());
+
+            writeFileAtomicAsync(pool, path.path(), "atomic").get();
+            EXPECT_EQ("atomic", readFileAsync(pool, path.path()).get());
+
+            File f(path.path());
+            char buf[16];
+            EXPECT_EQ(3u, preadFullAsync(pool, f.fd(), buf, sizeof(buf), 3).get());
+            EXPECT_EQ("mic", std::string(buf, 3));
+
+            try {
+                readFileAsync(pool, path.path() + ".missing").get();
+                ADD_FAILURE() << "read of a missing file succeeded";
+            } catch (const std::system_error& e) {
+                EXPECT_EQ(ENOENT, e.code().value());
+            }
+            EXPECT_THROW(preadFullAsync(pool, -1, buf, sizeof(buf), 0).get(), std::system_error);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+/*
+ * Reading lines from the middle of a large text file: skipping to them with
+ * LineReader against a LineIndex, and the cost of building the index
+ * compared with reading the file through LineReader once.
+ *
+ * The file is --size_mb of lines of 1 to 200 bytes.  --reads ranges of 10
+ * lines are read at random line numbers.
+ */
+
+#include "system_io/LineIndex.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/LineReader.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int32(size_mb, 1024, "Size of the file in MB");
+DEFINE_int32(reads, 1000, "Random line ranges read through the index");
+DEFINE_int32(threads, 0, "Threads building the index; 0 for one per CPU");
+DEFINE_string(dir, "/tmp", "Directory for the file");
+
+using namespace sysio;
+using namespace sysio::test;
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const std::string path = FLAGS_dir + "/LineIndexBenchmark.txt";
+    const std::string indexPath = path + ".lineidx";
+    {
+        const size_t size = size_t(FLAGS_size_mb) << 20;
+        std::string data;
+        data.reserve(size + 256);
+        uint64_t x = 88172645463325252ull;
+        while (data.size() < size) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            data.append(size_t(x % 200), 'x');
+            data += '\n';
+        }
+        PCHECK(writeFile(data, path.c_str()));
+    }
+    const double bytes = double(size_t(FLAGS_size_mb) << 20);
+
+    uint64_t lines = 0;
+    double t = bestOf(3, [&] {
+        File file(path);
+        LineReader reader(file.fd(), LineReader::Options());
+        const char* begin;
+        const char* end;
+        lines = 0;
+        while (reader.readLines(&begin, &end) == LineReader::kReading) {
+            for (const char* p = begin; p != end; ++p) {
+                lines += *p == '\n';
+            }
+        }
+    });
+    printThroughput("count lines, LineReader", bytes, t);
+
+    LineIndex::Options options;
+    options.threads = size_t(FLAGS_threads);
+    t = bestOf(3, [&] {
+        unlink(indexPath.c_str());
+        LineIndex index(path, options);
+        CHECK_EQ(lines, index.lines());
+    });
+    printThroughput("build LineIndex (and write the sidecar)", bytes, t);
+
+    t = bestOf(3, [&] { LineIndex index(path, options); });
+    printRate("open LineIndex from the sidecar", 1, t);
+
+    // Skipping from the start costs half the file per read on average: time
+    // a few
+    const int skips = 5;
+    uint64_t x = 2463534242u;
+    auto nextLine = [&] {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x % (lines - 10);
+    };
+    t = bestOf(1, [&] {
+        File file(path);
+        for (int i = 0; i < skips; ++i) {
+            CHECK_ERR(lseek(file.fd(), 0, SEEK_SET));
+            LineReader reader(file.fd(), LineReader::Options());
+            uint64_t target = nextLine();
+            std::string line;
+            for (uint64_t n = 0; n < target + 10; ++n) {
+                CHECK_EQ(LineReader::kReading, reader.readLine(line));
+            }
+        }
+    });
+    printRate("read 10 lines at line N, LineReader skip", skips, t);
+
+    LineIndex index(path, options);
+    t = bestOf(3, [&] {
+        std::string out;
+        for (int i = 0; i < FLAGS_reads; ++i) {
+            out.clear();
+            CHECK_EQ(10u, index.readLines(nextLine(), 10, out));
+        }
+    });
+    printRate("read 10 lines at line N, LineIndex", FLAGS_reads, t);
+
+    unlink(indexPath.c_str());
+    unlink(path.c_str());
+    return 0;
+}
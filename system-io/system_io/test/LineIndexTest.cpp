@@ -0,0 +1,157 @@
+#include "system_io/LineIndex.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/LineReader.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        // Lines of 0 to 199 bytes, so that some span SIMD blocks and chunks
+        std::vector<std::string> makeLines(size_t count, size_t first = 0) {
+            std::vector<std::string> lines;
+            for (size_t i = first; i < first + count; ++i) {
+                lines.push_back(std::string((i * 37) % 200, char('a' + i % 26)) + "\n");
+            }
+            return lines;
+        }
+
+        std::string join(const std::vector<std::string>& lines) {
+            std::string out;
+            for (const auto& line : lines) {
+                out += line;
+            }
+            return out;
+        }
+
+        LineIndex::Options smallOptions(const std::string& indexPath) {
+            LineIndex::Options options;
+            options.interval = 7;
+            options.threads = 3;
+            options.chunkSize = 1000;
+            options.indexPath = indexPath;
+            return options;
+        }
+
+        void expectIndexed(LineIndex& index, const std::vector<std::string>& lines) {
+            ASSERT_EQ(lines.size(), index.lines());
+            uint64_t offset = 0;
+            for (size_t i = 0; i < lines.size(); ++i) {
+                ASSERT_EQ(offset, index.offsetOf(i)) << i;
+                offset += lines[i].size();
+            }
+            EXPECT_EQ(offset, index.offsetOf(lines.size()));
+        }
+
+        TEST(LineIndex, Build) {
+            TemporaryPath path;
+            TemporaryPath indexPath;
+            auto lines = makeLines(3000);
+            // The last line has no newline
+            std::string contents = join(lines) + "partial";
+            ASSERT_TRUE(writeFile(contents, path.c_str()));
+
+            LineIndex index(path.path(), smallOptions(indexPath.path()));
+            EXPECT_FALSE(index.stats().loaded);
+            EXPECT_EQ(contents.size(), index.stats().scannedBytes);
+            EXPECT_EQ(contents.size(), index.size());
+            expectIndexed(index, lines);
+
+            std::string out;
+            EXPECT_EQ(5u, index.readLines(1234, 5, out));
+            EXPECT_EQ(lines[1234] + lines[1235] + lines[1236] + lines[1237] + lines[1238], out);
+            out.clear();
+            EXPECT_EQ(3u, index.readLines(2998, 10, out));
+            EXPECT_EQ(lines[2998] + lines[2999] + "partial", out);
+            out.clear();
+            EXPECT_EQ(0u, index.readLines(3001, 1, out));
+
+            index.seekToLine(2500);
+            LineReader reader(index.fd(), LineReader::Options());
+            std::string line;
+            ASSERT_EQ(LineReader::kReading, reader.readLine(line));
+            EXPECT_EQ(lines[2500], line);
+        }
+
+        TEST(LineIndex, SidecarAndAppend) {
+            TemporaryPath path;
+            TemporaryPath indexPath;
+            auto lines = makeLines(1000);
+            ASSERT_TRUE(writeFile(join(lines), path.c_str()));
+            {
+                LineIndex index(path.path(), smallOptions(indexPath.path()));
+                EXPECT_EQ(1u, index.stats().rebuilds);
+            }
+
+            // Loaded, nothing scanned
+            {
+                LineIndex index(path.path(), smallOptions(indexPath.path()));
+                EXPECT_TRUE(index.stats().loaded);
+                EXPECT_EQ(0u, index.stats().scannedBytes);
+                expectIndexed(index, lines);
+            }
+
+            // Appended to: only the new lines are scanned, at open and on
+            // refresh()
+            auto more = makeLines(500, 1000);
+            std::string appended = join(more);
+            {
+                int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+                CHECK_ERR(fd);
+                CHECK_EQ(ssize_t(appended.size()), writeFull(fd, appended.data(), appended.size()));
+                close(fd);
+            }
+            lines.insert(lines.end(), more.begin(), more.end());
+            {
+                LineIndex index(path.path(), smallOptions(indexPath.path()));
+                EXPECT_EQ(1u, index.stats().extensions);
+                EXPECT_EQ(0u, index.stats().rebuilds);
+                EXPECT_EQ(appended.size(), index.stats().scannedBytes);
+                expectIndexed(index, lines);
+
+                EXPECT_FALSE(index.refresh());
+                more = makeLines(300, 1500);
+                appended = join(more);
+                int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+                CHECK_ERR(fd);
+                CHECK_EQ(ssize_t(appended.size()), writeFull(fd, appended.data(), appended.size()));
+                close(fd);
+                lines.insert(lines.end(), more.begin(), more.end());
+                EXPECT_TRUE(index.refresh());
+                EXPECT_EQ(2u, index.stats().extensions);
+                expectIndexed(index, lines);
+            }
+
+            // Rewritten: rebuilt
+            lines = makeLines(700, 3);
+            ASSERT_TRUE(writeFile(join(lines), path.c_str()));
+            {
+                LineIndex index(path.path(), smallOptions(indexPath.path()));
+                EXPECT_EQ(1u, index.stats().rebuilds);
+                EXPECT_EQ(0u, index.stats().extensions);
+                expectIndexed(index, lines);
+            }
+
+            // A corrupt sidecar is rebuilt too
+            ASSERT_TRUE(writeFile(std::string("garbage"), indexPath.c_str()));
+            {
+                LineIndex index(path.path(), smallOptions(indexPath.path()));
+                EXPECT_FALSE(index.stats().loaded);
+                expectIndexed(index, lines);
+            }
+        }
+    }
+}
@@ -72,7 +72,89 @@ namespace sysio
                 expect(lr, "");
             }
         }
-    }
-}
 
+        TEST(LineReader, ReadLines) {
+            File tmp = File::temporary();
+            int fd = tmp.fd();
+            writeAll(fd, "one\ntwo\nthree\nfour");
+            CHECK_ERR(lseek(fd, 0, SEEK_SET));
+
+            char buf[12];
+            LineReader lr(fd, buf, sizeof(buf));
+            const char* b;
+            const char* e;
+            // Only whole lines, as many as fit
+            ASSERT_EQ(LineReader::kReading, lr.readLines(&b, &e));
+            EXPECT_EQ("one\ntwo\n", std::string(b, e));
+            // Give back "two\n"; it comes back along with what follows
+            lr.unreadFrom(b + 4);
+            ASSERT_EQ(LineReader::kReading, lr.readLines(&b, &e));
+            EXPECT_EQ("two\nthree\n", std::string(b, e));
+            ASSERT_EQ(LineReader::kReading, lr.readLines(&b, &e));
+            EXPECT_EQ("four", std::string(b, e));
+            EXPECT_EQ(LineReader::kEof, lr.state());
+            EXPECT_EQ(LineReader::kEof, lr.readLines(&b, &e));
+        }
+
+        TEST(LineReader, Growable) {
+            File tmp = File::temporary();
+            int fd = tmp.fd();
+            std::string longLine(30, 'x');
+            std::string tooLong(100, 'y');
+            writeAll(fd, ("a\n" + longLine + "\nb\nc\nd\n" + tooLong + "\ne\nf\ng\nh\n").c_str());
+            CHECK_ERR(lseek(fd, 0, SEEK_SET));
 
+            LineReader::Options options;
+            options.initialSize = 8;
+            options.maxSize = 64;
+            options.shrinkAfter = 2;
+            LineReader lr(fd, options);
+            EXPECT_EQ(8u, lr.capacity());
+            expect(lr, "a\n");
+            // Grows 8 -> 16 -> 32 to hold the line whole
+            expect(lr, (longLine + "\n").c_str());
+            EXPECT_EQ(2u, lr.stats().grows);
+            EXPECT_EQ(32u, lr.capacity());
+            expect(lr, "b\n");
+            expect(lr, "c\n");
+            expect(lr, "d\n");
+            // Split at the cap
+            expect(lr, tooLong.substr(0, 64).c_str());
+            expect(lr, (tooLong.substr(64) + "\n").c_str());
+            EXPECT_EQ(1u, lr.stats().splitLines);
+            EXPECT_EQ(64u, lr.stats().peakCapacity);
+            EXPECT_EQ(0u, lr.stats().shrinks);
+            // Back to the initial size after two short lines
+            expect(lr, "e\n");
+            expect(lr, "f\n");
+            expect(lr, "g\n");
+            expect(lr, "h\n");
+            expect(lr, "");
+            EXPECT_EQ(1u, lr.stats().shrinks);
+            EXPECT_EQ(8u, lr.capacity());
+        }
+
+        TEST(LineReader, GrowableReadLines) {
+            File tmp = File::temporary();
+            int fd = tmp.fd();
+            std::string longLine(20, 'x');
+            writeAll(fd, ("one\n" + longLine + "\ntwo").c_str());
+            CHECK_ERR(lseek(fd, 0, SEEK_SET));
+
+            LineReader::Options options;
+            options.initialSize = 8;
+            LineReader lr(fd, options);
+            const char* b;
+            const char* e;
+            ASSERT_EQ(LineReader::kReading, lr.readLines(&b, &e));
+            EXPECT_EQ("one\n", std::string(b, e));
+            ASSERT_EQ(LineReader::kReading, lr.readLines(&b, &e));
+            EXPECT_EQ(longLine + "\n", std::string(b, e));
+            ASSERT_EQ(LineReader::kReading, lr.readLines(&b, &e));
+            EXPECT_EQ("two", std::string(b, e));
+            EXPECT_EQ(LineReader::kEof, lr.readLines(&b, &e));
+            EXPECT_EQ(0u, lr.stats().splitLines);
+            EXPECT_EQ(2u, lr.stats().grows);
+        }
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ * Small random in-place updates and small appends: pwriteFull() per record
+ * against stores into a MappedFile.
+ *
+ * The update runs overwrite --record_size byte records at random offsets of
+ * a --size_mb file, syncing every --sync_every updates (fdatasync() for
+ * pwrite, flush(kSync) for the mapping; 0 never syncs).  The append runs
+ * append --append_mb of records to an empty file.  Use --dir on the disk of
+ * interest.
+ *
+ * Each run starts with the file written back, so that none pays for the
+ * dirty pages of the one before it (writeback throttling), and with
+ * --cold also dropped from the page cache, so that all read what they
+ * update from the disk.
+ */
+
+#include "system_io/MappedFile.h"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int32(size_mb, 256, "File size in MB for the update runs");
+DEFINE_int32(updates, 1 << 20, "Random record updates per run");
+DEFINE_int32(record_size, 64, "Bytes per record");
+DEFINE_int32(sync_every, 0, "Updates between syncs; 0 for none");
+DEFINE_int32(append_mb, 256, "MB appended by the append runs");
+DEFINE_bool(cold, true, "Drop the file from the page cache before each run");
+DEFINE_string(dir, "/tmp", "Directory for the test file");
+
+using namespace sysio;
+using namespace sysio::test;
+
+namespace
+{
+    // Random record-aligned offsets
+    std::vector<size_t> offsets(size_t fileSize) {
+        std::vector<size_t> result(static_cast<size_t>(FLAGS_updates));
+        size_t records = fileSize / size_t(FLAGS_record_size);
+        uint64_t x = 88172645463325252ull;
+        for (auto& offset : result) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            offset = (x % records) * size_t(FLAGS_record_size);
+        }
+        return result;
+    }
+
+    bool syncNow(int i) {
+        return FLAGS_sync_every != 0 && (i + 1) % FLAGS_sync_every == 0;
+    }
+
+    // Writes the file back, and drops it from the page cache if --cold
+    void settle(const std::string& path) {
+        File file(path);
+        PCHECK(fdatasync(file.fd()) == 0);
+        if (FLAGS_cold) {
+            PCHECK(posix_fadvise(file.fd(), 0, 0, POSIX_FADV_DONTNEED) == 0);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const std::string path = FLAGS_dir + "/MappedFileBenchmark.dat";
+    const size_t size = size_t(FLAGS_size_mb) << 20;
+    const std::string record(size_t(FLAGS_record_size), 'r');
+    const auto where = offsets(size);
+    {
+        std::string data(size, 'd');
+        PCHECK(writeFile(data, path.c_str()));
+    }
+
+    double t;
+    settle(path);
+    {
+        File file(path, O_RDWR | O_CLOEXEC);
+        t = bestOf(1, [&] {
+            for (int i = 0; i < FLAGS_updates; ++i) {
+                PCHECK(pwriteFull(file.fd(), record.data(), record.size(), off_t(where[size_t(i)])) != -1);
+                if (syncNow(i)) {
+                    PCHECK(fdatasync(file.fd()) == 0);
+                }
+            }
+        });
+    }
+    printRate("random updates, pwriteFull()", FLAGS_updates, t);
+
+    settle(path);
+    {
+        MappedFile file(path);
+        t = bestOf(1, [&] {
+            for (int i = 0; i < FLAGS_updates; ++i) {
+                file.write(where[size_t(i)], record.data(), record.size());
+                if (syncNow(i)) {
+                    file.flush(MappedFile::Flush::kSync);
+                }
+            }
+        });
+        auto stats = file.stats();
+        printRate("random updates, MappedFile", FLAGS_updates, t);
+        if (stats.flushes != 0) {
+            printf("%-48s %10.1f ranges per flush\n", "",
+                   double(stats.flushedRanges) / double(stats.flushes));
+        }
+    }
+
+    const size_t appends = (size_t(FLAGS_append_mb) << 20) / record.size();
+    settle(path);
+    unlink(path.c_str());
+    {
+        File file(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC);
+        t = bestOf(1, [&] {
+            for (size_t i = 0; i < appends; ++i) {
+                PCHECK(writeFull(file.fd(), record.data(), record.size()) != -1);
+            }
+        });
+    }
+    printThroughput("appends, writeFull()", double(appends * record.size()), t);
+
+    settle(path);
+    unlink(path.c_str());
+    {
+        MappedFile file(path);
+        t = bestOf(1, [&] {
+            for (size_t i = 0; i < appends; ++i) {
+                memcpy(file.append(record.size()), record.data(), record.size());
+            }
+        });
+        printThroughput("appends, MappedFile", double(appends * record.size()), t);
+        printf("%-48s %10lu grows %6lu moves\n", "",
+               static_cast<unsigned long>(file.stats().grows),
+               static_cast<unsigned long>(file.stats().moves));
+    }
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "system_io/MappedFile.h"
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        off_t fileSize(const std::string& path) {
+            struct stat st;
+            PCHECK(stat(path.c_str(), &st) == 0);
+            return st.st_size;
+        }
+
+        // Appends synced, then more not synced, and is killed without
+        // closing the file
+        void appendAndKill(const std::string& path, const MappedFile::Options& options,
+                           const std::string& synced, const std::string& unsynced) {
+            pid_t child = fork();
+            ASSERT_NE(-1, child);
+            if (child == 0) {
+                MappedFile file(path, options);
+                memcpy(file.append(synced.size()), synced.data(), synced.size());
+                file.flush(MappedFile::Flush::kSync);
+                memcpy(file.append(unsynced.size()), unsynced.data(), unsynced.size());
+                raise(SIGKILL);
+            }
+            int status;
+            ASSERT_EQ(child, waitpid(child, &status, 0));
+            ASSERT_TRUE(WIFSIGNALED(status));
+        }
+
+        TEST(MappedFile, AppendAndGrow) {
+            TemporaryPath path;
+            MappedFile::Options options;
+            options.growthStep = 64 << 10;
+            std::string expected;
+            {
+                MappedFile file(path.path(), options);
+                EXPECT_EQ(0u, file.size());
+                for (int i = 0; i < 10000; ++i) {
+                    std::string record = std::to_string(i) + "\n";
+                    memcpy(file.append(record.size()), record.data(), record.size());
+                    expected += record;
+                }
+                EXPECT_EQ(expected.size(), file.size());
+                EXPECT_EQ(0u, file.capacity() % options.growthStep);
+                EXPECT_EQ(off_t(file.capacity()), fileSize(path.path()));
+                EXPECT_EQ(1u, file.stats().grows);
+                EXPECT_EQ(expected.size() / 4096 + 1, file.dirtyBytes() / 4096);
+
+                file.flush();
+                EXPECT_EQ(0u, file.dirtyBytes());
+                EXPECT_EQ(1u, file.stats().flushedRanges);
+                file.close();
+            }
+            // Trimmed to size
+            std::string contents;
+            ASSERT_TRUE(readFile(path.c_str(), contents));
+            EXPECT_EQ(expected, contents);
+
+            // Reopen, update in place and grow by writing past the end
+            {
+                MappedFile file(path.path(), options);
+                EXPECT_EQ(expected.size(), file.size());
+                EXPECT_EQ(0, memcmp(expected.data(), file.data(), expected.size()));
+                file.write(0, "X", 1);
+                file.write(100 << 10, "end", 3);
+                EXPECT_EQ((100u << 10) + 3, file.size());
+                EXPECT_EQ(0, file.data()[expected.size()]);
+            }
+            ASSERT_TRUE(readFile(path.c_str(), contents));
+            EXPECT_EQ((100u << 10) + 3, contents.size());
+            EXPECT_EQ('X', contents[0]);
+            EXPECT_EQ("end", contents.substr(100 << 10));
+        }
+
+        TEST(MappedFile, ReopenAfterKill) {
+            TemporaryPath path;
+            TemporaryPath sizePath;
+            MappedFile::Options options;
+            options.growthStep = 64 << 10;
+
+            // Without a size file, the padding becomes data
+            appendAndKill(path.path(), options, "first", "lost");
+            EXPECT_EQ(off_t(options.growthStep), fileSize(path.path()));
+            {
+                MappedFile file(path.path(), options);
+                EXPECT_EQ(options.growthStep, file.size());
+            }
+            ASSERT_EQ(0, unlink(path.c_str()));
+
+            // With one, the file reopens at the synced size, and appends go
+            // right after it
+            options.sizePath = sizePath.path();
+            appendAndKill(path.path(), options, "first", "lost");
+            EXPECT_EQ(off_t(options.growthStep), fileSize(path.path()));
+            appendAndKill(path.path(), options, "second", "lost");
+            {
+                MappedFile file(path.path(), options);
+                EXPECT_EQ("firstsecond", std::string(file.data(), file.size()));
+                memcpy(file.append(5), "third", 5);
+                EXPECT_EQ("firstsecondthird", std::string(file.data(), file.size()));
+                // Cleared, not left over from the killed writers
+                file.resize(file.size() + 4);
+                EXPECT_EQ(std::string(4, '\0'), std::string(file.data() + 16, 4));
+                file.resize(16);
+                file.close();
+            }
+            EXPECT_EQ(16, fileSize(path.path()));
+
+            // close() records the size too
+            {
+                MappedFile file(path.path(), options);
+                EXPECT_EQ(16u, file.size());
+                memcpy(file.append(1), "!", 1);
+            }
+            MappedFile file(path.path(), options);
+            EXPECT_EQ("firstsecondthird!", std::string(file.data(), file.size()));
+        }
+
+        TEST(MappedFile, DirtyRanges) {
+            TemporaryPath path;
+            MappedFile file(path.path());
+            file.resize(1 << 20);
+            EXPECT_EQ(0u, file.dirtyBytes());
+
+            file.markDirty(10, 1);             // page 0
+            file.markDirty(4096 * 2, 4096);    // page 2
+            file.markDirty(4096 * 2 + 5, 10);  // page 2 again
+            EXPECT_EQ(2u * 4096, file.dirtyBytes());
+            file.markDirty(4000, 200);         // pages 0-1: joins 0 and 2
+            file.markDirty(4096 * 10, 4097);   // pages 10-11
+            EXPECT_EQ(5u * 4096, file.dirtyBytes());
+
+            file.flush(MappedFile::Flush::kWriteback);
+            auto stats = file.stats();
+            EXPECT_EQ(2u, stats.flushedRanges);
+            EXPECT_EQ(5u * 4096, stats.flushedBytes);
+
+            // Shrinking and growing again reads back zeros
+            file.write(1000, "abc", 3);
+            file.resize(1000);
+            file.resize(2000);
+            EXPECT_EQ(0, file.data()[1000]);
+            file.flush(MappedFile::Flush::kAsync);
+            EXPECT_EQ(2u, file.stats().flushes);
+        }
+
+        TEST(MappedFile, ReserveKeepsPointers) {
+            TemporaryPath path;
+            MappedFile::Options options;
+            options.growthStep = 4096;
+            options.reserve = 1 << 20;
+            MappedFile file(path.path(), options);
+            file.append(1);
+            const char* data = file.data();
+            uint64_t generation = file.generation();
+            for (int i = 0; i < 255; ++i) {
+                file.append(4096);
+            }
+            EXPECT_EQ(data, file.data());
+            EXPECT_EQ(generation, file.generation());
+            EXPECT_EQ(256u, file.stats().grows);
+
+            // Past the reservation it may move, and the contents stay
+            file.write(file.size() - 1, "z", 1);
+            file.append(2 << 20);
+            EXPECT_EQ('z', file.data()[(255 << 12)]);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#include "system_io/MappedLineReader.h"
+
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        void append(const File& file, const std::string& data) {
+            CHECK_EQ(ssize_t(data.size()), writeFull(file.fd(), data.data(), data.size()));
+        }
+
+        std::vector<std::string> readLines(MappedLineReader& reader) {
+            std::vector<std::string> lines;
+            const char* b;
+            const char* e;
+            MappedLineReader::State state;
+            while ((state = reader.readLine(&b, &e)) == MappedLineReader::kReading) {
+                lines.emplace_back(b, e);
+            }
+            EXPECT_EQ(MappedLineReader::kEof, state);
+            return lines;
+        }
+
+        TEST(MappedLineReader, Simple) {
+            File tmp = File::temporary();
+            append(tmp, "Meow\nHello world\n\nIncomplete last line");
+            MappedLineReader reader(tmp.fd());
+            EXPECT_THAT(readLines(reader), testing::ElementsAre(
+                    "Meow\n", "Hello world\n", "\n", "Incomplete last line"));
+
+            File empty = File::temporary();
+            MappedLineReader emptyReader(empty.fd());
+            EXPECT_TRUE(readLines(emptyReader).empty());
+        }
+
+        TEST(MappedLineReader, LinesSpanningWindows) {
+            // Random lines, some longer than several windows of one page
+            std::mt19937 rng(42);
+            std::vector<std::string> expected;
+            std::string data;
+            size_t page = size_t(sysconf(_SC_PAGESIZE));
+            for (int i = 0; i < 2000; ++i) {
+                size_t length = i % 500 == 7 ? 3 * page + 5 : rng() % 200;
+                std::string line(length, char('a' + i % 26));
+                line += '\n';
+                expected.push_back(line);
+                data += line;
+            }
+            File tmp = File::temporary();
+            append(tmp, data);
+
+            MappedLineReader::Options options;
+            options.windowSize = page;
+            options.dropBehind = 2 * page;
+            MappedLineReader reader(tmp.fd(), options);
+            EXPECT_EQ(expected, readLines(reader));
+            EXPECT_EQ(data.size(), reader.offset());
+            EXPECT_GT(reader.stats().remaps, data.size() / page / 2);
+            EXPECT_GT(reader.stats().bytesDropped, 0u);
+
+            // Blocks of whole lines
+            MappedLineReader blocks(tmp.fd(), options);
+            std::string joined;
+            const char* b;
+            const char* e;
+            while (blocks.readLines(&b, &e) == MappedLineReader::kReading) {
+                ASSERT_EQ('\n', e[-1]);
+                joined.append(b, e);
+            }
+            EXPECT_EQ(data, joined);
+        }
+
+        TEST(MappedLineReader, GrowingFile) {
+            File tmp = File::temporary();
+            append(tmp, "one\ntw");
+            MappedLineReader::Options options;
+            options.partialLastLine = false;
+            MappedLineReader reader(tmp.fd(), options);
+            const char* b;
+            const char* e;
+            ASSERT_EQ(MappedLineReader::kReading, reader.readLine(&b, &e));
+            EXPECT_EQ("one\n", std::string(b, e));
+            // "tw" is held back until its newline arrives
+            EXPECT_EQ(MappedLineReader::kEof, reader.readLine(&b, &e));
+            EXPECT_EQ(4u, reader.offset());
+
+            append(tmp, "o\nthree\nfo");
+            ASSERT_EQ(MappedLineReader::kReading, reader.readLine(&b, &e));
+            EXPECT_EQ("two\n", std::string(b, e));
+            ASSERT_EQ(MappedLineReader::kReading, reader.readLine(&b, &e));
+            EXPECT_EQ("three\n", std::string(b, e));
+            EXPECT_EQ(MappedLineReader::kEof, reader.readLine(&b, &e));
+
+            append(tmp, "ur\n");
+            ASSERT_EQ(MappedLineReader::kReading, reader.readLine(&b, &e));
+            EXPECT_EQ("four\n", std::string(b, e));
+            EXPECT_EQ(MappedLineReader::kEof, reader.readLine(&b, &e));
+        }
+
+        TEST(MappedLineReader, Errors) {
+            const char* b;
+            const char* e;
+            MappedLineReader bad(-1);
+            EXPECT_EQ(MappedLineReader::kError, bad.readLine(&b, &e));
+            EXPECT_EQ(EBADF, errno);
+            // Stays failed
+            EXPECT_EQ(MappedLineReader::kError, bad.readLine(&b, &e));
+        }
+    }
+}
@@ -0,0 +1,190 @@
+/*
+ * Scan throughput and page faults of buffers and file mappings backed by
+ * 4 KB pages, transparent huge pages and hugetlbfs pages (reserve some in
+ * /proc/sys/vm/nr_hugepages first, or the hugetlbfs runs fall back to
+ * transparent huge pages), with and without pre-faulting.
+ *
+ * Fault counts are minor faults (getrusage()) taken during the timed run.
+ * The file runs read a page-cached file in --dir.
+ */
+
+#include "system_io/PageMemory.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/FileUtil.h"
+#include "system_io/MappedLineReader.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int32(size_mb, 512, "Buffer size in MB");
+DEFINE_int32(file_mb, 256, "File size in MB for the readFile() and mapping runs");
+DEFINE_int32(random_reads, 4 << 20, "Random 8 byte reads per scan");
+DEFINE_int32(iterations, 3, "Runs per measurement; the fastest one is reported");
+DEFINE_string(dir, "/tmp", "Directory for the test file");
+
+using namespace sysio;
+using namespace sysio::test;
+
+namespace
+{
+    struct Mode
+    {
+        const char* name;
+        PageOptions options;
+    };
+
+    std::vector<Mode> modes() {
+        std::vector<Mode> result;
+        PageOptions options;
+        result.push_back({"4 KB", options});
+        options.populate = true;
+        result.push_back({"4 KB, populated", options});
+        options = PageOptions();
+        options.hugePages = true;
+        result.push_back({"THP", options});
+        options.populate = true;
+        result.push_back({"THP, populated", options});
+        options = PageOptions();
+        options.hugeTlb = true;
+        result.push_back({"hugetlbfs", options});
+        return result;
+    }
+
+    long minorFaults() {
+        rusage usage;
+        PCHECK(getrusage(RUSAGE_SELF, &usage) == 0);
+        return usage.ru_minflt;
+    }
+
+    // Runs fn() like bestOf(), and also reports the faults of the best run
+    template <class F>
+    double measure(int iterations, long* faults, F fn) {
+        double best = 0;
+        for (int i = 0; i < iterations; ++i) {
+            long before = minorFaults();
+            double t = bestOf(1, fn);
+            if (i == 0 || t < best) {
+                best = t;
+                *faults = minorFaults() - before;
+            }
+        }
+        return best;
+    }
+
+    void print(const std::string& name, double bytes, double seconds, long faults) {
+        printThroughput(name.c_str(), bytes, seconds);
+        printf("%-48s %10ld minor faults\n", "", faults);
+    }
+
+    volatile uint64_t sink;
+}
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const size_t size = size_t(FLAGS_size_mb) << 20;
+    const size_t words = size / sizeof(uint64_t);
+    long faults = 0;
+
+    for (const Mode& mode : modes()) {
+        std::string name = mode.name;
+        PageBuffer probe(kHugePageSize, mode.options);
+        if (mode.options.hugeTlb && !probe.hugeTlb()) {
+            name += " (fell back to THP)";
+        }
+
+        // Allocation included, so that populate is not free
+        double t = measure(FLAGS_iterations, &faults, [&] {
+            PageBuffer buf(size, mode.options);
+            memset(buf.data(), 1, size);
+        });
+        print(name + ": allocate + fill", double(size), t, faults);
+
+        PageBuffer buf(size, mode.options);
+        memset(buf.data(), 1, size);
+        const uint64_t* p = reinterpret_cast<const uint64_t*>(buf.data());
+        t = measure(FLAGS_iterations, &faults, [&] {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < words; ++i) {
+                sum += p[i];
+            }
+            sink = sum;
+        });
+        print(name + ": sequential scan", double(size), t, faults);
+
+        t = measure(FLAGS_iterations, &faults, [&] {
+            uint64_t sum = 0;
+            uint64_t x = 88172645463325252ull;
+            for (int i = 0; i < FLAGS_random_reads; ++i) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                sum += p[x % words];
+            }
+            sink = sum;
+        });
+        printRate((name + ": random reads").c_str(), FLAGS_random_reads, t);
+    }
+
+    // Reading a file into a container, and scanning its lines over a mapping
+    const std::string path = FLAGS_dir + "/PageMemoryBenchmark.dat";
+    {
+        std::string line(99, 'p');
+        line += '\n';
+        std::string data;
+        data.reserve(size_t(FLAGS_file_mb) << 20);
+        while (data.size() < (size_t(FLAGS_file_mb) << 20)) {
+            data += line;
+        }
+        PCHECK(writeFile(data, path.c_str()));
+    }
+    const double fileBytes = double(size_t(FLAGS_file_mb) << 20);
+
+    double t = measure(FLAGS_iterations, &faults, [&] {
+        std::vector<char> contents;
+        PCHECK(readFile(path.c_str(), contents));
+    });
+    print("readFile(), std::vector<char>", fileBytes, t, faults);
+
+    for (const Mode& mode : modes()) {
+        t = measure(FLAGS_iterations, &faults, [&] {
+            std::vector<char, PageAllocator<char>> contents{PageAllocator<char>(mode.options)};
+            PCHECK(readFile(path.c_str(), contents));
+        });
+        print(std::string("readFile(), PageAllocator ") + mode.name, fileBytes, t, faults);
+    }
+
+    int fd = openNoInt(path.c_str(), O_RDONLY | O_CLOEXEC);
+    PCHECK(fd != -1);
+    for (const Mode& mode : modes()) {
+        if (mode.options.hugeTlb) {
+            continue; // Does not apply to file mappings
+        }
+        MappedLineReader::Options options;
+        options.pages = mode.options;
+        t = measure(FLAGS_iterations, &faults, [&] {
+            MappedLineReader reader(fd, options);
+            const char* b;
+            const char* e;
+            uint64_t lines = 0;
+            while (reader.readLine(&b, &e) == MappedLineReader::kReading) {
+                ++lines;
+            }
+            sink = lines;
+        });
+        print(std::string("MappedLineReader ") + mode.name, fileBytes, t, faults);
+    }
+
+    closeNoInt(fd);
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "system_io/PageMemory.h"
+
+#include <sys/resource.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/MappedLineReader.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        long minorFaults() {
+            rusage usage;
+            CHECK_ERR(getrusage(RUSAGE_SELF, &usage));
+            return usage.ru_minflt;
+        }
+
+        // Page faults taken writing every page of buf
+        long touchFaults(const PageBuffer& buf) {
+            long before = minorFaults();
+            for (size_t i = 0; i < buf.size(); i += 4096) {
+                buf.data()[i] = 1;
+            }
+            return minorFaults() - before;
+        }
+
+        TEST(PageMemory, Buffers) {
+            const size_t size = 4 << 20;
+            PageBuffer plain(size);
+            EXPECT_EQ(size, plain.size());
+            EXPECT_FALSE(plain.hugeTlb());
+            long plainFaults = touchFaults(plain);
+            EXPECT_GE(plainFaults, long(size / 4096 / 2));
+
+            // The faults were taken up front
+            PageOptions populate;
+            populate.populate = true;
+            PageBuffer populated(size, populate);
+            EXPECT_LT(touchFaults(populated) * 8, plainFaults);
+
+            // Falls back to transparent huge pages if none are reserved
+            PageOptions huge;
+            huge.hugePages = true;
+            huge.hugeTlb = true;
+            PageBuffer hugeBuf(size + 1, huge);
+            EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(hugeBuf.data()) % kHugePageSize);
+            memset(hugeBuf.data(), 'x', hugeBuf.size());
+
+            PageBuffer moved(std::move(hugeBuf));
+            EXPECT_EQ(nullptr, hugeBuf.data());
+            EXPECT_EQ('x', moved.data()[size]);
+        }
+
+        TEST(PageMemory, ContainersAndMappings) {
+            TemporaryPath path;
+            std::string data;
+            for (int i = 0; i < 100000; ++i) {
+                data += std::to_string(i) + "\n";
+            }
+            ASSERT_TRUE(writeFile(data, path.c_str()));
+
+            PageOptions options;
+            options.hugePages = true;
+            options.populate = true;
+            std::vector<char, PageAllocator<char>> contents{PageAllocator<char>(options)};
+            ASSERT_TRUE(readFile(path.c_str(), contents));
+            EXPECT_EQ(data, std::string(contents.begin(), contents.end()));
+
+            File file(path.path());
+            MappedLineReader::Options readerOptions;
+            readerOptions.windowSize = 64 * 1024;
+            readerOptions.pages = options;
+            MappedLineReader reader(file.fd(), readerOptions);
+            const char* b;
+            const char* e;
+            std::string joined;
+            while (reader.readLines(&b, &e) == MappedLineReader::kReading) {
+                joined.append(b, e);
+            }
+            EXPECT_EQ(data, joined);
+        }
+    }
+}
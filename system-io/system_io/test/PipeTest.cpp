@@ -0,0 +1,188 @@
+#include "system_io/Pipe.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        std::string makeData(size_t n) {
+            std::string data(n, '\0');
+            uint32_t x = 7;
+            for (auto& c : data) {
+                x = x * 1103515245 + 12345;
+                c = char(x >> 16);
+            }
+            return data;
+        }
+
+        File fileWith(const std::string& data) {
+            File f = File::temporary();
+            CHECK_EQ(ssize_t(data.size()), writeFull(f.fd(), data.data(), data.size()));
+            CHECK_ERR(lseek(f.fd(), 0, SEEK_SET));
+            return f;
+        }
+
+        std::string contents(const File& f) {
+            struct stat st;
+            CHECK_ERR(fstat(f.fd(), &st));
+            std::string out(size_t(st.st_size), '\0');
+            CHECK_EQ(st.st_size, preadFull(f.fd(), &out[0], out.size(), 0));
+            return out;
+        }
+
+        std::string readAll(int fd) {
+            std::string out;
+            char buf[4096];
+            ssize_t n;
+            while ((n = readNoInt(fd, buf, sizeof(buf))) > 0) {
+                out.append(buf, size_t(n));
+            }
+            CHECK_ERR(n);
+            return out;
+        }
+
+        TEST(Pipe, MakePipe) {
+            Pipe p = makePipe(1 << 20);
+            EXPECT_LE(size_t(64 * 1024), pipeSize(p.readEnd.fd()));
+            EXPECT_EQ(pipeSize(p.readEnd.fd()), pipeSize(p.writeEnd.fd()));
+
+            // Way over any limit: clamped rather than an error
+            Pipe big = makePipe(size_t(1) << 40);
+            EXPECT_LE(pipeSize(p.readEnd.fd()), pipeSize(big.readEnd.fd()));
+        }
+
+        TEST(Pipe, SpliceFullWithOffsets) {
+            std::string data = makeData(100000);
+            File in = fileWith(data);
+            File out = File::temporary();
+            Pipe p = makePipe(1 << 20);
+
+            loff_t inOff = 1000;
+            ASSERT_EQ(50000, spliceFull(in.fd(), &inOff, p.writeEnd.fd(), nullptr, 50000));
+            EXPECT_EQ(51000, inOff);
+            // The file offset was not used
+            EXPECT_EQ(0, lseek(in.fd(), 0, SEEK_CUR));
+
+            loff_t outOff = 10;
+            ASSERT_EQ(50000, spliceFull(p.readEnd.fd(), nullptr, out.fd(), &outOff, 50000));
+            EXPECT_EQ(50010, outOff);
+            EXPECT_EQ(std::string(10, '\0') + data.substr(1000, 50000), contents(out));
+        }
+
+        TEST(Pipe, SpliceFullStopsAtEof) {
+            std::string data = makeData(5000);
+            File in = fileWith(data);
+            Pipe p = makePipe();
+            EXPECT_EQ(5000, spliceFull(in.fd(), nullptr, p.writeEnd.fd(), nullptr, 10000));
+            p.writeEnd.close();
+            EXPECT_EQ(data, readAll(p.readEnd.fd()));
+        }
+
+        TEST(Pipe, VmspliceAndTee) {
+            std::string a = makeData(3000);
+            std::string b = makeData(5000);
+            Pipe p = makePipe();
+            Pipe copy = makePipe();
+            std::vector<iovec> iov = {{&a[0], a.size()}, {&b[0], b.size()}};
+            ASSERT_EQ(8000, vmspliceFull(p.writeEnd.fd(), iov.data(), int(iov.size())));
+
+            // tee() leaves the data in p
+            ASSERT_EQ(8000, teeNoInt(p.readEnd.fd(), copy.writeEnd.fd(), 8000));
+            p.writeEnd.close();
+            copy.writeEnd.close();
+            EXPECT_EQ(a + b, readAll(p.readEnd.fd()));
+            EXPECT_EQ(a + b, readAll(copy.readEnd.fd()));
+        }
+
+        TEST(Pump, FileToFile) {
+            std::string data = makeData(3 * (1 << 20) + 123);
+            File in = fileWith(data);
+            File out = File::temporary();
+            Pump pump(64 * 1024);
+            EXPECT_EQ(ssize_t(data.size()), pump.run(in.fd(), out.fd()));
+            EXPECT_EQ(data, contents(out));
+            EXPECT_EQ(data.size(), pump.stats().bytesSpliced);
+            EXPECT_EQ(0, pump.stats().bytesCopied);
+
+            // Limited length, continuing from the current offsets
+            CHECK_ERR(lseek(in.fd(), 0, SEEK_SET));
+            File out2 = File::temporary();
+            EXPECT_EQ(1000, pump.run(in.fd(), out2.fd(), 1000));
+            EXPECT_EQ(ssize_t(data.size() - 1000), pump.run(in.fd(), out2.fd()));
+            EXPECT_EQ(data, contents(out2));
+            EXPECT_EQ(0, pump.run(in.fd(), out2.fd()));
+        }
+
+        TEST(Pump, FileToSocketToFile) {
+            std::string data = makeData(2 * (1 << 20) + 7);
+            File in = fileWith(data);
+            File out = File::temporary();
+            int fds[2];
+            CHECK_ERR(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds));
+            File a(fds[0], true);
+            File b(fds[1], true);
+
+            ssize_t sent = -1;
+            std::thread sender([&] {
+                sent = pumpFull(in.fd(), a.fd());
+                a.close();
+            });
+            Pump pump;
+            EXPECT_EQ(ssize_t(data.size()), pump.run(b.fd(), out.fd()));
+            sender.join();
+            EXPECT_EQ(ssize_t(data.size()), sent);
+            EXPECT_EQ(data, contents(out));
+            EXPECT_EQ(0, pump.stats().bytesCopied);
+        }
+
+        TEST(Pump, PipeEndsAreSplicedDirectly) {
+            std::string data = makeData(200000);
+            File in = fileWith(data);
+            Pipe p = makePipe(1 << 20);
+            Pump pump;
+            std::thread writer([&] {
+                EXPECT_EQ(ssize_t(data.size()), pump.run(in.fd(), p.writeEnd.fd()));
+                p.writeEnd.close();
+            });
+            EXPECT_EQ(data, readAll(p.readEnd.fd()));
+            writer.join();
+            EXPECT_EQ(data.size(), pump.stats().bytesSpliced);
+        }
+
+        TEST(Pump, FallsBackToCopying) {
+            // splice() refuses O_APPEND outputs
+            std::string data = makeData(300000);
+            File in = fileWith(data);
+            File tmp = File::temporary();
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/self/fd/%d", tmp.fd());
+            File out(path, O_WRONLY | O_APPEND);
+
+            Pump pump(64 * 1024);
+            EXPECT_EQ(ssize_t(data.size()), pump.run(in.fd(), out.fd()));
+            EXPECT_EQ(data, contents(tmp));
+            EXPECT_EQ(data.size(), pump.stats().bytesCopied);
+
+            // The pipe was left empty
+            File out2 = File::temporary();
+            CHECK_ERR(lseek(in.fd(), 0, SEEK_SET));
+            EXPECT_EQ(ssize_t(data.size()), pump.run(in.fd(), out2.fd()));
+            EXPECT_EQ(data, contents(out2));
+        }
+    }
+}
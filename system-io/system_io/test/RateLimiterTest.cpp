@@ -0,0 +1,169 @@
+#include "system_io/RateLimiter.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/File.h"
+#include "system_io/LineReader.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        double secondsSince(Clock::time_point start) {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        TEST(RateLimiter, Bytes) {
+            RateLimiter::Options options;
+            options.bytesPerSecond = 1 << 20;
+            options.maxChunk = 64 << 10;
+            RateLimiter limiter(options);
+
+            // The first tenth of a second's worth goes through at once, the
+            // rest at the rate
+            File tmp = File::temporary();
+            std::vector<char> data(400 << 10, 'x');
+            auto start = Clock::now();
+            EXPECT_EQ(ssize_t(data.size()),
+                      pwriteFull(tmp.fd(), data.data(), data.size(), 0, limiter));
+            double seconds = secondsSince(start);
+            EXPECT_GE(seconds, 0.25);
+            EXPECT_LT(seconds, 2.0);
+
+            auto stats = limiter.stats();
+            EXPECT_EQ(data.size(), stats.bytes);
+            EXPECT_EQ(7u, stats.ops);
+            EXPECT_GT(stats.throttled[size_t(RateLimiter::Priority::kNormal)], 0u);
+            EXPECT_GT(stats.throttledTime[size_t(RateLimiter::Priority::kNormal)],
+                      std::chrono::milliseconds(200));
+            EXPECT_EQ(0u, stats.throttled[size_t(RateLimiter::Priority::kHigh)]);
+        }
+
+        TEST(RateLimiter, Ops) {
+            RateLimiter::Options options;
+            options.opsPerSecond = 100;
+            options.burstOps = 1;
+            RateLimiter limiter(options);
+
+            // Shared by several threads
+            auto start = Clock::now();
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 3; ++t) {
+                threads.emplace_back([&] {
+                    for (int i = 0; i < 7; ++i) {
+                        limiter.acquire(1 << 20);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            double seconds = secondsSince(start);
+            EXPECT_GE(seconds, 0.19);
+            EXPECT_LT(seconds, 2.0);
+            EXPECT_EQ(21u, limiter.stats().ops);
+        }
+
+        TEST(RateLimiter, Priorities) {
+            RateLimiter::Options options;
+            options.opsPerSecond = 10;
+            options.burstOps = 1;
+            RateLimiter limiter(options);
+            limiter.acquire(0);
+
+            std::atomic<int> done(0);
+            int lowOrder[2] = {-1, -1};
+            int highOrder = -1;
+            std::vector<std::thread> threads;
+            for (int i = 0; i < 2; ++i) {
+                threads.emplace_back([&, i] {
+                    limiter.acquire(0, RateLimiter::Priority::kLow);
+                    lowOrder[i] = done++;
+                });
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+            // Goes ahead of both, although they waited first
+            threads.emplace_back([&] {
+                limiter.acquire(0, RateLimiter::Priority::kHigh);
+                highOrder = done++;
+            });
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            EXPECT_EQ(0, highOrder);
+            EXPECT_EQ(1, lowOrder[0]);
+            EXPECT_EQ(2, lowOrder[1]);
+
+            auto stats = limiter.stats();
+            EXPECT_EQ(2u, stats.throttled[size_t(RateLimiter::Priority::kLow)]);
+            EXPECT_EQ(1u, stats.throttled[size_t(RateLimiter::Priority::kHigh)]);
+            EXPECT_GT(stats.throttledTime[size_t(RateLimiter::Priority::kLow)],
+                      stats.throttledTime[size_t(RateLimiter::Priority::kHigh)]);
+        }
+
+        TEST(RateLimiter, Wrappers) {
+            RateLimiter::Options options;
+            options.bytesPerSecond = 1e9;
+            options.maxChunk = 1000;
+            RateLimiter limiter(options);
+            auto priority = RateLimiter::Priority::kLow;
+
+            std::string contents;
+            for (int i = 0; i < 500; ++i) {
+                contents += "line " + std::to_string(i) + "\n";
+            }
+            TemporaryPath path;
+            iovec iov[2] = {
+                    {&contents[0], 2500},
+                    {&contents[2500], contents.size() - 2500},
+            };
+            writeFileAtomic(path.path(), iov, 2, limiter, priority);
+            // Gathered into writes of maxChunk bytes across the two buffers
+            EXPECT_EQ((contents.size() + 999) / 1000, limiter.stats().ops);
+            EXPECT_EQ(contents.size(), limiter.stats().bytes);
+
+            std::string read;
+            ASSERT_TRUE(readFile(path.c_str(), read, limiter, priority));
+            EXPECT_EQ(contents, read);
+
+            File file(path.path());
+            File copy = File::temporary();
+            EXPECT_EQ(ssize_t(contents.size()), copyFull(file.fd(), copy.fd(), limiter, priority));
+            CHECK_ERR(lseek(copy.fd(), 0, SEEK_SET));
+            read.clear();
+            ASSERT_TRUE(readFile(copy.fd(), read));
+            EXPECT_EQ(contents, read);
+
+            CHECK_ERR(lseek(copy.fd(), 0, SEEK_SET));
+            RateLimitedByteSource source(copy.fd(), limiter, priority);
+            LineReader::Options lineOptions;
+            LineReader lines(source, lineOptions);
+            std::string line;
+            int count = 0;
+            while (lines.readLine(line) == LineReader::kReading) {
+                EXPECT_EQ("line " + std::to_string(count) + "\n", line);
+                ++count;
+            }
+            EXPECT_EQ(500, count);
+
+            auto stats = limiter.stats();
+            EXPECT_GE(stats.bytes, 5 * contents.size());
+            EXPECT_EQ(0u, stats.throttled[size_t(RateLimiter::Priority::kNormal)]);
+        }
+    }
+}
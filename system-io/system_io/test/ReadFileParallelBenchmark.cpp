@@ -0,0 +1,118 @@
+/*
+ * Reading a large file into memory from a cold page cache: readFile(),
+ * which reads it front to back on one thread, against readFileParallel()
+ * and preadParallel() at several queue depths.
+ *
+ * Before each run the file is dropped from the page cache with
+ * POSIX_FADV_DONTNEED, which needs no privileges but only drops clean
+ * pages, hence the fdatasync() after writing it.  Put --dir on the device
+ * to measure; on tmpfs or a VM disk cached by the host, every run is warm.
+ */
+
+#include "system_io/FileUtil.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/File.h"
+#include "system_io/PageMemory.h"
+#include "system_io/test/BenchmarkUtil.h"
+
+DEFINE_int32(size_mb, 2048, "Size of the file in MB");
+DEFINE_int32(chunk_kb, 2048, "Chunk size of the parallel reads in KB");
+DEFINE_int32(iterations, 3, "Runs per measurement; the fastest one is reported");
+DEFINE_string(dir, "/tmp", "Directory for the file, on the device to measure");
+
+using namespace sysio;
+using namespace sysio::test;
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const std::string path = FLAGS_dir + "/ReadFileParallelBenchmark.dat";
+    const size_t size = size_t(FLAGS_size_mb) << 20;
+    {
+        File file(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC);
+        std::string block(1 << 20, '\0');
+        uint64_t x = 88172645463325252ull;
+        for (size_t done = 0; done < size; done += block.size()) {
+            for (char& c : block) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                c = char(x);
+            }
+            PCHECK(writeFull(file.fd(), block.data(), block.size()) == ssize_t(block.size()));
+        }
+        PCHECK(fdatasync(file.fd()) == 0);
+    }
+    File file(path.c_str());
+    auto drop = [&] { PCHECK(posix_fadvise(file.fd(), 0, 0, POSIX_FADV_DONTNEED) == 0); };
+    auto cold = [&](const char* name, const std::function<void()>& read) {
+        double best = 1e300;
+        for (int i = 0; i < FLAGS_iterations; ++i) {
+            drop();
+            best = std::min(best, bestOf(1, read));
+        }
+        printThroughput(name, double(size), best);
+    };
+
+    cold("readFile", [&] {
+        std::string data;
+        CHECK_ERR(lseek(file.fd(), 0, SEEK_SET));
+        PCHECK(readFile(file.fd(), data));
+        CHECK_EQ(size, data.size());
+    });
+
+    ParallelReadOptions options;
+    options.chunkSize = size_t(FLAGS_chunk_kb) << 10;
+    for (size_t threads : {1, 4, 8, 16, 32}) {
+        options.threads = threads;
+        std::string name = "readFileParallel, " + std::to_string(threads) + " threads";
+        cold(name.c_str(), [&] {
+            std::string data;
+            PCHECK(readFileParallel(file.fd(), data, options));
+            CHECK_EQ(size, data.size());
+        });
+    }
+
+    // Without the zero-fill of resizing a string, and with the page faults
+    // of the destination spread over the threads too
+    for (size_t threads : {8, 32}) {
+        options.threads = threads;
+        std::string name = "preadParallel into PageBuffer, " + std::to_string(threads) + " threads";
+        cold(name.c_str(), [&] {
+            PageBuffer buffer(size);
+            CHECK_EQ(ssize_t(size), preadParallel(file.fd(), buffer.data(), size, 0, options));
+        });
+    }
+
+    // And from the page cache, where the copy is all there is to it
+    {
+        std::string data;
+        PCHECK(readFileParallel(file.fd(), data, options));
+    }
+    double t = bestOf(FLAGS_iterations, [&] {
+        std::string data;
+        CHECK_ERR(lseek(file.fd(), 0, SEEK_SET));
+        PCHECK(readFile(file.fd(), data));
+    });
+    printThroughput("readFile, warm", double(size), t);
+    options.threads = 8;
+    t = bestOf(FLAGS_iterations, [&] {
+        PageBuffer buffer(size);
+        CHECK_EQ(ssize_t(size), preadParallel(file.fd(), buffer.data(), size, 0, options));
+    });
+    printThroughput("preadParallel into PageBuffer, 8 threads, warm", double(size), t);
+
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "system_io/RecordLog.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/Crc32c.h"
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        std::string makeRecord(size_t i) {
+            return std::string(i % 37, char('a' + i % 26)) + std::to_string(i);
+        }
+
+        std::vector<std::string> readAll(
+                const std::string& path,
+                RecordLogReader::State expectedEnd = RecordLogReader::kEnd) {
+            RecordLogReader reader(path);
+            std::vector<std::string> records;
+            const char* data;
+            size_t n;
+            RecordLogReader::State state;
+            while ((state = reader.next(&data, &n)) == RecordLogReader::kRecord) {
+                records.emplace_back(data, n);
+            }
+            EXPECT_EQ(expectedEnd, state);
+            return records;
+        }
+
+        off_t fileSize(const std::string& path) {
+            struct stat st;
+            CHECK_ERR(stat(path.c_str(), &st));
+            return st.st_size;
+        }
+
+        TEST(Crc32c, KnownValues) {
+            EXPECT_EQ(0u, crc32c("", 0));
+            EXPECT_EQ(0xE3069283u, crc32c("123456789", 9));
+            std::string data(1000, '\0');
+            for (size_t i = 0; i < data.size(); ++i) {
+                data[i] = char(i * 7);
+            }
+            uint32_t whole = crc32c(data.data(), data.size());
+            // any split point gives the same result
+            for (size_t split : {0, 1, 7, 8, 9, 500, 999, 1000}) {
+                EXPECT_EQ(whole, crc32c(data.data() + split, data.size() - split,
+                                        crc32c(data.data(), split)));
+            }
+        }
+
+        TEST(RecordLog, RoundTrip) {
+            TemporaryPath tmp("RecordLogTest");
+            std::vector<std::string> expected;
+            {
+                RecordLogWriter::Options options;
+                options.batchBytes = 4096;
+                options.copyThreshold = 1000;
+                RecordLogWriter writer(tmp.path(), options);
+                for (size_t i = 0; i < 10000; ++i) {
+                    expected.push_back(makeRecord(i));
+                    if (i % 1000 == 0) {
+                        // large record, written from the caller's buffer
+                        expected.push_back(std::string(5000 + i, 'L'));
+                    }
+                    if (i % 3000 == 0) {
+                        expected.push_back(std::string());
+                    }
+                }
+                for (const auto& record : expected) {
+                    writer.append(record);
+                }
+                writer.sync();
+                EXPECT_EQ(uint64_t(fileSize(tmp.path())), writer.size());
+            }
+            EXPECT_EQ(expected, readAll(tmp.path()));
+        }
+
+        TEST(RecordLog, DestructorFlushes) {
+            TemporaryPath tmp("RecordLogTest");
+            {
+                RecordLogWriter writer(tmp.path());
+                writer.append("hello");
+                writer.append("world");
+            }
+            EXPECT_EQ((std::vector<std::string>{"hello", "world"}), readAll(tmp.path()));
+        }
+
+        TEST(RecordLog, TornTailIsTruncated) {
+            TemporaryPath tmp("RecordLogTest");
+            {
+                RecordLogWriter writer(tmp.path());
+                for (size_t i = 0; i < 100; ++i) {
+                    writer.append(makeRecord(i));
+                }
+            }
+            // cut the last record in half, as a crash mid-write would
+            off_t size = fileSize(tmp.path());
+            CHECK_ERR(truncate(tmp.path().c_str(), size - 10));
+            readAll(tmp.path(), RecordLogReader::kCorrupt);
+
+            RecordLogWriter writer(tmp.path());
+            EXPECT_EQ(99u, writer.recovery().recordsRecovered);
+            EXPECT_LT(0u, writer.recovery().truncatedBytes);
+            writer.append("after recovery");
+            writer.flush();
+
+            auto records = readAll(tmp.path());
+            ASSERT_EQ(100u, records.size());
+            EXPECT_EQ(makeRecord(98), records[98]);
+            EXPECT_EQ("after recovery", records[99]);
+        }
+
+        TEST(RecordLog, CorruptionIsDetected) {
+            TemporaryPath tmp("RecordLogTest");
+            {
+                RecordLogWriter writer(tmp.path());
+                for (size_t i = 0; i < 100; ++i) {
+                    writer.append(makeRecord(i));
+                }
+            }
+            RecordLogReader before(tmp.path());
+            const char* data;
+            size_t n;
+            for (size_t i = 0; i < 50; ++i) {
+                ASSERT_EQ(RecordLogReader::kRecord, before.next(&data, &n));
+            }
+            uint64_t corruptAt = before.offset();
+
+            File f(tmp.path(), O_RDWR);
+            char byte = 0;
+            ASSERT_EQ(1, preadFull(f.fd(), &byte, 1, off_t(corruptAt + 9)));
+            byte ^= 0x20;
+            ASSERT_EQ(1, pwriteFull(f.fd(), &byte, 1, off_t(corruptAt + 9)));
+
+            RecordLogReader reader(tmp.path());
+            for (size_t i = 0; i < 50; ++i) {
+                ASSERT_EQ(RecordLogReader::kRecord, reader.next(&data, &n));
+                EXPECT_EQ(makeRecord(i), std::string(data, n));
+            }
+            EXPECT_EQ(RecordLogReader::kCorrupt, reader.next(&data, &n));
+            EXPECT_EQ(corruptAt, reader.offset());
+        }
+
+        TEST(RecordLog, RecoveryScansOnlyUnsyncedTail) {
+            TemporaryPath tmp("RecordLogTest");
+            uint64_t synced;
+            {
+                RecordLogWriter writer(tmp.path());
+                for (size_t i = 0; i < 50000; ++i) {
+                    writer.append(makeRecord(i));
+                }
+                writer.sync();
+                synced = writer.size();
+                for (size_t i = 0; i < 10; ++i) {
+                    writer.append(makeRecord(i));
+                }
+            }
+            RecordLogWriter writer(tmp.path());
+            EXPECT_EQ(synced, writer.recovery().scanStart);
+            EXPECT_EQ(10u, writer.recovery().recordsRecovered);
+            EXPECT_EQ(0u, writer.recovery().truncatedBytes);
+            EXPECT_EQ(50010u, readAll(tmp.path()).size());
+        }
+
+        TEST(RecordLog, NotALog) {
+            TemporaryPath tmp("RecordLogTest");
+            std::string junk(100, 'x');
+            {
+                File f(tmp.path(), O_WRONLY | O_CREAT);
+                ASSERT_EQ(ssize_t(junk.size()), writeFull(f.fd(), junk.data(), junk.size()));
+            }
+            EXPECT_THROW(RecordLogWriter writer(tmp.path()), std::system_error);
+            EXPECT_THROW(RecordLogReader reader(tmp.path()), std::system_error);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef SYSTEM_IO_TEST_TESTUTIL_H
+#define SYSTEM_IO_TEST_TESTUTIL_H
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+#include <glog/logging.h>
+
+namespace sysio
+{
+    namespace test
+    {
+        /*
+         * A unique path under /tmp that does not exist yet, and is unlinked
+         * when the object goes out of scope.
+         */
+        class TemporaryPath
+        {
+        public:
+            explicit TemporaryPath(const char* prefix = "system_io") {
+                std::string name = std::string("/tmp/") + prefix + ".XXXXXX";
+                int fd = mkstemp(&name[0]);
+                CHECK_ERR(fd);
+                ::close(fd);
+                ::unlink(name.c_str());
+                path_ = name;
+            }
+
+            TemporaryPath(const TemporaryPath&) = delete;
+            TemporaryPath& operator=(const TemporaryPath&) = delete;
+
+            ~TemporaryPath() {
+                ::unlink(path_.c_str());
+            }
+
+            const std::string& path() const {
+                return path_;
+            }
+
+            const char* c_str() const {
+                return path_.c_str();
+            }
+
+        private:
+            std::string path_;
+        };
+
+        /*
+         * A temporary directory, removed with its contents when the object
+         * goes out of scope.
+         */
+        class TemporaryDirectory
+        {
+        public:
+            TemporaryDirectory() {
+                CHECK_ERR(mkdir(path_.c_str(), 0755));
+            }
+
+            ~TemporaryDirectory() {
+                std::string cmd = "rm -rf " + path_.path();
+                CHECK_ERR(system(cmd.c_str()));
+            }
+
+            const std::string& path() const {
+                return path_.path();
+            }
+
+        private:
+            TemporaryPath path_;
+        };
+    }
+}
+
+#endif //SYSTEM_IO_TEST_TESTUTIL_H
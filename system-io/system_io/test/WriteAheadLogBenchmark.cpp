@@ -0,0 +1,117 @@
+/*
+ * Durable append throughput and commit latency with 1 to 64 producer
+ * threads: WriteAheadLog's group commit against each producer doing its own
+ * writeFull() + fdatasync() under a lock.
+ *
+ * Each producer appends --records records one at a time, waiting for each
+ * to be durable.  Run with --dir on the disk of interest: on tmpfs,
+ * fdatasync() costs nothing and there is nothing to share.
+ */
+
+#include "system_io/WriteAheadLog.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "system_io/File.h"
+#include "system_io/FileUtil.h"
+
+DEFINE_string(producers, "1,2,4,8,16,32,64", "Producer thread counts to run");
+DEFINE_int32(records, 200, "Records appended by each producer");
+DEFINE_int32(record_size, 128, "Bytes per record");
+DEFINE_string(dir, ".", "Directory for the log; should be on a real disk");
+
+using namespace sysio;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Runs producers threads that each call commit() --records times, and
+    // prints throughput and latency percentiles
+    template <class F>
+    void run(const char* name, int producers, F commit) {
+        std::vector<std::vector<double>> latencies(static_cast<size_t>(producers));
+        std::vector<std::thread> threads;
+        auto start = Clock::now();
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                std::string record(size_t(FLAGS_record_size), char('a' + p % 26));
+                auto& mine = latencies[size_t(p)];
+                mine.reserve(size_t(FLAGS_records));
+                for (int i = 0; i < FLAGS_records; ++i) {
+                    auto before = Clock::now();
+                    commit(record);
+                    std::chrono::duration<double, std::micro> us = Clock::now() - before;
+                    mine.push_back(us.count());
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+
+        std::vector<double> all;
+        for (auto& l : latencies) {
+            all.insert(all.end(), l.begin(), l.end());
+        }
+        std::sort(all.begin(), all.end());
+        auto percentile = [&](double q) {
+            return all[std::min(all.size() - 1, size_t(q * double(all.size())))];
+        };
+        printf("%-16s %4d producers %10.0f commits/s   p50 %9.1f us   p99 %9.1f us\n",
+               name, producers, double(all.size()) / elapsed.count(),
+               percentile(0.5), percentile(0.99));
+    }
+}
+
+int main(int argc, char** argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    const std::string path = FLAGS_dir + "/WriteAheadLogBenchmark.log";
+    std::vector<int> counts;
+    std::stringstream list(FLAGS_producers);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        counts.push_back(atoi(item.c_str()));
+    }
+
+    for (int producers : counts) {
+        unlink(path.c_str());
+        {
+            File file(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC);
+            std::mutex mutex;
+            run("write + sync", producers, [&](const std::string& record) {
+                std::lock_guard<std::mutex> lock(mutex);
+                PCHECK(writeFull(file.fd(), record.data(), record.size()) == ssize_t(record.size()));
+                PCHECK(fdatasync(file.fd()) == 0);
+            });
+        }
+
+        unlink(path.c_str());
+        {
+            WriteAheadLog wal(path);
+            run("WriteAheadLog", producers, [&](const std::string& record) {
+                wal.append(record).get();
+            });
+            auto stats = wal.stats();
+            printf("%-16s %4s %9.1f records per fdatasync, at most %lu\n", "", "",
+                   double(stats.records) / double(stats.syncs),
+                   static_cast<unsigned long>(stats.maxBatchRecords));
+        }
+    }
+    unlink(path.c_str());
+    return 0;
+}
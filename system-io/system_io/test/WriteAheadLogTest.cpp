@@ -0,0 +1,138 @@
+#include "system_io/WriteAheadLog.h"
+
+#include <sys/resource.h>
+#include <csignal>
+
+#include <future>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "system_io/RecordLog.h"
+#include "system_io/test/TestUtil.h"
+
+
+using namespace sysio;
+
+namespace sysio
+{
+    namespace test
+    {
+        std::vector<std::string> readAll(const std::string& path) {
+            RecordLogReader reader(path);
+            std::vector<std::string> records;
+            const char* data;
+            size_t n;
+            while (reader.next(&data, &n) == RecordLogReader::kRecord) {
+                records.emplace_back(data, n);
+            }
+            return records;
+        }
+
+        TEST(WriteAheadLog, ConcurrentAppends) {
+            TemporaryPath path;
+            const int kThreads = 4;
+            const int kRecords = 500;
+            std::vector<std::vector<uint64_t>> lsns(kThreads);
+            uint64_t durable;
+            {
+                WriteAheadLog wal(path.path());
+                EXPECT_EQ(kRecordLogHeaderSize, wal.durableLsn());
+                std::vector<std::thread> threads;
+                for (int t = 0; t < kThreads; ++t) {
+                    threads.emplace_back([&, t] {
+                        std::vector<std::future<uint64_t>> futures;
+                        for (int i = 0; i < kRecords; ++i) {
+                            futures.push_back(wal.append(std::to_string(t) + ":" + std::to_string(i)));
+                        }
+                        for (auto& future : futures) {
+                            lsns[size_t(t)].push_back(future.get());
+                        }
+                    });
+                }
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                durable = wal.durableLsn();
+                auto stats = wal.stats();
+                EXPECT_EQ(uint64_t(kThreads * kRecords), stats.records);
+                EXPECT_LE(stats.syncs, stats.records);
+                EXPECT_GE(stats.maxBatchRecords, 1u);
+            }
+
+            // Each producer's records are in order, and every LSN is unique
+            std::set<uint64_t> all;
+            for (auto& threadLsns : lsns) {
+                for (size_t i = 1; i < threadLsns.size(); ++i) {
+                    EXPECT_LT(threadLsns[i - 1], threadLsns[i]);
+                }
+                all.insert(threadLsns.begin(), threadLsns.end());
+                EXPECT_LE(threadLsns.back(), durable);
+            }
+            EXPECT_EQ(size_t(kThreads * kRecords), all.size());
+            EXPECT_EQ(durable, *all.rbegin());
+
+            auto records = readAll(path.path());
+            ASSERT_EQ(size_t(kThreads * kRecords), records.size());
+            std::set<std::string> unique(records.begin(), records.end());
+            EXPECT_EQ(records.size(), unique.size());
+            EXPECT_EQ(1u, unique.count("3:499"));
+        }
+
+        TEST(WriteAheadLog, BatchLimitAndReopen) {
+            TemporaryPath path;
+            WriteAheadLog::Options options;
+            options.maxBatchBytes = 1;
+            uint64_t last;
+            {
+                WriteAheadLog wal(path.path(), options);
+                std::vector<std::future<uint64_t>> futures;
+                for (int i = 0; i < 20; ++i) {
+                    futures.push_back(wal.append(std::string(10, char('a' + i))));
+                }
+                for (auto& future : futures) {
+                    last = future.get();
+                }
+                // One record per sync
+                EXPECT_EQ(20u, wal.stats().syncs);
+                EXPECT_EQ(200u, wal.stats().bytes);
+            }
+
+            WriteAheadLog wal(path.path());
+            EXPECT_EQ(last, wal.durableLsn());
+            EXPECT_EQ(last + kRecordFrameHeaderSize + 3, wal.append("end", 3).get());
+            EXPECT_EQ(21u, readAll(path.path()).size());
+        }
+
+        TEST(WriteAheadLog, FailedWritesFailLaterRecords) {
+            TemporaryPath path;
+            WriteAheadLog wal(path.path());
+            ASSERT_EQ(kRecordLogHeaderSize + 9, wal.append("x").get());
+
+            // Writes past the file size limit fail with EFBIG
+            auto oldHandler = signal(SIGXFSZ, SIG_IGN);
+            rlimit old;
+            ASSERT_EQ(0, getrlimit(RLIMIT_FSIZE, &old));
+            rlimit limit = old;
+            limit.rlim_cur = 4096;
+            ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &limit));
+            auto big = wal.append(std::string(8192, 'b'));
+            try {
+                big.get();
+                ADD_FAILURE() << "expected an error";
+            } catch (const std::system_error& e) {
+                EXPECT_EQ(EFBIG, e.code().value());
+            }
+            ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &old));
+            signal(SIGXFSZ, oldHandler);
+
+            EXPECT_THROW(wal.append("y").get(), std::system_error);
+            EXPECT_EQ(kRecordLogHeaderSize + 9, wal.durableLsn());
+        }
+    }
+}